@@ -97,6 +97,14 @@ namespace Foundation
         //! Returns information about current asset transfers
         virtual AssetTransferInfoVector GetTransferInfo() = 0;
 
+        //! Sets download priority of an asset transfer, requested or in progress
+        /*! Providers that can not reorder their transfers ignore this.
+            \param asset_id Asset ID
+            \param priority Priority, higher is downloaded first
+            \param discard_level For textures, the coarsest JPEG2000 resolution level that is needed, 0 for the whole texture
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, float priority, int discard_level) {};
+
         //! Sets current protocolmodule
         virtual void SetCurrentProtocolModule(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> protocolModule) {};
 
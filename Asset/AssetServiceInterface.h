@@ -89,6 +89,17 @@ namespace Foundation
          */
         virtual bool QueryAssetStatus(const std::string& asset_id, uint& size, uint& received, uint& received_continuous) = 0;
 
+        //! Sets download priority of an asset transfer
+        /*! Passed on to the asset providers; the ones that support it download higher priority assets first.
+            Can be called repeatedly as the priority changes.
+
+            \param asset_id Asset ID, UUID for legacy UDP assets
+            \param priority Priority, higher is downloaded first
+            \param discard_level For textures, the coarsest JPEG2000 resolution level that is needed. The provider may
+                   stop the download once it has the data for that level. 0 downloads the whole texture.
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, float priority, int discard_level) = 0;
+
         //! Gets information about current status of asset memory cache
         virtual AssetCacheInfoMap GetAssetCacheInfo() = 0;
 
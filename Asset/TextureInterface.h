@@ -6,6 +6,8 @@
 #include "ResourceInterface.h"
 #include "CoreModuleApi.h"
 
+#include <vector>
+
 namespace Foundation
 {
     class TextureInterface;    
@@ -36,15 +38,33 @@ namespace Foundation
         virtual int GetLevel() const = 0;
 
         //! returns data
-        /*! each pixel of each component should be encoded as a u8, so data size should be width * height * components
+        /*! each pixel of each component should be encoded as a u8, so data size should be width * height * components.
+            For block compressed formats the data holds the compressed image, followed by GetNumMipmaps() smaller levels.
+            The data may be mapped read-only from a cache, so it must not be written to.
          */
-        virtual u8* GetData() = 0;
+        virtual const u8* GetData() = 0;
 
         //! Get data size
         virtual uint GetDataSize() = 0;
 
         //! Get ogre image pixel format
         virtual int GetFormat() = 0;
+
+        //! returns number of mipmap levels in the data after the full size image, 0 if none
+        virtual uint GetNumMipmaps() const { return 0; }
+
+        //! returns the full size image as width * height * components u8s, decompressing it if the data is block compressed
+        /*! \param pixels [out] pixel data
+            \return true if successful
+         */
+        virtual bool GetPixels(std::vector<u8>& pixels)
+        {
+            uint size = GetWidth() * GetHeight() * GetComponents();
+            if ((!size) || (GetDataSize() < size))
+                return false;
+            pixels.assign(GetData(), GetData() + size);
+            return true;
+        }
     };
 }
 
@@ -34,6 +34,16 @@ namespace Foundation
          */
         virtual request_tag_t RequestTexture(const std::string& asset_id) = 0;
 
+        //! Sets priority of a texture request, and the size the texture is drawn at
+        /*! Requests are downloaded and decoded in priority order. A texture is decoded, and downloaded if the asset
+            provider supports it, only up to the resolution level that covers the drawn size; a larger size later
+            resumes the request. Meant to be called repeatedly by the renderer as the view changes.
+            \param asset_id texture ID
+            \param priority priority, higher is served first
+            \param screen_size largest size the texture is drawn at in pixels, 0 if not known (decode the full resolution)
+         */
+        virtual void SetTexturePriority(const std::string& asset_id, float priority, uint screen_size) = 0;
+
         //! Gets a texture rousource from cache
         //! @param texture_id as std::string
         //! @return valid ptr if found, 0 ptr if not
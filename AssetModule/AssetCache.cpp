@@ -10,18 +10,25 @@
 #include "Platform.h"
 #include "ConfigurationManager.h"
 #include "UiSettingsServiceInterface.h"
+#include "FrameScheduler.h"
 
 #include <QCryptographicHash>
+#include <QFile>
 #include <QString>
 #include <QSettings>
 #include <QMessageBox>
 
+#include <boost/bind.hpp>
+
 namespace Asset
 {
     const char *DEFAULT_ASSET_CACHE_PATH = "/assetcache";
+    const char *EXTRACTED_ASSETS_PATH = "/files";
     const int DEFAULT_MEMORY_CACHE_SIZE = 32 * 1024 * 1024;
     const f64 CACHE_CHECK_INTERVAL = 1.0;
     const int CACHE_MAX_DELETES = 10;
+    const std::string CACHE_COMPACTION_STAGE("AssetCacheCompaction");
+    const f64 CACHE_COMPACTION_SHARE = 0.02;
 
     AssetCache::AssetCache(Foundation::Framework* framework) :
         framework_(framework),
@@ -44,13 +51,22 @@ namespace Asset
         // Init disk
         InitDiskCaching();
 
-        // Read both disk caches 
-        CheckDiskCache(cache_path_);
+        // Open the disk cache, and index the local cache
+        store_.reset(new Foundation::PackStore(cache_path_.c_str(), "assets"));
+        if (store_->IsNew())
+            ImportLooseFiles();
         CheckDiskCache(local_cache_path);
+        CheckDiskCacheSize(false);
+
+        framework_->GetFrameScheduler()->AddStage(CACHE_COMPACTION_STAGE, CACHE_COMPACTION_SHARE,
+            boost::bind(&AssetCache::CompactDiskCache, this, _1, _2));
     }
 
     AssetCache::~AssetCache()
     {
+        Foundation::FrameSchedulerPtr scheduler = framework_->GetFrameScheduler();
+        if (scheduler)
+            scheduler->RemoveStage(CACHE_COMPACTION_STAGE);
     }
 
     void AssetCache::InitDiskCaching()
@@ -77,35 +93,26 @@ namespace Asset
 
     void AssetCache::ClearDiskCache()
     {
-        QFileInfoList file_list = cache_dir_.entryInfoList(QDir::Files);
-        if (file_list.count() > 0)
-        {
-            int removed_files = 0;
-            qint64 removed_bytes = 0;
-            
-            foreach(QFileInfo file_info, file_list)
-            {
-                QString native_absolute_path = file_info.absoluteFilePath().replace("/", QDir::separator());
-                qint64 file_size = file_info.size();
-                if (!cache_dir_.remove(file_info.fileName()))
-                    continue;
-                
-                removed_files++;
-                removed_bytes += file_size;
+        // Files extracted for GetAbsoluteFilePath() go too
+        QDir extracted_dir(QString((cache_path_ + EXTRACTED_ASSETS_PATH).c_str()));
+        QFileInfoList extracted_files = extracted_dir.entryInfoList(QDir::Files);
+        foreach(QFileInfo file_info, extracted_files)
+            extracted_dir.remove(file_info.fileName());
 
-                std::set<std::string>::iterator find_result = disk_cache_contents_.find(native_absolute_path.toStdString());
-                if (find_result != disk_cache_contents_.end())
-                    disk_cache_contents_.erase(find_result);
-            }
+        if (store_->GetNumRecords() > 0)
+        {
+            uint removed_files = store_->GetNumRecords();
+            u64 removed_bytes = store_->GetLiveBytes();
+            store_->Clear();
 
             // Notify user
             qreal removed_bytes_f = removed_bytes;
             QString mb_string = QString::number(((removed_bytes_f/1024)/1024));
             mb_string = mb_string.left(mb_string.indexOf(".")+3);
-            QMessageBox::information(0, "Asset Cache", QString("Asset cache cleared, removed %1 files total of " + mb_string + " mb").arg(removed_files));
+            QMessageBox::information(0, "Asset Cache", QString("Asset cache cleared, removed %1 assets total of " + mb_string + " mb").arg(removed_files));
         }
         else
-            QMessageBox::information(0, "Asset Cache", "There are currently no files in asset cache");
+            QMessageBox::information(0, "Asset Cache", "There are currently no assets in asset cache");
     }
 
     void AssetCache::CacheConfigChanged(int new_disk_max_size)
@@ -119,47 +126,34 @@ namespace Asset
 
     void AssetCache::CheckDiskCacheSize(bool make_extra_space)
     {
-        if (disk_cache_max_size_ == 0)
-            return;
-
-        int current_size = 0;
-        QFileInfoList file_list = cache_dir_.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
-        foreach(QFileInfo file, file_list)
-            current_size += file.size();
-
-        if (current_size > disk_cache_max_size_)
+        if (disk_cache_max_size_ != 0 && store_->GetLiveBytes() > (u64)disk_cache_max_size_)
         {
-            int removed_files = 0;
-            qint64 removed_bytes = 0;
-
             int aimed_size = disk_cache_max_size_;
             if (make_extra_space)
                 aimed_size -= (2*1024*1024);
+            if (aimed_size < 0)
+                aimed_size = 0;
 
-            foreach(QFileInfo file_info, file_list)
-            {
-                QString native_absolute_path = file_info.absoluteFilePath().replace("/", QDir::separator());
-                qint64 file_size = file_info.size();
-                if (!cache_dir_.remove(file_info.fileName()))
-                    continue;
-                
-                removed_files++;
-                removed_bytes += file_size;
-                current_size -= file_size;
-
-                std::set<std::string>::iterator find_result = disk_cache_contents_.find(native_absolute_path.toStdString());
-                if (find_result != disk_cache_contents_.end())
-                    disk_cache_contents_.erase(find_result);
-
-                if (current_size < aimed_size)
-                    break;
-            }
+            // Least recently used first
+            u64 removed_bytes = 0;
+            uint removed_files = store_->Trim(aimed_size, &removed_bytes);
 
             AssetModule::LogInfo("Asset cache was over limit. Removed " + QString::number(removed_files).toStdString() + 
-                " files, total of " + QString::number(removed_bytes).toStdString() + " bytes");
+                " assets, total of " + QString::number(removed_bytes).toStdString() + " bytes");
+
+            if (removed_files)
+                TrimExtractedFiles();
         }
     }
 
+    bool AssetCache::CompactDiskCache(f64 frametime, const Foundation::FrameBudget& budget)
+    {
+        // Copying all live assets takes seconds for a large cache, so it is spread over frames
+        if ((!store_->IsCompacting()) && (!store_->NeedsCompaction()))
+            return true;
+        return store_->Compact(budget);
+    }
+
     void AssetCache::CheckDiskCache(const std::string& path)
     {
         try
@@ -169,7 +163,11 @@ namespace Asset
             while (i != end_iter)
             {
                 if (boost::filesystem::is_regular_file(i->status()))
-                    disk_cache_contents_.insert(i->path().native_directory_string());
+                {
+                    // File names are of the form hash.type
+                    std::string file_name = i->path().leaf();
+                    local_cache_files_[file_name.substr(0, file_name.find('.'))] = i->path().native_directory_string();
+                }
                 ++i;
             }
         }
@@ -262,17 +260,23 @@ namespace Asset
         
         if (check_disk)
         {
-            std::set<std::string>::iterator i = disk_cache_contents_.begin();
-            while (i != disk_cache_contents_.end())
+            // The asset data is used straight from the pack file
+            Foundation::PackBlob record = store_->Load(asset_hash);
+            if ((!record.IsNull()) && (asset_type.empty() || record.GetTag() == asset_type))
             {
-                if ((i->find(asset_hash) != std::string::npos) && (asset_type.empty() || i->find(asset_type) != std::string::npos))
-                    break;
-                ++i;
+                RexAsset* new_asset = new RexAsset(asset_id, record.GetTag());
+                new_asset->SetStorage(record);
+                assets_[asset_id] = Foundation::AssetPtr(new_asset);
+                return assets_[asset_id];
             }
-            
-            if (i != disk_cache_contents_.end())
+
+            boost::unordered_map<std::string, std::string>::iterator i = local_cache_files_.find(asset_hash);
+            if ((i != local_cache_files_.end()) && (!asset_type.empty()) && (i->second.find(asset_type) == std::string::npos))
+                i = local_cache_files_.end();
+
+            if (i != local_cache_files_.end())
             {
-                boost::filesystem::path file_path(*i);
+                boost::filesystem::path file_path(i->second);
                 std::ifstream filestr(file_path.native_directory_string().c_str(), std::ios::in | std::ios::binary);
                 if (filestr.good())
                 {
@@ -281,12 +285,12 @@ namespace Asset
                     filestr.seekg(0, std::ios::beg);
                     
                     // Identify assettype from end of cached asset name
-                    StringVector assetNameType = SplitString(*i, '.');
+                    StringVector assetNameType = SplitString(i->second, '.');
                     if (assetNameType.size() < 2)
                     {
-                        AssetModule::LogDebug("Malformed assetcache filename " + *i);
+                        AssetModule::LogDebug("Malformed assetcache filename " + i->second);
                         filestr.close();
-                        disk_cache_contents_.erase(i);
+                        local_cache_files_.erase(i);
                         return Foundation::AssetPtr();
                     }
                     
@@ -304,7 +308,7 @@ namespace Asset
                 else
                 {
                     // File got deleted by someone else while program was running, or something, do not re-check
-                    disk_cache_contents_.erase(i);
+                    local_cache_files_.erase(i);
                 }
             }
         }
@@ -324,24 +328,13 @@ namespace Asset
         if (!store_to_disk)
             return;
         
-        // Store to disk cache
-        const std::string& type = asset->GetType();
-        boost::filesystem::path file_path(cache_path_ + "/" + GetHash(asset_id) + "." + type);
-        std::ofstream filestr(file_path.native_directory_string().c_str(), std::ios::out | std::ios::binary);
-        if (filestr.good())
-        {
-            const u8* data = asset->GetData();
-            uint size = asset->GetSize();
-            
-            filestr.write((const char *)&data[0], size);
-            filestr.close();
-
-            disk_cache_contents_.insert(file_path.native_directory_string());
-        }
+        // Store to disk cache. A file copy of the previous data would be stale
+        std::string asset_hash = GetHash(asset_id);
+        RemoveExtractedFile(asset_hash, asset->GetType());
+        if (store_->Store(asset_hash, asset->GetType(), asset->GetData(), asset->GetSize()))
+            disk_changes_after_last_check_ = true;
         else
-        {
             AssetModule::LogError("Error storing asset " + asset_id + " to cache.");
-        }
     }
 
     bool AssetCache::DeleteAsset(Foundation::AssetPtr asset)
@@ -349,39 +342,96 @@ namespace Asset
         const std::string& asset_id = asset->GetId();
 
         // Delete from disk cache
-        const std::string& type = asset->GetType();
-        boost::filesystem::path file_path(cache_path_ + "/" + GetHash(asset_id)  + "." + type);
-        if (boost::filesystem::exists(file_path))
+        std::string asset_hash = GetHash(asset_id);
+        RemoveExtractedFile(asset_hash, asset->GetType());
+        if (store_->Remove(asset_hash))
         {
-            if (boost::filesystem::remove(file_path))
-            {
-                AssetModule::LogDebug("Removed asset " + asset_id + " from cache");
+            AssetModule::LogDebug("Removed asset " + asset_id + " from cache");
+            assets_.erase(asset_id);
+            disk_changes_after_last_check_ = true;
+        }
+        else
+            AssetModule::LogDebug("Asset " + asset_id + " is not in disk cache, could not delete from cache.");
+        return true;
+    }
 
-                std::set<std::string>::iterator find_result = disk_cache_contents_.find(file_path.native_directory_string());
-                if (find_result != disk_cache_contents_.end())
-                    disk_cache_contents_.erase(find_result);
+    std::string AssetCache::GetAbsoluteFilePath(const std::string& asset_id, const std::string& asset_type)
+    {
+        std::string asset_hash = GetHash(asset_id);
+        boost::unordered_map<std::string, std::string>::const_iterator i = local_cache_files_.find(asset_hash);
+        if (i != local_cache_files_.end())
+            return i->second;
 
-                assets_.erase(asset_id);
-                disk_changes_after_last_check_ = true;
+        // Disk cached assets live in the pack file; write a file copy for callers that need a path
+        std::string file_path = cache_path_ + EXTRACTED_ASSETS_PATH + "/" + asset_hash + "." + asset_type;
+        if (!boost::filesystem::exists(file_path))
+        {
+            Foundation::PackBlob record = store_->Load(asset_hash);
+            if (record.IsNull())
+                return file_path;
 
-                return true;
-            }
-            else
+            boost::filesystem::create_directory(cache_path_ + EXTRACTED_ASSETS_PATH);
+            std::ofstream filestr(file_path.c_str(), std::ios::out | std::ios::binary);
+            if (filestr.good())
             {
-                AssetModule::LogDebug("Could not removed asset " + asset_id + " from cache");
-                return false;
+                filestr.write((const char *)record.GetData(), record.GetSize());
+                filestr.close();
             }
+            else
+                AssetModule::LogError("Error writing asset " + asset_id + " from cache to file.");
         }
-        else
+        return file_path;
+    }
+
+    void AssetCache::RemoveExtractedFile(const std::string& asset_hash, const std::string& asset_type)
+    {
+        // Same name as in GetAbsoluteFilePath(), so no directory scan is needed
+        QFile::remove(QString((cache_path_ + EXTRACTED_ASSETS_PATH + "/" + asset_hash + "." + asset_type).c_str()));
+    }
+
+    void AssetCache::TrimExtractedFiles()
+    {
+        QDir extracted_dir(QString((cache_path_ + EXTRACTED_ASSETS_PATH).c_str()));
+        QStringList files = extracted_dir.entryList(QDir::Files);
+        foreach(QString file, files)
         {
-            AssetModule::LogDebug("File " + file_path.string() + " does not exist, could not delete from cache.");
-            return true;
+            if (!store_->Contains(file.left(file.indexOf('.')).toStdString()))
+                extracted_dir.remove(file);
         }
     }
 
-    std::string AssetCache::GetAbsoluteFilePath(const std::string& asset_id, const std::string& asset_type)
+    void AssetCache::ImportLooseFiles()
     {
-        return cache_path_ + "/" + GetHash(asset_id)  + "." + asset_type;
+        QFileInfoList file_list = cache_dir_.entryInfoList(QDir::Files);
+        if (file_list.isEmpty())
+            return;
+
+        int imported = 0;
+        foreach(QFileInfo file_info, file_list)
+        {
+            // File names are of the form hash.type, where hash is 32 hex digits. This skips the pack store files.
+            QString file_name = file_info.fileName();
+            int dot = file_name.indexOf('.');
+            if (dot != 32)
+                continue;
+            QString type = file_name.mid(dot + 1);
+            if ((type.isEmpty()) || (type.contains('.')))
+                continue;
+
+            QFile file(file_info.absoluteFilePath());
+            if (!file.open(QIODevice::ReadOnly))
+                continue;
+            QByteArray data = file.readAll();
+            file.close();
+
+            if (store_->Store(file_name.left(dot).toStdString(), type.toStdString(), (const u8 *)data.constData(), data.size()))
+            {
+                cache_dir_.remove(file_name);
+                ++imported;
+            }
+        }
+
+        AssetModule::LogInfo("Imported " + QString::number(imported).toStdString() + " assets to the asset cache pack");
     }
 
     std::string AssetCache::GetHash(const std::string &asset_id)
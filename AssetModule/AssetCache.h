@@ -5,10 +5,14 @@
 
 #include "Foundation.h"
 #include "AssetInterface.h"
+#include "PackStore.h"
 
 #include <QObject>
 #include <QDir>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
 namespace Asset
 {
     //! Stores assets to memory and/or disk based cache. Created and used by AssetManager.
@@ -67,11 +71,28 @@ namespace Asset
         //! Read config and init QDir to working directory
         void ReadConfig();
 
-        //! Check contents of a disk cache path
-        /*! \param path Disk cache path
+        //! Indexes the files of a read-only local cache path
+        /*! \param path Local cache path
          */
         void CheckDiskCache(const std::string& path);
 
+        //! Moves assets cached as individual files by earlier versions into the pack store
+        void ImportLooseFiles();
+
+        //! Deletes the file copy written by GetAbsoluteFilePath() of an asset
+        /*! \param asset_hash Hash of the asset id
+            \param asset_type Type of the asset, the extension of the file
+         */
+        void RemoveExtractedFile(const std::string& asset_hash, const std::string& asset_type);
+
+        //! Deletes the file copies of assets that are no longer in the disk cache
+        void TrimExtractedFiles();
+
+        //! Compacts the disk cache a few assets at a time. Run as the AssetCacheCompaction frame stage
+        /*! \return true if no compaction is left in progress
+         */
+        bool CompactDiskCache(f64 frametime, const Foundation::FrameBudget& budget);
+
         //! Calculates hash from given asset id
         //! Used for file name generation
         std::string GetHash(const std::string &asset_id);
@@ -88,9 +109,12 @@ namespace Asset
         //! Update time accumulator
         f64 update_time_;
 
-        //! Assets known to be in disk cache
-        //! Values are hash values from asset id's
-        std::set<std::string> disk_cache_contents_;
+        //! Disk cache, keyed by asset id hash, tagged with asset type
+        boost::scoped_ptr<Foundation::PackStore> store_;
+
+        //! Files of the local read-only cache
+        //! Keys are hash values from asset id's, values are file paths
+        boost::unordered_map<std::string, std::string> local_cache_files_;
 
         //! Framework
         Foundation::Framework* framework_;
@@ -130,6 +130,17 @@ namespace Asset
         return false;
     }
 
+    void AssetManager::SetAssetPriority(const std::string& asset_id, float priority, int discard_level)
+    {
+        // The request may still be queued inside a provider, not yet in progress, so let each provider look it up
+        AssetProviderVector::iterator i = providers_.begin();
+        while (i != providers_.end())
+        {
+            (*i)->SetAssetPriority(asset_id, priority, discard_level);
+            ++i;
+        }
+    }
+
     void AssetManager::StoreAsset(Foundation::AssetPtr asset, bool store_to_disk)
     {
         cache_->StoreAsset(asset, store_to_disk);
@@ -81,6 +81,14 @@ namespace Asset
             \return true if asset was found either in cache or as a transfer in progress, and variables have been filled, false if not found
          */
         virtual bool QueryAssetStatus(const std::string& asset_id, uint& size, uint& received, uint& received_continuous);
+
+        //! Sets download priority of an asset transfer
+        /*! Passed on to all asset providers.
+            \param asset_id Asset ID, UUID for legacy UDP assets
+            \param priority Priority, higher is downloaded first
+            \param discard_level For textures, the coarsest resolution level needed, 0 for the whole texture
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, float priority, int discard_level);
         
         //! Gets information about current status of asset memory cache
         virtual Foundation::AssetCacheInfoMap GetAssetCacheInfo();
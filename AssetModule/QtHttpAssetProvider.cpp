@@ -17,22 +17,36 @@
 
 #include <QDebug>
 #include <QStringList>
-
-#define MAX_HTTP_CONNECTIONS 10000 // Basically means no limit to parallel connections
+#include <QSet>
 
 namespace Asset
 {
+    //! Default maximum of simultaneous transfers per host. Qt keeps this many keep-alive connections per host open.
+    static const int DEFAULT_MAX_CONNECTIONS_PER_HOST = 6;
+
+    //! Default maximum of resumed attempts of a failed transfer
+    static const int DEFAULT_MAX_RETRIES = 3;
+
+    //! Queued textures with a lower priority than this drop to the low priority class
+    static const float LOW_PRIORITY_THRESHOLD = 10.0f;
+
     QtHttpAssetProvider::QtHttpAssetProvider(Foundation::Framework *framework) :
         QObject(),
         framework_(framework),
         event_manager_(framework->GetEventManager().get()),
         name_("QtHttpAssetProvider"),
         network_manager_(new QNetworkAccessManager()),
-        filling_stack_(false),
+        queue_changed_(false),
         get_texture_cap_(QUrl())
     {
         if (event_manager_)
             asset_event_category_ = event_manager_->QueryEventCategory("Asset");
+
+        max_connections_per_host_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "http_connections_per_host", DEFAULT_MAX_CONNECTIONS_PER_HOST);
+        if (max_connections_per_host_ <= 0)
+            max_connections_per_host_ = 1;
+        max_retries_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "http_max_retries", DEFAULT_MAX_RETRIES);
+
         connect(network_manager_, SIGNAL(finished(QNetworkReply*)), SLOT(TranferCompleted(QNetworkReply*)));
         AssetModule::LogInfo("HttpAssetProvider initialized");
     }
@@ -53,7 +67,8 @@ namespace Asset
 
     void QtHttpAssetProvider::Update(f64 frametime)
     {
-        StartTransferFromQueue();
+        if (queue_changed_)
+            StartTransferFromQueue();
     }
 
     const std::string& QtHttpAssetProvider::Name()
@@ -84,42 +99,51 @@ namespace Asset
         if (!IsValidId(asset_id, asset_type))
             return false;
 
+        // Requests of an asset already being fetched ride on the same transfer
         QString asset_id_qstring = QString::fromStdString(asset_id);
-        if (assetid_to_transfer_map_.contains(asset_id_qstring))
+        QtHttpAssetTransfer *existing = GetTransfer(asset_id_qstring);
+        if (existing)
         {
-            assetid_to_transfer_map_[asset_id_qstring]->GetTranferInfo().AddTag(tag);
+            existing->GetTranferInfo().AddTag(tag);
+            return true;
+        }
+
+        asset_type_t asset_type_int = RexTypes::GetAssetTypeFromTypeName(asset_type);
+        QtHttpAssetTransfer *transfer = 0;
+        if (IsAcceptableAssetType(asset_type) && RexUUID::IsValid(asset_id) && get_texture_cap_.isValid())
+        {
+            // Http texture/meshes via cap url
+            QString texture_url_string = get_texture_cap_.toString() + "?texture_id=" + asset_id_qstring;
+            QUrl texture_url(texture_url_string);
+            transfer = new QtHttpAssetTransfer(texture_url, asset_id_qstring, asset_type_int, tag);
         }
         else
         {
-            asset_type_t asset_type_int = RexTypes::GetAssetTypeFromTypeName(asset_type);
-            QtHttpAssetTransfer *transfer = 0;
-            if (IsAcceptableAssetType(asset_type) && RexUUID::IsValid(asset_id) && get_texture_cap_.isValid())
-            {
-                // Http texture/meshes via cap url
-                QString texture_url_string = get_texture_cap_.toString() + "?texture_id=" + asset_id_qstring;
-                QUrl texture_url(texture_url_string);
-                transfer = new QtHttpAssetTransfer(texture_url, asset_id_qstring, asset_type_int, tag);
-            }
-            else
-            {
-                // Normal http get
-                QUrl asset_url = CreateUrl(asset_id_qstring);
-                transfer = new QtHttpAssetTransfer(asset_url, asset_id_qstring, asset_type_int, tag);
-            }
+            // Normal http get
+            QUrl asset_url = CreateUrl(asset_id_qstring);
+            transfer = new QtHttpAssetTransfer(asset_url, asset_id_qstring, asset_type_int, tag);
+        }
 
-            if (!transfer)
-                return false;
+        if (!transfer)
+            return false;
 
-            transfer->setOriginatingObject(transfer);
-            if (assetid_to_transfer_map_.count() <= MAX_HTTP_CONNECTIONS)
-            {
-                assetid_to_transfer_map_[asset_id_qstring] = transfer;
-                network_manager_->get(*transfer);
-                AssetModule::LogDebug("New HTTP asset request: " + asset_id + " type: " + asset_type);
-            }
-            else
-                pending_request_queue_.append(transfer);
+        transfer->setOriginatingObject(transfer);
+        transfer->SetPriorityClass(GetDefaultPriorityClass(asset_type_int));
+
+        // Start right away if the host has a free connection and nothing more urgent is waiting, otherwise queue
+        bool more_urgent_queued = false;
+        for (int i = 0; i < transfer->GetPriorityClass(); ++i)
+            if (!pending_request_queues_[i].empty())
+                more_urgent_queued = true;
+
+        if ((!more_urgent_queued) && (host_connections_.value(transfer->GetHostKey()) < max_connections_per_host_))
+        {
+            StartTransfer(transfer);
+            AssetModule::LogDebug("New HTTP asset request: " + asset_id + " type: " + asset_type);
         }
+        else
+            QueueTransfer(transfer);
+
         return true;
     }
 
@@ -134,12 +158,13 @@ namespace Asset
 
     bool QtHttpAssetProvider::QueryAssetStatus(const std::string& asset_id, uint& size, uint& received, uint& received_continuous)
     {
-        if (InProgress(asset_id))
+        QtHttpAssetTransfer *transfer = GetTransfer(QString::fromStdString(asset_id));
+        if (transfer)
         {
-            // We dont know, QNetworkAccessManager handles these
-            size = 0;
-            received = 0;
-            received_continuous = 0;
+            // Size is known once the reply headers have arrived; HTTP data always arrives in order
+            size = transfer->GetSize();
+            received = transfer->GetData().size();
+            received_continuous = received;
             return true;
         }
         else
@@ -148,6 +173,19 @@ namespace Asset
 
     Foundation::AssetPtr QtHttpAssetProvider::GetIncompleteAsset(const std::string& asset_id, const std::string& asset_type, uint received)       
     {
+        QtHttpAssetTransfer *transfer = GetTransfer(QString::fromStdString(asset_id));
+        if ((transfer) && (received) && ((uint)transfer->GetData().size() >= received))
+        {
+            // Make new temporary asset for the incomplete data
+            const QByteArray &data_array = transfer->GetData();
+            RexAsset* new_asset = new RexAsset(asset_id, RexTypes::GetTypeNameFromAssetType(transfer->GetTranferInfo().type));
+            Foundation::AssetPtr asset_ptr(new_asset);
+
+            RexAsset::AssetDataVector& data_vector = new_asset->GetDataInternal();
+            data_vector.assign(data_array.constData(), data_array.constData() + data_array.size());
+            return asset_ptr;
+        }
+
         return Foundation::AssetPtr();
     }
 
@@ -156,21 +194,36 @@ namespace Asset
         Foundation::AssetTransferInfoVector info_vector;
         foreach (QtHttpAssetTransfer *transfer, assetid_to_transfer_map_.values())
         {
-            HttpAssetTransferInfo iter_info = transfer->GetTranferInfo();
+            HttpAssetTransferInfo &iter_info = transfer->GetTranferInfo();
             // What we know
             Foundation::AssetTransferInfo info;
             info.id_ = iter_info.id.toStdString();
             info.type_ = RexTypes::GetAssetTypeString(iter_info.type);
             info.provider_ = Name();
-            // The following we dont know, QNetworkAccessManager handles these
-            info.size_ = 0;
-            info.received_ = 0;
-            info.received_continuous_ = 0;
+            info.size_ = transfer->GetSize();
+            info.received_ = transfer->GetData().size();
+            info.received_continuous_ = info.received_;
             info_vector.push_back(info);
         }
         return info_vector;
     }
 
+    void QtHttpAssetProvider::SetAssetPriority(const std::string& asset_id, float priority, int discard_level)
+    {
+        QtHttpAssetTransfer *transfer = queued_transfers_.value(QString::fromStdString(asset_id));
+        if ((!transfer) || (transfer->GetPriorityClass() == HTTP_PRIORITY_HIGH))
+            return;
+
+        HttpPriorityClass priority_class = priority < LOW_PRIORITY_THRESHOLD ? HTTP_PRIORITY_LOW : HTTP_PRIORITY_NORMAL;
+        if (priority_class == transfer->GetPriorityClass())
+            return;
+
+        pending_request_queues_[transfer->GetPriorityClass()].removeOne(transfer);
+        queued_transfers_.remove(transfer->GetTranferInfo().id);
+        transfer->SetPriorityClass(priority_class);
+        QueueTransfer(transfer);
+    }
+
     // Private
 
     QUrl QtHttpAssetProvider::CreateUrl(QString assed_id)
@@ -180,161 +233,107 @@ namespace Asset
         return QUrl(assed_id);
     }
 
+    void QtHttpAssetProvider::DataReceived()
+    {
+        QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+        if (!reply)
+            return;
+        QtHttpAssetTransfer *transfer = dynamic_cast<QtHttpAssetTransfer*>(reply->request().originatingObject());
+        if (transfer)
+            transfer->ReadReply(reply);
+    }
+
     void QtHttpAssetProvider::TranferCompleted(QNetworkReply *reply)
     {
-        fake_metadata_fetch_ = false;
         QtHttpAssetTransfer *transfer = dynamic_cast<QtHttpAssetTransfer*>(reply->request().originatingObject());
+        if (!transfer)
+        {
+            reply->deleteLater();
+            return;
+        }
 
-        /**** THIS IS A DATA REQUEST REPLY AND IT FAILED ****/
-        if (reply->error() != QNetworkReply::NoError && transfer)
+        HttpAssetTransferInfo &tranfer_info = transfer->GetTranferInfo();
+
+        /**** THE REQUEST FAILED ****/
+        if (reply->error() != QNetworkReply::NoError)
         {
+            if (IsRetryableError(reply, transfer))
+            {
+                // Put back to the front of its queue. The next attempt asks only for the bytes still missing.
+                transfer->AddRetry();
+                AssetModule::LogDebug("HTTP asset " + tranfer_info.id.toStdString() + " interrupted after " +
+                    ToString<int>(transfer->GetData().size()) + " bytes, resuming");
+
+                assetid_to_transfer_map_.remove(tranfer_info.id);
+                host_connections_[transfer->GetHostKey()]--;
+                pending_request_queues_[transfer->GetPriorityClass()].prepend(transfer);
+                queued_transfers_[tranfer_info.id] = transfer;
+                queue_changed_ = true;
+                StartTransferFromQueue();
+
+                reply->deleteLater();
+                return;
+            }
+
             // Send asset canceled events
-            HttpAssetTransferInfo error_transfer_data = transfer->GetTranferInfo();
-            Events::AssetCanceled *data = new Events::AssetCanceled(error_transfer_data.id.toStdString(), RexTypes::GetAssetTypeString(error_transfer_data.type));
+            Events::AssetCanceled *data = new Events::AssetCanceled(tranfer_info.id.toStdString(), RexTypes::GetAssetTypeString(tranfer_info.type));
             EventDataPtr data_ptr(data);
             event_manager_->SendDelayedEvent(asset_event_category_, Events::ASSET_CANCELED, data_ptr, 0);
 
+            AssetModule::LogDebug("HTTP asset " + tranfer_info.id.toStdString() + " canceled. Network error occurred.");
+
             // Clean up
-            RemoveFinishedTransfers(error_transfer_data.id, reply->url());
+            RemoveFinishedTransfers(tranfer_info.id);
             StartTransferFromQueue();
-
-            AssetModule::LogDebug("HTTP asset " + error_transfer_data.id.toStdString() + " canceled. Network error occurred.");
             reply->deleteLater();
             return;
         }
 
-        /**** THIS IS A /data REQUEST REPLY ****/
-        if (transfer)
-        {
-            // Create asset pointer
-            HttpAssetTransferInfo tranfer_info = transfer->GetTranferInfo();
-            std::string id = tranfer_info.id.toStdString();
-            std::string type = RexTypes::GetTypeNameFromAssetType(tranfer_info.type);
-            Foundation::AssetPtr asset_ptr = Foundation::AssetPtr(new RexAsset(id, type));
-
-            // Fill asset data with reply data
-            RexAsset::AssetDataVector& data_vector = checked_static_cast<RexAsset*>(asset_ptr.get())->GetDataInternal();
-            QByteArray data_array = reply->readAll();
-            for (int index = 0; index < data_array.count(); ++index)
-                data_vector.push_back(data_array.at(index));
-
-            // Get metadata if available
-            QString url_path = tranfer_info.url.path();
-            if (url_path.endsWith("/data") || url_path.endsWith("/data/"))
-            {
-                // Generate metada url
-                int clip_count;
-                if (url_path.endsWith("/data"))
-                    clip_count = 5;
-                else if (url_path.endsWith("/data/"))
-                    clip_count = 6;
-                else
-                {
-                    reply->deleteLater();
-                    return;
-                }
+        /**** THE ASSET IS COMPLETE ****/
+        // The asset completes with the data reply. A /data url used to be followed by a /metadata round trip, but
+        // nothing reads the metadata, so it is not fetched.
+        transfer->ReadReply(reply);
 
-                QUrl metadata_url = tranfer_info.url;
-                url_path = url_path.left(url_path.count()-clip_count);
-                url_path = url_path + "/metadata";
-                metadata_url.setPath(url_path);
-                tranfer_info.url = metadata_url;
-
-                QNetworkRequest *metada_request = new QNetworkRequest(metadata_url);
-
-                // Store tranfer data and asset data pointer internally
-                QPair<HttpAssetTransferInfo, Foundation::AssetPtr> data_pair;
-                data_pair.first = tranfer_info;
-                data_pair.second = asset_ptr;
-                metadata_to_assetptr_[metada_request->url()] = data_pair;
-                
-                // Send metadata network request
-                //network_manager_->get(*metada_request);
-                
-                // HACK to avoid metadata fetch for now, we dont use it to anything yet
-                fake_metadata_url_ = metada_request->url();
-                fake_metadata_fetch_ = true;
-            }
-            // Asset data feched, lets store
-            else
-            {
-                AssetModule::LogDebug("HTTP asset " + tranfer_info.id.toStdString() + " completed");
+        // Create asset pointer
+        std::string id = tranfer_info.id.toStdString();
+        std::string type = RexTypes::GetTypeNameFromAssetType(tranfer_info.type);
+        Foundation::AssetPtr asset_ptr = Foundation::AssetPtr(new RexAsset(id, type));
 
-                // Store asset, but don't store textures, they have their own cache action after decoding
-                boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
-                if (asset_service) 
-                    asset_service->StoreAsset(asset_ptr);
+        // Fill asset data with reply data
+        RexAsset::AssetDataVector& data_vector = checked_static_cast<RexAsset*>(asset_ptr.get())->GetDataInternal();
+        const QByteArray &data_array = transfer->GetData();
+        data_vector.assign(data_array.constData(), data_array.constData() + data_array.size());
 
-                // Send asset ready events
-                foreach (request_tag_t tag, tranfer_info.tags)
-                {
-                    Events::AssetReady event_data(asset_ptr.get()->GetId(), asset_ptr.get()->GetType(), asset_ptr, tag);
-                    event_manager_->SendEvent(asset_event_category_, Events::ASSET_READY, &event_data);
-                }
+        AssetModule::LogDebug("HTTP asset " + id + " completed");
 
-                RemoveFinishedTransfers(tranfer_info.id, QUrl());
-                StartTransferFromQueue();
-            }
-        }
+        // Store asset, but don't store textures, they have their own cache action after decoding
+        boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
+        if (asset_service) 
+            asset_service->StoreAsset(asset_ptr);
 
-        // Complete /data and /metadata sequence, fake is here as long as we dont have xml parser for metadata
-        // or actually we dont use metadata in naali so thats the main reason its not fetched
-        if (fake_metadata_fetch_)
+        // Send asset ready events
+        QList<request_tag_t> tags = tranfer_info.tags;
+        RemoveFinishedTransfers(tranfer_info.id);
+        foreach (request_tag_t tag, tags)
         {
-            /**** THIS IS A /metadata REQUEST REPLY ****/
-            if (metadata_to_assetptr_.contains(fake_metadata_url_))
-            {
-                // Pull out transfer data and asset pointer assosiated with this reply url
-                QUrl metadata_transfer_url = fake_metadata_url_;
-                HttpAssetTransferInfo transfer_data = metadata_to_assetptr_[metadata_transfer_url].first;
-                Foundation::AssetPtr ready_asset_ptr = metadata_to_assetptr_[metadata_transfer_url].second;
-                if (!ready_asset_ptr)
-                {
-                    reply->deleteLater();
-                    return;
-                }
-
-                // Fill metadata
-                /*
-                const QByteArray &inbound_metadata = reply->readAll();
-                QString decoded_metadata = QString::fromUtf8(inbound_metadata.data());
-                #if defined(__GNUC__)
-                RexAssetMetadata *m = dynamic_cast<RexAssetMetadata*>(ready_asset_ptr.get()->GetMetadata());
-                #else	   
-                Foundation::AssetMetadataInterface *metadata = ready_asset_ptr.get()->GetMetadata();
-                RexAssetMetadata *m = static_cast<RexAssetMetadata*>(metadata);
-                #endif
-                std::string std_md(decoded_metadata.toStdString());
-                m->DesesrializeFromJSON(std_md); // TODO: implement a xml based metadata parser.
-                */
-
-                AssetModule::LogDebug("HTTP asset " + transfer_data.id.toStdString() + " completed with metadata");
-
-                // Store asset
-                boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
-                if (asset_service)
-                    asset_service->StoreAsset(ready_asset_ptr);
-
-                // Send asset ready events
-                foreach (request_tag_t tag, transfer_data.tags)
-                {
-                    Events::AssetReady event_data(ready_asset_ptr.get()->GetId(), ready_asset_ptr.get()->GetType(), ready_asset_ptr, tag);
-                    event_manager_->SendEvent(asset_event_category_, Events::ASSET_READY, &event_data);
-                }
-
-                RemoveFinishedTransfers(transfer_data.id, metadata_transfer_url);
-                StartTransferFromQueue();
-            }
+            Events::AssetReady event_data(asset_ptr.get()->GetId(), asset_ptr.get()->GetType(), asset_ptr, tag);
+            event_manager_->SendEvent(asset_event_category_, Events::ASSET_READY, &event_data);
         }
+
+        StartTransferFromQueue();
         reply->deleteLater();
     }
 
-    void QtHttpAssetProvider::RemoveFinishedTransfers(QString asset_transfer_key, QUrl metadata_transfer_key)
+    void QtHttpAssetProvider::RemoveFinishedTransfers(QString asset_transfer_key)
     {
-        QtHttpAssetTransfer *remove_transfer = assetid_to_transfer_map_[asset_transfer_key];
-        assetid_to_transfer_map_.remove(asset_transfer_key);
-        if (metadata_transfer_key.isValid())
-            metadata_to_assetptr_.remove(metadata_transfer_key);
+        QtHttpAssetTransfer *remove_transfer = assetid_to_transfer_map_.take(asset_transfer_key);
+        if (!remove_transfer)
+            return;
+
+        QString host = remove_transfer->GetHostKey();
+        if (--host_connections_[host] <= 0)
+            host_connections_.remove(host);
+        queue_changed_ = true;
         SAFE_DELETE(remove_transfer);
     }
 
@@ -343,46 +342,121 @@ namespace Asset
         foreach (QtHttpAssetTransfer *transfer, assetid_to_transfer_map_.values())
             SAFE_DELETE(transfer);
         assetid_to_transfer_map_.clear();
+        host_connections_.clear();
 
-        foreach (QtHttpAssetTransfer *transfer, pending_request_queue_)
-            SAFE_DELETE(transfer);
-        pending_request_queue_.clear();
+        for (int i = 0; i < HTTP_PRIORITY_CLASSES; ++i)
+        {
+            foreach (QtHttpAssetTransfer *transfer, pending_request_queues_[i])
+                SAFE_DELETE(transfer);
+            pending_request_queues_[i].clear();
+        }
+        queued_transfers_.clear();
+        queue_changed_ = false;
     }
 
     void QtHttpAssetProvider::StartTransferFromQueue()
     {
-        if (pending_request_queue_.count() == 0)
-            return;
+        queue_changed_ = false;
 
-        // If the whole map is empty then go and start new MAX_HTTP_CONNECTIONS amount of http gets
-        if (assetid_to_transfer_map_.count() == 0)
-            filling_stack_ = true;
-
-        if (!filling_stack_)
-            return;
-
-        if (assetid_to_transfer_map_.count() <= MAX_HTTP_CONNECTIONS && pending_request_queue_.count() > 0)
+        // Fill the free connections of each host, most urgent class first. A host that is full is skipped, so that a
+        // slow host does not hold back the transfers of the others.
+        QSet<QString> full_hosts;
+        for (int i = 0; i < HTTP_PRIORITY_CLASSES; ++i)
         {
-            if (assetid_to_transfer_map_.count() == MAX_HTTP_CONNECTIONS || pending_request_queue_.count() == 0)
-                filling_stack_ = false; 
-            else
+            QList<QtHttpAssetTransfer *> &queue = pending_request_queues_[i];
+            QList<QtHttpAssetTransfer *>::iterator iter = queue.begin();
+            while (iter != queue.end())
             {
-                QtHttpAssetTransfer *new_transfer = pending_request_queue_.takeAt(0);
-                assetid_to_transfer_map_[new_transfer->GetTranferInfo().id] = new_transfer;
-                network_manager_->get(*new_transfer);
+                QtHttpAssetTransfer *new_transfer = *iter;
+                QString host = new_transfer->GetHostKey();
+                if (full_hosts.contains(host))
+                {
+                    ++iter;
+                    continue;
+                }
+                if (host_connections_.value(host) >= max_connections_per_host_)
+                {
+                    full_hosts.insert(host);
+                    ++iter;
+                    continue;
+                }
+
+                iter = queue.erase(iter);
+                queued_transfers_.remove(new_transfer->GetTranferInfo().id);
+                StartTransfer(new_transfer);
 
                 AssetModule::LogDebug("New HTTP asset request from queue: " + new_transfer->GetTranferInfo().id.toStdString() + " type: " + RexTypes::GetAssetTypeString(new_transfer->GetTranferInfo().type));
-                StartTransferFromQueue(); // Recursivly fill the transfer map
             }
         }
     }
 
+    void QtHttpAssetProvider::StartTransfer(QtHttpAssetTransfer *transfer)
+    {
+        transfer->PrepareRequest();
+        assetid_to_transfer_map_[transfer->GetTranferInfo().id] = transfer;
+        host_connections_[transfer->GetHostKey()]++;
+
+        QNetworkReply *reply = network_manager_->get(*transfer);
+        connect(reply, SIGNAL(readyRead()), SLOT(DataReceived()));
+    }
+
+    void QtHttpAssetProvider::QueueTransfer(QtHttpAssetTransfer *transfer)
+    {
+        pending_request_queues_[transfer->GetPriorityClass()].append(transfer);
+        queued_transfers_[transfer->GetTranferInfo().id] = transfer;
+        queue_changed_ = true;
+    }
+
+    QtHttpAssetTransfer *QtHttpAssetProvider::GetTransfer(const QString &asset_id)
+    {
+        QtHttpAssetTransfer *transfer = assetid_to_transfer_map_.value(asset_id);
+        if (!transfer)
+            transfer = queued_transfers_.value(asset_id);
+        return transfer;
+    }
+
     bool QtHttpAssetProvider::CheckRequestQueue(QString assed_id)
     {
-        foreach (QtHttpAssetTransfer *transfer, pending_request_queue_)
-            if (transfer->GetTranferInfo().id == assed_id)
+        return queued_transfers_.contains(assed_id);
+    }
+
+    HttpPriorityClass QtHttpAssetProvider::GetDefaultPriorityClass(asset_type_t asset_type)
+    {
+        using namespace RexTypes;
+
+        switch (asset_type)
+        {
+            case RexAT_Mesh:
+            case RexAT_Skeleton:
+            case RexAT_MaterialScript:
+            case RexAT_ParticleScript:
+            case RexAT_GenericAvatarXml:
+                return HTTP_PRIORITY_HIGH;
+            default:
+                return HTTP_PRIORITY_NORMAL;
+        }
+    }
+
+    bool QtHttpAssetProvider::IsRetryableError(QNetworkReply *reply, QtHttpAssetTransfer *transfer)
+    {
+        if (transfer->GetRetries() >= max_retries_)
+            return false;
+
+        // The reply was aborted because its range did not continue the received data, try again from the start
+        if (transfer->HasRangeMismatch())
+            return true;
+
+        // Connection level failures are worth another attempt; content errors such as 404 are not
+        QNetworkReply::NetworkError error = reply->error();
+        switch (error)
+        {
+            case QNetworkReply::RemoteHostClosedError:
+            case QNetworkReply::TimeoutError:
+            case QNetworkReply::UnknownNetworkError:
                 return true;
-        return false;
+            default:
+                return false;
+        }
     }
 
     bool QtHttpAssetProvider::IsAcceptableAssetType(const std::string& asset_type)
@@ -10,6 +10,7 @@
 #include <QNetworkAccessManager>
 #include <QObject>
 #include <QMap>
+#include <QHash>
 #include <QPair>
 #include <QUrl>
 
@@ -39,17 +40,36 @@ namespace Asset
 
         Foundation::AssetPtr GetIncompleteAsset(const std::string& asset_id, const std::string& asset_type, uint received);
         Foundation::AssetTransferInfoVector GetTransferInfo();
+
+        //! Moves a queued transfer to the priority class matching the priority. Transfers already started are not affected.
+        void SetAssetPriority(const std::string& asset_id, float priority, int discard_level);
     
     private slots:
         QUrl CreateUrl(QString assed_id);
         void TranferCompleted(QNetworkReply *reply);
-        void RemoveFinishedTransfers(QString asset_transfer_key, QUrl metadata_transfer_key);
+        void DataReceived();
+        void RemoveFinishedTransfers(QString asset_transfer_key);
         void StartTransferFromQueue();
 
         bool CheckRequestQueue(QString assed_id);
         bool IsAcceptableAssetType(const std::string& asset_type);
 
     private:
+        //! Sends the request of a transfer and counts it against the connection window of its host
+        void StartTransfer(QtHttpAssetTransfer *transfer);
+
+        //! Queues a transfer at the end of its priority class
+        void QueueTransfer(QtHttpAssetTransfer *transfer);
+
+        //! Returns a started or queued transfer, 0 if none
+        QtHttpAssetTransfer *GetTransfer(const QString &asset_id);
+
+        //! Returns the priority class an asset type starts in
+        HttpPriorityClass GetDefaultPriorityClass(asset_type_t asset_type);
+
+        //! Returns true if a failed transfer is worth another attempt
+        bool IsRetryableError(QNetworkReply *reply, QtHttpAssetTransfer *transfer);
+
         Foundation::Framework *framework_;
         EventManager *event_manager_;
         const std::string name_;
@@ -58,13 +78,26 @@ namespace Asset
         event_category_id_t asset_event_category_;
         f64 asset_timeout_;
 
+        //! Started transfers
         QMap<QString, QtHttpAssetTransfer *> assetid_to_transfer_map_;
-        QMap<QUrl, QPair<HttpAssetTransferInfo, Foundation::AssetPtr> > metadata_to_assetptr_;
-        QList<QtHttpAssetTransfer *> pending_request_queue_;
 
-        bool filling_stack_;
-        bool fake_metadata_fetch_;
-        QUrl fake_metadata_url_;
+        //! Queued transfers, one queue per priority class
+        QList<QtHttpAssetTransfer *> pending_request_queues_[HTTP_PRIORITY_CLASSES];
+
+        //! Queued transfers by asset id
+        QHash<QString, QtHttpAssetTransfer *> queued_transfers_;
+
+        //! Amount of started transfers per host
+        QMap<QString, int> host_connections_;
+
+        //! Maximum amount of simultaneous transfers per host
+        int max_connections_per_host_;
+
+        //! Maximum amount of resumed attempts of a failed transfer
+        int max_retries_;
+
+        //! Whether queued transfers may be startable, set when a transfer is queued or a connection frees up
+        bool queue_changed_;
 
         QUrl get_texture_cap_;
 
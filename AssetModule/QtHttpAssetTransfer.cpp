@@ -3,6 +3,8 @@
 #include "StableHeaders.h"
 #include "QtHttpAssetTransfer.h"
 
+#include <QNetworkReply>
+
 namespace Asset
 {
     // ==========================================================
@@ -38,8 +40,86 @@ namespace Asset
     QtHttpAssetTransfer::QtHttpAssetTransfer(QUrl asset_url, QString asset_id, asset_type_t asset_type, request_tag_t tag) :
         QObject(0),
         QNetworkRequest(asset_url),
-        transfer_info_(asset_url, asset_id, asset_type)
+        transfer_info_(asset_url, asset_id, asset_type),
+        size_(0),
+        range_start_(0),
+        reply_checked_(false),
+        reply_accepted_(false),
+        range_mismatch_(false),
+        priority_class_(HTTP_PRIORITY_NORMAL),
+        retries_(0)
     {
         transfer_info_.AddTag(tag);
     }
-}
\ No newline at end of file
+
+    QString QtHttpAssetTransfer::GetHostKey() const
+    {
+        return transfer_info_.url.host() + ":" + QString::number(transfer_info_.url.port(80));
+    }
+
+    void QtHttpAssetTransfer::PrepareRequest()
+    {
+        // Keep the connection open for the next transfer to the same host, and let requests queue up on it
+        setRawHeader("Connection", "Keep-Alive");
+        setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+
+        range_start_ = data_.size();
+        if (range_start_ > 0)
+            setRawHeader("Range", "bytes=" + QByteArray::number(range_start_) + "-");
+        else
+            setRawHeader("Range", QByteArray());
+
+        reply_checked_ = false;
+        reply_accepted_ = false;
+        range_mismatch_ = false;
+    }
+
+    void QtHttpAssetTransfer::ReadReply(QNetworkReply *reply)
+    {
+        if (!reply_checked_)
+        {
+            int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (status == 206)
+            {
+                // Continues the data received before. Content-Range is "bytes first-last/total"
+                QByteArray content_range = reply->rawHeader("Content-Range");
+                int space = content_range.indexOf(' ');
+                int dash = content_range.indexOf('-', space + 1);
+                int slash = content_range.lastIndexOf('/');
+                bool first_ok = false;
+                uint first = dash > space ? content_range.mid(space + 1, dash - space - 1).trimmed().toUInt(&first_ok) : 0;
+                if (first_ok && first == range_start_)
+                {
+                    bool ok = false;
+                    uint total = slash >= 0 ? content_range.mid(slash + 1).toUInt(&ok) : 0;
+                    if (ok)
+                        size_ = total;
+                    reply_accepted_ = true;
+                }
+                else
+                {
+                    // The range does not continue our data. Start over from the beginning with the next attempt.
+                    data_.clear();
+                    size_ = 0;
+                    range_mismatch_ = true;
+                    reply_checked_ = true;
+                    reply->abort();
+                    return;
+                }
+            }
+            else if ((status == 200) || (!status))
+            {
+                // The whole asset, either the first attempt or a server that does not support ranges
+                data_.clear();
+                size_ = reply->header(QNetworkRequest::ContentLengthHeader).toUInt();
+                reply_accepted_ = true;
+            }
+            reply_checked_ = true;
+        }
+
+        if (reply_accepted_)
+            data_.append(reply->readAll());
+        else
+            reply->readAll();
+    }
+}
@@ -9,9 +9,24 @@
 #include <QNetworkRequest>
 #include <QUrl>
 #include <QString>
+#include <QByteArray>
+
+class QNetworkReply;
 
 namespace Asset
 {
+    //! Priority classes of HTTP transfers. Transfers of a higher class are always started before a lower one.
+    enum HttpPriorityClass
+    {
+        //! Assets that other assets wait for, such as meshes, skeletons and materials
+        HTTP_PRIORITY_HIGH = 0,
+        //! Textures in view, and everything else
+        HTTP_PRIORITY_NORMAL,
+        //! Textures that are out of view or not seen at all
+        HTTP_PRIORITY_LOW,
+        HTTP_PRIORITY_CLASSES
+    };
+
     struct HttpAssetTransferInfo
     {
         HttpAssetTransferInfo();
@@ -32,12 +47,69 @@ namespace Asset
 
     public:
         QtHttpAssetTransfer(QUrl asset_url, QString asset_id, asset_type_t asset_type, request_tag_t tag);
-        HttpAssetTransferInfo GetTranferInfo() { return transfer_info_; }
+        HttpAssetTransferInfo& GetTranferInfo() { return transfer_info_; }
+
+        //! Returns the host the transfer is fetched from, used to limit connections per host
+        QString GetHostKey() const;
+
+        //! Prepares the request headers for a new attempt. Asks only for the missing bytes if some data was already received.
+        void PrepareRequest();
+
+        //! Reads the data a reply has received so far
+        /*! Data of a 200 reply replaces what was received before, data of a 206 reply continues it. Error pages are ignored.
+            A 206 reply whose range does not start where the received data ends is aborted, and the data dropped, so
+            that the provider retries the transfer from the start.
+         */
+        void ReadReply(QNetworkReply *reply);
+
+        //! Returns the data received so far
+        const QByteArray& GetData() const { return data_; }
+
+        //! Returns the total size of the asset, 0 if not yet known
+        uint GetSize() const { return size_; }
+
+        //! Returns the priority class
+        HttpPriorityClass GetPriorityClass() const { return priority_class_; }
+
+        //! Sets the priority class
+        void SetPriorityClass(HttpPriorityClass priority_class) { priority_class_ = priority_class; }
+
+        //! Returns the amount of failed attempts
+        int GetRetries() const { return retries_; }
+
+        //! Adds a failed attempt
+        void AddRetry() { ++retries_; }
+
+        //! Returns whether the current reply was aborted because its range did not continue the data received before
+        bool HasRangeMismatch() const { return range_mismatch_; }
 
     private:
         HttpAssetTransferInfo transfer_info_;
 
+        //! Data received so far
+        QByteArray data_;
+
+        //! Total size of the asset, 0 if not yet known
+        uint size_;
+
+        //! Offset the current attempt was requested from
+        uint range_start_;
+
+        //! Whether the status of the current reply has been checked
+        bool reply_checked_;
+
+        //! Whether the current reply carries asset data
+        bool reply_accepted_;
+
+        //! Whether the current reply was aborted because of a wrong Content-Range
+        bool range_mismatch_;
+
+        //! Priority class
+        HttpPriorityClass priority_class_;
+
+        //! Amount of failed attempts
+        int retries_;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
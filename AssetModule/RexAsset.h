@@ -6,6 +6,7 @@
 #include "AssetInterface.h"
 #include "RexAssetMetadata.h"
 #include "RexUUID.h"
+#include "PackStore.h"
 
 namespace Asset
 {
@@ -32,13 +33,27 @@ namespace Asset
         virtual const std::string& GetType() const { return asset_type_; }
 
         //! returns asset data size
-        virtual uint GetSize() const { return data_.size(); }
+        virtual uint GetSize() const { return storage_.IsNull() ? data_.size() : storage_.GetSize(); }
 
         //! returns asset data
-        virtual const u8* GetData() const { ResetAge(); return &data_[0]; }
+        virtual const u8* GetData() const { ResetAge(); return storage_.IsNull() ? &data_[0] : storage_.GetData(); }
 
         //! returns asset data vector, non-const. For internal use
-        AssetDataVector& GetDataInternal() { ResetAge(); return data_; }
+        /*! If the data was read from the disk cache, copies it to the vector first.
+         */
+        AssetDataVector& GetDataInternal()
+        {
+            ResetAge();
+            if (!storage_.IsNull())
+            {
+                data_.assign(storage_.GetData(), storage_.GetData() + storage_.GetSize());
+                storage_ = Foundation::PackBlob();
+            }
+            return data_;
+        }
+
+        //! uses a disk cache record as the asset data, without copying. For internal use
+        void SetStorage(const Foundation::PackBlob& storage) { data_.clear(); storage_ = storage; }
 
         //! returns asset metadata
         virtual Foundation::AssetMetadataInterface* GetMetadata() const { ResetAge(); return (Foundation::AssetMetadataInterface*)&metadata_;}
@@ -62,6 +77,9 @@ namespace Asset
         //! asset data
         AssetDataVector data_;
 
+        //! disk cache record holding the asset data instead of data_, if any
+        Foundation::PackBlob storage_;
+
         //! asset metadata
         RexAssetMetadata metadata_;
 
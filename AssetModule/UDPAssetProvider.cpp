@@ -24,11 +24,13 @@ using namespace RexTypes;
 namespace Asset
 {
     const float UDPAssetProvider::DEFAULT_ASSET_TIMEOUT = 120.0;
+    const float UDPAssetProvider::DEFAULT_PAUSED_TEXTURE_TIMEOUT = 10.0;
 
     UDPAssetProvider::UDPAssetProvider(Foundation::Framework* framework) :
         framework_(framework)
     {
         asset_timeout_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "udp_timeout", DEFAULT_ASSET_TIMEOUT);
+        paused_texture_timeout_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "udp_paused_texture_timeout", DEFAULT_PAUSED_TEXTURE_TIMEOUT);
 
         EventManagerPtr event_manager = framework_->GetEventManager();
 
@@ -69,6 +71,8 @@ namespace Asset
         new_request.asset_id_ = asset_id;
         new_request.asset_type_ = asset_type_int;
         new_request.tags_.push_back(tag);
+        new_request.priority_ = UDP_DEFAULT_PRIORITY;
+        new_request.discard_level_ = 0;
         pending_requests_.push_back(new_request);
 
         return true;
@@ -100,6 +104,29 @@ namespace Asset
         return Foundation::AssetPtr();
     }
 
+    void UDPAssetProvider::SetAssetPriority(const std::string& asset_id, float priority, int discard_level)
+    {
+        if (!RexUUID::IsValid(asset_id))
+            return;
+
+        UDPAssetTransferMap::iterator i = texture_transfers_.find(RexUUID(asset_id));
+        if (i != texture_transfers_.end())
+        {
+            i->second.SetPriority(priority, discard_level);
+            return;
+        }
+
+        // Not sent yet, the request goes out with the new priority
+        for (AssetRequestVector::iterator j = pending_requests_.begin(); j != pending_requests_.end(); ++j)
+        {
+            if ((j->asset_id_ == asset_id) && (j->asset_type_ == RexAT_Texture))
+            {
+                j->priority_ = priority;
+                j->discard_level_ = discard_level;
+            }
+        }
+    }
+
     void UDPAssetProvider::SetCurrentProtocolModule(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> protocolModule)
     {
         protocolModule_ = protocolModule;
@@ -137,8 +164,12 @@ namespace Asset
             return;
         }
 
-        // Connection exists, send any pending requests
+        // Connection exists, send any pending requests, and the changed priorities of the ongoing ones
         SendPendingRequests(net);
+        SendPriorityUpdates(net);
+
+        // Textures paused for long are no longer needed by anyone, cancel them
+        HandlePausedTextures(net, frametime);
 
         // Handle timeouts for texture & asset transfers
         // Disable asset timeouts for now, a long transfer may stall all others on the server
@@ -155,6 +186,8 @@ namespace Asset
             new_request.asset_id_ = i->second.GetAssetId();
             new_request.asset_type_ = i->second.GetAssetType();
             new_request.tags_ = i->second.GetTags();
+            new_request.priority_ = i->second.GetPriority();
+            new_request.discard_level_ = i->second.GetDiscardLevel();
             pending_requests_.push_back(new_request);
             ++i;
         }
@@ -166,6 +199,8 @@ namespace Asset
             new_request.asset_id_ = j->second.GetAssetId();
             new_request.asset_type_ = j->second.GetAssetType();
             new_request.tags_ = j->second.GetTags();
+            new_request.priority_ = UDP_DEFAULT_PRIORITY;
+            new_request.discard_level_ = 0;
             pending_requests_.push_back(new_request);
             ++j;
         }
@@ -181,7 +216,12 @@ namespace Asset
         while(i != texture_transfers_.end())
         {
             UDPAssetTransfer& transfer = i->second;
-            if (!transfer.Ready())
+            // Paused transfers are left to HandlePausedTextures(). Ones that only need a reduced resolution may
+            // legitimately go without data for long
+            bool paused = transfer.GetPriority() <= 0.0f;
+            if ((!transfer.Ready()) && (!paused) && (transfer.GetDiscardLevel() > 0))
+                transfer.ResetTime();
+            else if ((!transfer.Ready()) && (!paused))
             {
                 transfer.AddTime(frametime);
                 if (transfer.GetTime() > asset_timeout_)
@@ -191,21 +231,7 @@ namespace Asset
                     AssetModule::LogInfo("Texture transfer " + transfer.GetAssetId() + " timed out.");
 
                     // Send cancel message
-                    const ProtocolUtilities::ClientParameters& client = net->GetClientParameters();
-                    ProtocolUtilities::NetOutMessage *m = net->StartMessageBuilding(RexNetMsgRequestImage);
-                    assert(m);
-                    
-                    m->AddUUID(client.agentID);
-                    m->AddUUID(client.sessionID);
-
-                    m->SetVariableBlockCount(1);
-                    m->AddUUID(asset_uuid); // Image UUID
-                    m->AddS8(-1); // Discard level, -1 = cancel
-                    m->AddF32(0.0); // Download priority, 0 = cancel
-                    m->AddU32(0); // Starting packet
-                    m->AddU8(RexIT_Normal); // Image type
-                    m->MarkReliable();
-                    net->FinishMessageBuilding(m);
+                    SendImageRequest(net, asset_uuid, 0.0f, -1, 0);
 
                     // Send transfer canceled event
                     SendAssetCanceled(transfer);
@@ -221,6 +247,34 @@ namespace Asset
             texture_transfers_.erase(erase_tex[j]);
     }
 
+    void UDPAssetProvider::HandlePausedTextures(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime)
+    {
+        std::vector<RexUUID> erase_tex;
+        for (UDPAssetTransferMap::iterator i = texture_transfers_.begin(); i != texture_transfers_.end(); ++i)
+        {
+            UDPAssetTransfer& transfer = i->second;
+            if ((transfer.Ready()) || (transfer.GetPriority() > 0.0f))
+                continue;
+
+            transfer.AddTime(frametime);
+            if (transfer.GetTime() > paused_texture_timeout_)
+            {
+                AssetModule::LogDebug("Paused texture transfer " + transfer.GetAssetId() + " canceled.");
+
+                // Send cancel message
+                SendImageRequest(net, i->first, 0.0f, -1, 0);
+
+                // Send transfer canceled event
+                SendAssetCanceled(transfer);
+
+                erase_tex.push_back(i->first);
+            }
+        }
+
+        for (uint j = 0; j < erase_tex.size(); ++j)
+            texture_transfers_.erase(erase_tex[j]);
+    }
+
     void UDPAssetProvider::HandleAssetTimeouts(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime)
     {
         UDPAssetTransferMap::iterator i = asset_transfers_.begin();
@@ -266,7 +320,7 @@ namespace Asset
         {
             RexUUID asset_uuid(i->asset_id_);
             if (i->asset_type_ == RexAT_Texture)
-                RequestTexture(net, asset_uuid, i->tags_);
+                RequestTexture(net, asset_uuid, i->tags_, i->priority_, i->discard_level_);
             else
                 RequestOtherAsset(net, asset_uuid, i->asset_type_, i->tags_);
 
@@ -274,8 +328,26 @@ namespace Asset
         }
     }
 
+    void UDPAssetProvider::SendPriorityUpdates(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net)
+    {
+        for (UDPAssetTransferMap::iterator i = texture_transfers_.begin(); i != texture_transfers_.end(); ++i)
+        {
+            UDPAssetTransfer& transfer = i->second;
+            if (!transfer.IsPriorityChanged())
+                continue;
+            transfer.ClearPriorityChanged();
+
+            // Repeating the request with the same image UUID updates the transfer on the server. Start from the first
+            // missing packet, in case the transfer was paused and is being resumed.
+            if (transfer.GetPriority() > 0.0f)
+                SendImageRequest(net, i->first, transfer.GetPriority(), transfer.GetDiscardLevel(), transfer.GetReceivedContinuousPackets());
+            else
+                SendImageRequest(net, i->first, 0.0f, -1, 0);
+        }
+    }
+
     void UDPAssetProvider::RequestTexture(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, 
-        const RexUUID& asset_id, const RequestTagVector& tags)
+        const RexUUID& asset_id, const RequestTagVector& tags, f32 priority, int discard_level)
     {
         // If request already exists, just append the new tag(s)
         std::string asset_id_str = asset_id.ToString();
@@ -286,16 +358,25 @@ namespace Asset
             return;
         }
 
-        const ProtocolUtilities::ClientParameters& client = net->GetClientParameters();
-
         UDPAssetTransfer new_transfer;
         new_transfer.SetAssetId(asset_id.ToString());
         new_transfer.SetAssetType(RexAT_Texture);
         new_transfer.InsertTags(tags);
+        new_transfer.SetPriority(priority, discard_level);
+        new_transfer.ClearPriorityChanged();
         texture_transfers_[asset_id] = new_transfer;
 
         AssetModule::LogDebug("Requesting texture " + asset_id.ToString());
 
+        if (priority > 0.0f)
+            SendImageRequest(net, asset_id, priority, discard_level, 0);
+    }
+
+    void UDPAssetProvider::SendImageRequest(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net,
+        const RexUUID& asset_id, f32 priority, int discard_level, uint packet)
+    {
+        const ProtocolUtilities::ClientParameters& client = net->GetClientParameters();
+
         ProtocolUtilities::NetOutMessage *m = net->StartMessageBuilding(RexNetMsgRequestImage);
         assert(m);
 
@@ -304,9 +385,9 @@ namespace Asset
 
         m->SetVariableBlockCount(1);
         m->AddUUID(asset_id); // Image UUID
-        m->AddS8(0); // Discard level
-        m->AddF32(100.0); // Download priority
-        m->AddU32(0); // Starting packet
+        m->AddS8(discard_level); // Discard level, -1 = cancel
+        m->AddF32(priority); // Download priority, 0 = cancel
+        m->AddU32(packet); // Starting packet
         m->AddU8(RexIT_Normal); // Image type
         m->MarkReliable();
         net->FinishMessageBuilding(m);
@@ -63,6 +63,16 @@ namespace Asset
         
         //! Returns information about current asset transfers
         virtual Foundation::AssetTransferInfoVector GetTransferInfo();
+
+        //! Sets download priority of a texture transfer
+        /*! The new priority and discard level are sent to the server on the next update, by repeating the image
+            request. Priority 0 pauses the transfer on the server; a later nonzero priority resumes it from the
+            first missing packet. Other asset transfers can not be reprioritized, and are ignored.
+            \param asset_id Asset UUID
+            \param priority Download priority
+            \param discard_level Coarsest texture resolution level needed
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, float priority, int discard_level);
         
         virtual void SetCurrentProtocolModule(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> protocolModule);
 
@@ -89,6 +99,10 @@ namespace Asset
             int asset_type_;
             //! Associated request tags
             RequestTagVector tags_;
+            //! Download priority, for textures
+            f32 priority_;
+            //! Discard level, for textures
+            int discard_level_;
         };
 
         //! Sends pending UDP asset requests
@@ -102,6 +116,12 @@ namespace Asset
          */
         void HandleTextureTimeouts(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime);
 
+        //! Cancels texture transfers that have stayed paused longer than the paused texture timeout
+        /*! \param net Connected network interface
+            \param frametime Time since last frame
+         */
+        void HandlePausedTextures(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime);
+
         //! Handles other asset timeouts
         /*! \param net Connected network interface
             \param frametime Time since last frame
@@ -152,13 +172,30 @@ namespace Asset
          */
         UDPAssetTransfer* GetTransfer(const std::string& asset_id);
 
+        //! Sends changed texture priorities to the server
+        /*! \param net Connected network interface
+         */
+        void SendPriorityUpdates(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net);
+
         //! Requests a texture from network
         /*! \param net Connected network interface
             \param asset_id Asset UUID
             \param tags Asset request tag(s)
+            \param priority Download priority
+            \param discard_level Discard level
          */
         void RequestTexture(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net,
-            const RexUUID& asset_id, const RequestTagVector& tags);
+            const RexUUID& asset_id, const RequestTagVector& tags, f32 priority, int discard_level);
+
+        //! Sends an image request message. Also used to reprioritize and cancel image transfers
+        /*! \param net Connected network interface
+            \param asset_id Asset UUID
+            \param priority Download priority, 0 = cancel
+            \param discard_level Discard level, -1 = cancel
+            \param packet Packet to start from
+         */
+        void SendImageRequest(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net,
+            const RexUUID& asset_id, f32 priority, int discard_level, uint packet);
 
         //! Requests an other asset from network
         /*! \param net Connected network interface
@@ -195,6 +232,12 @@ namespace Asset
         //! Default asset transfer timeout 
         static const float DEFAULT_ASSET_TIMEOUT;
 
+        //! Time a texture transfer may stay paused before it is canceled
+        f64 paused_texture_timeout_;
+
+        //! Default paused texture transfer timeout
+        static const float DEFAULT_PAUSED_TEXTURE_TIMEOUT;
+
         //! Framework
         Foundation::Framework* framework_;
 
@@ -2,12 +2,20 @@
 #include "UDPAssetTransfer.h"
 #include "AssetModule.h"
 
+#include <cmath>
+
 namespace Asset
 {
+    //! Relative priority change that is worth telling the server about
+    const f32 PRIORITY_CHANGE_THRESHOLD = 0.1f;
+
     UDPAssetTransfer::UDPAssetTransfer() :
         size_(0),
         received_(0),
-        time_(0.0)
+        time_(0.0),
+        priority_(UDP_DEFAULT_PRIORITY),
+        discard_level_(0),
+        priority_changed_(false)
     {
     }
     
@@ -45,6 +53,39 @@ namespace Asset
         return size;
     }
     
+    uint UDPAssetTransfer::GetReceivedContinuousPackets() const
+    {
+        uint packets = 0;
+        DataPacketMap::const_iterator i = data_packets_.begin();
+        while ((i != data_packets_.end()) && (i->first == packets))
+        {
+            ++packets;
+            ++i;
+        }
+
+        return packets;
+    }
+
+    void UDPAssetTransfer::SetPriority(f32 priority, int discard_level)
+    {
+        if (priority < 0.0f)
+            priority = 0.0f;
+
+        // Pausing and resuming always count as a change, otherwise only a large enough difference
+        bool changed = (discard_level != discard_level_) || ((priority == 0.0f) != (priority_ == 0.0f)) ||
+            (fabs(priority - priority_) > priority_ * PRIORITY_CHANGE_THRESHOLD);
+        if (!changed)
+            return;
+
+        // Time is counted from pausing, so that a transfer that stays paused can be canceled
+        if ((priority == 0.0f) != (priority_ == 0.0f))
+            time_ = 0.0;
+
+        priority_ = priority;
+        discard_level_ = discard_level;
+        priority_changed_ = true;
+    }
+
     void UDPAssetTransfer::ReceiveData(uint packet_index, const u8* data, uint size)
     {
         time_ = 0.0;
@@ -6,6 +6,9 @@
 #include "CoreTypes.h"
 namespace Asset
 {
+    //! Download priority of UDP transfers that have not been given one
+    const f32 UDP_DEFAULT_PRIORITY = 100.0f;
+
     //! Stores data related to an UDP asset transfer that is in progress. Not necessary to clients of the AssetModule.
     class UDPAssetTransfer
     {
@@ -81,8 +84,30 @@ namespace Asset
         //! Returns total size of continuous data from the asset beginning received so far
         uint GetReceivedContinuous() const;
         
+        //! Returns amount of continuous packets received from the asset beginning
+        uint GetReceivedContinuousPackets() const;
+
         //! Returns elapsed time since last packet
         f64 GetTime() const { return time_; }
+
+        //! Sets download priority and discard level
+        /*! Marks the priority changed if it differs enough from the last one sent to the server
+            \param priority Download priority, 0 to pause the transfer
+            \param discard_level Coarsest texture resolution level needed
+         */
+        void SetPriority(f32 priority, int discard_level);
+
+        //! Returns download priority
+        f32 GetPriority() const { return priority_; }
+
+        //! Returns texture discard level
+        int GetDiscardLevel() const { return discard_level_; }
+
+        //! Returns whether the priority has changed since it was last sent to the server
+        bool IsPriorityChanged() const { return priority_changed_; }
+
+        //! Marks the priority sent to the server
+        void ClearPriorityChanged() { priority_changed_ = false; }
                         
         //! Returns whether transfer is finished (all bytes received)
         bool Ready() const;
@@ -107,6 +132,15 @@ namespace Asset
         
         //! Elapsed time since last packet
         f64 time_;
+
+        //! Download priority
+        f32 priority_;
+
+        //! Texture discard level
+        int discard_level_;
+
+        //! Whether priority or discard level has changed since last sent
+        bool priority_changed_;
         
         //! List of request tags associated with this transfer
         RequestTagVector tags_;
@@ -91,6 +91,7 @@ namespace Asset
             if (!manager_.GetThreadTask(host))
             {
                 Foundation::ThreadTaskPtr new_task(new HttpUtilities::HttpTask(host, true));
+                new_task->SetThreadPool(framework_->GetIoThreadPool().get());
                 manager_.AddThreadTask(new_task);
             }
             HttpUtilities::HttpTaskRequestPtr new_http_request(new HttpUtilities::HttpTaskRequest);
@@ -141,6 +141,7 @@ namespace Avatar
         
         // Setup new http task running in the background
         HttpUtilities::HttpTaskPtr new_download(new HttpUtilities::HttpTask());
+        new_download->SetThreadPool(framework_->GetIoThreadPool().get());
         HttpUtilities::HttpTaskRequestPtr new_request(new HttpUtilities::HttpTaskRequest());
         new_request->url_ = appearance_address;
         appearance_downloaders_[entity->GetId()] = new_download;
@@ -1554,8 +1555,9 @@ namespace Avatar
         }
         AvatarModule::LogInfo("Avatar export for user " + account + " @ " + authserver);
         
-        // Instantiate new avatar exporter & give it the work request
+        // Instantiate new avatar exporter & give it the work request. The export blocks on HTTP, so it runs on the I/O thread pool.
         avatar_exporter_ = AvatarExporterPtr(new AvatarExporter());
+        avatar_exporter_->SetThreadPool(framework_->GetIoThreadPool().get());
         
         AvatarExporterRequestPtr request(new AvatarExporterRequest());
         request->account_ = account;
@@ -21,17 +21,22 @@ static const float REAUTHENTICATION_TIME = 60.0f;
 
 namespace Avatar
 {
-    AvatarExporter::AvatarExporter() : ThreadTask("AvatarExport")
+    AvatarExporter::AvatarExporter() : ThreadTask("AvatarExport", true)
     {
     }
     
-    void AvatarExporter::Work()
+    AvatarExporter::~AvatarExporter()
+    {
+        Stop();
+    }
+    
+    void AvatarExporter::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
     {
         AvatarExporterResultPtr result(new AvatarExporterResult());
         
-        AvatarExporterRequestPtr request = GetNextRequest<AvatarExporterRequest>();
-        if (request)
-            ProcessRequest(request, result);
+        AvatarExporterRequestPtr export_request = boost::dynamic_pointer_cast<AvatarExporterRequest>(request);
+        if (export_request)
+            PerformExport(export_request, result);
         else
         {
             result->message_ = "No valid export request";
@@ -41,7 +46,7 @@ namespace Avatar
         SetResult<AvatarExporterResult>(result);
     }
     
-    void AvatarExporter::ProcessRequest(AvatarExporterRequestPtr request, AvatarExporterResultPtr result)
+    void AvatarExporter::PerformExport(AvatarExporterRequestPtr request, AvatarExporterResultPtr result)
     {
         if (request->avatar_xml_.empty())
         {
@@ -62,11 +62,16 @@ namespace Avatar
     public:
         AvatarExporter();
         
-        virtual void Work();
+        //! Destructor. Waits for the running export to finish.
+        virtual ~AvatarExporter();
+        
+    protected:
+        //! Serves the export request
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
         
     private:
         //! Perform the export
-        void ProcessRequest(AvatarExporterRequestPtr request, AvatarExporterResultPtr result);
+        void PerformExport(AvatarExporterRequestPtr request, AvatarExporterResultPtr result);
         
         //! Login to authentication & get new sessionhash
         bool LoginToAuthentication(const std::string& account, const std::string& authserver, const std::string& password, std::string& sessionhash, std::string& avatarurl, std::string& error);
@@ -48,6 +48,7 @@ typedef unsigned long ulong;
 typedef int service_type_t;
 
 typedef unsigned int entity_id_t;
+typedef unsigned int component_type_id_t;
 typedef unsigned int event_category_id_t;
 typedef unsigned int event_id_t;
 typedef unsigned int sound_id_t;
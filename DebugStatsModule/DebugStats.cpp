@@ -108,11 +108,11 @@ void DebugStatsModule::PostInitialize()
         Console::Bind(this, &DebugStatsModule::DumpTextures)));
 
     RegisterConsoleCommand(Console::CreateCommand("savescene",
-        "Saves scene (serializable entities) into an XML file. Usage: \"savescene(filename)\"",
+        "Saves scene (serializable entities) into an XML file, or a binary file if \"binary\" is given. Usage: \"savescene(filename[,binary])\"",
         Console::Bind(this, &DebugStatsModule::SaveScene)));
     
     RegisterConsoleCommand(Console::CreateCommand("loadscene",
-        "Loads scene (serializable entities) from an XML file. Usage: \"loadscene(filename)\"",
+        "Loads scene (serializable entities) from an XML or binary file. Usage: \"loadscene(filename)\"",
         Console::Bind(this, &DebugStatsModule::LoadScene)));
         
     RegisterConsoleCommand(Console::CreateCommand("exec",
@@ -437,7 +437,8 @@ Console::CommandResult DebugStatsModule::SaveScene(const StringVector &params)
         return Console::ResultFailure("No active scene found.");
     if (params.size() < 1)
         return Console::ResultFailure("No filename given.");
-    bool success = scene->SaveScene(params[0]);
+    bool binary = params.size() > 1 && params[1] == "binary";
+    bool success = binary ? scene->SaveSceneBinary(params[0]) : scene->SaveScene(params[0]);
     if (success)
         return Console::ResultSuccess();
     else
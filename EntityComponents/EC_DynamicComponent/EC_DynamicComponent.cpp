@@ -6,10 +6,13 @@
 #include "ModuleManager.h"
 #include "Entity.h"
 #include "LoggingFunctions.h"
+#include "DataSerializer.h"
 
 #include <QScriptEngine>
 #include <QScriptValueIterator>
 
+#include <set>
+
 DEFINE_POCO_LOGGING_FUNCTIONS("EC_DynamicComponent")
 
 #include <QDomDocument>
@@ -89,6 +92,63 @@ void EC_DynamicComponent::DeserializeFrom(QDomElement& element, AttributeChange:
         child = child.nextSiblingElement("attribute");
     }
 
+    ApplyDeserializedAttributes(deserializedAttributes, change);
+}
+
+void EC_DynamicComponent::SerializeAttributesToBinary(DataSerializer& dest) const
+{
+    dest.AddVLE(attributes_.size());
+    for(AttributeVector::const_iterator iter = attributes_.begin(); iter != attributes_.end(); ++iter)
+    {
+        dest.AddString(QString::fromStdString((*iter)->GetNameString()));
+        dest.AddString(QString::fromStdString((*iter)->TypeName()));
+        (*iter)->ToBinary(dest);
+    }
+}
+
+void EC_DynamicComponent::DeserializeAttributesFromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    // Read each value straight into the attribute of the same name, recreating the attribute if its type has changed.
+    std::set<std::string> receivedNames;
+    u32 count = source.ReadVLE();
+    for(u32 i = 0; i < count && source.IsValid(); ++i)
+    {
+        QString name = source.ReadString();
+        QString type = source.ReadString();
+        IAttribute *attribute = IComponent::GetAttribute(name);
+        if (attribute && attribute->TypeName() != type.toStdString())
+        {
+            RemoveAttribute(name, change);
+            attribute = 0;
+        }
+        if (!attribute)
+            attribute = CreateAttribute(type, name, change);
+        if (!attribute)
+        {
+            LogError("Unknown attribute type " + type.toStdString() + " in binary data of dynamic component " + Name().toStdString());
+            return;
+        }
+        attribute->FromBinary(source, change);
+        receivedNames.insert(name.toStdString());
+    }
+
+    if (!source.IsValid())
+    {
+        LogError("Truncated binary data of dynamic component " + Name().toStdString());
+        return;
+    }
+
+    // Remove the attributes that are no longer in the data.
+    QStringList removedNames;
+    for(AttributeVector::const_iterator iter = attributes_.begin(); iter != attributes_.end(); ++iter)
+        if (receivedNames.find((*iter)->GetNameString()) == receivedNames.end())
+            removedNames.push_back(QString::fromStdString((*iter)->GetNameString()));
+    for(int i = 0; i < removedNames.size(); ++i)
+        RemoveAttribute(removedNames[i], change);
+}
+
+void EC_DynamicComponent::ApplyDeserializedAttributes(std::vector<DeserializeData> &deserializedAttributes, AttributeChange::Type change)
+{
     // Sort both lists in alphabetical order.
     AttributeVector oldAttributes = attributes_;
     std::stable_sort(oldAttributes.begin(), oldAttributes.end(), &CmpAttributeByName);
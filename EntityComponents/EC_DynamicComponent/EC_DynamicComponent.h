@@ -9,6 +9,8 @@
 
 #include <QVariant>
 
+struct DeserializeData;
+
 /// Component for which user can add and delete attributes at runtime.
 /**
 <table class="header">
@@ -184,11 +186,21 @@ signals:
     */
     void AttributeRemoved(const QString &name);
 
+protected:
+    /// IComponent override. Writes the name and type of each attribute along with its value.
+    virtual void SerializeAttributesToBinary(DataSerializer& dest) const;
+
+    /// IComponent override. Reads the values directly into the attributes, and creates and removes attributes to match the data.
+    virtual void DeserializeAttributesFromBinary(DataDeserializer& source, AttributeChange::Type change);
+
 private:
     /// Constructor.
     /** @param module Declaring module
     */
     explicit EC_DynamicComponent(IModule *module);
+
+    /// Updates, creates and removes attributes to match the deserialized attribute list.
+    void ApplyDeserializedAttributes(std::vector<DeserializeData> &deserializedAttributes, AttributeChange::Type change);
 };
 
 #endif
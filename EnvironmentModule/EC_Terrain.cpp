@@ -10,6 +10,9 @@
 #include <Ogre.h>
 #include "OgreMaterialUtils.h"
 #include "OgreConversionUtils.h"
+#include "ThreadPool.h"
+
+#include <boost/bind.hpp>
 
 #include <utility>
 
@@ -325,7 +328,7 @@ float EC_Terrain::GetInterpolatedHeightValue(float x, float y) const
     return h1 * (1.f - xFrac - yFrac) + h2 * xFrac + h3 * yFrac;
 }
 
-Vector3df EC_Terrain::CalculateNormal(int x, int y, int xinside, int yinside)
+Vector3df EC_Terrain::CalculateNormal(int x, int y, int xinside, int yinside) const
 {
     int px = x * cPatchSize + xinside;
     int py = y * cPatchSize + yinside;
@@ -500,50 +503,39 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
 {
     PROFILE(EC_Terrain_GenerateTerrainGeometryForOnePatch);
 
-    EC_Terrain::Patch &patch = GetPatch(patchX, patchY);
-
-    Renderer *renderer = framework_->GetService<Renderer>();
-    if (!renderer)
-        return;
-
-    Ogre::SceneNode *node = patch.node;
-    bool firstTimeFill = (node == 0);
-    UNREFERENCED_PARAM(firstTimeFill);
-    if (!node)
-    {
-        CreateOgreTerrainPatchNode(node, patch.x, patch.y);
-        patch.node = node;
-    }
-    assert(node);
-
-    Ogre::MaterialPtr terrainMaterial = Ogre::MaterialManager::getSingleton().getByName(material.Get().toStdString().c_str());
-    if (!terrainMaterial.get()) // If we could not find the material we were supposed to use, just use the default system terrain material.
-        terrainMaterial = OgreRenderer::GetOrCreateLitTexturedMaterial("Rex/TerrainPCF");
+    PatchGeometry geometry;
+    GeneratePatchGeometry(patchX, patchY, geometry);
+    UploadPatchGeometry(patchX, patchY, geometry);
+}
 
-    Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
-    Ogre::ManualObject *manual = sceneMgr->createManualObject(renderer->GetUniqueObjectName());
-    manual->setCastShadows(false);
+void EC_Terrain::GeneratePatchGeometry(int patchX, int patchY, PatchGeometry &geometry) const
+{
+    const EC_Terrain::Patch &patch = GetPatch(patchX, patchY);
 
-    manual->clear();
-    manual->estimateVertexCount((cPatchSize+1)*(cPatchSize+1));
-    manual->estimateIndexCount((cPatchSize+1)*(cPatchSize+1)*3*2);
-    manual->begin(terrainMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+    geometry.positions.clear();
+    geometry.normals.clear();
+    geometry.texCoords.clear();
+    geometry.indices.clear();
+    geometry.positions.reserve((cPatchSize+1)*(cPatchSize+1));
+    geometry.normals.reserve((cPatchSize+1)*(cPatchSize+1));
+    geometry.texCoords.reserve((cPatchSize+1)*(cPatchSize+1)*2);
+    geometry.indices.reserve(cPatchSize*cPatchSize*3*2);
 
     const float vertexSpacingX = 1.f;
     const float vertexSpacingY = 1.f;
     const float patchSpacingX = cPatchSize * vertexSpacingX;
     const float patchSpacingY = cPatchSize * vertexSpacingY;
 //        const Ogre::Vector3 patchOrigin(patch.y * patchSpacingY, 0.f, patch.x * patchSpacingX);
-    const Ogre::Vector3 patchOrigin(patch.x * patchSpacingX, patch.y * patchSpacingY, 0.f);
+    const Vector3df patchOrigin(patch.x * patchSpacingX, patch.y * patchSpacingY, 0.f);
 
-    int curIndex = 0;
+    uint curIndex = 0;
 
     const int cPatchVertexWidth = cPatchSize; // The number of vertices in the patch in horizontal direction. We use the fixed value of cPatchSize==16.
     const int cPatchVertexHeight = cPatchSize; // The number of vertices in the patch in vertical  direction. We use the fixed value of cPatchSize==16.
     // If we assume each patch is 16x16 vertices, then all the internal patches will get a 17x17 grid, since we need to connect seams.
     // But, the outermost patch row and column at the terrain edge will not have this, since they do not need to connect to a next patch.
     // This is the vertex stride for the terrain.
-    const int stride = (patch.x + 1 >= patchWidth) ? cPatchVertexWidth : (cPatchVertexWidth+1);
+    const uint stride = (patch.x + 1 >= patchWidth) ? cPatchVertexWidth : (cPatchVertexWidth+1);
 
     const float uScale = this->uScale.Get();
     const float vScale = this->vScale.Get();
@@ -557,13 +549,13 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
 
             // These coordinates are directly generated to our Ogre coordinate system, i.e. are cycled from OpenSim XYZ -> our YZX.
             // see OpenSimToOgreCoordinateAxes.
-            Ogre::Vector3 pos;
+            Vector3df pos;
 // Ogre:                pos.x = vertexSpacingY * y;
 // Ogre:                pos.z = vertexSpacingX * x;
             pos.x = vertexSpacingX * x;
             pos.y = vertexSpacingY * y;
 
-            EC_Terrain::Patch *thisPatch;
+            const EC_Terrain::Patch *thisPatch;
             int X = x;
             int Y = y;
             if (x < cPatchVertexWidth && y < cPatchVertexHeight)
@@ -573,13 +565,13 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
                 if ((patch.x + 1 < patchWidth || x+1 < cPatchVertexWidth) &&
                     (patch.y + 1 < patchHeight || y+1 < cPatchVertexHeight))
                 {
-                    manual->index(curIndex);
-                    manual->index(curIndex+1);
-                    manual->index(curIndex+stride);
+                    geometry.indices.push_back(curIndex);
+                    geometry.indices.push_back(curIndex+1);
+                    geometry.indices.push_back(curIndex+stride);
 
-                    manual->index(curIndex+1);
-                    manual->index(curIndex+stride+1);
-                    manual->index(curIndex+stride);
+                    geometry.indices.push_back(curIndex+1);
+                    geometry.indices.push_back(curIndex+stride+1);
+                    geometry.indices.push_back(curIndex+stride);
                 }
             }
             else if (x == cPatchVertexWidth && y == cPatchVertexHeight)
@@ -602,12 +594,54 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
 // Ogre:        pos.y = thisPatch->heightData[Y*patchSize+X];
             pos.z = thisPatch->heightData[Y*cPatchVertexWidth+X];
 
-            manual->position(pos);
-            manual->normal(OgreRenderer::ToOgreVector3(CalculateNormal(thisPatch->x, thisPatch->y, X, Y)));
+            geometry.positions.push_back(pos);
+            geometry.normals.push_back(CalculateNormal(thisPatch->x, thisPatch->y, X, Y));
 // Ogre:                manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.z + pos.z) * vScale);
-            manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.y + pos.y) * vScale);
+            geometry.texCoords.push_back((patchOrigin.x + pos.x) * uScale);
+            geometry.texCoords.push_back((patchOrigin.y + pos.y) * vScale);
             ++curIndex;
         }
+}
+
+void EC_Terrain::UploadPatchGeometry(int patchX, int patchY, const PatchGeometry &geometry)
+{
+    EC_Terrain::Patch &patch = GetPatch(patchX, patchY);
+
+    Renderer *renderer = framework_->GetService<Renderer>();
+    if (!renderer)
+        return;
+
+    Ogre::SceneNode *node = patch.node;
+    bool firstTimeFill = (node == 0);
+    UNREFERENCED_PARAM(firstTimeFill);
+    if (!node)
+    {
+        CreateOgreTerrainPatchNode(node, patch.x, patch.y);
+        patch.node = node;
+    }
+    assert(node);
+
+    Ogre::MaterialPtr terrainMaterial = Ogre::MaterialManager::getSingleton().getByName(material.Get().toStdString().c_str());
+    if (!terrainMaterial.get()) // If we could not find the material we were supposed to use, just use the default system terrain material.
+        terrainMaterial = OgreRenderer::GetOrCreateLitTexturedMaterial("Rex/TerrainPCF");
+
+    Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
+    Ogre::ManualObject *manual = sceneMgr->createManualObject(renderer->GetUniqueObjectName());
+    manual->setCastShadows(false);
+
+    manual->clear();
+    manual->estimateVertexCount(geometry.positions.size());
+    manual->estimateIndexCount(geometry.indices.size());
+    manual->begin(terrainMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+
+    for(size_t i = 0; i < geometry.positions.size(); ++i)
+    {
+        manual->position(OgreRenderer::ToOgreVector3(geometry.positions[i]));
+        manual->normal(OgreRenderer::ToOgreVector3(geometry.normals[i]));
+        manual->textureCoord(geometry.texCoords[i*2], geometry.texCoords[i*2+1]);
+    }
+    for(size_t i = 0; i < geometry.indices.size(); ++i)
+        manual->index(geometry.indices[i]);
 
     manual->end();
 
@@ -722,10 +756,19 @@ void EC_Terrain::DirtyAllTerrainPatches()
         patches[i].patch_geometry_dirty = true;
 }
 
+void EC_Terrain::GeneratePatchGeometryAt(const std::vector<std::pair<int, int> > *patchCoords, std::vector<PatchGeometry> *geometries, uint index) const
+{
+    GeneratePatchGeometry((*patchCoords)[index].first, (*patchCoords)[index].second, (*geometries)[index]);
+}
+
 void EC_Terrain::RegenerateDirtyTerrainPatches()
 {
     PROFILE(EC_Terrain_RegenerateDirtyTerrainPatches);
 
+    // Collect the patches to regenerate first. The geometry is computed in parallel on the thread pool, then
+    // uploaded to Ogre on this thread.
+    std::vector<std::pair<int, int> > patchCoords;
+
     for(int y = 0; y < patchHeight; ++y)
         for(int x = 0; x < patchWidth; ++x)
         {
@@ -756,8 +799,27 @@ void EC_Terrain::RegenerateDirtyTerrainPatches()
             }
 
             if (neighborsLoaded)
-                GenerateTerrainGeometryForOnePatch(x, y);
+                patchCoords.push_back(std::make_pair(x, y));
         }
+
+    if (patchCoords.empty())
+        return;
+
+    std::vector<PatchGeometry> geometries(patchCoords.size());
+    {
+        PROFILE(EC_Terrain_GeneratePatchGeometry);
+        Foundation::ThreadPoolPtr threadPool = framework_->GetThreadPool();
+        if (threadPool && patchCoords.size() > 1)
+            threadPool->ParallelFor(0, (uint)patchCoords.size(),
+                boost::bind(&EC_Terrain::GeneratePatchGeometryAt, this, &patchCoords, &geometries, _1));
+        else
+            for(uint i = 0; i < patchCoords.size(); ++i)
+                GeneratePatchGeometryAt(&patchCoords, &geometries, i);
+    }
+
+    PROFILE(EC_Terrain_UploadPatchGeometry);
+    for(size_t i = 0; i < patchCoords.size(); ++i)
+        UploadPatchGeometry(patchCoords[i].first, patchCoords[i].second, geometries[i]);
 }
 
 
@@ -136,7 +136,7 @@ public:
     /// @param patchY The patch to read from, [0, PatchHeight()[.
     /// @param vertexX The vertex inside the patch to compute the normal for, [0, cPatchSize[.
     /// @param vertexY The vertex inside the patch to compute the normal for, [0, cPatchSize[.
-    Vector3df CalculateNormal(int patchX, int patchY, int vertexX, int vertexY);
+    Vector3df CalculateNormal(int patchX, int patchY, int vertexX, int vertexY) const;
 
 public slots:
     /// Returns true if the given patch exists, i.e. whether the given coordinates are within the current terrain patch dimensions.
@@ -303,7 +303,27 @@ private:
     /// @param textureName The Ogre texture resource name to set.
     void SetTerrainMaterialTexture(int index, const char *textureName);
 
+    /// CPU-side vertex and index data of a single patch, generated before it is uploaded to Ogre.
+    struct PatchGeometry
+    {
+        std::vector<Vector3df> positions;
+        std::vector<Vector3df> normals;
+        /// Two texture coordinates per vertex.
+        std::vector<float> texCoords;
+        std::vector<uint> indices;
+    };
+
     void GenerateTerrainGeometryForOnePatch(int patchX, int patchY);
+
+    /// Computes the vertex and index data for the given patch. Only reads the height data, so it can be run for
+    /// several patches in parallel. The patch and its neighbors must have their height data loaded.
+    void GeneratePatchGeometry(int patchX, int patchY, PatchGeometry &geometry) const;
+
+    /// Creates the Ogre mesh for the given patch from the generated geometry, replacing the old one. Main thread only.
+    void UploadPatchGeometry(int patchX, int patchY, const PatchGeometry &geometry);
+
+    /// Generates the geometry of the index'th patch in the list. Used to run GeneratePatchGeometry on the thread pool.
+    void GeneratePatchGeometryAt(const std::vector<std::pair<int, int> > *patchCoords, std::vector<PatchGeometry> *geometries, uint index) const;
 };
 }
 
@@ -2160,10 +2160,15 @@ namespace Environment
         uint img_width        = tex.GetWidth(); 
         uint img_height       = tex.GetHeight(); 
         uint img_components   = tex.GetComponents();
-        u8 *data              = tex.GetData();
         uint img_width_step   = img_width * img_components;
         QImage image;
 
+        // Block compressed textures are decompressed here
+        std::vector<u8> pixels;
+        if (!tex.GetPixels(pixels))
+            return image;
+        const u8 *data        = &pixels[0];
+
         if(img_width > 0 && img_height > 0 && img_components > 0)
         {
             if(img_components == 3)// For RGB888
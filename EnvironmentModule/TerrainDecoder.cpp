@@ -13,6 +13,15 @@
 #include "BitStream.h"
 #include "TerrainDecoder.h"
 #include "EnvironmentModule.h"
+#include "ThreadPool.h"
+
+#include <boost/bind.hpp>
+
+// The IDCT runs four columns at a time with SSE, when the target has it.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TERRAIN_DECODER_SSE
+#include <xmmintrin.h>
+#endif
 
 namespace Environment
 {
@@ -21,6 +30,7 @@ namespace
 {
 const int cEndOfPatches = 97; ///< Magic number that denotes in a LayerData header that there are no more patches present in the packet.
 const float OO_SQRT2 = 0.7071067811865475244008443621049f;
+const int cMinPatchesForThreadPool = 4; ///< Packets with fewer patches are transformed on the calling thread.
 
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
 /// Stores precomputed tables of coefficients needed in the IDCT transform.
@@ -32,11 +42,14 @@ public:
         BuildDequantizeTable16();
         BuildQuantizeTable16();
         SetupCosines16();
+        BuildIDCTTable16();
         BuildCopyMatrix16();
     }
 
     float dequantizeTable16[16*16];
     float cosineTable16[16*16];
+    /// Basis function values: idctTable16[u*16+n] is the weight of frequency u in sample n.
+    float idctTable16[16*16];
     int copyMatrix16[16*16];
     float quantizeTable16[16*16];
 
@@ -63,6 +76,13 @@ public:
                 cosineTable16[u*16 + n] = (float)cosf((2.0f * (float)n + 1.0f) * (float)u * hposz);
     }
 
+    void BuildIDCTTable16()
+    {
+        for (int u = 0; u < 16; u++)
+            for (int n = 0; n < 16; n++)
+                idctTable16[u*16 + n] = (u == 0) ? OO_SQRT2 : cosineTable16[u*16 + n];
+    }
+
     void BuildCopyMatrix16()
     {
         bool diag = false;
@@ -173,51 +193,68 @@ void DecodeTerrainPatch(int *patches, ProtocolUtilities::BitStream &bits, const
     }
 }
 
-/// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-/// Performs IDCT on a single column of 16 elements of data. (stride assumed to be 16 elements)
-void IDCTColumn16(const float *linein, float *lineout, int column)
+/// Sets dst = src * scale, for a row of 16 elements.
+inline void ScaleRow16(float *dst, const float *src, float scale)
 {
-    float total;
-    const int cStride = 16;
-
-    for (int n = 0; n < 16; n++)
-    {
-        total = OO_SQRT2 * linein[column];
-
-        for (int u = 1; u < 16; u++)
-            total += linein[u*cStride + column] * precompTables.cosineTable16[u*cStride + n];
+#ifdef TERRAIN_DECODER_SSE
+    const __m128 s = _mm_set1_ps(scale);
+    for (int i = 0; i < 16; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), s));
+#else
+    for (int i = 0; i < 16; i++)
+        dst[i] = src[i] * scale;
+#endif
+}
 
-        lineout[16 * n + column] = total;
-    }
+/// Sets dst += src * scale, for a row of 16 elements.
+inline void MulAddRow16(float *dst, const float *src, float scale)
+{
+#ifdef TERRAIN_DECODER_SSE
+    const __m128 s = _mm_set1_ps(scale);
+    for (int i = 0; i < 16; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), s)));
+#else
+    for (int i = 0; i < 16; i++)
+        dst[i] += src[i] * scale;
+#endif
 }
 
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-/// Performs IDCT on a single row of 16 elements of data.
-void IDCTLine16(const float *linein, float *lineout, int line)
+/// Performs the 2D IDCT on a 16x16 block. The column and row passes are written as sums of whole rows, so that
+/// 16 outputs are computed at a time.
+/// @param block [in, out] The dequantized coefficients, replaced with the transformed values.
+void IDCT16x16(float *block)
 {
-    const float oosob = 2.0f / 16.0f;
-    int lineSize = line * 16;
-    float total;
+    const float *idct = precompTables.idctTable16;
+    float ftemp[16*16];
 
+    // Column pass: row n of the output is the sum of the input rows u, weighted by the basis value of u at n.
     for (int n = 0; n < 16; n++)
     {
-        total = OO_SQRT2 * linein[lineSize];
-
+        float *out = ftemp + n*16;
+        ScaleRow16(out, block, idct[n]);
         for (int u = 1; u < 16; u++)
-        {
-            total += linein[lineSize + u] * precompTables.cosineTable16[u * 16 + n];
-        }
+            MulAddRow16(out, block + u*16, idct[u*16 + n]);
+    }
 
-        lineout[lineSize + n] = total * oosob;
+    // Row pass: row l of the output is the sum of the basis rows u, weighted by element u of the row l.
+    const float oosob = 2.0f / 16.0f;
+    for (int l = 0; l < 16; l++)
+    {
+        const float *in = ftemp + l*16;
+        float *out = block + l*16;
+        ScaleRow16(out, idct, in[0]);
+        for (int u = 1; u < 16; u++)
+            MulAddRow16(out, idct + u*16, in[u]);
+        ScaleRow16(out, out, oosob);
     }
 }
 
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const TerrainPatchHeader &patchHeader, const TerrainPatchGroupHeader &groupHeader)
+/// @param patchData The quantized coefficients of the patch. Must be 16*16 elements.
+void DecompressTerrainPatch(std::vector<float> &output, const int *patchData, const TerrainPatchHeader &patchHeader)
 {
-    std::vector<float> block(groupHeader.patchSize * groupHeader.patchSize);
-    output.clear();
-    output.resize(groupHeader.patchSize * groupHeader.patchSize);
+    float block[16*16];
 
     int prequant = (patchHeader.quantWBits >> 4) + 2;
     int quantize = 1 << prequant;
@@ -225,31 +262,45 @@ void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const Te
     float mult = ooq * (float)patchHeader.range;
     float addval = mult * (float)(1 << (prequant - 1)) + patchHeader.dcOffset;
 
-    if (groupHeader.patchSize != 16)
-    {
-        EnvironmentModule::LogWarning("TerrainDecoder:DecompressTerrainPatch: Unsupported patch size present!");
-        return;
-    }
-
     for(int n = 0; n < 16 * 16; n++)
         block[n] = patchData[precompTables.copyMatrix16[n]] * precompTables.dequantizeTable16[n];
 
-    std::vector<float> ftemp(16*16);
+    IDCT16x16(block);
 
-    for (int o = 0; o < 16; o++)
-        IDCTColumn16(&block[0], &ftemp[0], o);
-    for (int o = 0; o < 16; o++)
-        IDCTLine16(&ftemp[0], &block[0], o);
-
-    for (int j = 0; j < block.size(); j++)
+    output.resize(16 * 16);
+    for (int j = 0; j < 16 * 16; j++)
         output[j] = block[j] * mult + addval;
 }
 
+/// Decompresses one patch of a packet into height data, from the coefficients already read from the bit stream.
+/// Each patch is independent of the others, so several threads may decompress different patches at the same time.
+/// @param patches Decoded patches. The header of the patch must be filled in, its height data is written.
+/// @param firstPatch Position in patches of the first patch of the packet.
+/// @param coefficients Coefficients of the patches of the packet, 16 * 16 per patch, in the order they were read.
+/// @param index Number of the patch within the packet, starting from 0.
+void DecompressTerrainPatchAt(std::vector<DecodedTerrainPatch> *patches, size_t firstPatch, const std::vector<int> *coefficients, uint index)
+{
+    DecodedTerrainPatch &patch = (*patches)[firstPatch + index];
+    DecompressTerrainPatch(patch.heightData, &(*coefficients)[index * 16 * 16], patch.header);
+}
+
 } // ~unnamed namespace
 
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader)
+void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader,
+    Foundation::ThreadPool *threadPool)
 {
+    // Reading the bit stream is sequential, so first read the headers and coefficients of all patches in the packet.
+    // Then run the IDCTs, which are independent of each other.
+    if (groupHeader.patchSize != 16)
+    {
+        EnvironmentModule::LogWarning("TerrainDecoder:DecompressLand: Unsupported patch size present!");
+        return;
+    }
+
+    const size_t firstPatch = patches.size();
+    std::vector<int> coefficients;
+
     while(bits.BitsLeft() > 0)
     {
         DecodedTerrainPatch patch;
@@ -264,16 +315,24 @@ void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities
         if (patch.header.x >= cPatchesPerEdge || patch.header.y >= cPatchesPerEdge)
         {
             EnvironmentModule::LogWarning("TerrainDecoder:DecompressLand: Invalid patch data!");
-            return;
+            break;
         }
 
-        int patchData[16*16];
-        DecodeTerrainPatch(patchData, bits, patch.header, groupHeader.patchSize);
-
-        DecompressTerrainPatch(patch.heightData, patchData, patch.header, groupHeader);
+        coefficients.resize(coefficients.size() + 16 * 16);
+        DecodeTerrainPatch(&coefficients[coefficients.size() - 16 * 16], bits, patch.header, groupHeader.patchSize);
 
-        patches.push_back(patch); ///\todo Can optimize out a copy of heavy struct by push_backing early in the loop.
+        patches.push_back(patch);
     }
+
+    const uint numDecoded = (uint)(patches.size() - firstPatch);
+    if (numDecoded == 0)
+        return;
+
+    if (threadPool && numDecoded >= (uint)cMinPatchesForThreadPool)
+        threadPool->ParallelFor(0, numDecoded, boost::bind(&DecompressTerrainPatchAt, &patches, firstPatch, &coefficients, _1));
+    else
+        for(uint i = 0; i < numDecoded; ++i)
+            DecompressTerrainPatchAt(&patches, firstPatch, &coefficients, i);
 }
 
 }
@@ -11,6 +11,11 @@
 
 #include "BitStream.h"
 
+namespace Foundation
+{
+    class ThreadPool;
+}
+
 namespace Environment
 {
     /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
@@ -48,11 +53,13 @@ namespace Environment
         TerrainPatchHeader header;
     };
 
-    /// Decompresses a single patch of terrain height data from a LayerData packet.
-    /// @param patches [out] The resulting patch data will be output here.
+    /// Decompresses the patches of terrain height data in a LayerData packet.
+    /// @param patches [out] The resulting patch data will be appended here.
     /// @param bits [in] The LayerData packet, of which the Patch Group Header has already been read.
     /// @param groupHeader 
-    void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader);
+    /// @param threadPool If specified, and the packet contains several patches, the inverse transforms are run on this pool.
+    void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader,
+        Foundation::ThreadPool *threadPool = 0);
 }
 
 #endif
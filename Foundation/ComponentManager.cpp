@@ -15,6 +15,9 @@
 
 #include "MemoryLeakCheck.h"
 
+QHash<QString, component_type_id_t> ComponentManager::typeIds_;
+QStringList ComponentManager::typeNames_;
+
 ComponentManager::ComponentManager(Foundation::Framework *framework) : framework_(framework)
 {
     attributeTypes_.push_back("string");
@@ -35,6 +38,7 @@ void ComponentManager::RegisterFactory(const QString &component, const Component
 {
     if (factories_.find(component) == factories_.end())
         factories_[component] = factory;
+    GetComponentTypeId(component);
 }
 
 void ComponentManager::UnregisterFactory(const QString &component)
@@ -116,6 +120,30 @@ QStringList ComponentManager::GetAttributeTypes() const
     return attributeTypes_;
 }
 
+component_type_id_t ComponentManager::GetComponentTypeId(const QString &type_name)
+{
+    QHash<QString, component_type_id_t>::const_iterator iter = typeIds_.find(type_name);
+    if (iter != typeIds_.end())
+        return iter.value();
+
+    typeNames_.append(type_name);
+    component_type_id_t type_id = (component_type_id_t)typeNames_.size();
+    typeIds_.insert(type_name, type_id);
+    return type_id;
+}
+
+component_type_id_t ComponentManager::FindComponentTypeId(const QString &type_name)
+{
+    return typeIds_.value(type_name, 0);
+}
+
+QString ComponentManager::GetComponentTypeName(component_type_id_t type_id)
+{
+    if (type_id == 0 || type_id > (component_type_id_t)typeNames_.size())
+        return QString();
+    return typeNames_[type_id - 1];
+}
+
 QStringList ComponentManager::GetAvailableComponentTypeNames() const
 {
     QStringList ret;
@@ -4,8 +4,11 @@
 #define incl_Foundation_ComponentManager_h
 
 #include "ForwardDefines.h"
+#include "CoreTypes.h"
 
 #include <map>
+#include <QHash>
+#include <QStringList>
 
 //! Scenegraph, entity and component model that together form a generic, extendable, lightweight scene model.
 /*! See \ref SceneModelPage "Scenes, entities and components" for details about the viewer's scene model.
@@ -74,10 +77,34 @@ public:
     //! Returns string list of available component type names.
     QStringList GetAvailableComponentTypeNames() const;
 
+    //! Returns the type id of a component type name, assigning a new id if the name has not been seen before.
+    /*! Type ids are small consecutive integers starting from 1. They are shared by all component managers and kept
+        for the lifetime of the process, even if the factory is unregistered. Entities use them to look up their
+        components without string compares.
+        Ids are assigned when a factory is registered, or when a component of an unregistered type is added to an
+        entity, both on the main thread. Only call this from the main thread; the lookup functions below do not lock,
+        so the table must not change while other threads read it.
+        \param type_name type of the component
+        \return type id, never 0
+    */
+    static component_type_id_t GetComponentTypeId(const QString &type_name);
+
+    //! Returns the type id of a component type name, or 0 if no id has been assigned to the name.
+    static component_type_id_t FindComponentTypeId(const QString &type_name);
+
+    //! Returns the type name that the type id was assigned to, or empty string if the id is not in use.
+    static QString GetComponentTypeName(component_type_id_t type_id);
+
 private:
     //! Map of component factories
     ComponentFactoryMap factories_;
 
+    //! Component type name -> type id
+    static QHash<QString, component_type_id_t> typeIds_;
+
+    //! Component type names, indexed by type id - 1
+    static QStringList typeNames_;
+
     //! List of supported attribute types.
     QStringList attributeTypes_;
 
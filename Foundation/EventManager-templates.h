@@ -19,6 +19,7 @@ bool EventManager::AddSubscriber(T* subscriber, QList<U>& subscribers, int prior
         {
             subscribers[i].priority_ = priority;
             qSort(subscribers.begin(), subscribers.end());
+            InvalidateDispatchTables();
             return true;
         }
 
@@ -27,6 +28,7 @@ bool EventManager::AddSubscriber(T* subscriber, QList<U>& subscribers, int prior
     new_subscriber.priority_ = priority;
     subscribers.append(new_subscriber);
     qSort(subscribers.begin(), subscribers.end());
+    InvalidateDispatchTables();
 
     return true;
 }
@@ -58,6 +60,7 @@ bool EventManager::RemoveSubscriber(T* subscriber, QList<U>& subscribers )
         if (subscribers[i].subscriber_ == subscriber)
         {
             subscribers.erase(subscribers.begin() + i);
+            InvalidateDispatchTables();
             return true;
         }
 
@@ -104,6 +107,9 @@ bool EventManager::UnregisterEventSubscriber(T* subscriber)
                 ++iter;
         }
 
+        if (ret2)
+            InvalidateDispatchTables();
+
         return (ret || ret2);
     }
 
@@ -139,30 +145,3 @@ bool EventManager::HasEventSubscriber(T* subscriber)
 
     return false;
  }
-
-template <typename T>
-bool EventManager::SendEvent(const EventSubscriber<T>& subs, event_category_id_t category_id, event_id_t event_id, IEventData* data) const
- {
-    T* subscriber = subs.subscriber_;
-    if (subscriber)
-    {
-        try
-        {
-            return subscriber->HandleEvent(category_id, event_id, data);
-        }
-        catch(const std::exception &/*e*/)
-        {
-            //std::cout << "HandleEvent caught an exception inside module " << module->Name() << ": " << (e.what() ? e.what() : "(null)") << std::endl;
-            //RootLogCritical(std::string("HandleEvent caught an exception inside module " + module->Name() + ": " + (e.what() ? e.what() : "(null)")));
-            throw;
-        }
-        catch(...)
-        {
-            //std::cout << "HandleEvent caught an unknown exception inside module " << module->Name() << std::endl;
-            //RootLogCritical(std::string("HandleEvent caught an unknown exception inside module " + module->Name()));
-            throw;
-        }
-    }
-
-    return false;
-}
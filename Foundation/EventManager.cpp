@@ -24,6 +24,8 @@ EventManager::EventManager(Foundation::Framework *framework) :
     framework_(framework),
     next_category_id_(1),
     next_request_tag_(1),
+    posted_events_sent_(0),
+    subscribers_revision_(0),
     main_thread_id_(QThread::currentThreadId())
 {
 }
@@ -120,35 +122,63 @@ bool EventManager::SendEvent(event_category_id_t category_id, event_id_t event_i
     if (framework_->Asset())
         framework_->Asset()->HandleEvent(category_id, event_id, data);
 
-    // Send event in priority order, until someone returns true
-    for (int i = 0; i < module_subscribers_.size(); ++i)
-        if (SendEvent(module_subscribers_[i], category_id, event_id, data))
-            return true;
-
-    // After that send events to components
-    for (int i = 0; i < component_subscribers_.size(); ++i)
-        if (SendEvent(component_subscribers_[i], category_id, event_id, data))
-            return true;
-
-    // Then go through 
-    QPair<event_category_id_t, event_id_t> group = qMakePair<event_category_id_t, event_id_t>(category_id, event_id);
-   
-    if ( specialEvents_.contains(group) )
+    // Send event in priority order, until someone returns true. Keep a reference to the table, as it is replaced
+    // if an event handler registers or unregisters subscribers.
+    const DispatchTablePtr table = GetDispatchTable(category_id, event_id);
+    const uint revision = subscribers_revision_;
+    for (size_t i = 0; i < table->size(); ++i)
     {
-        QList<IComponent* >& lst = specialEvents_[group];
-        for ( int i = 0; i < lst.size(); ++i)
+        const DispatchEntry &entry = (*table)[i];
+        if (revision != subscribers_revision_)
         {
-            EventSubscriber<IComponent> subs;
-            subs.subscriber_ = lst[i];
-
-            if (SendEvent(subs, category_id, event_id, data))
-                return true;
+            // The subscribers have changed during this event. Removed subscribers may already be deleted, so only
+            // call those that are still registered.
+            const DispatchTablePtr &current = GetDispatchTable(category_id, event_id);
+            if (std::find(current->begin(), current->end(), entry) == current->end())
+                continue;
         }
+
+        if (entry.module_ ? entry.module_->HandleEvent(category_id, event_id, data) :
+            entry.component_->HandleEvent(category_id, event_id, data))
+            return true;
     }
 
     return false;
 }
 
+const EventManager::DispatchTablePtr &EventManager::GetDispatchTable(event_category_id_t category_id, event_id_t event_id)
+{
+    DispatchTablePtr &table = dispatch_tables_[DispatchKey(category_id, event_id)];
+    if (table)
+        return table;
+
+    table = DispatchTablePtr(new DispatchTable());
+    QMap<QPair<event_category_id_t, event_id_t>, QList<IComponent* > >::const_iterator special =
+        specialEvents_.constFind(qMakePair<event_category_id_t, event_id_t>(category_id, event_id));
+    table->reserve(module_subscribers_.size() + component_subscribers_.size() +
+        (special != specialEvents_.constEnd() ? special.value().size() : 0));
+
+    for (int i = 0; i < module_subscribers_.size(); ++i)
+        if (module_subscribers_[i].subscriber_)
+            table->push_back(DispatchEntry(module_subscribers_[i].subscriber_, 0));
+    for (int i = 0; i < component_subscribers_.size(); ++i)
+        if (component_subscribers_[i].subscriber_)
+            table->push_back(DispatchEntry(0, component_subscribers_[i].subscriber_));
+    if (special != specialEvents_.constEnd())
+        for (int i = 0; i < special.value().size(); ++i)
+            if (special.value()[i])
+                table->push_back(DispatchEntry(0, special.value()[i]));
+
+    return table;
+}
+
+void EventManager::InvalidateDispatchTables()
+{
+    // Tables still referenced by an ongoing SendEvent stay alive until it returns.
+    dispatch_tables_.clear();
+    ++subscribers_revision_;
+}
+
 bool EventManager::SendEvent(const std::string& category, event_id_t event_id, IEventData* data)
 {
     return SendEvent(QueryEventCategory(category), event_id, data);
@@ -176,6 +206,26 @@ void EventManager::SendDelayedEvent(event_category_id_t category_id, event_id_t
     new_delayed_events_.push_back(new_delayed_event);
 }
 
+void EventManager::PostEvent(event_category_id_t category_id, event_id_t event_id, EventDataPtr data)
+{
+    // Do not send messages after exit
+    if (framework_->IsExiting())
+        return;
+
+    if (category_id == IllegalEventCategory)
+    {
+        RootLogWarning("Attempted to post event with illegal category");
+        return;
+    }
+
+    DelayedEvent posted_event;
+    posted_event.category_id_ = category_id;
+    posted_event.event_id_ = event_id;
+    posted_event.data_ = data;
+    posted_event.delay_ = 0.0;
+    posted_events_.Push(posted_event);
+}
+
 bool EventManager::RegisterEventSubscriber(IComponent* component, event_category_id_t category_id, event_id_t event_id)
 {
    
@@ -193,6 +243,7 @@ bool EventManager::RegisterEventSubscriber(IComponent* component, event_category
         specialEvents_.insert(group,lst);
     }
 
+    InvalidateDispatchTables();
     return true;
 }
 
@@ -211,6 +262,7 @@ bool EventManager::UnregisterEventSubscriber(IComponent* component, event_catego
         if (lst.empty())
             specialEvents_.remove(group);
         
+        InvalidateDispatchTables();
         return true;
    }
 
@@ -229,10 +281,39 @@ void EventManager::ClearDelayedEvents()
     MutexLock lock(delayed_events_mutex_);
     delayed_events_.clear();
     new_delayed_events_.clear();
+    posted_events_.Clear();
+    posted_events_scratch_.clear();
+    posted_events_sent_ = 0;
 }
 
 void EventManager::ProcessDelayedEvents(f64 frametime)
 {
+    ProcessDelayedEvents(frametime, Foundation::FrameBudget::Unlimited());
+}
+
+bool EventManager::ProcessDelayedEvents(f64 frametime, const Foundation::FrameBudget &budget)
+{
+    bool sent_any = false;
+
+    // Send the posted events first, the ones left over from the last call before the new ones. Handlers may post
+    // more events; those are sent on the next update.
+    if (!posted_events_.IsEmpty())
+        posted_events_.PopAll(posted_events_scratch_);
+    while (posted_events_sent_ < posted_events_scratch_.size())
+    {
+        if (sent_any && budget.Expired())
+            break;
+        DelayedEvent event = posted_events_scratch_[posted_events_sent_++];
+        SendEvent(event.category_id_, event.event_id_, event.data_.get());
+        sent_any = true;
+    }
+    bool done = (posted_events_sent_ == posted_events_scratch_.size());
+    if (done)
+    {
+        posted_events_scratch_.clear();
+        posted_events_sent_ = 0;
+    }
+
     {
         MutexLock lock(delayed_events_mutex_);
         delayed_events_.insert(delayed_events_.end(), new_delayed_events_.begin(), new_delayed_events_.end());
@@ -243,13 +324,24 @@ void EventManager::ProcessDelayedEvents(f64 frametime)
     while (i != delayed_events_.end())
         if (i->delay_ <= 0.0)
         {
-            SendEvent(i->category_id_, i->event_id_, i->data_.get());
+            // Due events left over stay due, and are sent on the next call
+            if (sent_any && budget.Expired())
+            {
+                done = false;
+                ++i;
+                continue;
+            }
+            DelayedEvent event = *i;
             i = delayed_events_.erase(i);
+            SendEvent(event.category_id_, event.event_id_, event.data_.get());
+            sent_any = true;
         }
         else
         {
             i->delay_ -= frametime;
             ++i;
         }
+
+    return done;
 }
 
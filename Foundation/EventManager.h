@@ -8,6 +8,10 @@
 #include "CoreThread.h"
 #include "IComponent.h"
 #include "Framework.h"
+#include "MpscQueue.h"
+#include "FrameScheduler.h"
+
+#include <boost/unordered_map.hpp>
 
 #include <QList>
 #include <QtAlgorithms>
@@ -90,6 +94,15 @@ public:
     template <class T>
     void SendDelayedEvent(event_category_id_t category_id, event_id_t event_id, boost::shared_ptr<T> data, f64 delay = 0.0);
 
+    //! Posts an event to be sent during the next framework update
+    /*! Thread-safe and lock-free, meant for worker threads that produce events at a high rate. Events posted from
+        one thread are sent in the order they were posted, before any delayed events that are due in the same frame.
+        \param category_id Event category ID
+        \param event_id Event ID
+        \param data Shared pointer to event data structure (event-specific), can be 0 if not needed
+     */
+    void PostEvent(event_category_id_t category_id, event_id_t event_id, EventDataPtr data);
+
     //! Registers a module or component to the event subscriber list
     /*! Do not call while responding to an event! Note that it is ok to resubscribe your module to change priority.
         \param module Module to register
@@ -126,6 +139,14 @@ public:
      */
     void ProcessDelayedEvents(f64 frametime);
 
+    //! Processes delayed events until the budget expires, but sends at least one. Called by the framework.
+    /*! Events that are due but not sent are sent first on the next call.
+        \param frametime Time since last frame
+        \param budget Time to spend
+        \return true if all due events were sent
+     */
+    bool ProcessDelayedEvents(f64 frametime, const Foundation::FrameBudget &budget);
+
     //! Returns event category map
     const EventCategoryMap &GetEventCategoryMap() const { return event_category_map_; }
 
@@ -184,15 +205,30 @@ private:
         f64 delay_;
    };
 
-    /// Sends event to a module in the subscriber vector
-    /** @param subscriber Which subscriber to send to
-        @param category_id Event category ID
-        @param event_id Event ID
-        @param data Pointer to event data structure (event-specific)
-        @return true if event handled and further subscribers should not be processed
-    */
-   template <typename T>
-   bool SendEvent(const EventSubscriber<T>& subs, event_category_id_t category_id, event_id_t event_id, IEventData* data) const;
+   //! Entry of a dispatch table. Exactly one of the pointers is set.
+   struct DispatchEntry
+   {
+        DispatchEntry(IModule *module, IComponent *component) : module_(module), component_(component) {}
+
+        bool operator==(const DispatchEntry &rhs) const { return module_ == rhs.module_ && component_ == rhs.component_; }
+
+        IModule *module_;
+        IComponent *component_;
+   };
+
+   //! Subscribers of one (category, event) pair in the order they are called: modules by priority, components by
+   //! priority, then the components registered for that event only.
+   typedef std::vector<DispatchEntry> DispatchTable;
+   typedef boost::shared_ptr<DispatchTable> DispatchTablePtr;
+
+   //! Returns key of the dispatch table map for an event.
+   static u64 DispatchKey(event_category_id_t category_id, event_id_t event_id) { return ((u64)category_id << 32) | event_id; }
+
+   //! Returns the dispatch table of an event, building it if necessary.
+   const DispatchTablePtr &GetDispatchTable(event_category_id_t category_id, event_id_t event_id);
+
+   //! Drops all dispatch tables. Called whenever the subscriber lists change.
+   void InvalidateDispatchTables();
 
    template <typename T, typename U>
    bool AddSubscriber(T* subscriber, QList<U>& subscribers, int priority);
@@ -229,6 +265,21 @@ private:
     //! Mutex for new delayed events
     Mutex delayed_events_mutex_;
 
+    //! Events posted with PostEvent, waiting for the next framework update
+    MpscQueue<DelayedEvent> posted_events_;
+
+    //! Scratch vector for draining posted_events_
+    DelayedEventVector posted_events_scratch_;
+
+    //! Amount of events in posted_events_scratch_ already sent
+    size_t posted_events_sent_;
+
+    //! Dispatch tables of the events sent since the subscribers last changed, keyed by DispatchKey
+    boost::unordered_map<u64, DispatchTablePtr> dispatch_tables_;
+
+    //! Incremented every time the subscriber lists change. Lets SendEvent notice changes made by the event handlers.
+    uint subscribers_revision_;
+
     //! Framework
     Foundation::Framework *framework_;
 
@@ -55,6 +55,9 @@ namespace Foundation
     class Platform;
     class Application;
     class ThreadTaskManager;
+    class ThreadPool;
+    class FrameScheduler;
+    class FrameBudget;
     class Framework;
     class KeyBindings;
     class MainWindow;
@@ -63,6 +66,8 @@ namespace Foundation
     typedef boost::shared_ptr<Platform> PlatformPtr;
     typedef boost::shared_ptr<Application> ApplicationPtr;
     typedef boost::shared_ptr<ThreadTaskManager> ThreadTaskManagerPtr;
+    typedef boost::shared_ptr<ThreadPool> ThreadPoolPtr;
+    typedef boost::shared_ptr<FrameScheduler> FrameSchedulerPtr;
 
     class RenderServiceInterface;
     typedef boost::shared_ptr<RenderServiceInterface> RendererPtr;
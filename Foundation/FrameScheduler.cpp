@@ -0,0 +1,126 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "Foundation.h"
+#include "FrameScheduler.h"
+#include "Framework.h"
+#include "ConfigurationManager.h"
+
+#include <algorithm>
+
+namespace Foundation
+{
+    namespace
+    {
+        //! Default target frame time, in seconds
+        const f64 DEFAULT_TARGET_FRAME_TIME = 1.0 / 60.0;
+
+        //! Weight of the latest frame in the moving average of stage times
+        const f64 AVERAGE_WEIGHT = 0.05;
+    }
+
+    FrameScheduler::FrameScheduler(Framework *framework) :
+        framework_(framework)
+    {
+        target_frame_time_ = framework_->GetDefaultConfig().DeclareSetting(Framework::ConfigurationGroup(), "target_frame_time", DEFAULT_TARGET_FRAME_TIME);
+        if (target_frame_time_ <= 0.0)
+            target_frame_time_ = DEFAULT_TARGET_FRAME_TIME;
+    }
+
+    void FrameScheduler::AddStage(const std::string &name, f64 share, const StageFunction &function, bool budgeted)
+    {
+        share = framework_->GetDefaultConfig().DeclareSetting("FrameScheduler", name + "_share", share);
+        if (share < 0.0)
+            share = 0.0;
+
+        for(size_t i = 0; i < stages_.size(); ++i)
+            if (stages_[i].stats_.name_ == name)
+            {
+                stages_[i].share_ = share;
+                stages_[i].function_ = function;
+                stages_[i].budgeted_ = budgeted;
+                stages_[i].stats_.budget_ = share * target_frame_time_;
+                return;
+            }
+
+        Stage stage;
+        stage.share_ = share;
+        stage.function_ = function;
+        stage.budgeted_ = budgeted;
+        stage.stats_.name_ = name;
+        stage.stats_.budget_ = share * target_frame_time_;
+        stages_.push_back(stage);
+    }
+
+    void FrameScheduler::RemoveStage(const std::string &name)
+    {
+        for(std::vector<Stage>::iterator iter = stages_.begin(); iter != stages_.end(); ++iter)
+            if (iter->stats_.name_ == name)
+            {
+                stages_.erase(iter);
+                return;
+            }
+    }
+
+    void FrameScheduler::RunFrame(f64 frametime)
+    {
+        const tick_t freq = GetCurrentClockFreq();
+        const tick_t frame_start = GetCurrentClockTime();
+        f64 shares_so_far = 0.0;
+
+        // Stages may add or remove stages, so do not hold on to iterators
+        for(size_t i = 0; i < stages_.size(); ++i)
+        {
+            shares_so_far += stages_[i].share_;
+            f64 budget = stages_[i].share_ * target_frame_time_;
+
+            // Time earlier stages did not use is available to this one
+            tick_t start = GetCurrentClockTime();
+            f64 elapsed_so_far = (f64)(start - frame_start) / freq;
+            budget = std::max(budget, shares_so_far * target_frame_time_ - elapsed_so_far);
+
+            StageFunction function = stages_[i].function_;
+            bool budgeted = stages_[i].budgeted_;
+            std::string name = stages_[i].stats_.name_;
+            bool done = function(frametime, budgeted ? FrameBudget(start + (tick_t)(budget * freq)) : FrameBudget::Unlimited());
+
+            f64 time = (f64)(GetCurrentClockTime() - start) / freq;
+
+            // The stage may have removed itself or others
+            if (i >= stages_.size() || stages_[i].stats_.name_ != name)
+                continue;
+
+            StageStats &stats = stages_[i].stats_;
+            stats.last_time_ = time;
+            stats.average_time_ = stats.frames_ ? stats.average_time_ + (time - stats.average_time_) * AVERAGE_WEIGHT : time;
+            stats.max_time_ = std::max(stats.max_time_, time);
+            ++stats.frames_;
+            if (time > stats.budget_)
+            {
+                ++stats.overruns_;
+                stats.overrun_time_ += time - stats.budget_;
+            }
+            if (!done)
+                ++stats.deferred_frames_;
+        }
+    }
+
+    std::vector<FrameScheduler::StageStats> FrameScheduler::GetStats() const
+    {
+        std::vector<StageStats> stats;
+        for(size_t i = 0; i < stages_.size(); ++i)
+            stats.push_back(stages_[i].stats_);
+        return stats;
+    }
+
+    void FrameScheduler::ResetStats()
+    {
+        for(size_t i = 0; i < stages_.size(); ++i)
+        {
+            std::string name = stages_[i].stats_.name_;
+            stages_[i].stats_ = StageStats();
+            stages_[i].stats_.name_ = name;
+            stages_[i].stats_.budget_ = stages_[i].share_ * target_frame_time_;
+        }
+    }
+}
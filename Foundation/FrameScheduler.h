@@ -0,0 +1,159 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_FrameScheduler_h
+#define incl_Foundation_FrameScheduler_h
+
+#include "CoreTypes.h"
+#include "HighPerfClock.h"
+
+#include <boost/function.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Foundation
+{
+    class Framework;
+
+    //! Time a frame stage may use, see FrameScheduler
+    class FrameBudget
+    {
+    public:
+        //! Constructor
+        /*! \param deadline Clock time the stage should return by
+         */
+        explicit FrameBudget(tick_t deadline) : deadline_(deadline) {}
+
+        //! Returns true once the time of the stage is used up. Stages check this between units of work.
+        bool Expired() const { return GetCurrentClockTime() >= deadline_; }
+
+        //! Returns a budget that never expires, for running work to completion
+        static FrameBudget Unlimited() { return FrameBudget((tick_t)-1); }
+
+    private:
+        //! Clock time the stage should return by
+        tick_t deadline_;
+    };
+
+    //! Runs the main thread work of each frame in stages, each within a share of the target frame time.
+    /*! A budgeted stage does units of work until its FrameBudget expires, and leaves the rest for the next frame.
+        It always does at least one unit per frame, so that no work starves however long the units take. The
+        budget of a stage is its share of the target frame time, or the time left of the shares of all stages so
+        far if earlier stages finished early. Stages that are not budgeted always run to completion; their
+        overruns are recorded the same way.
+
+        The framework runs modules, thread task results and delayed events as stages, see
+        Framework::ProcessOneFrame(). Modules may add stages of their own. The share of each stage can be set in
+        the FrameScheduler configuration group as "<stage name>_share", and the target frame time in the
+        framework configuration group as "target_frame_time".
+     */
+    class FrameScheduler
+    {
+    public:
+        //! Work of a stage
+        /*! \param frametime Time elapsed since the previous frame, in seconds
+            \param budget Time the stage may use
+            \return true if the stage has no work left, false if work was left for the next frame
+         */
+        typedef boost::function<bool(f64 frametime, const FrameBudget &budget)> StageFunction;
+
+        //! Timing statistics of a stage
+        struct StageStats
+        {
+            StageStats() :
+                budget_(0.0),
+                last_time_(0.0),
+                average_time_(0.0),
+                max_time_(0.0),
+                frames_(0),
+                overruns_(0),
+                overrun_time_(0.0),
+                deferred_frames_(0)
+            {
+            }
+
+            //! Name of the stage
+            std::string name_;
+
+            //! Budget of the stage, in seconds
+            f64 budget_;
+
+            //! Time spent in the stage last frame, in seconds
+            f64 last_time_;
+
+            //! Moving average of the time spent in the stage, in seconds
+            f64 average_time_;
+
+            //! Longest time spent in the stage, in seconds
+            f64 max_time_;
+
+            //! Amount of frames the stage has run in
+            u32 frames_;
+
+            //! Amount of frames the stage used more than its budget in
+            u32 overruns_;
+
+            //! Total time the stage has used over its budget, in seconds
+            f64 overrun_time_;
+
+            //! Amount of frames the stage left work for the next frame in
+            u32 deferred_frames_;
+        };
+
+        //! Constructor
+        explicit FrameScheduler(Framework *framework);
+
+        //! Adds a stage, or replaces the function of an existing one. Stages run in the order they were added.
+        /*! \param name Name of the stage
+            \param share Default share of the target frame time, overridden by the configuration
+            \param function Work of the stage
+            \param budgeted If false, the stage always runs to completion
+         */
+        void AddStage(const std::string &name, f64 share, const StageFunction &function, bool budgeted = true);
+
+        //! Removes a stage. Modules must remove their stages before they are unloaded.
+        void RemoveStage(const std::string &name);
+
+        //! Runs all stages once
+        /*! \param frametime Time elapsed since the previous frame, in seconds
+         */
+        void RunFrame(f64 frametime);
+
+        //! Returns the target frame time, in seconds
+        f64 GetTargetFrameTime() const { return target_frame_time_; }
+
+        //! Returns the statistics of all stages, in the order the stages run
+        std::vector<StageStats> GetStats() const;
+
+        //! Resets the statistics of all stages
+        void ResetStats();
+
+    private:
+        //! A stage of the frame
+        struct Stage
+        {
+            //! Share of the target frame time
+            f64 share_;
+
+            //! Work of the stage
+            StageFunction function_;
+
+            //! Whether the stage may leave work for the next frame
+            bool budgeted_;
+
+            //! Timing statistics
+            StageStats stats_;
+        };
+
+        //! Framework
+        Framework *framework_;
+
+        //! Target frame time, in seconds
+        f64 target_frame_time_;
+
+        //! Stages in the order they run
+        std::vector<Stage> stages_;
+    };
+}
+
+#endif
@@ -14,6 +14,8 @@
 #include "ServiceManager.h"
 #include "ResourceInterface.h"
 #include "ThreadTaskManager.h"
+#include "ThreadPool.h"
+#include "FrameScheduler.h"
 #include "RenderServiceInterface.h"
 #include "ConsoleServiceInterface.h"
 #include "ConsoleCommandServiceInterface.h"
@@ -39,6 +41,8 @@
 #include <Poco/Path.h>
 #include <Poco/UnicodeConverter.h>
 
+#include <boost/bind.hpp>
+
 #include <QApplication>
 #include <QGraphicsView>
 #include <QIcon>
@@ -97,6 +101,7 @@ namespace Foundation
         {
 #ifdef PROFILING
             ProfilerSection::SetProfiler(&profiler_);
+            profiler_capture_end_ = 0;
 #endif
             PROFILE(FW_Startup);
 //            application_ = ApplicationPtr(new Application(this));
@@ -135,7 +140,15 @@ namespace Foundation
             component_manager_ = ComponentManagerPtr(new ComponentManager(this));
             service_manager_ = ServiceManagerPtr(new ServiceManager());
             event_manager_ = EventManagerPtr(new EventManager(this));
+            // Worker thread count 0 = sized to the hardware
+            int worker_threads = config_manager_->DeclareSetting(Framework::ConfigurationGroup(), std::string("worker_threads"), int(0));
+            thread_pool_ = ThreadPoolPtr(new ThreadPool(worker_threads > 0 ? (uint)worker_threads : 0));
+            // Blocking I/O gets its own few threads, so that it can not hold up the workers
+            int io_threads = config_manager_->DeclareSetting(Framework::ConfigurationGroup(), std::string("io_threads"), int(2));
+            io_thread_pool_ = ThreadPoolPtr(new ThreadPool(io_threads > 0 ? (uint)io_threads : 1));
             thread_task_manager_ = ThreadTaskManagerPtr(new ThreadTaskManager(this));
+            frame_scheduler_ = FrameSchedulerPtr(new FrameScheduler(this));
+            RegisterFrameStages();
 
             Scene::Events::RegisterSceneEvents(event_manager_);
             Resource::Events::RegisterResourceEvents(event_manager_);
@@ -161,7 +174,10 @@ namespace Foundation
 
     Framework::~Framework()
     {
+        frame_scheduler_.reset();
         thread_task_manager_.reset();
+        io_thread_pool_.reset();
+        thread_pool_.reset();
         event_manager_.reset();
         service_manager_.reset();
         component_manager_.reset();
@@ -280,7 +296,9 @@ namespace Foundation
             ("server", po::value<std::string>(), "world server and port")
             ("auth_server", po::value<std::string>(), "realXtend authentication server address and port")
             ("auth_login", po::value<std::string>(), "realXtend authentication server user name")
-            ("login", "automatically login to server using provided credentials");
+            ("login", "automatically login to server using provided credentials")
+            ("profilecapture", po::value<double>(), "record profiling data of all threads for the given amount of seconds from startup")
+            ("profilecapturefile", po::value<std::string>(), "file to write --profilecapture to: .json for Chrome trace, .folded for collapsed stacks");
 
         try
         {
@@ -305,6 +323,16 @@ namespace Foundation
         // commands must be registered after modules are loaded and initialized
         RegisterConsoleCommands();
 
+#ifdef PROFILING
+        if (cm_options_.count("profilecapture"))
+        {
+            std::string filename = platform_->GetUserDocumentsDirectory() + "/profilecapture.json";
+            if (cm_options_.count("profilecapturefile"))
+                filename = cm_options_["profilecapturefile"].as<std::string>();
+            StartProfilerCapture(cm_options_["profilecapture"].as<double>(), filename);
+        }
+#endif
+
         ProgramOptionsEvent *data = new ProgramOptionsEvent(cm_options_, argc_, argv_);
         event_manager_->SendEvent(framework_events, PROGRAM_OPTIONS, data);
         delete data;
@@ -321,23 +349,9 @@ namespace Foundation
             double frametime = timer.elapsed();
             
             timer.restart();
-            // do synchronized update for modules
-            {
-                PROFILE(FW_UpdateModules);
-                module_manager_->UpdateModules(frametime);
-            }
-
-            // check framework's thread task manager for completed requests, send as events
-            {
-                PROFILE(FW_ProcessThreadTaskResults)
-                thread_task_manager_->SendResultEvents();
-            }
-
-            // process delayed events
-            {
-                PROFILE(FW_ProcessDelayedEvents);
-                event_manager_->ProcessDelayedEvents(frametime);
-            }
+            // update modules, send thread task results and delayed events, and run the stages added by modules,
+            // each within its share of the frame
+            frame_scheduler_->RunFrame(frametime);
 
             // if we have a renderer service, render now
             boost::weak_ptr<Foundation::RenderServiceInterface> renderer = service_manager_->GetService<RenderServiceInterface>();
@@ -352,6 +366,11 @@ namespace Foundation
         }
 
         RESETPROFILER
+
+#ifdef PROFILING
+        if (profiler_capture_end_ && GetCurrentClockTime() >= profiler_capture_end_)
+            StopProfilerCapture();
+#endif
     }
 
     void Framework::Go()
@@ -587,19 +606,83 @@ namespace Foundation
         if (console)
         {
             Profiler &profiler = GetProfiler();
-//            ProfilerNodeTree *node = profiler.Lock().get();
-            ProfilerNodeTree *node = profiler.GetRoot();
+            ProfilerNodeTree *node = profiler.Lock();
             if (params.size() > 0 && params.front() == "all")
                 PrintTimingsToConsole(console, node, true);
             else
                 PrintTimingsToConsole(console, node, false);
             console->Print(" ");
-//            profiler.Release();
+            profiler.Release();
         }
 #endif
         return Console::ResultSuccess();
     }
 
+    Console::CommandResult Framework::ConsoleProfileCapture(const StringVector &params)
+    {
+#ifdef PROFILING
+        if (params.size() == 1 && params[0] == "stop")
+        {
+            if (!StopProfilerCapture())
+                return Console::ResultFailure("No profiling capture to write.");
+            return Console::ResultSuccess("Profiling capture written to " + profiler_capture_file_ + ".");
+        }
+
+        if (params.size() != 1 && params.size() != 2)
+            return Console::ResultInvalidParameters();
+
+        f64 seconds = 0.0;
+        try
+        {
+            seconds = ParseString<f64>(params[0]);
+        }
+        catch (std::exception &)
+        {
+            return Console::ResultInvalidParameters();
+        }
+        if (seconds <= 0.0)
+            return Console::ResultInvalidParameters();
+
+        std::string filename = platform_->GetUserDocumentsDirectory() + "/profilecapture.json";
+        if (params.size() == 2)
+            filename = params[1];
+        StartProfilerCapture(seconds, filename);
+        return Console::ResultSuccess("Capturing profiling data for " + params[0] + " seconds to " + filename + ".");
+#else
+        return Console::ResultFailure("Profiling is not enabled in this build.");
+#endif
+    }
+
+    Console::CommandResult Framework::ConsoleFrameStats(const StringVector &params)
+    {
+        if (params.size() == 1 && params[0] == "reset")
+        {
+            frame_scheduler_->ResetStats();
+            return Console::ResultSuccess("Frame stage timings reset.");
+        }
+        if (!params.empty())
+            return Console::ResultInvalidParameters();
+
+        boost::shared_ptr<Console::ConsoleServiceInterface> console = GetService<Console::ConsoleServiceInterface>(Service::ST_Console).lock();
+        if (!console)
+            return Console::ResultFailure("No console.");
+
+        char text[256];
+        sprintf(text, "Target frame time %.2f msecs", frame_scheduler_->GetTargetFrameTime() * 1000.0);
+        console->Print(text);
+        std::vector<FrameScheduler::StageStats> stats = frame_scheduler_->GetStats();
+        for(size_t i = 0; i < stats.size(); ++i)
+        {
+            const FrameScheduler::StageStats &stage = stats[i];
+            sprintf(text, "%s: budget %.2f, last %.2f, avg %.2f, max %.2f msecs, %u/%u frames over budget by %.2f msecs total, %u frames deferred",
+                stage.name_.c_str(), stage.budget_ * 1000.0, stage.last_time_ * 1000.0, stage.average_time_ * 1000.0,
+                stage.max_time_ * 1000.0, stage.overruns_, stage.frames_, stage.overrun_time_ * 1000.0, stage.deferred_frames_);
+            console->Print(text);
+        }
+        console->Print(" ");
+        return Console::ResultSuccess();
+    }
+
     void Framework::RegisterConsoleCommands()
     {
         boost::shared_ptr<Console::CommandService> console = GetService<Console::CommandService>(Service::ST_ConsoleCommand).lock();
@@ -621,10 +704,19 @@ namespace Foundation
                 "Sends an internal event. Only for events that contain no data. Usage: SendEvent(event category name, event id)", 
                 Console::Bind(this, &Framework::ConsoleSendEvent)));
 
+            console->RegisterCommand(Console::CreateCommand("FrameStats", 
+                "Outputs the timings of the main loop stages against their budgets. Usage: FrameStats() or FrameStats(reset)", 
+                Console::Bind(this, &Framework::ConsoleFrameStats)));
+
 #ifdef PROFILING
             console->RegisterCommand(Console::CreateCommand("Profile", 
                 "Outputs profiling data. Usage: Profile() for full, or Profile(name) for specific profiling block", 
                 Console::Bind(this, &Framework::ConsoleProfile)));
+
+            console->RegisterCommand(Console::CreateCommand("ProfileCapture", 
+                "Records profiling data of all threads to file. Usage: ProfileCapture(seconds, filename) "
+                "where filename is .json for Chrome trace or .folded for collapsed stacks, or ProfileCapture(stop) to end early", 
+                Console::Bind(this, &Framework::ConsoleProfileCapture)));
 #endif
         }
     }
@@ -634,6 +726,34 @@ namespace Foundation
     {
         return profiler_;
     }
+
+    void Framework::StartProfilerCapture(f64 seconds, const std::string &filename)
+    {
+        if (profiler_.IsCapturing())
+            StopProfilerCapture();
+
+        profiler_capture_file_ = filename;
+        profiler_capture_end_ = GetCurrentClockTime() + (tick_t)(seconds * GetCurrentClockFreq());
+        profiler_.StartCapture();
+        RootLogInfo("Capturing profiling data for " + ToString(seconds) + " seconds to " + filename);
+    }
+
+    bool Framework::StopProfilerCapture()
+    {
+        profiler_capture_end_ = 0;
+        ProfilerCapturePtr capture = profiler_.StopCapture();
+        if (!capture)
+            return false;
+
+        if (!capture->Write(profiler_capture_file_))
+        {
+            RootLogError("Could not write profiling capture to " + profiler_capture_file_);
+            return false;
+        }
+
+        RootLogInfo("Wrote " + ToString(capture->GetNumBlocks()) + " profiling blocks to " + profiler_capture_file_);
+        return true;
+    }
 #endif
 
     ComponentManagerPtr Framework::GetComponentManager() const
@@ -671,6 +791,48 @@ namespace Foundation
         return thread_task_manager_;
     }
 
+    ThreadPoolPtr Framework::GetThreadPool()
+    {
+        return thread_pool_;
+    }
+
+    ThreadPoolPtr Framework::GetIoThreadPool()
+    {
+        return io_thread_pool_;
+    }
+
+    FrameSchedulerPtr Framework::GetFrameScheduler()
+    {
+        return frame_scheduler_;
+    }
+
+    void Framework::RegisterFrameStages()
+    {
+        // Modules expect to be updated exactly once per frame, so they always run to completion
+        frame_scheduler_->AddStage("Modules", 0.4, boost::bind(&Framework::UpdateModulesStage, this, _1, _2), false);
+        frame_scheduler_->AddStage("TaskResults", 0.15, boost::bind(&Framework::SendTaskResultsStage, this, _1, _2));
+        frame_scheduler_->AddStage("DelayedEvents", 0.1, boost::bind(&Framework::ProcessDelayedEventsStage, this, _1, _2));
+    }
+
+    bool Framework::UpdateModulesStage(f64 frametime, const FrameBudget &budget)
+    {
+        PROFILE(FW_UpdateModules);
+        module_manager_->UpdateModules(frametime);
+        return true;
+    }
+
+    bool Framework::SendTaskResultsStage(f64 frametime, const FrameBudget &budget)
+    {
+        PROFILE(FW_ProcessThreadTaskResults);
+        return thread_task_manager_->SendResultEvents(budget);
+    }
+
+    bool Framework::ProcessDelayedEventsStage(f64 frametime, const FrameBudget &budget)
+    {
+        PROFILE(FW_ProcessDelayedEvents);
+        return event_manager_->ProcessDelayedEvents(frametime, budget);
+    }
+
     ConfigurationManager &Framework::GetDefaultConfig()
     {
         return *(config_manager_.get());
@@ -118,6 +118,15 @@ namespace Foundation
         //! Returns thread task manager.
         ThreadTaskManagerPtr GetThreadTaskManager();
 
+        //! Returns the shared worker thread pool.
+        ThreadPoolPtr GetThreadPool();
+
+        //! Returns the thread pool for jobs that block on I/O, such as HTTP requests. Has only a few threads.
+        ThreadPoolPtr GetIoThreadPool();
+
+        //! Returns the scheduler of the main loop stages. Modules may add budgeted stages of their own.
+        FrameSchedulerPtr GetFrameScheduler();
+
         //! Cancel a pending exit
         void CancelExit();
 
@@ -190,6 +199,17 @@ namespace Foundation
         //! Returns the default profiler used by all normal profiling blocks. For profiling code, use PROFILE-macro.
         //! Profiler &GetProfiler() { return *ProfilerSection::GetProfiler(); }
         Profiler &GetProfiler();
+
+        //! Starts recording the profiling data of all threads for offline analysis. Ends a previous capture first.
+        /*! \param seconds How long to record, the capture is written at the end of the first frame after that
+            \param filename File to write the capture to, see ProfilerCapture::Write()
+         */
+        void StartProfilerCapture(f64 seconds, const std::string &filename);
+
+        //! Ends the profiler capture and writes it to file
+        /*! \return true if a capture was written
+         */
+        bool StopProfilerCapture();
 #endif
         //! Add a new log listener for poco log
         void AddLogChannel(Poco::Channel *channel);
@@ -212,6 +232,12 @@ namespace Foundation
         //! Output profiling data
         Console::CommandResult ConsoleProfile(const StringVector &params);
 
+        //! Capture profiling data to file
+        Console::CommandResult ConsoleProfileCapture(const StringVector &params);
+
+        //! Output frame stage timings
+        Console::CommandResult ConsoleFrameStats(const StringVector &params);
+
         //! limit frames
         Console::CommandResult ConsoleLimitFrames(const StringVector &params);
 
@@ -318,6 +344,18 @@ namespace Foundation
         //! Should be called after modules are loaded and initialized
         void RegisterConsoleCommands();
 
+        //! Adds the framework stages of the main loop to the frame scheduler
+        void RegisterFrameStages();
+
+        //! Frame stage: updates the modules
+        bool UpdateModulesStage(f64 frametime, const FrameBudget &budget);
+
+        //! Frame stage: sends the thread task results as events
+        bool SendTaskResultsStage(f64 frametime, const FrameBudget &budget);
+
+        //! Frame stage: sends the posted and delayed events
+        bool ProcessDelayedEventsStage(f64 frametime, const FrameBudget &budget);
+
         //! Create logging system
         void CreateLoggingSystem();
 
@@ -339,6 +377,15 @@ namespace Foundation
         //! Thread task manager.
         ThreadTaskManagerPtr thread_task_manager_;
 
+        //! Worker thread pool.
+        ThreadPoolPtr thread_pool_;
+
+        //! Thread pool for blocking I/O.
+        ThreadPoolPtr io_thread_pool_;
+
+        //! Main loop stage scheduler.
+        FrameSchedulerPtr frame_scheduler_;
+
         //! default configuration
         ConfigurationManagerPtr config_manager_;
 
@@ -363,6 +410,12 @@ namespace Foundation
 #ifdef PROFILING
         //! profiler
         Profiler profiler_;
+
+        //! Clock time the profiler capture ends at, 0 if not capturing
+        tick_t profiler_capture_end_;
+
+        //! File the profiler capture is written to
+        std::string profiler_capture_file_;
 #endif
         //! program options
         boost::program_options::variables_map cm_options_;
@@ -0,0 +1,96 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_MpscQueue_h
+#define incl_Foundation_MpscQueue_h
+
+#include <QAtomicPointer>
+
+#include <cstddef>
+
+/** Implements an unbounded multiple-producer, single-consumer queue:
+    - Any number of threads may call Push() concurrently. Pushing does not take a lock; it allocates one node
+      and links it in with a compare-and-swap.
+    - Only one thread, the consumer, may call PopAll() and Clear().
+    - PopAll() takes every item pushed so far at once, and returns them in the order they were pushed.
+      Items pushed by different threads are ordered by the time their compare-and-swap succeeded.
+
+    Deliberately not following the naming of std::queue, as the queue can not be inspected or popped one item
+    at a time. */
+template<typename T>
+class MpscQueue
+{
+    MpscQueue(const MpscQueue &); // N/I
+    void operator =(const MpscQueue &); // N/I
+public:
+    struct Node
+    {
+        T value;
+        Node *next;
+    };
+
+    MpscQueue() : head(0) {}
+
+    ~MpscQueue() { Clear(); }
+
+    /// Adds an item to the queue. Thread-safe, may be called from any thread.
+    void Push(const T &value)
+    {
+        Node *newNode = new Node;
+        newNode->value = value;
+        Node *oldHead;
+        do
+        {
+            oldHead = head;
+            newNode->next = oldHead;
+        } while(!head.testAndSetRelease(oldHead, newNode));
+    }
+
+    /// Moves all queued items to the back of the given container, oldest first. May only be called from the consumer thread.
+    /// @return The number of items moved.
+    template<typename Container>
+    size_t PopAll(Container &dst)
+    {
+        // Detach the whole stack, newest node first, and reverse it to get the push order.
+        Node *node = head.fetchAndStoreAcquire(0);
+        Node *reversed = 0;
+        while(node)
+        {
+            Node *next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+
+        size_t count = 0;
+        while(reversed)
+        {
+            Node *next = reversed->next;
+            dst.push_back(reversed->value);
+            delete reversed;
+            reversed = next;
+            ++count;
+        }
+        return count;
+    }
+
+    /// @return True if the queue appears to be empty. Only a hint if producers are running.
+    bool IsEmpty() const { return (Node *)head == 0; }
+
+    /// Deletes all queued items. May only be called from the consumer thread.
+    void Clear()
+    {
+        Node *node = head.fetchAndStoreAcquire(0);
+        while(node)
+        {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+private:
+    /// The most recently pushed node. Nodes are linked from newest to oldest.
+    QAtomicPointer<Node> head;
+};
+
+#endif
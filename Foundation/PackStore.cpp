@@ -0,0 +1,995 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "Foundation.h"
+#include "PackStore.h"
+#include "Profiler.h"
+#include "CoreThread.h"
+#include "FrameScheduler.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Foundation
+{
+    namespace
+    {
+        const u32 cPackMagic = 0x4b50414e; // "NAPK"
+        const u32 cIndexMagic = 0x5844494e; // "NIDX"
+        const u32 cVersion = 1;
+        const u32 cRecordLive = 0x31434552; // "REC1"
+        const u32 cRecordDead = 0x44414544; // "DEAD"
+
+        const u64 cPackHeaderSize = 16;
+        const u32 cInitialCapacity = 4096;
+        const u64 cEmptySlot = 0;
+        const u64 cRemovedSlot = ~(u64)0;
+
+        //! Garbage below this is never worth a compaction
+        const u64 cMinCompactionGarbage = 4 * 1024 * 1024;
+
+        //! Size of the windows the pack file is mapped in
+        const u64 cWindowSize = 1024 * 1024;
+
+        //! Amount of recently used windows kept mapped when no PackBlob points into them
+        const size_t cRecentWindows = 16;
+
+        const char cZeroPadding[8] = { 0 };
+
+        u64 Align8(u64 value)
+        {
+            return (value + 7) & ~(u64)7;
+        }
+
+        //! FNV-1a
+        u64 HashKey(const std::string& key)
+        {
+            u64 hash = 14695981039346656037ULL;
+            for (size_t i = 0; i < key.size(); ++i)
+            {
+                hash ^= (u8)key[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+    }
+
+    struct PackStore::RecordHeader
+    {
+        //! cRecordLive or cRecordDead
+        u32 magic;
+        u32 key_size;
+        u32 tag_size;
+        u32 data_size;
+        u64 hash;
+        // Followed by the key and the tag, padded to 8 bytes, and the data, padded to 8 bytes.
+
+        u64 GetDataOffset() const { return Align8(sizeof(RecordHeader) + key_size + tag_size); }
+        u64 GetRecordSize() const { return GetDataOffset() + Align8(data_size); }
+        const char* GetKey() const { return (const char*)this + sizeof(RecordHeader); }
+        const char* GetTag() const { return GetKey() + key_size; }
+        const u8* GetData() const { return (const u8*)this + GetDataOffset(); }
+    };
+
+    struct PackStore::IndexHeader
+    {
+        u32 magic;
+        u32 version;
+        //! Amount of slots, a power of two
+        u32 capacity;
+        //! Slots in use
+        u32 count;
+        //! Slots marked removed
+        u32 removed;
+        //! Generation of the current pack file
+        u32 generation;
+        //! Nonzero if the store was closed cleanly
+        u32 clean;
+        u32 reserved;
+        //! End of the last record in the pack file
+        u64 data_end;
+        //! Total size of the live records
+        u64 live_bytes;
+        //! Access counter, used as the access time of records
+        u64 clock;
+        u64 reserved2;
+    };
+
+    struct PackStore::IndexSlot
+    {
+        u64 hash;
+        //! Record offset in the pack file, cEmptySlot or cRemovedSlot
+        u64 offset;
+        //! Value of the access counter when the record was last stored or loaded
+        u64 last_access;
+        //! Record size including the header
+        u32 size;
+        u32 reserved;
+    };
+
+    //! Read-only handle of a pack file generation, shared by its mappings
+    class PackStore::PackFile
+    {
+    public:
+        explicit PackFile(const QString& path) :
+            file_(path),
+            delete_file_(false)
+        {
+            file_.open(QIODevice::ReadOnly);
+        }
+
+        ~PackFile()
+        {
+            file_.close();
+            // The generation has been compacted away or cleared, and this was the last user of it
+            if (delete_file_)
+                QFile::remove(file_.fileName());
+        }
+
+        QFile file_;
+        //! Mappings may be released in any thread
+        Mutex mutex_;
+        bool delete_file_;
+    };
+
+    //! Read-only mapping of a range of a pack file
+    class PackStore::Mapping
+    {
+    public:
+        Mapping(const boost::shared_ptr<PackFile>& file, u64 offset, u64 size) :
+            file_(file),
+            data_(0),
+            offset_(offset),
+            size_(0)
+        {
+            MutexLock lock(file_->mutex_);
+            if ((file_->file_.isOpen()) && (size))
+                data_ = file_->file_.map(offset, size);
+            if (data_)
+                size_ = size;
+        }
+
+        ~Mapping()
+        {
+            MutexLock lock(file_->mutex_);
+            if (data_)
+                file_->file_.unmap(data_);
+        }
+
+        //! Returns whether the mapping covers the given range
+        bool Covers(u64 offset, u64 size) const { return (data_) && (offset >= offset_) && (offset + size <= offset_ + size_); }
+
+        //! Returns pointer to the given offset of the pack file
+        const uchar* GetData(u64 offset) const { return data_ + (offset - offset_); }
+
+        boost::shared_ptr<PackFile> file_;
+        uchar* data_;
+        u64 offset_;
+        u64 size_;
+    };
+
+    //! State of a compaction that is spread over several Compact() calls
+    struct PackStore::Compaction
+    {
+        Compaction(u32 generation, const QString& path) :
+            generation_(generation),
+            out_(path),
+            read_offset_(cPackHeaderSize),
+            write_offset_(cPackHeaderSize)
+        {
+        }
+
+        //! Generation being written
+        u32 generation_;
+        //! New pack file, under a temporary name until finished
+        QFile out_;
+        //! Offset in the current pack file up to which records have been copied
+        u64 read_offset_;
+        //! Offset in the new pack file the next record goes to
+        u64 write_offset_;
+        //! Offsets of the copied records in the current and in the new pack file, in increasing order
+        std::vector<std::pair<u64, u64> > moved_;
+    };
+
+    PackStore::PackStore(const QString& directory, const QString& name) :
+        directory_(directory),
+        name_(name),
+        data_file_(0),
+        index_file_(0),
+        index_data_(0),
+        is_new_(false)
+    {
+        if (!Open())
+        {
+            RootLogError("PackStore: could not open " + QDir(directory_).absoluteFilePath(name_).toStdString());
+            Close();
+        }
+    }
+
+    PackStore::~PackStore()
+    {
+        Close();
+    }
+
+    bool PackStore::Open()
+    {
+        QDir dir(directory_);
+        if (!dir.exists() && !dir.mkpath("."))
+            return false;
+
+        index_file_ = new QFile(dir.absoluteFilePath(name_ + ".index"));
+        bool index_existed = index_file_->exists();
+        if (!index_file_->open(QIODevice::ReadWrite))
+            return false;
+
+        // Validate the index
+        qint64 index_size = index_file_->size();
+        bool index_valid = false;
+        bool index_clean = false;
+        u32 generation = 0;
+        if (index_size >= (qint64)sizeof(IndexHeader))
+        {
+            index_data_ = index_file_->map(0, index_size);
+            if (index_data_)
+            {
+                const IndexHeader* header = GetHeader();
+                if ((header->magic == cIndexMagic) && (header->version == cVersion))
+                {
+                    generation = header->generation;
+                    index_valid = (header->capacity >= cInitialCapacity) && !(header->capacity & (header->capacity - 1)) &&
+                        (index_size == (qint64)(sizeof(IndexHeader) + (u64)header->capacity * sizeof(IndexSlot)));
+                    index_clean = index_valid && header->clean;
+                }
+                if (!index_valid)
+                {
+                    index_file_->unmap(index_data_);
+                    index_data_ = 0;
+                }
+            }
+        }
+
+        // If the index is unusable, go with the newest pack file there is
+        if (!index_valid)
+        {
+            QStringList packs = dir.entryList(QStringList(name_ + ".*.pack"), QDir::Files);
+            bool found = false;
+            foreach(QString pack, packs)
+            {
+                bool ok = false;
+                u32 pack_generation = pack.mid(name_.length() + 1, pack.length() - name_.length() - 6).toUInt(&ok);
+                if ((ok) && ((!found) || (pack_generation > generation)))
+                {
+                    generation = pack_generation;
+                    found = true;
+                }
+            }
+            is_new_ = !index_existed && !found;
+
+            if (!ResizeIndex(cInitialCapacity, false))
+                return false;
+            GetHeader()->generation = generation;
+        }
+
+        DeleteStalePackFiles(generation);
+
+        if (!QFile::exists(GetPackPath(generation)) && !CreatePackFile(generation))
+            return false;
+        data_file_ = new QFile(GetPackPath(generation));
+        if (!data_file_->open(QIODevice::ReadWrite))
+        {
+            delete data_file_;
+            data_file_ = 0;
+            return false;
+        }
+
+        // A pack file with a bad header can not be salvaged
+        u32 pack_header[4] = { 0 };
+        if ((data_file_->read((char*)pack_header, sizeof(pack_header)) != sizeof(pack_header)) ||
+            (pack_header[0] != cPackMagic) || (pack_header[1] != cVersion))
+        {
+            RootLogWarning("PackStore: discarding corrupt pack file " + GetPackPath(generation).toStdString());
+            data_file_->close();
+            delete data_file_;
+            data_file_ = 0;
+            if (!QFile::remove(GetPackPath(generation)) || !CreatePackFile(generation))
+                return false;
+            data_file_ = new QFile(GetPackPath(generation));
+            if (!data_file_->open(QIODevice::ReadWrite))
+            {
+                delete data_file_;
+                data_file_ = 0;
+                return false;
+            }
+            index_clean = false;
+        }
+
+        pack_file_.reset(new PackFile(GetPackPath(generation)));
+
+        IndexHeader* header = GetHeader();
+        if ((index_clean) && ((u64)data_file_->size() >= header->data_end))
+        {
+            // Drop anything appended after the index was last written
+            if ((u64)data_file_->size() > header->data_end)
+                data_file_->resize(header->data_end);
+        }
+        else if ((!is_new_) && (!RebuildIndex()))
+            return false;
+
+        // Until closed cleanly, the index is not to be trusted
+        GetHeader()->clean = 0;
+        return true;
+    }
+
+    void PackStore::Close()
+    {
+        AbortCompaction();
+        recent_windows_.clear();
+        windows_.clear();
+        pack_file_.reset();
+
+        if (data_file_)
+        {
+            data_file_->flush();
+            data_file_->close();
+            delete data_file_;
+            data_file_ = 0;
+
+            // Only an index that matches the pack file is marked clean
+            if (index_data_)
+                GetHeader()->clean = 1;
+        }
+
+        if (index_file_)
+        {
+            if (index_data_)
+                index_file_->unmap(index_data_);
+            index_data_ = 0;
+            index_file_->close();
+            delete index_file_;
+            index_file_ = 0;
+        }
+    }
+
+    QString PackStore::GetPackPath(u32 generation) const
+    {
+        return QDir(directory_).absoluteFilePath(name_ + "." + QString::number(generation) + ".pack");
+    }
+
+    PackStore::IndexHeader* PackStore::GetHeader() const
+    {
+        return (IndexHeader*)index_data_;
+    }
+
+    PackStore::IndexSlot* PackStore::GetSlots() const
+    {
+        return (IndexSlot*)(index_data_ + sizeof(IndexHeader));
+    }
+
+    bool PackStore::CreatePackFile(u32 generation)
+    {
+        QFile file(GetPackPath(generation));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        u32 pack_header[4] = { cPackMagic, cVersion, 0, 0 };
+        bool ok = file.write((const char*)pack_header, sizeof(pack_header)) == sizeof(pack_header);
+        file.close();
+        return ok;
+    }
+
+    void PackStore::DeleteStalePackFiles(u32 generation)
+    {
+        QDir dir(directory_);
+        QString current = name_ + "." + QString::number(generation) + ".pack";
+        QStringList names;
+        names << name_ + ".*.pack" << name_ + ".*.pack.tmp";
+        QStringList files = dir.entryList(names, QDir::Files);
+        foreach(QString file, files)
+        {
+            if (file != current)
+                dir.remove(file);
+        }
+    }
+
+    bool PackStore::ResizeIndex(u32 capacity, bool keep_records)
+    {
+        IndexHeader header;
+        memset(&header, 0, sizeof(IndexHeader));
+        std::vector<IndexSlot> records;
+
+        if (index_data_)
+        {
+            header = *GetHeader();
+            if (keep_records)
+            {
+                const IndexSlot* slots = GetSlots();
+                records.reserve(header.count);
+                for (u32 i = 0; i < header.capacity; ++i)
+                {
+                    if ((slots[i].offset != cEmptySlot) && (slots[i].offset != cRemovedSlot))
+                        records.push_back(slots[i]);
+                }
+            }
+            index_file_->unmap(index_data_);
+            index_data_ = 0;
+        }
+        else
+        {
+            header.magic = cIndexMagic;
+            header.version = cVersion;
+        }
+
+        if (!keep_records)
+            header.data_end = cPackHeaderSize;
+        // InsertSlot() counts the records back in
+        header.capacity = capacity;
+        header.count = 0;
+        header.removed = 0;
+        header.live_bytes = 0;
+
+        qint64 size = sizeof(IndexHeader) + (qint64)capacity * sizeof(IndexSlot);
+        if (!index_file_->resize(size))
+            return false;
+        index_data_ = index_file_->map(0, size);
+        if (!index_data_)
+            return false;
+
+        memset(index_data_, 0, size);
+        *GetHeader() = header;
+        for (size_t i = 0; i < records.size(); ++i)
+            InsertSlot(records[i].hash, records[i].offset, records[i].size, records[i].last_access);
+
+        return true;
+    }
+
+    bool PackStore::RebuildIndex()
+    {
+        PROFILE(PackStore_RebuildIndex);
+
+        if (!ResizeIndex(GetHeader()->capacity, false))
+            return false;
+
+        const u64 file_size = data_file_->size();
+        u64 offset = cPackHeaderSize;
+        uint records = 0;
+        while (offset + sizeof(RecordHeader) <= file_size)
+        {
+            // A mapping failure is not a torn write, so it must not truncate the file
+            boost::shared_ptr<Mapping> mapping = GetMapping(offset, sizeof(RecordHeader));
+            if (!mapping)
+                return false;
+            const RecordHeader* record = (const RecordHeader*)mapping->GetData(offset);
+            if ((record->magic != cRecordLive) && (record->magic != cRecordDead))
+                break;
+            const u64 size = record->GetRecordSize();
+            if (offset + size > file_size)
+                break;
+
+            if (record->magic == cRecordLive)
+            {
+                mapping = GetMapping(offset, size);
+                if (!mapping)
+                    return false;
+                record = (const RecordHeader*)mapping->GetData(offset);
+                std::string key(record->GetKey(), record->key_size);
+                // A record that was replaced just before a crash may not have been marked dead yet; the later one wins
+                int unreadable_slot = -1;
+                int old_slot = FindSlot(key, record->hash, &unreadable_slot);
+                if (old_slot < 0)
+                    old_slot = unreadable_slot;
+                if (old_slot >= 0)
+                    RemoveSlot(old_slot);
+                if (!ReserveSlot())
+                    return false;
+                IndexHeader* header = GetHeader();
+                InsertSlot(record->hash, offset, (u32)size, ++header->clock);
+                ++records;
+            }
+            offset += size;
+        }
+
+        // Whatever follows the last intact record is a torn write
+        if (offset < file_size)
+        {
+            recent_windows_.clear();
+            windows_.clear();
+            data_file_->resize(offset);
+        }
+        GetHeader()->data_end = offset;
+
+        RootLogInfo("PackStore: rebuilt index of " + name_.toStdString() + " with " + ToString<uint>(records) + " records");
+        return true;
+    }
+
+    int PackStore::FindSlot(const std::string& key, u64 hash, int* unreadable_slot) const
+    {
+        if (unreadable_slot)
+            *unreadable_slot = -1;
+
+        const IndexHeader* header = GetHeader();
+        const IndexSlot* slots = GetSlots();
+        const u32 mask = header->capacity - 1;
+
+        for (u32 i = (u32)hash & mask, probes = 0; probes < header->capacity; i = (i + 1) & mask, ++probes)
+        {
+            const IndexSlot& slot = slots[i];
+            if (slot.offset == cEmptySlot)
+                return -1;
+            if ((slot.offset == cRemovedSlot) || (slot.hash != hash))
+                continue;
+
+            bool unreadable = false;
+            if (GetRecord(slot.offset, slot.size, key, hash, &unreadable))
+                return (int)i;
+            if ((unreadable) && (unreadable_slot) && (*unreadable_slot < 0))
+                *unreadable_slot = (int)i;
+        }
+        return -1;
+    }
+
+    void PackStore::InsertSlot(u64 hash, u64 offset, u32 size, u64 last_access)
+    {
+        IndexHeader* header = GetHeader();
+        IndexSlot* slots = GetSlots();
+        const u32 mask = header->capacity - 1;
+
+        u32 i = (u32)hash & mask;
+        while ((slots[i].offset != cEmptySlot) && (slots[i].offset != cRemovedSlot))
+            i = (i + 1) & mask;
+
+        if (slots[i].offset == cRemovedSlot)
+            --header->removed;
+        slots[i].hash = hash;
+        slots[i].offset = offset;
+        slots[i].size = size;
+        slots[i].last_access = last_access;
+        ++header->count;
+        header->live_bytes += size;
+    }
+
+    void PackStore::RemoveSlot(int slot)
+    {
+        IndexHeader* header = GetHeader();
+        IndexSlot& removed = GetSlots()[slot];
+
+        // Mark the record dead in the pack file too, so that rebuilding the index does not bring it back
+        if (data_file_->seek(removed.offset))
+        {
+            data_file_->write((const char*)&cRecordDead, sizeof(u32));
+            data_file_->flush();
+        }
+
+        header->live_bytes -= removed.size;
+        --header->count;
+        ++header->removed;
+        removed.offset = cRemovedSlot;
+    }
+
+    bool PackStore::ReserveSlot()
+    {
+        const IndexHeader* header = GetHeader();
+        // Keep the load, counting removed slots, under 3/4 so that probe sequences stay short
+        if ((u64)(header->count + header->removed + 1) * 4 <= (u64)header->capacity * 3)
+            return true;
+
+        // Rehash to a size where the live records take at most half, which also drops the removed slots
+        u32 capacity = cInitialCapacity;
+        while ((u64)(header->count + 1) * 2 > capacity)
+            capacity *= 2;
+        return ResizeIndex(capacity);
+    }
+
+    boost::shared_ptr<PackStore::Mapping> PackStore::GetMapping(u64 offset, u64 size) const
+    {
+        const u64 window = offset - offset % cWindowSize;
+
+        // The range may be in its window, or have been mapped by itself at the end of the file
+        boost::shared_ptr<Mapping> mapping;
+        std::map<u64, boost::weak_ptr<Mapping> >::iterator i = windows_.find(window);
+        if (i != windows_.end())
+            mapping = i->second.lock();
+        if (((!mapping) || (!mapping->Covers(offset, size))) && (offset != window))
+        {
+            i = windows_.find(offset);
+            if (i != windows_.end())
+                mapping = i->second.lock();
+        }
+
+        if ((mapping) && (mapping->Covers(offset, size)))
+        {
+            std::deque<boost::shared_ptr<Mapping> >::iterator j = std::find(recent_windows_.begin(), recent_windows_.end(), mapping);
+            if (j != recent_windows_.end())
+                recent_windows_.erase(j);
+            recent_windows_.push_back(mapping);
+            return mapping;
+        }
+
+        if (!pack_file_)
+            return boost::shared_ptr<Mapping>();
+        data_file_->flush();
+        const u64 file_size = data_file_->size();
+        if (offset + size > file_size)
+            return boost::shared_ptr<Mapping>();
+
+        // A record that crosses the window boundary extends its window. The window at the end of the file is not
+        // complete yet, so only the range is mapped, rather than the growing window again for each new record.
+        u64 map_offset = window;
+        u64 map_end = std::max(window + cWindowSize, offset + size);
+        if (map_end > file_size)
+        {
+            map_offset = offset;
+            map_end = offset + size;
+        }
+
+        mapping.reset(new Mapping(pack_file_, map_offset, map_end - map_offset));
+        if (!mapping->data_)
+            return boost::shared_ptr<Mapping>();
+
+        // Forget the mappings no longer in use
+        i = windows_.begin();
+        while (i != windows_.end())
+        {
+            if (i->second.expired())
+                windows_.erase(i++);
+            else
+                ++i;
+        }
+
+        windows_[map_offset] = mapping;
+        recent_windows_.push_back(mapping);
+        if (recent_windows_.size() > cRecentWindows)
+            recent_windows_.pop_front();
+        return mapping;
+    }
+
+    const PackStore::RecordHeader* PackStore::GetRecord(u64 offset, u32 size, const std::string& key, u64 hash, bool* unreadable) const
+    {
+        boost::shared_ptr<Mapping> mapping = GetMapping(offset, size);
+        if (!mapping)
+        {
+            if (unreadable)
+                *unreadable = true;
+            return 0;
+        }
+
+        const RecordHeader* record = (const RecordHeader*)mapping->GetData(offset);
+        if ((record->magic != cRecordLive) || (record->hash != hash) || (record->key_size != key.size()) ||
+            (record->GetRecordSize() != size) || (memcmp(record->GetKey(), key.data(), key.size()) != 0))
+            return 0;
+        return record;
+    }
+
+    bool PackStore::Store(const std::string& key, const std::string& tag, const u8* data, uint size)
+    {
+        if (!IsOpen())
+            return false;
+
+        PROFILE(PackStore_Store);
+
+        // A record that can not be read is removed if its hash matches, rather than risking two live records with
+        // the same key. With a 64-bit hash, it almost surely is the one being replaced.
+        const u64 hash = HashKey(key);
+        int unreadable_slot = -1;
+        int old_slot = FindSlot(key, hash, &unreadable_slot);
+        if (old_slot < 0)
+            old_slot = unreadable_slot;
+        if (old_slot >= 0)
+            RemoveSlot(old_slot);
+        if (!ReserveSlot())
+            return false;
+
+        RecordHeader record;
+        record.magic = cRecordLive;
+        record.key_size = (u32)key.size();
+        record.tag_size = (u32)tag.size();
+        record.data_size = size;
+        record.hash = hash;
+
+        const u64 key_padding = record.GetDataOffset() - sizeof(RecordHeader) - key.size() - tag.size();
+        const u64 data_padding = Align8(size) - size;
+
+        IndexHeader* header = GetHeader();
+        const u64 offset = header->data_end;
+        bool ok = data_file_->seek(offset) &&
+            (data_file_->write((const char*)&record, sizeof(RecordHeader)) == sizeof(RecordHeader)) &&
+            (data_file_->write(key.data(), key.size()) == (qint64)key.size()) &&
+            (data_file_->write(tag.data(), tag.size()) == (qint64)tag.size()) &&
+            (data_file_->write(cZeroPadding, key_padding) == (qint64)key_padding) &&
+            (data_file_->write((const char*)data, size) == (qint64)size) &&
+            (data_file_->write(cZeroPadding, data_padding) == (qint64)data_padding) &&
+            (data_file_->flush());
+        if (!ok)
+        {
+            data_file_->resize(offset);
+            return false;
+        }
+
+        InsertSlot(hash, offset, (u32)record.GetRecordSize(), ++header->clock);
+        header->data_end = offset + record.GetRecordSize();
+        return true;
+    }
+
+    PackBlob PackStore::Load(const std::string& key)
+    {
+        PackBlob blob;
+        if (!IsOpen())
+            return blob;
+
+        const u64 hash = HashKey(key);
+        int slot = FindSlot(key, hash);
+        if (slot < 0)
+            return blob;
+
+        IndexSlot& found = GetSlots()[slot];
+        boost::shared_ptr<Mapping> mapping = GetMapping(found.offset, found.size);
+        if (!mapping)
+            return blob;
+        found.last_access = ++GetHeader()->clock;
+
+        const RecordHeader* record = (const RecordHeader*)mapping->GetData(found.offset);
+        blob.mapping_ = mapping;
+        blob.data_ = record->GetData();
+        blob.size_ = record->data_size;
+        blob.tag_.assign(record->GetTag(), record->tag_size);
+        return blob;
+    }
+
+    bool PackStore::Contains(const std::string& key) const
+    {
+        if (!IsOpen())
+            return false;
+        return FindSlot(key, HashKey(key)) >= 0;
+    }
+
+    bool PackStore::Remove(const std::string& key)
+    {
+        if (!IsOpen())
+            return false;
+
+        // As in Store(), an unreadable record with the same hash is taken to be the one
+        int unreadable_slot = -1;
+        int slot = FindSlot(key, HashKey(key), &unreadable_slot);
+        if (slot < 0)
+            slot = unreadable_slot;
+        if (slot < 0)
+            return false;
+        RemoveSlot(slot);
+        return true;
+    }
+
+    void PackStore::Clear()
+    {
+        if (!IsOpen())
+            return;
+
+        AbortCompaction();
+
+        // Start a new, empty generation; the old pack file goes once nothing points into it
+        const u32 generation = GetHeader()->generation + 1;
+        if (!CreatePackFile(generation))
+            return;
+
+        QString old_path = data_file_->fileName();
+        data_file_->close();
+        ReplacePackFile(GetPackPath(generation));
+        QFile::remove(old_path);
+
+        data_file_->setFileName(GetPackPath(generation));
+        if (!data_file_->open(QIODevice::ReadWrite))
+        {
+            delete data_file_;
+            data_file_ = 0;
+            return;
+        }
+
+        ResizeIndex(cInitialCapacity, false);
+        GetHeader()->generation = generation;
+    }
+
+    uint PackStore::Trim(u64 max_bytes, u64* removed_bytes)
+    {
+        if (removed_bytes)
+            *removed_bytes = 0;
+        if ((!IsOpen()) || (GetHeader()->live_bytes <= max_bytes))
+            return 0;
+
+        PROFILE(PackStore_Trim);
+
+        // Oldest access first
+        const IndexHeader* header = GetHeader();
+        const IndexSlot* slots = GetSlots();
+        std::vector<std::pair<u64, int> > by_age;
+        by_age.reserve(header->count);
+        for (u32 i = 0; i < header->capacity; ++i)
+        {
+            if ((slots[i].offset != cEmptySlot) && (slots[i].offset != cRemovedSlot))
+                by_age.push_back(std::make_pair(slots[i].last_access, (int)i));
+        }
+        std::sort(by_age.begin(), by_age.end());
+
+        uint removed = 0;
+        for (size_t i = 0; (i < by_age.size()) && (header->live_bytes > max_bytes); ++i)
+        {
+            if (removed_bytes)
+                *removed_bytes += slots[by_age[i].second].size;
+            RemoveSlot(by_age[i].second);
+            ++removed;
+        }
+        return removed;
+    }
+
+    bool PackStore::NeedsCompaction() const
+    {
+        if (!IsOpen())
+            return false;
+
+        // Compact once at least half of the pack file is garbage, so that every byte gets copied at most about once
+        const IndexHeader* header = GetHeader();
+        const u64 garbage = header->data_end - cPackHeaderSize - header->live_bytes;
+        return (garbage >= cMinCompactionGarbage) && (garbage >= header->live_bytes);
+    }
+
+    bool PackStore::Compact(const FrameBudget& budget)
+    {
+        if (!IsOpen())
+            return true;
+
+        PROFILE(PackStore_Compact);
+
+        if (!compaction_)
+        {
+            // Write to a temporary name first, so that an interrupted compaction never leaves a partial newest generation
+            const u32 generation = GetHeader()->generation + 1;
+            compaction_.reset(new Compaction(generation, GetPackPath(generation) + ".tmp"));
+            u32 pack_header[4] = { cPackMagic, cVersion, 0, 0 };
+            if ((!compaction_->out_.open(QIODevice::WriteOnly | QIODevice::Truncate)) ||
+                (compaction_->out_.write((const char*)pack_header, sizeof(pack_header)) != sizeof(pack_header)))
+            {
+                AbortCompaction();
+                return true;
+            }
+        }
+
+        // Walk the pack file in order, copying the records that are still live. Removing a record marks it dead in
+        // the pack file, and new records are appended, so the walk sees the changes made between the calls.
+        Compaction& compaction = *compaction_;
+        bool copied_any = false;
+        while (compaction.read_offset_ < GetHeader()->data_end)
+        {
+            if ((copied_any) && (budget.Expired()))
+                return false;
+
+            const u64 offset = compaction.read_offset_;
+            boost::shared_ptr<Mapping> mapping = GetMapping(offset, sizeof(RecordHeader));
+            if (!mapping)
+            {
+                AbortCompaction();
+                return true;
+            }
+            const RecordHeader* record = (const RecordHeader*)mapping->GetData(offset);
+            const u64 size = record->GetRecordSize();
+
+            if (record->magic == cRecordLive)
+            {
+                mapping = GetMapping(offset, size);
+                if ((!mapping) || (compaction.out_.write((const char*)mapping->GetData(offset), size) != (qint64)size))
+                {
+                    AbortCompaction();
+                    return true;
+                }
+                compaction.moved_.push_back(std::make_pair(offset, compaction.write_offset_));
+                compaction.write_offset_ += size;
+            }
+            compaction.read_offset_ += size;
+            copied_any = true;
+        }
+
+        FinishCompaction();
+        return true;
+    }
+
+    bool PackStore::FinishCompaction()
+    {
+        Compaction& compaction = *compaction_;
+        IndexHeader* header = GetHeader();
+        IndexSlot* slots = GetSlots();
+
+        // Find the new offset of each live record. Records removed after they were copied are still live in the new
+        // pack file, so mark them dead there, or rebuilding the index would bring them back.
+        std::vector<std::pair<int, u64> > new_offsets;
+        new_offsets.reserve(header->count);
+        std::vector<bool> kept(compaction.moved_.size(), false);
+        for (u32 i = 0; i < header->capacity; ++i)
+        {
+            if ((slots[i].offset == cEmptySlot) || (slots[i].offset == cRemovedSlot))
+                continue;
+            std::vector<std::pair<u64, u64> >::iterator j = std::lower_bound(compaction.moved_.begin(),
+                compaction.moved_.end(), std::make_pair(slots[i].offset, (u64)0));
+            if ((j == compaction.moved_.end()) || (j->first != slots[i].offset))
+            {
+                AbortCompaction();
+                return false;
+            }
+            kept[j - compaction.moved_.begin()] = true;
+            new_offsets.push_back(std::make_pair((int)i, j->second));
+        }
+
+        bool ok = true;
+        for (size_t i = 0; (ok) && (i < kept.size()); ++i)
+        {
+            if (!kept[i])
+                ok = (compaction.out_.seek(compaction.moved_[i].second)) &&
+                    (compaction.out_.write((const char*)&cRecordDead, sizeof(u32)) == sizeof(u32));
+        }
+        ok = ok && compaction.out_.flush();
+        compaction.out_.close();
+
+        const QString path = GetPackPath(compaction.generation_);
+        QFile::remove(path);
+        if ((!ok) || (!QFile::rename(compaction.out_.fileName(), path)))
+        {
+            AbortCompaction();
+            return false;
+        }
+
+        QFile* new_file = new QFile(path);
+        if (!new_file->open(QIODevice::ReadWrite))
+        {
+            delete new_file;
+            QFile::remove(path);
+            compaction_.reset();
+            return false;
+        }
+
+        // Switch over. The old generation is deleted when its last mapping goes.
+        for (size_t i = 0; i < new_offsets.size(); ++i)
+            slots[new_offsets[i].first].offset = new_offsets[i].second;
+        header->generation = compaction.generation_;
+        header->data_end = compaction.write_offset_;
+        compaction_.reset();
+
+        data_file_->close();
+        delete data_file_;
+        data_file_ = new_file;
+        ReplacePackFile(path);
+
+        // Rehash to drop the removed slots
+        return ResizeIndex(header->capacity);
+    }
+
+    void PackStore::AbortCompaction()
+    {
+        if (!compaction_)
+            return;
+        compaction_->out_.close();
+        QFile::remove(compaction_->out_.fileName());
+        compaction_.reset();
+    }
+
+    void PackStore::ReplacePackFile(const QString& path)
+    {
+        recent_windows_.clear();
+        windows_.clear();
+        if (pack_file_)
+            pack_file_->delete_file_ = true;
+        pack_file_.reset(new PackFile(path));
+    }
+
+    uint PackStore::GetNumRecords() const
+    {
+        return IsOpen() ? GetHeader()->count : 0;
+    }
+
+    u64 PackStore::GetLiveBytes() const
+    {
+        return IsOpen() ? GetHeader()->live_bytes : 0;
+    }
+
+    u64 PackStore::GetPackFileSize() const
+    {
+        return IsOpen() ? GetHeader()->data_end : 0;
+    }
+}
@@ -0,0 +1,273 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_PackStore_h
+#define incl_Foundation_PackStore_h
+
+#include "CoreTypes.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <QString>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class QFile;
+
+namespace Foundation
+{
+    class FrameBudget;
+    class PackStore;
+
+    //! Read-only view to a record of a PackStore.
+    /*! Points directly into a memory mapped window of the pack file; no data is copied. The blob keeps the window
+        mapped, so it stays valid even if the record is later removed, evicted or compacted away, or the store is
+        destroyed. The blob may be released in any thread.
+     */
+    class PackBlob
+    {
+        friend class PackStore;
+
+    public:
+        //! Constructs a null blob
+        PackBlob() : data_(0), size_(0) {}
+
+        //! Returns true if the blob does not refer to any record
+        bool IsNull() const { return data_ == 0; }
+
+        //! Returns the record data. The memory is mapped read-only and must not be written to.
+        const u8* GetData() const { return data_; }
+
+        //! Returns size of the record data in bytes
+        uint GetSize() const { return size_; }
+
+        //! Returns the tag the record was stored with
+        const std::string& GetTag() const { return tag_; }
+
+    private:
+        //! Mapping the data points into
+        boost::shared_ptr<void> mapping_;
+
+        //! Record data
+        const u8* data_;
+
+        //! Record data size
+        uint size_;
+
+        //! Record tag
+        std::string tag_;
+    };
+
+    //! Persistent key-value store that keeps all records in one append-only, memory-mapped pack file.
+    /*! Used by the disk caches instead of one file per cached item. A store consists of two files in its directory:
+        - name.N.pack holds the records, appended one after another. N is the generation, which compaction bumps.
+        - name.index is an open addressing hash table of record locations and access times, memory-mapped and
+          updated in place. Lookups, stores and removals are O(1) and never touch the directory.
+
+        Records are keyed by a string and carry a short tag (for example an asset type) besides their data. Storing
+        an existing key replaces the record. Removed and replaced records stay in the pack file as garbage until
+        Compact() copies the live records to a new generation. Compaction runs a few records at a time, so that the
+        caller can spread it over frames; the store is used normally in between.
+
+        The pack file is mapped in fixed-size windows rather than as a whole, so that the address space used stays
+        small even for a large pack file on 32-bit platforms. A window stays mapped while a PackBlob points into it,
+        or while it is among the most recently used ones.
+
+        Trim() evicts the least recently used records, based on the access times kept in the index, until the
+        live data fits a size limit.
+
+        If the program exits without closing the store, the index is rebuilt from the pack file when the store is next
+        opened. Access times are lost in that case, but no records are.
+
+        The store is not thread-safe; use it from one thread only.
+     */
+    class PackStore
+    {
+    public:
+        //! Opens or creates a store.
+        /*! \param directory Directory of the store files. Created if it does not exist.
+            \param name Base name of the store files
+         */
+        PackStore(const QString& directory, const QString& name);
+
+        //! Destructor. Closes the store cleanly.
+        ~PackStore();
+
+        //! Returns true if the store files could be opened
+        bool IsOpen() const { return data_file_ != 0; }
+
+        //! Returns true if the store did not exist before it was opened
+        bool IsNew() const { return is_new_; }
+
+        //! Stores a record, replacing any previous record with the same key.
+        /*! \param key Record key
+            \param tag Record tag
+            \param data Record data
+            \param size Size of data in bytes
+            \return true if successful
+         */
+        bool Store(const std::string& key, const std::string& tag, const u8* data, uint size);
+
+        //! Returns a record and marks it as most recently used.
+        /*! \param key Record key
+            \return View to the record, null blob if not found
+         */
+        PackBlob Load(const std::string& key);
+
+        //! Returns true if a record exists. Does not affect the access time.
+        bool Contains(const std::string& key) const;
+
+        //! Removes a record.
+        /*! \return true if the record existed
+         */
+        bool Remove(const std::string& key);
+
+        //! Removes all records and deletes the pack file
+        void Clear();
+
+        //! Removes least recently used records until the live data is at most the given size.
+        /*! \param max_bytes Size to trim to
+            \param removed_bytes [out] Optional, receives the amount of data removed
+            \return Amount of records removed
+         */
+        uint Trim(u64 max_bytes, u64* removed_bytes = 0);
+
+        //! Returns true if enough of the pack file is garbage for Compact() to be worth its cost
+        bool NeedsCompaction() const;
+
+        //! Returns true if a compaction has been started and not finished yet
+        bool IsCompacting() const { return compaction_.get() != 0; }
+
+        //! Copies live records to a new pack file generation until the budget expires, but at least one record.
+        /*! Starts a compaction if none is in progress. Records stored meanwhile are copied too. Once all records have
+            been copied, switches to the new generation; the old pack file is deleted once the last PackBlob pointing
+            into it is gone. If copying fails, the compaction is abandoned and the old generation stays in use.
+            \return true if no compaction is left in progress, false if records are left for a later call
+         */
+        bool Compact(const FrameBudget& budget);
+
+        //! Returns amount of records
+        uint GetNumRecords() const;
+
+        //! Returns total size of the live records, including their headers
+        u64 GetLiveBytes() const;
+
+        //! Returns size of the pack file
+        u64 GetPackFileSize() const;
+
+    private:
+        PackStore(const PackStore &); // N/I
+        void operator =(const PackStore &); // N/I
+
+        struct RecordHeader;
+        struct IndexHeader;
+        struct IndexSlot;
+        class PackFile;
+        class Mapping;
+        struct Compaction;
+
+        //! Opens the pack and index files
+        bool Open();
+
+        //! Closes the files, marking the index clean
+        void Close();
+
+        //! Returns path of a pack file generation
+        QString GetPackPath(u32 generation) const;
+
+        //! Returns the index header in the index mapping
+        IndexHeader* GetHeader() const;
+
+        //! Returns the index slot array in the index mapping
+        IndexSlot* GetSlots() const;
+
+        //! Resizes the index file to the given capacity and rehashes the records into it
+        /*! \param capacity Amount of slots, a power of two
+            \param keep_records If false, empties the index instead
+         */
+        bool ResizeIndex(u32 capacity, bool keep_records = true);
+
+        //! Rebuilds the index by scanning the pack file
+        bool RebuildIndex();
+
+        //! Finds the slot of a key.
+        /*! \param unreadable_slot [out] Optional, receives the slot of a record with the same hash that could not be
+                   read, -1 if none. Such a record may have the key.
+            \return Slot index, or -1 if not found
+         */
+        int FindSlot(const std::string& key, u64 hash, int* unreadable_slot = 0) const;
+
+        //! Inserts a record location into the index. The key must not be in the index.
+        void InsertSlot(u64 hash, u64 offset, u32 size, u64 last_access);
+
+        //! Marks a slot removed, and the record in the pack file dead
+        void RemoveSlot(int slot);
+
+        //! Grows or cleans the index if inserting one more record would make it too full
+        bool ReserveSlot();
+
+        //! Returns a mapping that covers the given range of the pack file
+        /*! The range is mapped as part of its window. At the end of the file, where the window is not complete yet,
+            only the range itself is mapped.
+            \return Mapping, or null if the file is not that large or could not be mapped
+         */
+        boost::shared_ptr<Mapping> GetMapping(u64 offset, u64 size) const;
+
+        //! Returns the record header at the given offset if the record is live and has the given key, null otherwise
+        /*! The header stays valid only while its mapping is kept.
+            \param unreadable [out] Optional, set to true if the record could not be mapped
+         */
+        const RecordHeader* GetRecord(u64 offset, u32 size, const std::string& key, u64 hash, bool* unreadable = 0) const;
+
+        //! Switches to a new pack file generation. The old pack file is deleted once nothing maps it anymore
+        void ReplacePackFile(const QString& path);
+
+        //! Switches to the pack file of a compaction that has copied all records
+        bool FinishCompaction();
+
+        //! Abandons a compaction in progress and deletes its unfinished pack file
+        void AbortCompaction();
+
+        //! Writes a new pack file with only the header
+        bool CreatePackFile(u32 generation);
+
+        //! Deletes pack files of other generations, and unfinished ones
+        void DeleteStalePackFiles(u32 generation);
+
+        //! Directory of the store files
+        QString directory_;
+
+        //! Base name of the store files
+        QString name_;
+
+        //! Pack file, open for appending
+        QFile* data_file_;
+
+        //! Index file
+        QFile* index_file_;
+
+        //! Index file mapping
+        uchar* index_data_;
+
+        //! Read-only handle of the current pack file, shared with its mappings
+        boost::shared_ptr<PackFile> pack_file_;
+
+        //! Mappings of the current pack file by offset, as long as they are in use
+        mutable std::map<u64, boost::weak_ptr<Mapping> > windows_;
+
+        //! Most recently used mappings, kept mapped between lookups
+        mutable std::deque<boost::shared_ptr<Mapping> > recent_windows_;
+
+        //! Compaction in progress, null if none
+        boost::scoped_ptr<Compaction> compaction_;
+
+        //! Whether the store was created on open
+        bool is_new_;
+    };
+}
+
+#endif // incl_Foundation_PackStore_h
@@ -7,6 +7,24 @@
 #include "CoreStringUtils.h"
 #include "HighPerfClock.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//! Turns the volatile index stores of the event rings into release stores and the index loads into acquire loads,
+//! so that the events are visible to the consumer before the index that publishes them. x86 does not reorder stores
+//! with older stores, or loads with younger loads and stores, so there only the compiler needs to be kept from
+//! reordering. Other architectures get a full fence.
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define PROFILER_ORDER_BARRIER() _ReadWriteBarrier()
+#elif defined(_MSC_VER)
+#define PROFILER_ORDER_BARRIER() _ReadWriteBarrier(); MemoryBarrier()
+#elif defined(__i386__) || defined(__x86_64__)
+#define PROFILER_ORDER_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define PROFILER_ORDER_BARRIER() __sync_synchronize()
+#endif
+
 namespace Foundation
 {
     bool ProfilerBlock::supported_ = false;
@@ -31,100 +49,151 @@ namespace Foundation
     boost::int64_t ProfilerBlock::frequency_;
     boost::int64_t ProfilerBlock::api_overhead_;
     
-    void Profiler::StartBlock(const std::string &name)
+    ProfilerBlockId Profiler::RegisterBlock(const std::string &name)
     {
-#ifdef PROFILING
-        // Get the current topmost profiling node in the stack, or 
-        // if none exists, get the root node or create a new root node.
-        // This will be the parent node of the new block we're starting.
-        ProfilerNodeTree *parent = current_node_.get();
-        if (!parent)
-        {
-            parent = GetOrCreateThreadRootBlock();
-            current_node_.reset(parent);
-        }
-        assert(parent);
-
-        // If parent name == new block name, we assume that we're
-        // recursively re-entering the same function (with a single
-        // profiling block).
-        ProfilerNodeTree *node = (name != parent->Name()) ? parent->GetChild(name) : parent;
-
-        // We're entering this PROFILE() block for the first time,
-        // need to allocate the memory for it.
-        if (!node)
-        {
-            node = new ProfilerNode(name);
-            parent->AddChild(boost::shared_ptr<ProfilerNodeTree>(node));
-        }
+        boost::mutex::scoped_lock lock(block_mutex_);
+        std::map<std::string, ProfilerBlockId>::const_iterator iter = block_ids_.find(name);
+        if (iter != block_ids_.end())
+            return iter->second;
 
-        assert (parent->recursion_ >= 0);
+        ProfilerBlockId id = next_block_id_++;
+        block_ids_[name] = id;
+        block_names_.resize(id + 1);
+        block_names_[id] = name;
+        return id;
+    }
 
-        // If a recursive call, just increment recursion count, the timer has already
-        // been started so no need to touch it. Otherwise, start the timer for the current
-        // block.
-        if (parent == node)
-            parent->recursion_++; // handle recursion
-        else
-        {
-            current_node_.release();
-            current_node_.reset(node);
+    std::string Profiler::GetBlockName(ProfilerBlockId id)
+    {
+        boost::mutex::scoped_lock lock(block_mutex_);
+        if (id < block_names_.size())
+            return block_names_[id];
+        return std::string();
+    }
 
-            checked_static_cast<ProfilerNode*>(node)->block_.Start();
-        }
+    void Profiler::StartBlock(ProfilerBlockId id)
+    {
+#ifdef PROFILING
+        WriteEvent(GetOrCreateThreadData(), id, ProfilerEvent::Begin, GetCurrentClockTime());
 #endif
     }
 
-    void Profiler::EndBlock(const std::string &name)
+    void Profiler::EndBlock(ProfilerBlockId id)
     {
 #ifdef PROFILING
-        using namespace std;
+        tick_t now = GetCurrentClockTime();
+        ProfilerThreadData *data = GetOrCreateThreadData();
+        WriteEvent(data, id, ProfilerEvent::End, now);
+        data->ring_.Publish();
+#endif
+    }
 
-        ProfilerNodeTree *treeNode = current_node_.get();
-        assert (treeNode->Name() == name && "New profiling block started before old one ended!");
+    void Profiler::ThreadedReset()
+    {
+        ProfilerThreadData *data = thread_data_.get();
+        if (!data)
+            return;
 
-        ProfilerNode* node = checked_static_cast<ProfilerNode*>(treeNode);
-        node->block_.Stop();
-        node->num_called_total_++;
-        node->num_called_current_++;
+        WriteEvent(data, 0, ProfilerEvent::Reset, GetCurrentClockTime());
+        data->ring_.Publish();
+    }
 
-        double elapsed = node->block_.ElapsedTimeSeconds();
+    void Profiler::AggregateAll()
+    {
+        for(std::list<ProfilerThreadData*>::iterator iter = threads_.begin(); iter != threads_.end(); ++iter)
+            Aggregate(*iter);
+    }
 
-        node->elapsed_current_ += elapsed;
-        node->elapsed_min_current_ = (equals(node->elapsed_min_current_, 0.0) ? elapsed : (elapsed < node->elapsed_min_current_ ? elapsed : node->elapsed_min_current_));
-        node->elapsed_max_current_ = elapsed > node->elapsed_max_current_ ? elapsed : node->elapsed_max_current_;
-        node->total_ += elapsed;
+    void Profiler::Aggregate(ProfilerThreadData *data)
+    {
+        ProfilerEventRing &ring = data->ring_;
+        std::vector<ProfilerThreadData::OpenBlock> &open_blocks = data->open_blocks_;
 
-        node->num_called_custom_++;
-        node->total_custom_ += elapsed;
-        node->custom_elapsed_min_ = std::min(node->custom_elapsed_min_, elapsed);
-        node->custom_elapsed_max_ = std::max(node->custom_elapsed_max_, elapsed);
+        size_t end = ring.BeginRead();
+        for(size_t i = ring.ReadIndex(); i != end; ++i)
+        {
+            const ProfilerEvent &event = ring.Event(i);
+            switch(event.type_)
+            {
+            case ProfilerEvent::Begin:
+            {
+                // If parent id == new block id, we assume that we're
+                // recursively re-entering the same function (with a single
+                // profiling block). The timer has already been started, so
+                // just count the recursion.
+                if (!open_blocks.empty() && open_blocks.back().node_->Id() == event.id_)
+                {
+                    ++open_blocks.back().recursion_;
+                    break;
+                }
 
-        assert (node->recursion_ >= 0);
+                ProfilerNodeTree *parent = open_blocks.empty() ? &data->root_ : open_blocks.back().node_;
+                ProfilerNodeTree *node = parent->GetChild(event.id_);
 
-        // need to handle recursion
-        if (node->recursion_ > 0)
-            --node->recursion_;
-        else
-        {
-            current_node_.release();
-            current_node_.reset(node->Parent());
+                // We're entering this PROFILE() block for the first time,
+                // need to allocate the memory for it.
+                if (!node)
+                {
+                    node = new ProfilerNode(GetBlockName(event.id_), event.id_);
+                    parent->AddChild(boost::shared_ptr<ProfilerNodeTree>(node));
+                }
+
+                open_blocks.push_back(ProfilerThreadData::OpenBlock(checked_static_cast<ProfilerNode*>(node), event.time_));
+                break;
+            }
+            case ProfilerEvent::End:
+            {
+                // Blocks that ended without a recorded start are ignored
+                if (open_blocks.empty())
+                    break;
+
+                assert (open_blocks.back().node_->Id() == event.id_ && "New profiling block started before old one ended!");
+
+                // Of recursive calls only the outermost is timed, so that the time is not counted twice
+                if (open_blocks.back().recursion_ > 0)
+                {
+                    --open_blocks.back().recursion_;
+                    break;
+                }
+
+                ProfilerThreadData::OpenBlock block = open_blocks.back();
+                open_blocks.pop_back();
+
+                ProfilerNode *node = block.node_;
+
+                if (capture_)
+                    capture_->AddBlock(data, &data->root_, node, block.start_, event.time_);
+
+                node->num_called_total_++;
+                node->num_called_current_++;
+
+                double elapsed = ProfilerBlock::ElapsedTimeSeconds(block.start_, event.time_);
+
+                node->elapsed_current_ += elapsed;
+                node->elapsed_min_current_ = (equals(node->elapsed_min_current_, 0.0) ? elapsed : (elapsed < node->elapsed_min_current_ ? elapsed : node->elapsed_min_current_));
+                node->elapsed_max_current_ = elapsed > node->elapsed_max_current_ ? elapsed : node->elapsed_max_current_;
+                node->total_ += elapsed;
+
+                node->num_called_custom_++;
+                node->total_custom_ += elapsed;
+                node->custom_elapsed_min_ = std::min(node->custom_elapsed_min_, elapsed);
+                node->custom_elapsed_max_ = std::max(node->custom_elapsed_max_, elapsed);
+                break;
+            }
+            case ProfilerEvent::Reset:
+                if (capture_)
+                    capture_->AddFrame(data, &data->root_, event.time_);
+                data->root_.ResetValues();
+                break;
+            }
         }
-#endif
+        ring.EndRead(end);
     }
 
     ProfilerNodeTree *Profiler::GetThreadRootBlock()
     { 
-        return thread_specific_root_.get();
-    }
-
-    ProfilerNodeTree *Profiler::GetOrCreateThreadRootBlock()
-    { 
-#ifdef PROFILING // If not profiling, never create the root block so the getter will always return 0.
-        if (!thread_specific_root_.get())
-            return CreateThreadRootBlock();
-#endif
-        return thread_specific_root_.get();
+        ProfilerThreadData *data = thread_data_.get();
+        return data ? &data->root_ : 0;
     }
 
     std::string Profiler::GetThisThreadRootBlockName()
@@ -132,76 +201,107 @@ namespace Foundation
         return std::string("Thread" + ToString(boost::this_thread::get_id()));
     }
 
-    ProfilerNodeTree *Profiler::CreateThreadRootBlock()
+    ProfilerThreadData *Profiler::CreateThreadData()
     {
-#ifdef PROFILING
         ProfilerBlock::QueryCapability();
-        
-        std::string rootObjectName = GetThisThreadRootBlockName();
 
-        ProfilerNodeTree *root = new ProfilerNodeTree(rootObjectName);
-        thread_specific_root_.reset(root);
+        ProfilerThreadData *data = new ProfilerThreadData(this, GetThisThreadRootBlockName());
+        thread_data_.reset(data);
 
         // Each thread root block is added as a child of a dummy node root_ owned by
         // this Profiler. The root_ object doesn't own the memory of its children,
         // but just weakly refers to them an allows easy access for printing the
         // profiling data in each thread.
         mutex_.lock();
-        root_.AddChild(boost::shared_ptr<ProfilerNodeTree>(root, &EmptyDeletor));
-        root->MarkAsRootBlock(this);
-        thread_root_nodes_.push_back(root);
+        root_.AddChild(boost::shared_ptr<ProfilerNodeTree>(&data->root_, &EmptyDeletor));
+        threads_.push_back(data);
         mutex_.unlock();
-        return root;
-#else
-        return 0;
-#endif
+        return data;
     }
 
-    void Profiler::RemoveThreadRootBlock(ProfilerNodeTree *rootBlock)
+    void Profiler::StartCapture()
     {
-#ifdef PROFILING
         mutex_.lock();
-        for(std::list<ProfilerNodeTree*>::iterator iter = thread_root_nodes_.begin(); iter != thread_root_nodes_.end(); ++iter)
-            if (*iter == rootBlock)
+        // Events recorded so far belong to no capture
+        AggregateAll();
+        capture_ = ProfilerCapturePtr(new ProfilerCapture(GetCurrentClockTime()));
+        mutex_.unlock();
+    }
+
+    ProfilerCapturePtr Profiler::StopCapture()
+    {
+        mutex_.lock();
+        AggregateAll();
+        ProfilerCapturePtr capture = capture_;
+        if (capture)
+            capture->Stop(GetCurrentClockTime());
+        capture_.reset();
+        mutex_.unlock();
+        return capture;
+    }
+
+    void Profiler::RemoveThreadData(ProfilerThreadData *data)
+    {
+        mutex_.lock();
+        if (capture_)
+        {
+            // Keep what the thread recorded before exiting
+            Aggregate(data);
+            capture_->RemoveThread(data);
+        }
+        root_.RemoveChild(&data->root_);
+        for(std::list<ProfilerThreadData*>::iterator iter = threads_.begin(); iter != threads_.end(); ++iter)
+            if (*iter == data)
             {
-                thread_root_nodes_.erase(iter);
+                threads_.erase(iter);
                 mutex_.unlock();
                 return;
             }
 
         std::cout << "Warning: Tried to delete a nonexisting thread root block!" << std::endl;
         mutex_.unlock();
-#endif
     }
 
-    void Profiler::ThreadedReset()
+    ProfilerThreadData::~ProfilerThreadData()
     {
-        ProfilerNodeTree *root = GetThreadRootBlock();
-        if (!root)
-            return;
+        if (owner_)
+            owner_->RemoveThreadData(this);
+    }
 
-        mutex_.lock();
-        root->ResetValues();
-        mutex_.unlock();
+    void ProfilerEventRing::Publish()
+    {
+        PROFILER_ORDER_BARRIER();
+        writeIndex_ = pendingIndex_;
     }
 
-    void ProfilerNodeTree::RemoveThreadRootBlock()
+    size_t ProfilerEventRing::BeginRead()
     {
-#ifdef PROFILING
-        assert(owner_);
-#endif
-        if (owner_)
-            owner_->RemoveThreadRootBlock(this);
+        size_t end = writeIndex_;
+        PROFILER_ORDER_BARRIER();
+        return end;
+    }
+
+    void ProfilerEventRing::EndRead(size_t end)
+    {
+        PROFILER_ORDER_BARRIER();
+        readIndex_ = end;
+    }
+
+    size_t ProfilerEventRing::ReadIndex() const
+    {
+        size_t index = readIndex_;
+        PROFILER_ORDER_BARRIER();
+        return index;
     }
 
     Profiler::~Profiler()
     {
-        // We are going down.. tell all root blocks that they don't need to notify back to the Profiler that they've been deleted.
-        // i.e. 'detach' all the (thread specific) root blocks so that they delete themselves at their leisure when their threads die.
+        // We are going down.. tell all threads that they don't need to notify back to the Profiler that they've exited.
+        // i.e. 'detach' all the thread specific data so that it deletes itself at its leisure when its thread dies.
         mutex_.lock();
-        for(std::list<ProfilerNodeTree*>::iterator iter = thread_root_nodes_.begin(); iter != thread_root_nodes_.end(); ++iter)
-            (*iter)->MarkAsRootBlock(0);
+        for(std::list<ProfilerThreadData*>::iterator iter = threads_.begin(); iter != threads_.end(); ++iter)
+            (*iter)->owner_ = 0;
+        threads_.clear();
         mutex_.unlock();
     }
 }
-
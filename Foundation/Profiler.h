@@ -9,6 +9,7 @@
 #endif
 
 #include "HighPerfClock.h"
+#include "ProfilerCapture.h"
 
 // Disable warning C4244 coming from boost
 #pragma warning ( push )
@@ -16,14 +17,22 @@
 #include <boost/thread.hpp>
 #pragma warning( pop )
 
+#include <list>
+#include <map>
+#include <vector>
+
 #if (defined(_POSIX_C_SOURCE) || defined(_WINDOWS)) && defined(PROFILING)
 //! Profiles a block of code in current scope. Ends the profiling when it goes out of scope
 /*! Name of the profiling block must be unique in the scope, so do not use the name of the function
     as the name of the profiling block!
 
+    The name is interned to a block id the first time the block is entered, and kept in a static of the
+    enclosing function, so entering the block afterwards costs no string handling or locking.
+
     \param x Unique name for the profiling block, use without quotes, f.ex. PROFILE(name_of_the_block)
 */
-#   define PROFILE(x) Foundation::ProfilerSection x ## __profiler__(#x);
+#   define PROFILE(x) static Foundation::ProfilerBlockId x ## __profiler_id__ = 0; \
+        Foundation::ProfilerSection x ## __profiler__(x ## __profiler_id__, #x);
 
 //! Optionally ends the current profiling block
 /*! Use when you wish to end a profiling block before it goes out of scope
@@ -46,6 +55,9 @@ namespace Foundation
 {
     class ProfilerNodeTree;
 
+    //! Interned name of a profiling block, see Profiler::RegisterBlock(). 0 is never a valid block id.
+    typedef unsigned int ProfilerBlockId;
+
     //! Profiles a block of code
     class ProfilerBlock
     {
@@ -134,22 +146,19 @@ namespace Foundation
     class ProfilerNodeTree
     {
         friend class Profiler;
-//        ProfilerNodeTree(); // N/I
+        ProfilerNodeTree(); // N/I
         ProfilerNodeTree(const ProfilerNodeTree &rhs); // N/I
     public:
         typedef std::list<boost::shared_ptr<ProfilerNodeTree> > NodeList;
 
         //! constructor that takes a name for the node
-        explicit ProfilerNodeTree(const std::string &name) : name_(name), parent_(0), recursion_(0), owner_(0) {}
+        /*! \param name Name of the node
+            \param id Block id of the node, 0 for thread root nodes
+         */
+        explicit ProfilerNodeTree(const std::string &name, ProfilerBlockId id = 0) : parent_(0), name_(name), id_(id) {}
 
         //! destructor
-        virtual ~ProfilerNodeTree()
-        {
-            if (owner_)
-                RemoveThreadRootBlock();
-        }
-        
-        void RemoveThreadRootBlock();
+        virtual ~ProfilerNodeTree() {}
 
         //! Resets this node and all child nodes
         virtual void ResetValues()
@@ -190,29 +199,44 @@ namespace Foundation
                     return (*it).get();
             return 0;
         }
+
+        //! Returns a child node
+        /*!
+          \param id Block id of the child node
+          \return Child node or 0 if the node was not child
+        */
+        ProfilerNodeTree* GetChild(ProfilerBlockId id)
+        {
+            for (NodeList::iterator it = children_.begin() ; it != children_.end() ; ++it)
+                if ((*it)->id_ == id)
+                    return (*it).get();
+            return 0;
+        }
+
         //! Returns the name of this node
         const std::string &Name() const { return name_; }
 
+        //! Returns the block id of this node, 0 for thread root nodes
+        ProfilerBlockId Id() const { return id_; }
+
         //! Returns the parent of this node
         ProfilerNodeTree *Parent() { return parent_; }
 
+        //! Returns the parent of this node
+        const ProfilerNodeTree *Parent() const { return parent_; }
+
         //! Returns list of children for introspection
         const NodeList &GetChildren() const { return children_; }
 
-        void MarkAsRootBlock(Profiler *owner) { owner_ = owner; }
-
     private:
         //! list of all children for this node
         NodeList children_;
         //! cached parent node for easy access
         ProfilerNodeTree *parent_;
-        //! If non-null, this node is a root block owned by the given profiler.
-        Profiler *owner_;
         //! Name of this node
         const std::string name_;
-
-        //! helper counter for recursion
-        int recursion_;
+        //! Block id of this node
+        const ProfilerBlockId id_;
     };
     typedef boost::shared_ptr<ProfilerNodeTree> ProfilerNodeTreePtr;
 
@@ -224,8 +248,8 @@ namespace Foundation
         ProfilerNode(const ProfilerNode &rhs); // N/I
     public:
         //! constructor that takes a name for the node
-        explicit ProfilerNode(const std::string &name) : 
-        ProfilerNodeTree(name),
+        explicit ProfilerNode(const std::string &name, ProfilerBlockId id = 0) : 
+        ProfilerNodeTree(name, id),
             num_called_total_(0),
             num_called_(0),
             num_called_current_(0),
@@ -295,20 +319,142 @@ namespace Foundation
         double elapsed_current_;
         double elapsed_min_current_;
         double elapsed_max_current_;
-
-        ProfilerBlock block_;
     };
 
     namespace
     {
         //! For boost::thread_specific_ptr, we don't want it doing automatic deletion
         void EmptyDeletor(ProfilerNodeTree *node) { }
-/*        void TSPNodeDeletor(ProfilerNodeTree *node)
-          { 
-          delete node;
-          }*/
     }
 
+    //! A single timing event recorded by a profiled thread
+    struct ProfilerEvent
+    {
+        enum Type
+        {
+            //! A profiling block was entered
+            Begin,
+            //! A profiling block was left
+            End,
+            //! The thread reset its per frame profiling data
+            Reset
+        };
+
+        //! Block id, 0 for Reset events
+        ProfilerBlockId id_;
+
+        //! Event type
+        unsigned int type_;
+
+        //! Clock time of the event
+        tick_t time_;
+    };
+
+    //! Fixed size lock-free single-producer, single-consumer queue of the timing events of one thread.
+    /*! The profiled thread writes events and publishes them with Publish(); the consumer, which is whoever holds
+        the profiler lock, drains the published events into the profiling tree. Events are written without a memory
+        barrier, and are published together when a block ends by a release store of the write index. On x86 that is
+        a plain store behind a compiler barrier, so profiling a block costs two clock reads and a few stores to
+        thread-local memory.
+     */
+    class ProfilerEventRing
+    {
+    public:
+        //! Amount of events the ring holds, a power of two
+        static const size_t cCapacity = 8192;
+
+        ProfilerEventRing() : writeIndex_(0), readIndex_(0), pendingIndex_(0), cachedReadIndex_(0) {}
+
+        //! Writes an event without publishing it. Called from the producer thread only.
+        /*! \return false if the ring is full, in which case the consumer must drain it first
+         */
+        bool Write(ProfilerBlockId id, unsigned int type, tick_t time)
+        {
+            if (pendingIndex_ - cachedReadIndex_ >= cCapacity)
+            {
+                cachedReadIndex_ = ReadIndex();
+                if (pendingIndex_ - cachedReadIndex_ >= cCapacity)
+                    return false;
+            }
+            ProfilerEvent &event = events_[pendingIndex_ & (cCapacity - 1)];
+            event.id_ = id;
+            event.type_ = type;
+            event.time_ = time;
+            ++pendingIndex_;
+            return true;
+        }
+
+        //! Makes the written events visible to the consumer with a release store of the write index. Called from the producer thread only.
+        void Publish();
+
+        //! Returns the running count of published events. Called from the consumer only.
+        size_t BeginRead();
+
+        //! Returns an event between the read index and the index returned by BeginRead(). Called from the consumer only.
+        const ProfilerEvent &Event(size_t index) const { return events_[index & (cCapacity - 1)]; }
+
+        //! Hands the events up to end back to the producer. Called from the consumer only.
+        void EndRead(size_t end);
+
+        //! Returns the running count of events handed back by the consumer
+        size_t ReadIndex() const;
+
+    private:
+        ProfilerEvent events_[cCapacity];
+
+        //! Running count of published events. Written by the producer thread only.
+        volatile size_t writeIndex_;
+
+        //! Running count of events handed back by the consumer. Written by the consumer only.
+        volatile size_t readIndex_;
+
+        //! Running count of written events, including the ones not yet published. Producer thread only.
+        size_t pendingIndex_;
+
+        //! Last read index seen by the producer thread
+        size_t cachedReadIndex_;
+    };
+
+    //! Profiling state of one thread, owned by the thread and deleted when the thread exits
+    class ProfilerThreadData
+    {
+        friend class Profiler;
+        ProfilerThreadData(); // N/I
+        ProfilerThreadData(const ProfilerThreadData &rhs); // N/I
+    public:
+        //! constructor
+        /*! \param owner Profiler the thread reports to
+            \param name Name of the thread root node
+         */
+        ProfilerThreadData(Profiler *owner, const std::string &name) : owner_(owner), root_(name) {}
+
+        //! destructor, removes the thread root node from the owner
+        ~ProfilerThreadData();
+
+    private:
+        //! A block entered by the thread and not yet left, as seen by the consumer
+        struct OpenBlock
+        {
+            OpenBlock(ProfilerNode *node, tick_t start) : node_(node), start_(start), recursion_(0) {}
+            ProfilerNode *node_;
+            tick_t start_;
+            //! Recursive re-entries of the block not yet left. Only the outermost call is timed.
+            int recursion_;
+        };
+
+        //! Profiler the thread reports to, 0 if the profiler has been destroyed
+        Profiler *owner_;
+
+        //! Timing events not yet aggregated
+        ProfilerEventRing ring_;
+
+        //! Aggregated profiling data of the thread
+        ProfilerNodeTree root_;
+
+        //! Blocks open at the last aggregated event, innermost last
+        std::vector<OpenBlock> open_blocks_;
+    };
+
     //! Profiler can be used to measure execution time of a block of code.
     /*!
       Do not use this class directly for profiling, use instead PROFILE
@@ -319,67 +465,90 @@ namespace Foundation
       per frame, so ThreadedReset() should be called from within the 
       profiled thread. The profiling data won't show up otherwise.
 
-      Lock() and Release() functions should not be used, they are for
-      reporting profiling data. They are threadsafe because the
-      variables that are accessed during reporting are ones that are only
-      written to during Reset() or ResetThread and that is protected by a lock.
-      Otherwise for thread safety boost::thread_specific_ptr is used to store
-      thread specific profiling data. 
-              
-      Locks are not used when dealing with profiling blocks, as they might skew
-      the data too much.
-
-      \todo A memory leak around here somewhere of several kilobytes.
+      Profiling a block does not look up names, and locks only when the
+      event ring of the thread is full. Each block name is
+      interned to a ProfilerBlockId once, and each thread records begin, end
+      and reset events with clock times to its own ProfilerEventRing. The
+      events are aggregated into the profiling tree lazily: when the data is
+      reported with Lock() or GetRoot(), or when the ring of a thread is full.
+
+      Lock() and Release() are for reporting profiling data. While the lock
+      is held, the profiling tree is not modified.
     */
     class Profiler
     {
         friend class Framework;
+        friend class ProfilerThreadData;
     public://private:
     Profiler()
-        :current_node_(&EmptyDeletor),
-            root_("Root")
+        :root_("Root"),
+        next_block_id_(1)
             {
             }
     public:
         ~Profiler();
 
+        //! Interns a profiling block name. Thread-safe.
+        /*! \param name Name of the block
+            \return Id of the block, the same for every call with the same name
+         */
+        ProfilerBlockId RegisterBlock(const std::string &name);
+
+        //! Returns the name of an interned block, or empty string if the id is not known. Thread-safe.
+        std::string GetBlockName(ProfilerBlockId id);
+
         //! Start a profiling block.
         /*!
           Normally you don't use this directly, instead you use the macro PROFILE.
           However if you want profiling that lasts out of scope, you can use this directly,
           you also need to call matching Profiler::EndBlock()
 
-          Can be called multiple times with the same name without calling EndBlock() for
+          Can be called multiple times with the same id without calling EndBlock() for
           recursion support.
 
           Re-entrant.
         */
-        void StartBlock(const std::string &name);
+        void StartBlock(ProfilerBlockId id);
 
         //! End the profiling block
         /*! Each StartBlock() should have a matching EndBlock(). Recursion is supported.
             
           Re-entrant.
         */
-        void EndBlock(const std::string &name);
+        void EndBlock(ProfilerBlockId id);
+
+        //! Start a profiling block by name. Interns the name on every call, prefer StartBlock(ProfilerBlockId).
+        void StartBlock(const std::string &name) { StartBlock(RegisterBlock(name)); }
+
+        //! End a profiling block by name. Interns the name on every call, prefer EndBlock(ProfilerBlockId).
+        void EndBlock(const std::string &name) { EndBlock(RegisterBlock(name)); }
 
         //! Reset profiling data for the current thread. Don't call directly, use RESETPROFILER macro instead.
         void ThreadedReset();
 
-        ProfilerNodeTree *CreateThreadRootBlock();
-        void RemoveThreadRootBlock(ProfilerNodeTree *rootBlock);
+        //! Starts recording the profiling blocks and frame boundaries of all threads. Discards a previous capture that was not stopped.
+        void StartCapture();
+
+        //! Stops recording and returns the capture, or null if not capturing
+        ProfilerCapturePtr StopCapture();
+
+        //! Returns whether a capture is being recorded
+        bool IsCapturing() const { return capture_.get() != 0; }
 
+        //! Returns aggregated root profiling node for the current thread only, or 0 if the thread has not profiled anything.
+        /*! Lock the profiler before reading the node.
+         */
         ProfilerNodeTree *GetThreadRootBlock();
 
         std::string GetThisThreadRootBlockName();
 
-        //! Returns root profiling node for the current thread only, re-entrant
-        ProfilerNodeTree *GetOrCreateThreadRootBlock();
-
-        //! Returns root profiling node for all threads.
+        //! Aggregates the recorded events of all threads and returns root profiling node for all threads.
+        /*! The profiling tree stays unmodified until Release() is called.
+         */
         ProfilerNodeTree *Lock()
         {
             mutex_.lock();
+            AggregateAll();
             return &root_;
         }
 
@@ -388,25 +557,85 @@ namespace Foundation
             mutex_.unlock();
         }
 
-        ProfilerNodeTree *GetRoot() { return &root_; }
+        //! Aggregates the recorded events of all threads and returns root profiling node for all threads.
+        /*! Unlike Lock(), does not keep other threads from modifying the profiling tree while it is read.
+         */
+        ProfilerNodeTree *GetRoot()
+        {
+            Lock();
+            Release();
+            return &root_;
+        }
 
     private:
+        //! Returns profiling state of the current thread, creates it if needed
+        ProfilerThreadData *GetOrCreateThreadData()
+        {
+            ProfilerThreadData *data = thread_data_.get();
+            return data ? data : CreateThreadData();
+        }
+
+        //! Creates profiling state for the current thread
+        ProfilerThreadData *CreateThreadData();
+
+        //! Removes a thread from the profiler, called when the thread exits
+        void RemoveThreadData(ProfilerThreadData *data);
+
+        //! Writes an event to the ring of a thread, aggregating the ring first if it is full
+        /*! Events are never dropped, as a lost begin or end event would break the block nesting of the thread.
+            Instead the thread takes the profiler lock when its ring is full, which is rare as the ring holds
+            thousands of events and is drained whenever the profiling data is reported.
+         */
+        void WriteEvent(ProfilerThreadData *data, ProfilerBlockId id, unsigned int type, tick_t time)
+        {
+            if (!data->ring_.Write(id, type, time))
+            {
+                // Publish the events since the last block end too, so that the ring is drained completely
+                data->ring_.Publish();
+                mutex_.lock();
+                Aggregate(data);
+                mutex_.unlock();
+                // Aggregating emptied the ring, so this cannot fail
+                data->ring_.Write(id, type, time);
+            }
+        }
+
+        //! Aggregates the published events of all threads. Call with the lock held.
+        void AggregateAll();
+
+        //! Aggregates the published events of one thread. Call with the lock held.
+        void Aggregate(ProfilerThreadData *data);
+
         //! The single global root node object. This is a dummy root node that doesn't track any
         //! timing statistics, but just contains all the root blocks of each thread as its children.
         //! This root_ node doesn't own any of the memory of any of its children, those are owned 
         //! and freed by each thread separately Namely, freeing all instances inside the 
-        //! thread_specific_root_ will cause all blocks to be freed.
+        //! thread_data_ will cause all blocks to be freed.
         ProfilerNodeTree root_;
 
-        //! Contains the root profile block for each thread.
-        boost::thread_specific_ptr<ProfilerNodeTree> thread_specific_root_;
-        //! Points to the current topmost profile block in the stack for each thread.
-        boost::thread_specific_ptr<ProfilerNodeTree> current_node_;
+        //! Contains the profiling state for each thread.
+        boost::thread_specific_ptr<ProfilerThreadData> thread_data_;
+
+        //! container for the profiling state of all threads.
+        std::list<ProfilerThreadData*> threads_;
+
+        //! Protects the profiling tree and threads_. Recursive, so that the tree can be read with GetRoot() while locked.
+        boost::recursive_mutex mutex_;
+
+        //! Interned block names, indexed by block id
+        std::vector<std::string> block_names_;
+
+        //! Block ids by name
+        std::map<std::string, ProfilerBlockId> block_ids_;
+
+        //! Id of the next interned block
+        ProfilerBlockId next_block_id_;
 
-        //! container for all the root profile nodes for each thread.
-        std::list<ProfilerNodeTree*> thread_root_nodes_;
+        //! Protects the interned block names
+        boost::mutex block_mutex_;
 
-        boost::mutex mutex_;
+        //! Capture being recorded, null if none
+        ProfilerCapturePtr capture_;
     };
 
     //! Used by PROFILE - macro to automatically stop profiling clock when going out of scope
@@ -416,10 +645,24 @@ namespace Foundation
         ProfilerSection(); // N/I
         ProfilerSection(const ProfilerSection &rhs);
     public:
-        explicit ProfilerSection(const std::string &name) : name_(name), destroyed_(false)
+        //! constructor that interns the block name if id is still 0
+        /*! \param id [in, out] Static block id of the PROFILE() site
+            \param name Name of the block
+         */
+        ProfilerSection(ProfilerBlockId &id, const char *name) : destroyed_(false)
         {
             assert (profiler_ && "Trying to profile before profiler initialized.");
-            GetProfiler()->StartBlock(name);
+            if (!id)
+                id = GetProfiler()->RegisterBlock(name);
+            id_ = id;
+            GetProfiler()->StartBlock(id_);
+        }
+
+        explicit ProfilerSection(const std::string &name) : destroyed_(false)
+        {
+            assert (profiler_ && "Trying to profile before profiler initialized.");
+            id_ = GetProfiler()->RegisterBlock(name);
+            GetProfiler()->StartBlock(id_);
         }
 
         ~ProfilerSection()
@@ -435,7 +678,7 @@ namespace Foundation
         {
             assert (profiler_ && "Trying to profile before profiler initialized.");
 
-            GetProfiler()->EndBlock(name_);
+            GetProfiler()->EndBlock(id_);
             destroyed_ = true;
         }
         static Profiler *GetProfiler() { return profiler_; }
@@ -446,8 +689,8 @@ namespace Foundation
         //! Parent profiler used by this section
         static Profiler *profiler_;
 
-        //! Name of this profiling section
-        const std::string name_;
+        //! Block id of this profiling section
+        ProfilerBlockId id_;
 
         //! True if this section has explicitly been destroyed before it run out of scope
         bool destroyed_;
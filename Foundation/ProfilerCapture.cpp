@@ -0,0 +1,191 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "ProfilerCapture.h"
+#include "Profiler.h"
+
+#include <fstream>
+
+namespace Foundation
+{
+    namespace
+    {
+        //! Writes a string as a JSON string literal
+        void WriteJsonString(std::ostream &out, const std::string &str)
+        {
+            out << '"';
+            for (size_t i = 0; i < str.length(); ++i)
+            {
+                char c = str[i];
+                if (c == '"' || c == '\\')
+                    out << '\\' << c;
+                else if ((unsigned char)c >= 0x20)
+                    out << c;
+            }
+            out << '"';
+        }
+    }
+
+    ProfilerCapture::ProfilerCapture(tick_t start) :
+        start_(start),
+        end_(0)
+    {
+    }
+
+    void ProfilerCapture::AddBlock(const ProfilerThreadData *thread, const ProfilerNodeTree *root, const ProfilerNodeTree *node, tick_t start, tick_t end)
+    {
+        if (end < start_ || (end_ && start > end_))
+            return;
+
+        Thread &data = GetThread(thread, root);
+        Block block;
+        block.stack_ = GetStack(data, node);
+        block.start_ = start < start_ ? start_ : start;
+        block.end_ = end;
+        data.blocks_.push_back(block);
+    }
+
+    void ProfilerCapture::AddFrame(const ProfilerThreadData *thread, const ProfilerNodeTree *root, tick_t time)
+    {
+        if (time < start_ || (end_ && time > end_))
+            return;
+
+        GetThread(thread, root).frames_.push_back(time);
+    }
+
+    void ProfilerCapture::RemoveThread(const ProfilerThreadData *thread)
+    {
+        thread_index_.erase(thread);
+    }
+
+    size_t ProfilerCapture::GetNumBlocks() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < threads_.size(); ++i)
+            count += threads_[i]->blocks_.size();
+        return count;
+    }
+
+    ProfilerCapture::Thread &ProfilerCapture::GetThread(const ProfilerThreadData *thread, const ProfilerNodeTree *root)
+    {
+        std::map<const ProfilerThreadData*, size_t>::const_iterator iter = thread_index_.find(thread);
+        if (iter != thread_index_.end())
+            return *threads_[iter->second];
+
+        ThreadPtr data(new Thread());
+        data->name_ = root->Name();
+        thread_index_[thread] = threads_.size();
+        threads_.push_back(data);
+        return *data;
+    }
+
+    int ProfilerCapture::GetStack(Thread &thread, const ProfilerNodeTree *node)
+    {
+        std::map<const ProfilerNodeTree*, int>::const_iterator iter = thread.stack_index_.find(node);
+        if (iter != thread.stack_index_.end())
+            return iter->second;
+
+        // Thread root nodes have no block id
+        const ProfilerNodeTree *parent = node->Parent();
+        int parent_index = -1;
+        if (parent && parent->Id())
+            parent_index = GetStack(thread, parent);
+
+        Stack stack;
+        stack.name_ = node->Name();
+        stack.parent_ = parent_index;
+        stack.path_ = (parent_index >= 0 ? thread.stacks_[parent_index].path_ : thread.name_) + ";" + node->Name();
+
+        int index = (int)thread.stacks_.size();
+        thread.stacks_.push_back(stack);
+        thread.stack_index_[node] = index;
+        return index;
+    }
+
+    double ProfilerCapture::ToMicroseconds(tick_t time) const
+    {
+        return ProfilerBlock::ElapsedTimeSeconds(start_, time) * 1000000.0;
+    }
+
+    bool ProfilerCapture::WriteChromeTrace(const std::string &filename) const
+    {
+        std::ofstream out(filename.c_str(), std::ios::out | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+
+        out.setf(std::ios::fixed);
+        out.precision(3);
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (size_t i = 0; i < threads_.size(); ++i)
+        {
+            const Thread &thread = *threads_[i];
+
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+            WriteJsonString(out, thread.name_);
+            out << "}}";
+            first = false;
+
+            for (size_t j = 1; j < thread.frames_.size(); ++j)
+            {
+                double start = ToMicroseconds(thread.frames_[j - 1]);
+                out << ",\n{\"name\":\"Frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << i << ",\"ts\":" << start
+                    << ",\"dur\":" << ToMicroseconds(thread.frames_[j]) - start << "}";
+            }
+
+            for (size_t j = 0; j < thread.blocks_.size(); ++j)
+            {
+                const Block &block = thread.blocks_[j];
+                double start = ToMicroseconds(block.start_);
+                out << ",\n{\"name\":";
+                WriteJsonString(out, thread.stacks_[block.stack_].name_);
+                out << ",\"cat\":\"profile\",\"ph\":\"X\",\"pid\":1,\"tid\":" << i << ",\"ts\":" << start
+                    << ",\"dur\":" << ToMicroseconds(block.end_) - start << "}";
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        return !out.fail();
+    }
+
+    bool ProfilerCapture::WriteCollapsedStacks(const std::string &filename) const
+    {
+        std::ofstream out(filename.c_str(), std::ios::out | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+
+        out.setf(std::ios::fixed);
+        out.precision(0);
+        for (size_t i = 0; i < threads_.size(); ++i)
+        {
+            const Thread &thread = *threads_[i];
+
+            // Time spent in each stack including the enclosed blocks, then subtract the enclosed blocks from their parents
+            std::vector<double> self_time(thread.stacks_.size(), 0.0);
+            for (size_t j = 0; j < thread.blocks_.size(); ++j)
+            {
+                const Block &block = thread.blocks_[j];
+                double elapsed = ToMicroseconds(block.end_) - ToMicroseconds(block.start_);
+                self_time[block.stack_] += elapsed;
+                int parent = thread.stacks_[block.stack_].parent_;
+                if (parent >= 0)
+                    self_time[parent] -= elapsed;
+            }
+
+            for (size_t j = 0; j < thread.stacks_.size(); ++j)
+                if (self_time[j] >= 1.0)
+                    out << thread.stacks_[j].path_ << " " << self_time[j] << "\n";
+        }
+
+        return !out.fail();
+    }
+
+    bool ProfilerCapture::Write(const std::string &filename) const
+    {
+        std::string::size_type dot = filename.rfind('.');
+        std::string extension = dot != std::string::npos ? filename.substr(dot) : std::string();
+        if (extension == ".folded" || extension == ".txt")
+            return WriteCollapsedStacks(filename);
+        return WriteChromeTrace(filename);
+    }
+}
@@ -0,0 +1,148 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_ProfilerCapture_h
+#define incl_Foundation_ProfilerCapture_h
+
+#include "HighPerfClock.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Foundation
+{
+    class ProfilerNodeTree;
+    class ProfilerThreadData;
+
+    //! Profiling blocks and frame boundaries of all threads, recorded over a period of time for offline analysis.
+    /*! Filled in by Profiler while it aggregates the timing events of the threads, see Profiler::StartCapture().
+        The blocks keep their place in the ProfilerNodeTree hierarchy as a call stack, so the capture stays
+        readable after the threads that recorded it have exited.
+
+        Can be written as Chrome Trace Event JSON, for chrome://tracing and compatible viewers, or as collapsed
+        stacks, one line per call stack with the time spent in it, for flame graph tools.
+     */
+    class ProfilerCapture
+    {
+    public:
+        //! constructor
+        /*! \param start Clock time the capture starts at, earlier events are not recorded
+         */
+        explicit ProfilerCapture(tick_t start);
+
+        //! Returns clock time the capture starts at
+        tick_t GetStart() const { return start_; }
+
+        //! Returns clock time the capture ended at, 0 if still capturing
+        tick_t GetEnd() const { return end_; }
+
+        //! Ends the capture
+        void Stop(tick_t end) { end_ = end; }
+
+        //! Records a completed profiling block
+        /*! \param thread Thread the block ran in
+            \param root Root node of the thread
+            \param node Node of the block in the profiling tree of the thread
+            \param start Clock time the block was entered
+            \param end Clock time the block was left
+         */
+        void AddBlock(const ProfilerThreadData *thread, const ProfilerNodeTree *root, const ProfilerNodeTree *node, tick_t start, tick_t end);
+
+        //! Records a frame boundary, ie. a RESETPROFILER in the thread
+        void AddFrame(const ProfilerThreadData *thread, const ProfilerNodeTree *root, tick_t time);
+
+        //! Forgets a thread that is about to exit. Its recorded data is kept.
+        void RemoveThread(const ProfilerThreadData *thread);
+
+        //! Returns amount of recorded blocks in all threads
+        size_t GetNumBlocks() const;
+
+        //! Writes the capture as Chrome Trace Event JSON. Blocks are complete ("X") events, frames are spans between frame boundaries.
+        /*! \return true if successful
+         */
+        bool WriteChromeTrace(const std::string &filename) const;
+
+        //! Writes the capture as collapsed stacks: "thread;block;block microseconds", the time spent in the innermost block itself.
+        /*! \return true if successful
+         */
+        bool WriteCollapsedStacks(const std::string &filename) const;
+
+        //! Writes the capture, in collapsed stack format if the file extension is .folded or .txt, as Chrome trace otherwise
+        bool Write(const std::string &filename) const;
+
+    private:
+        //! A call stack, ie. a node of the profiling tree of a thread
+        struct Stack
+        {
+            //! Name of the innermost block
+            std::string name_;
+
+            //! Names of the thread and all blocks in the stack, separated by ';'
+            std::string path_;
+
+            //! Index of the enclosing stack, -1 if the stack is a single block
+            int parent_;
+        };
+
+        //! A completed profiling block
+        struct Block
+        {
+            //! Index of the call stack of the block
+            int stack_;
+
+            //! Clock time the block was entered
+            tick_t start_;
+
+            //! Clock time the block was left
+            tick_t end_;
+        };
+
+        //! Recorded data of one thread
+        struct Thread
+        {
+            //! Name of the thread root node
+            std::string name_;
+
+            //! Call stacks seen in the thread
+            std::vector<Stack> stacks_;
+
+            //! Index of the call stack of each seen node
+            std::map<const ProfilerNodeTree*, int> stack_index_;
+
+            //! Completed blocks, in the order they ended
+            std::vector<Block> blocks_;
+
+            //! Frame boundaries
+            std::vector<tick_t> frames_;
+        };
+
+        typedef boost::shared_ptr<Thread> ThreadPtr;
+
+        //! Returns recorded data of a thread, creates it if needed
+        Thread &GetThread(const ProfilerThreadData *thread, const ProfilerNodeTree *root);
+
+        //! Returns index of the call stack of a node, creates it if needed
+        int GetStack(Thread &thread, const ProfilerNodeTree *node);
+
+        //! Returns microseconds from the start of the capture
+        double ToMicroseconds(tick_t time) const;
+
+        //! Clock time the capture starts at
+        tick_t start_;
+
+        //! Clock time the capture ended at, 0 if still capturing
+        tick_t end_;
+
+        //! Recorded data of all threads, in the order they were first seen
+        std::vector<ThreadPtr> threads_;
+
+        //! Index of the recorded data of each live thread
+        std::map<const ProfilerThreadData*, size_t> thread_index_;
+    };
+
+    typedef boost::shared_ptr<ProfilerCapture> ProfilerCapturePtr;
+}
+
+#endif
@@ -0,0 +1,242 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "Foundation.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+namespace Foundation
+{
+    namespace
+    {
+        //! Shared state of one ParallelFor call. Helper jobs that start after the call has returned find no work left.
+        struct ParallelForState
+        {
+            ParallelForState(uint begin, uint end, const boost::function<void(uint)>& body) :
+                next_(begin), end_(end), remaining_(end - begin), body_(body) {}
+
+            Mutex mutex_;
+            Condition done_;
+            uint next_;
+            uint end_;
+            uint remaining_;
+            boost::function<void(uint)> body_;
+        };
+
+        void RunParallelFor(boost::shared_ptr<ParallelForState> state)
+        {
+            for (;;)
+            {
+                uint index;
+                {
+                    MutexLock lock(state->mutex_);
+                    if (state->next_ >= state->end_)
+                        return;
+                    index = state->next_++;
+                }
+
+                try
+                {
+                    state->body_(index);
+                }
+                catch (std::exception& e)
+                {
+                    RootLogError(std::string("ParallelFor body threw an exception: ") + e.what());
+                }
+                catch (...)
+                {
+                    RootLogError("ParallelFor body threw an unknown exception");
+                }
+
+                bool last;
+                {
+                    MutexLock lock(state->mutex_);
+                    last = (--state->remaining_ == 0);
+                }
+                if (last)
+                    state->done_.notify_all();
+            }
+        }
+    }
+
+    ThreadPool::ThreadPool(uint num_threads) :
+        queued_jobs_(0),
+        next_worker_(0),
+        accepting_(true),
+        stopping_(false)
+    {
+        if (!num_threads)
+        {
+            uint hardware_threads = boost::thread::hardware_concurrency();
+            num_threads = hardware_threads > 1 ? hardware_threads - 1 : 1;
+        }
+
+        workers_.resize(num_threads);
+        for (uint i = 0; i < num_threads; ++i)
+            workers_[i] = new Worker();
+        // Start the threads only after all workers exist, as they steal from each other
+        for (uint i = 0; i < num_threads; ++i)
+            workers_[i]->thread_ = boost::thread(boost::bind(&ThreadPool::WorkerLoop, this, i));
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        Stop();
+
+        for (uint i = 0; i < workers_.size(); ++i)
+            delete workers_[i];
+        workers_.clear();
+    }
+
+    bool ThreadPool::Submit(const Job& job, Priority priority)
+    {
+        if (!job)
+            return false;
+        if (priority < PriorityHigh || priority >= NumPriorities)
+            priority = PriorityNormal;
+
+        uint index;
+        if (current_worker_.get())
+            index = *current_worker_;
+        else
+        {
+            MutexLock lock(idle_mutex_);
+            if (!accepting_)
+                return false;
+            index = next_worker_;
+            next_worker_ = (next_worker_ + 1) % workers_.size();
+        }
+
+        {
+            MutexLock lock(workers_[index]->mutex_);
+            workers_[index]->queues_[priority].push_back(job);
+        }
+
+        {
+            MutexLock lock(idle_mutex_);
+            ++queued_jobs_;
+        }
+        idle_condition_.notify_one();
+        return true;
+    }
+
+    void ThreadPool::ParallelFor(uint begin, uint end, const boost::function<void(uint)>& body, Priority priority)
+    {
+        if (begin >= end)
+            return;
+
+        boost::shared_ptr<ParallelForState> state(new ParallelForState(begin, end, body));
+        uint helpers = std::min(GetNumThreads(), end - begin - 1);
+        for (uint i = 0; i < helpers; ++i)
+            if (!Submit(boost::bind(&RunParallelFor, state), priority))
+                break;
+
+        RunParallelFor(state);
+
+        ScopedLock lock(state->mutex_);
+        while (state->remaining_)
+            state->done_.wait(lock);
+    }
+
+    void ThreadPool::Stop()
+    {
+        {
+            MutexLock lock(idle_mutex_);
+            if (stopping_)
+                return;
+            accepting_ = false;
+            stopping_ = true;
+        }
+        idle_condition_.notify_all();
+
+        for (uint i = 0; i < workers_.size(); ++i)
+            workers_[i]->thread_.join();
+    }
+
+    uint ThreadPool::GetNumQueuedJobs()
+    {
+        MutexLock lock(idle_mutex_);
+        return queued_jobs_ > 0 ? (uint)queued_jobs_ : 0;
+    }
+
+    bool ThreadPool::TakeJob(uint index, Job& job)
+    {
+        const uint num_workers = workers_.size();
+        for (int priority = PriorityHigh; priority < NumPriorities; ++priority)
+        {
+            // Own jobs first, oldest first
+            {
+                Worker* worker = workers_[index];
+                MutexLock lock(worker->mutex_);
+                std::deque<Job>& queue = worker->queues_[priority];
+                if (!queue.empty())
+                {
+                    job.swap(queue.front());
+                    queue.pop_front();
+                    return true;
+                }
+            }
+
+            // Then steal from the other end of the other workers' queues, so that the owner keeps its oldest jobs
+            for (uint i = 1; i < num_workers; ++i)
+            {
+                Worker* victim = workers_[(index + i) % num_workers];
+                MutexLock lock(victim->mutex_);
+                std::deque<Job>& queue = victim->queues_[priority];
+                if (!queue.empty())
+                {
+                    job.swap(queue.back());
+                    queue.pop_back();
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::WorkerLoop(uint index)
+    {
+        current_worker_.reset(new uint(index));
+
+        for (;;)
+        {
+            Job job;
+            if (TakeJob(index, job))
+            {
+                {
+                    MutexLock lock(idle_mutex_);
+                    --queued_jobs_;
+                }
+
+                try
+                {
+                    PROFILE(ThreadPool_Job);
+                    job();
+                }
+                catch (std::exception& e)
+                {
+                    RootLogError(std::string("Thread pool job threw an exception: ") + e.what());
+                }
+                catch (...)
+                {
+                    RootLogError("Thread pool job threw an unknown exception");
+                }
+
+                RESETPROFILER
+                continue;
+            }
+
+            ScopedLock lock(idle_mutex_);
+            while (queued_jobs_ <= 0 && !stopping_)
+                idle_condition_.wait(lock);
+            // When stopping, exit only once all queues have been emptied
+            if (stopping_ && queued_jobs_ <= 0)
+                return;
+        }
+    }
+}
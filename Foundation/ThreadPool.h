@@ -0,0 +1,124 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_ThreadPool_h
+#define incl_Foundation_ThreadPool_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+
+#include <boost/function.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace Foundation
+{
+    //! Pool of worker threads that run independent jobs.
+    /*! Every worker has its own job queues, one per priority class. Jobs submitted from a worker thread go to the
+        queue of that worker, jobs submitted from other threads are spread over the workers. A worker that runs out
+        of jobs steals from the other workers, so all threads are kept busy as long as there is work.
+
+        Jobs of a higher priority class are always started before jobs of a lower class. Within a class, a worker
+        runs its own jobs in submission order.
+
+        The framework owns one pool sized to the hardware, see Framework::GetThreadPool(). ThreadTasks that process
+        their requests with ThreadTask::ProcessRequest() run on it. Jobs that wait on sockets or files go to the
+        smaller pool of Framework::GetIoThreadPool() instead, so that they do not hold up the compute jobs.
+     */
+    class ThreadPool
+    {
+    public:
+        //! Priority classes of jobs
+        enum Priority
+        {
+            PriorityHigh = 0,
+            PriorityNormal,
+            PriorityLow,
+            NumPriorities
+        };
+
+        //! Job function
+        typedef boost::function<void()> Job;
+
+        //! Constructor. Starts the worker threads.
+        /*! \param num_threads Number of worker threads. If 0, uses one less than the number of hardware threads,
+                but at least one.
+         */
+        explicit ThreadPool(uint num_threads = 0);
+
+        //! Destructor. Calls Stop().
+        ~ThreadPool();
+
+        //! Queues a job. Thread-safe.
+        /*! \param job Job to run. Must not block waiting for other jobs of the pool, as they may be queued behind it.
+            \param priority Priority class
+            \return true if queued, false if the pool has been stopped
+         */
+        bool Submit(const Job& job, Priority priority = PriorityNormal);
+
+        //! Calls body(i) for every i in [begin, end) and returns once all calls have returned.
+        /*! The calls are spread over the worker threads, and the calling thread takes part too, so this is safe to
+            call from a worker thread. The body must be thread-safe.
+            \param begin First index
+            \param end One past the last index
+            \param body Function to call
+            \param priority Priority class of the helper jobs queued to the workers
+         */
+        void ParallelFor(uint begin, uint end, const boost::function<void(uint)>& body, Priority priority = PriorityHigh);
+
+        //! Stops accepting jobs, runs the already queued jobs to completion and joins the worker threads.
+        void Stop();
+
+        //! Returns number of worker threads
+        uint GetNumThreads() const { return (uint)workers_.size(); }
+
+        //! Returns number of jobs that are queued and not yet started
+        uint GetNumQueuedJobs();
+
+        //! Returns true if called from one of the worker threads of this pool
+        bool IsWorkerThread() const { return current_worker_.get() != 0; }
+
+    private:
+        ThreadPool(const ThreadPool &); // N/I
+        void operator =(const ThreadPool &); // N/I
+
+        //! Worker thread and its job queues
+        struct Worker
+        {
+            //! Mutex for the queues
+            Mutex mutex_;
+            //! Job queues by priority class
+            std::deque<Job> queues_[NumPriorities];
+            //! Thread
+            Thread thread_;
+        };
+
+        //! Worker thread entry point
+        void WorkerLoop(uint index);
+
+        //! Takes the next job for a worker, from its own queues or stolen from another worker
+        bool TakeJob(uint index, Job& job);
+
+        //! Workers
+        std::vector<Worker*> workers_;
+
+        //! Index of the worker the calling thread is, if any
+        boost::thread_specific_ptr<uint> current_worker_;
+
+        //! Mutex for idle waiting and the variables below
+        Mutex idle_mutex_;
+        //! Signaled when jobs are queued or the pool is stopped
+        Condition idle_condition_;
+        //! Number of queued jobs. May briefly go negative, as jobs are counted after they are pushed.
+        int queued_jobs_;
+        //! Worker that gets the next job submitted from outside the pool
+        uint next_worker_;
+        //! False once Stop() has been called
+        bool accepting_;
+        //! Set when the workers should exit after emptying the queues
+        bool stopping_;
+    };
+}
+
+#endif // incl_Foundation_ThreadPool_h
@@ -5,16 +5,30 @@
 #include "ThreadTask.h"
 #include "ThreadTaskManager.h"
 #include "ForwardDefines.h"
+#include "Profiler.h"
+
+#include <boost/bind.hpp>
 
 namespace Foundation
 {
-    ThreadTask::ThreadTask(const std::string& task_description) :
+    ThreadTask::ThreadTask(const std::string& task_description, bool pooled) :
         keep_running_(true),
         task_description_(task_description),
+        profiler_block_id_(0),
         task_manager_(0),
+        thread_pool_(0),
+        requests_in_flight_(0),
+        max_parallel_requests_(0),
+        max_pending_results_(0),
+        pooled_(pooled),
         running_(false),
         finished_(false)
     {
+#ifdef PROFILING
+        // Register the block name here, so that running a request does not build a string and look it up each time
+        if (ProfilerSection::GetProfiler())
+            profiler_block_id_ = ProfilerSection::GetProfiler()->RegisterBlock("ThreadTask_" + task_description_);
+#endif
     }
 
     ThreadTask::~ThreadTask()
@@ -25,19 +39,35 @@ namespace Foundation
     void ThreadTask::Stop()
     {
         keep_running_ = false;
-        request_condition_.notify_one();
+        request_condition_.notify_all();
         
         thread_.join();
+        
+        // Wait for the pooled requests already queued to the thread pool. Those that have not started yet return
+        // immediately as ShouldRun() is false.
+        ScopedLock lock(request_mutex_);
+        while (requests_in_flight_)
+            request_condition_.wait(lock);
     }
 
     void ThreadTask::AddRequest(ThreadTaskRequestPtr request)
     {
         if (request)
         {
-            if (!running_)
+            if (pooled_ && thread_pool_)
+            {
+                {
+                    MutexLock lock(request_mutex_);
+                    InsertRequest(request);
+                    running_ = true;
+                    finished_ = false;
+                }
+                DispatchRequests();
+            }
+            else if (!running_)
             {
                 thread_.join(); // Make sure it's really stopped, not just set the flag to false
-                requests_.push_back(request);
+                InsertRequest(request);
                 running_ = true;
                 finished_ = false;
                 thread_ = boost::thread(boost::ref(*this));
@@ -45,7 +75,7 @@ namespace Foundation
             else
             {
                 MutexLock lock(request_mutex_);
-                requests_.push_back(request);
+                InsertRequest(request);
             }
             request_condition_.notify_one();
         }
@@ -55,6 +85,90 @@ namespace Foundation
         }
     }
 
+    void ThreadTask::InsertRequest(ThreadTaskRequestPtr request)
+    {
+        std::list<ThreadTaskRequestPtr>::iterator i = requests_.end();
+        while (i != requests_.begin())
+        {
+            std::list<ThreadTaskRequestPtr>::iterator prev = i;
+            --prev;
+            if ((*prev)->priority_ <= request->priority_)
+                break;
+            i = prev;
+        }
+        requests_.insert(i, request);
+    }
+
+    void ThreadTask::DispatchRequests()
+    {
+        DispatchRequests(0);
+    }
+
+    void ThreadTask::DispatchRequests(uint finishing)
+    {
+        if (!pooled_ || !thread_pool_)
+            return;
+        
+        for (;;)
+        {
+            ThreadTaskRequestPtr request;
+            {
+                MutexLock lock(request_mutex_);
+                if (requests_.empty() || !keep_running_)
+                    return;
+                uint in_flight = requests_in_flight_ - finishing;
+                if (max_parallel_requests_ && in_flight >= max_parallel_requests_)
+                    return;
+                if (max_pending_results_ && task_manager_ &&
+                    in_flight + task_manager_->GetNumResults(task_description_) >= max_pending_results_)
+                    return;
+                
+                request = requests_.front();
+                requests_.pop_front();
+                ++requests_in_flight_;
+            }
+            
+            if (!thread_pool_->Submit(boost::bind(&ThreadTask::RunPooledRequest, this, request), request->priority_))
+            {
+                RootLogError("Thread pool has been stopped, could not run request of thread task " + task_description_);
+                MutexLock lock(request_mutex_);
+                --requests_in_flight_;
+                running_ = requests_in_flight_ > 0;
+                request_condition_.notify_all();
+                return;
+            }
+        }
+    }
+
+    void ThreadTask::RunPooledRequest(ThreadTaskRequestPtr request)
+    {
+        if (keep_running_)
+        {
+#ifdef PROFILING
+            // Shows the task activity in profiler captures. Use a copy of the id, the section writes to it if it is still 0
+            ProfilerBlockId block_id = profiler_block_id_;
+            ProfilerSection section(block_id, "ThreadTask");
+#endif
+            ProcessRequest(request);
+        }
+        
+        // Queue the next requests while this one still counts as in flight, so that Stop() keeps waiting for it
+        DispatchRequests(1);
+        
+        // Once the count drops, Stop() may return and the task be destroyed, so this is the last access to it
+        MutexLock lock(request_mutex_);
+        --requests_in_flight_;
+        if (!requests_in_flight_ && requests_.empty())
+        {
+            running_ = false;
+            // One-shot tasks are finished once they have set their result
+            MutexLock result_lock(result_mutex_);
+            if (result_)
+                finished_ = true;
+        }
+        request_condition_.notify_all();
+    }
+
     ThreadTaskResultPtr ThreadTask::GetResult() const
     {
         if (!finished_)
@@ -63,6 +177,31 @@ namespace Foundation
         return result_;
     }
 
+    void ThreadTask::Work()
+    {
+        while (ShouldRun())
+        {
+            WaitForRequests();
+            
+            ThreadTaskRequestPtr request = GetNextRequest();
+            if (request)
+            {
+#ifdef PROFILING
+                ProfilerBlockId block_id = profiler_block_id_;
+                ProfilerSection section(block_id, "ThreadTask");
+#endif
+                ProcessRequest(request);
+            }
+            
+            RESETPROFILER
+            
+            // One-shot tasks stop once they have set their result
+            MutexLock lock(result_mutex_);
+            if (result_)
+                break;
+        }
+    }
+
     void ThreadTask::operator() ()
     {
         Work();
@@ -6,6 +6,7 @@
 #include "IEventData.h"
 #include "CoreTypes.h"
 #include "CoreThread.h"
+#include "ThreadPool.h"
 
 namespace Foundation
 {
@@ -15,13 +16,16 @@ namespace Foundation
     class ThreadTaskRequest
     {
     public:
-        ThreadTaskRequest() {}
+        ThreadTaskRequest() : tag_(0), priority_(ThreadPool::PriorityNormal) {}
         virtual ~ThreadTaskRequest() {}
         
         //! Request tag. Assigned when queuing the request & returned to caller.
         /*! Note: assigned by a ThreadTaskManager, not by ThreadTask itself
          */
         request_tag_t tag_;
+        
+        //! Priority class. Requests of a higher class are served first.
+        ThreadPool::Priority priority_;
     };
 
     typedef boost::shared_ptr<ThreadTaskRequest> ThreadTaskRequestPtr;
@@ -40,10 +44,18 @@ namespace Foundation
     typedef boost::shared_ptr<ThreadTaskResult> ThreadTaskResultPtr;
     
     //! A class for performing threaded work.
-    /*! Subclass to use and implement the Work() function. The work can either be 
+    /*! Subclass to use and implement either the Work() or the ProcessRequest() function.
+        
+        Work() runs in a thread owned by the task, and serves the requests one at a time. The work can either be 
         - one-shot, use SetResult() and terminate work thread
         - continuous, use QueueResult() to queue results to the thread task manager, while work thread keeps running
           In this mode a thread task manager is needed to post results to, otherwise results will be lost
+        
+        ProcessRequest() serves a single request. Tasks that implement it and pass pooled = true to the constructor
+        run their requests as jobs on a ThreadPool, several in parallel, instead of owning a thread. Results are
+        passed on the same way: SetResult() for one-shot tasks, QueueResult() for continuous ones. The pool is set
+        by ThreadTaskManager::AddThreadTask(), or with SetThreadPool() for tasks that are not managed. If a pooled
+        task has no pool, it falls back to serving the requests in its own thread.
      */
     class ThreadTask
     {
@@ -53,19 +65,20 @@ namespace Foundation
         //! Constructor
         /*! \param task_description Description of the work this thread will be doing. Should be unique,
             if work requests are to be communicated via the foundation's default ThreadTaskManager
+            \param pooled Whether the task implements ProcessRequest() and may run on a thread pool
          */
-        ThreadTask(const std::string& task_description);
+        ThreadTask(const std::string& task_description, bool pooled = false);
         
         //! Destructor
-        /*! Calls Stop(). Note that in subclass destructors, it would be safest to call Stop() first, at least before
-            accessing any data that the still running work thread may also be accessing
+        /*! Calls Stop(). Subclasses that implement Work() or ProcessRequest() must call Stop() first in their own
+            destructors, as the work thread or the pooled requests may still be running and calling them
          */
         virtual ~ThreadTask();
         
         //! Returns task description.
         const std::string& GetTaskDescription() { return task_description_; }
         
-        //! Adds a work request and starts the work thread if not running
+        //! Adds a work request and starts the work thread if not running, or queues the request to the thread pool
         void AddRequest(ThreadTaskRequestPtr request);
         
         //! Template version of adding a work request. Performs dynamic_pointer_cast from the type specified.
@@ -92,16 +105,41 @@ namespace Foundation
         bool HasFinished() const { return finished_; }
         
         //! Commands the work thread to stop after current iteration is complete (continuous tasks only)
+        /*! For pooled tasks, drops the requests that have not been started, and waits for the running ones to finish.
+         */
         void Stop();
         
+        //! Sets thread pool to run the requests of a pooled task on. The pool must outlive the task.
+        void SetThreadPool(ThreadPool* pool) { thread_pool_ = pool; }
+        
+        //! Returns thread pool, or 0 if not set
+        ThreadPool* GetThreadPool() const { return thread_pool_; }
+        
+        //! Sets maximum amount of requests of a pooled task that may run in parallel. 0 (default) = no limit
+        void SetMaxParallelRequests(uint max_requests) { max_parallel_requests_ = max_requests; }
+        
+        //! Sets maximum amount of results of a pooled task that may wait in the thread task manager, including the
+        //! requests that are running. Further requests are held back until results are collected. 0 (default) = no limit
+        void SetMaxPendingResults(uint max_results) { max_pending_results_ = max_results; }
+        
+        //! Queues held back requests of a pooled task to the thread pool, if the limits allow. Called by the thread
+        //! task manager after it has collected results.
+        void DispatchRequests();
+        
         //! Thread entry point
         void operator()();
         
     protected:
         //! Performs work thread activity.
-        /*! Note: if doing a loop, check ShouldRun() function and terminate when it returns false
+        /*! Note: if doing a loop, check ShouldRun() function and terminate when it returns false.
+            The default implementation serves the requests with ProcessRequest() until stopped.
+         */
+        virtual void Work();
+        
+        //! Serves a single request. Implement in pooled tasks.
+        /*! Called from thread pool worker threads, possibly for several requests at the same time.
          */
-        virtual void Work() = 0;
+        virtual void ProcessRequest(ThreadTaskRequestPtr request) {}
         
         //! Waits for request queue to contain at least one item, or ShouldRun() becomes false
         /*! \return true if a request did arrive, false if ShouldRun() becomes false
@@ -161,16 +199,38 @@ namespace Foundation
          */
         void SetThreadTaskManager(ThreadTaskManager* manager) { task_manager_ = manager; }
         
+        //! Thread pool job entry point for pooled tasks
+        void RunPooledRequest(ThreadTaskRequestPtr request);
+        
+        //! Queues held back requests to the thread pool, not counting the given amount of requests in flight that
+        //! are about to finish
+        void DispatchRequests(uint finishing);
+        
+        //! Inserts a request to the request queue after the requests of the same or higher priority. Lock request_mutex_ first.
+        void InsertRequest(ThreadTaskRequestPtr request);
+        
         //! Task description
         std::string task_description_;
+        //! Profiler block id (ProfilerBlockId) of the task's requests, registered once in the constructor
+        uint profiler_block_id_;
         //! Mutex for request queue
         Mutex request_mutex_;
         //! Mutex for result
         Mutex result_mutex_;
-        //! Condition for request queue
+        //! Condition for request queue, also signaled when pooled requests finish
         Condition request_condition_;
-        //! Request queue
+        //! Request queue, in priority order
         std::list<ThreadTaskRequestPtr> requests_;
+        //! Thread pool for pooled tasks
+        ThreadPool* thread_pool_;
+        //! Number of requests queued to the thread pool and not finished
+        uint requests_in_flight_;
+        //! Maximum number of requests in flight, 0 = no limit
+        uint max_parallel_requests_;
+        //! Maximum number of requests in flight plus results waiting in the thread task manager, 0 = no limit
+        uint max_pending_results_;
+        //! Pooled task flag
+        bool pooled_;
         //! Work thread
         Thread thread_;
         //! Final result, available when work finished
@@ -39,6 +39,8 @@ namespace Foundation
         }
         
         task->SetThreadTaskManager(this);
+        if (!task->GetThreadPool() && framework_)
+            task->SetThreadPool(framework_->GetThreadPool().get());
         tasks_.push_back(task);
     }
 
@@ -139,16 +141,56 @@ namespace Foundation
 
     void ThreadTaskManager::SendResultEvents()
     {
-        std::vector<ThreadTaskResultPtr> results = GetResults();
+        SendResultEvents(FrameBudget::Unlimited());
+    }
+
+    bool ThreadTaskManager::SendResultEvents(const FrameBudget &budget)
+    {
+        // Queue the results of finished tasks with the others, delete the finished tasks
+        std::vector<ThreadTaskPtr>::iterator i = tasks_.begin();
+        while (i != tasks_.end())
+        {
+            if ((*i)->HasFinished())
+            {
+                ThreadTaskResultPtr result = (*i)->GetResult();
+                if (result)
+                    QueueResult(result);
+                i = tasks_.erase(i);
+            }
+            else ++i;
+        }
+
         EventManagerPtr event_manager = framework_->GetEventManager();
         event_category_id_t threadtask_category = event_manager->QueryEventCategory("Task");
         
-        std::vector<ThreadTaskResultPtr>::iterator i = results.begin();
-        while (i != results.end())
+        // The results stay in the queue until sent, so that they keep counting against the pending result limits
+        bool all_sent = true;
+        bool sent_any = false;
+        for (;;)
         {
-            event_manager->SendEvent(threadtask_category, Task::Events::REQUEST_COMPLETED, (*i).get());
-            ++i;
+            ThreadTaskResultPtr result;
+            {
+                MutexLock lock(result_mutex_);
+                if (results_.empty())
+                    break;
+                if (sent_any && budget.Expired())
+                {
+                    all_sent = false;
+                    break;
+                }
+                result = results_.front();
+                results_.pop_front();
+            }
+            
+            event_manager->SendEvent(threadtask_category, Task::Events::REQUEST_COMPLETED, result.get());
+            sent_any = true;
         }
+        
+        // Results have been sent, so pooled tasks that were held back may continue
+        for (i = tasks_.begin(); i != tasks_.end(); ++i)
+            (*i)->DispatchRequests();
+        
+        return all_sent;
     }
 
     std::vector<ThreadTaskResultPtr> ThreadTaskManager::GetResults()
@@ -183,6 +225,10 @@ namespace Foundation
             results_.clear();
         }
         
+        // Results have been collected, so pooled tasks that were held back may continue
+        for (i = tasks_.begin(); i != tasks_.end(); ++i)
+            (*i)->DispatchRequests();
+        
         return results;
     }
 
@@ -220,6 +266,11 @@ namespace Foundation
             }
         }
         
+        // Results have been collected, so pooled tasks that were held back may continue
+        for (i = tasks_.begin(); i != tasks_.end(); ++i)
+            if ((*i)->GetTaskDescription() == task_description)
+                (*i)->DispatchRequests();
+        
         return results;
     }
 
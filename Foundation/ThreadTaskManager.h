@@ -4,6 +4,7 @@
 #define incl_Foundation_ThreadTaskManager_h
 
 #include "ThreadTask.h"
+#include "FrameScheduler.h"
 
 namespace Foundation
 {
@@ -75,6 +76,13 @@ namespace Foundation
         /*! Framework calls this for the system-wide ThreadTaskManager on each run of the main loop.
          */
         void SendResultEvents();
+
+        //! Checks for results and sends them as events until the budget expires, but at least one. Deletes finished ThreadTasks.
+        /*! Results not sent are sent first on the next call. Until then they count as pending results of their tasks.
+            \param budget Time to spend
+            \return true if all results were sent
+         */
+        bool SendResultEvents(const FrameBudget &budget);
         
         //! Gets all results. Does not send them as events. Deletes finished ThreadTasks.
         std::vector<ThreadTaskResultPtr> GetResults();
@@ -5,16 +5,27 @@
 
 namespace HttpUtilities
 {
+    //! Maximum amount of requests of one task that are performed in parallel. The requests block a pool thread
+    //! while waiting for the server, so do not let one host occupy the whole thread pool.
+    static const uint MAX_PARALLEL_REQUESTS = 2;
+
     HttpTask::HttpTask() :
-        Foundation::ThreadTask("HttpRequest"),
+        Foundation::ThreadTask("HttpRequest", true),
         continuous_(false)
     {
+        SetMaxParallelRequests(MAX_PARALLEL_REQUESTS);
     }
 
     HttpTask::HttpTask(const std::string& task_description, bool continuous) :
-        Foundation::ThreadTask(task_description),
+        Foundation::ThreadTask(task_description, true),
         continuous_(continuous)
     {
+        SetMaxParallelRequests(MAX_PARALLEL_REQUESTS);
+    }
+    
+    HttpTask::~HttpTask()
+    {
+        Stop();
     }
     
     void HttpTask::SetContinuous(bool enable)
@@ -22,41 +33,33 @@ namespace HttpUtilities
         continuous_ = enable;
     }
 
-    void HttpTask::Work()
+    void HttpTask::ProcessRequest(Foundation::ThreadTaskRequestPtr task_request)
     {
-        while (ShouldRun())
+        boost::shared_ptr<HttpTaskRequest> request = boost::dynamic_pointer_cast<HttpTaskRequest>(task_request);
+        if (!request)
+            return;
+        
+        HttpUtilities::HttpRequest http;
+        http.SetUrl(request->url_);
+        http.SetMethod(request->method_);
+        http.SetTimeout(request->timeout_);
+        if (request->data_.size())
         {
-            WaitForRequests();
-            
-            boost::shared_ptr<HttpTaskRequest> request = GetNextRequest<HttpTaskRequest>();
-            if (request)
-            {
-                HttpUtilities::HttpRequest http;
-                http.SetUrl(request->url_);
-                http.SetMethod(request->method_);
-                http.SetTimeout(request->timeout_);
-                if (request->data_.size())
-                {
-                    http.SetRequestData(request->content_type_, request->data_);
-                }
-                
-                http.Perform();
-                
-                boost::shared_ptr<HttpTaskResult> result(new HttpTaskResult());
-                result->tag_ = request->tag_;
-                result->success_ = http.GetSuccess();
-                result->reason_ = http.GetReason();
-                result->data_ = http.GetResponseData();
-                
-                if (continuous_)
-                    QueueResult<HttpTaskResult>(result);
-                else
-                    SetResult<HttpTaskResult>(result);
-            }
-            
-            if (!continuous_)
-                break;
+            http.SetRequestData(request->content_type_, request->data_);
         }
+        
+        http.Perform();
+        
+        boost::shared_ptr<HttpTaskResult> result(new HttpTaskResult());
+        result->tag_ = request->tag_;
+        result->success_ = http.GetSuccess();
+        result->reason_ = http.GetReason();
+        result->data_ = http.GetResponseData();
+        
+        if (continuous_)
+            QueueResult<HttpTaskResult>(result);
+        else
+            SetResult<HttpTaskResult>(result);
     }
     
 }
\ No newline at end of file
@@ -48,7 +48,7 @@ namespace HttpUtilities
 
     typedef boost::shared_ptr<HttpTaskResult> HttpTaskResultPtr;
 
-    // Performs threaded http request(s)
+    // Performs threaded http request(s). Runs on a thread pool if one has been set, several requests in parallel.
     class HttpTask : public Foundation::ThreadTask
     {
     public:
@@ -61,6 +61,9 @@ namespace HttpUtilities
          */
         HttpTask(const std::string& task_description, bool continuous = false);
         
+        //! Destructor. Waits for the running requests to finish.
+        virtual ~HttpTask();
+        
         //! Sets continuous mode on/off. Default is off (no ThreadTaskManager needed, one-shot request/response)
         /*! \param enable Continuous mode setting
          */
@@ -70,8 +73,8 @@ namespace HttpUtilities
         bool GetContinuous() const { return continuous_; }
 
     protected:
-        //! Work function, performs http request(s)
-        virtual void Work();
+        //! Performs a http request
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr task_request);
 
     private:
         //! Continuous mode flag
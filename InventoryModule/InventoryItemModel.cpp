@@ -639,8 +639,15 @@ void InventoryItemModel::DeleteDummyFolder(const QString &parent_id)
     if (!parentFolder)
         return;
 
-    AbstractInventoryItem *dummyFolder = static_cast<InventoryFolder *>(parentFolder)->GetChildById("DummyItem");
-    if (!dummyFolder)
+    // The dummy item is always the first child, so there's no need to search the whole folder.
+    // OpenSimInventoryDataModel::CreateNewFolderFromFolderSkeleton adds it to the folder before any other child.
+    InventoryFolder *folder = static_cast<InventoryFolder *>(parentFolder);
+#ifdef _DEBUG
+    for(int i = 1; i < folder->ChildCount(); ++i)
+        assert(folder->Child(i)->GetID() != "DummyItem" && "The dummy item must be the first child of the folder");
+#endif
+    AbstractInventoryItem *dummyFolder = folder->Child(0);
+    if (!dummyFolder || dummyFolder->GetID() != "DummyItem")
         return;
 
     QModelIndexList all_items = persistentIndexList();
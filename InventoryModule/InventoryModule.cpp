@@ -208,7 +208,7 @@ bool InventoryModule::HandleEvent(event_category_id_t category_id, event_id_t ev
             case AT_RealXtend:
             {
                 // Create OpenSim inventory model.
-                inventory_ = InventoryPtr(new OpenSimInventoryDataModel(this, auth->inventorySkeleton.get()));
+                inventory_ = InventoryPtr(new OpenSimInventoryDataModel(this, auth->inventorySkeleton));
 
                 // Set world stream used for sending udp packets.
                 static_cast<OpenSimInventoryDataModel *>(inventory_.get())->SetWorldStream(currentWorldStream_);
@@ -876,10 +876,10 @@ void InventoryModule::ConnectSignals()
     QObject::connect(inventory_.get(), SIGNAL(UploadStarted(const QString &)),
         uploadProgressWindow_, SLOT(UploadStarted(const QString &)));
 
-    connect(inventory_.get(), SIGNAL(UploadFailed(const QString &)),
+    connect(inventory_.get(), SIGNAL(UploadFailed(const QString &, const QString &)),
         uploadProgressWindow_, SLOT(UploadProgress(const QString &)));
 
-    connect(inventory_.get(), SIGNAL(UploadCompleted(const QString &)),
+    connect(inventory_.get(), SIGNAL(UploadCompleted(const QString &, const QString &)),
         uploadProgressWindow_, SLOT(UploadProgress(const QString &)));
 
     QObject::connect(inventory_.get(), SIGNAL(MultiUploadCompleted()),
@@ -7,7 +7,10 @@
 #include "DebugOperatorNew.h"
 #include "J2kEncoder.h"
 #include "InventoryModule.h"
-#include <OgreColourValue.h>
+#include "ThreadPool.h"
+
+#include <OgrePixelFormat.h>
+#include <boost/bind.hpp>
 
 #include "openjpeg.h"
 #include "MemoryLeakCheck.h"
@@ -59,8 +62,18 @@ int GetClosestPowerOfTwo(int value)
     return closest;
 }
 
+/// Copies one row of interleaved 8-bit pixels to the component planes of the encoder input.
+static void CopyRow(const u8 *pixels, opj_image_t *image, int width, int num_comps, uint y)
+{
+    const u8 *src = pixels + y * width * num_comps;
+    int offset = y * width;
+    for (int x = 0; x < width; ++x)
+        for (int c = 0; c < num_comps; ++c)
+            image->comps[c].data[offset + x] = *src++;
+}
+
 // Code adapted from LibOpenJpeg (http://www.openjpeg.org/index.php?menu=download), file image_to_j2k.c.
-bool J2kEncode(Ogre::Image &src_image, std::vector<u8> &outbuf, bool reversible)
+bool J2kEncode(Ogre::Image &src_image, std::vector<u8> &outbuf, bool reversible, Foundation::ThreadPool *pool)
 {
     bool success;
     opj_cparameters_t parameters;   // compression parameters
@@ -158,33 +171,17 @@ bool J2kEncode(Ogre::Image &src_image, std::vector<u8> &outbuf, bool reversible)
     image->x1 = width;
     image->y1 = height;
 
-    int i = 0;
-    for (int y = 0; y < height; ++y)
-    {
-        for (int x = 0; x < width; ++x)
-        {
-            Ogre::ColourValue pixel = src_image.getColourAt(x,y,0);
-            for (int c = 0; c < num_comps; ++c)
-            {
-                switch (c)
-                {
-                case 0:
-                    image->comps[c].data[i] = pixel.r * 255.0;
-                    break;
-                case 1:
-                    image->comps[c].data[i] = pixel.g * 255.0;
-                    break;
-                case 2:
-                    image->comps[c].data[i] = pixel.b * 255.0;
-                    break;
-                case 3:
-                    image->comps[c].data[i] = pixel.a * 255.0;
-                    break;
-                }
-            }
-            ++i;
-        }
-    }
+    // Convert to 8-bit RGB(A) in one pass; reading the pixels one colour value at a time is several times slower
+    std::vector<u8> pixels(width * height * num_comps);
+    Ogre::PixelBox converted(width, height, 1, num_comps == 4 ? Ogre::PF_BYTE_RGBA : Ogre::PF_BYTE_RGB, &pixels[0]);
+    Ogre::PixelUtil::bulkPixelConversion(src_image.getPixelBox(), converted);
+
+    boost::function<void(uint)> copy_row = boost::bind(&CopyRow, &pixels[0], image, width, num_comps, _1);
+    if (pool)
+        pool->ParallelFor(0, height, copy_row);
+    else
+        for (int y = 0; y < height; ++y)
+            copy_row(y);
 
     // Encode the destination image.
     opj_cio_t *cio = 0;
@@ -206,7 +203,10 @@ bool J2kEncode(Ogre::Image &src_image, std::vector<u8> &outbuf, bool reversible)
     if (!success)
     {
         opj_cio_close(cio);
+        opj_destroy_compress(cinfo);
         opj_image_destroy(image);
+        if (parameters.cp_comment)
+            free(parameters.cp_comment);
         InventoryModule::LogInfo("Failed to encode image.");
         return false;
     }
@@ -9,6 +9,11 @@
 #include <OgreImage.h>
 #include "CoreTypes.h"
 
+namespace Foundation
+{
+    class ThreadPool;
+}
+
 namespace J2k
 {
     /// J2k error print callback.
@@ -26,11 +31,12 @@ namespace J2k
     /// @return Closest power of two value.
     int GetClosestPowerOfTwo(int value);
 
-    /// J2k encoding function.
+    /// J2k encoding function. Thread-safe, so separate images can be encoded in parallel.
     /// @param src_image
     /// @param outbuf
     /// @param reversible
-    bool J2kEncode(Ogre::Image &src_image, std::vector<u8> &outbuf, bool reversible);
+    /// @param pool If given, the image rows are converted to the encoder input in parallel on the pool.
+    bool J2kEncode(Ogre::Image &src_image, std::vector<u8> &outbuf, bool reversible, Foundation::ThreadPool *pool = 0);
 }
 
 #endif
@@ -12,6 +12,7 @@
 #include "InventoryFolder.h"
 #include "InventoryAsset.h"
 #include "J2kEncoder.h"
+#include "UploadEncodeQueue.h"
 
 #include "Framework.h"
 #include "ModuleManager.h"
@@ -27,6 +28,7 @@
 #include "HttpRequest.h"
 #include "LLSDUtilities.h"
 #include "WorldStream.h"
+#include "ThreadPool.h"
 
 #include <QDir>
 #include <QFile>
@@ -46,12 +48,13 @@ namespace Inventory
 
 OpenSimInventoryDataModel::OpenSimInventoryDataModel(
     InventoryModule *owner,
-    ProtocolUtilities::InventorySkeleton *inventory_skeleton) :
+    ProtocolUtilities::InventoryPtr inventory_skeleton) :
     owner_(owner),
     rootFolder_(0),
+    inventorySkeleton_(inventory_skeleton),
     worldLibraryOwnerId_("")
 {
-    SetupModelData(inventory_skeleton);
+    SetupModelData(inventory_skeleton.get());
 }
 
 OpenSimInventoryDataModel::~OpenSimInventoryDataModel()
@@ -61,12 +64,31 @@ OpenSimInventoryDataModel::~OpenSimInventoryDataModel()
 
 AbstractInventoryItem *OpenSimInventoryDataModel::GetFirstChildFolderByName(const QString &searchName) const
 {
+    // Search the folders received at login from the skeleton, so that the folders not yet created don't need to be.
+    if (inventorySkeleton_)
+    {
+        ProtocolUtilities::InventoryFolderSkeleton *skeleton =
+            inventorySkeleton_->GetFirstChildFolderByName(searchName.toStdString().c_str());
+        if (skeleton)
+        {
+            InventoryFolder *folder = const_cast<OpenSimInventoryDataModel *>(this)->GetOrCreateFolderFromSkeleton(
+                skeleton->id.ToQString());
+            if (folder && folder->GetName() == searchName)
+                return folder;
+        }
+    }
+
+    // The folder has been created or renamed after login.
     return rootFolder_->GetFirstChildFolderByName(searchName);
 }
 
 AbstractInventoryItem *OpenSimInventoryDataModel::GetChildFolderById(const QString &searchId) const
 {
-    return rootFolder_->GetChildFolderById(searchId);
+    AbstractInventoryItem *item = GetIndexedItem(searchId);
+    if (item)
+        return item->GetItemType() == AbstractInventoryItem::Type_Folder ? item : 0;
+
+    return const_cast<OpenSimInventoryDataModel *>(this)->GetOrCreateFolderFromSkeleton(searchId);
 }
 
 AbstractInventoryItem *OpenSimInventoryDataModel::GetChildAssetById(const QString &searchId) const
@@ -76,7 +98,11 @@ AbstractInventoryItem *OpenSimInventoryDataModel::GetChildAssetById(const QStrin
 
 AbstractInventoryItem *OpenSimInventoryDataModel::GetChildById(const QString &searchId) const
 {
-    return rootFolder_->GetChildById(searchId);
+    AbstractInventoryItem *item = GetIndexedItem(searchId);
+    if (item)
+        return item;
+
+    return const_cast<OpenSimInventoryDataModel *>(this)->GetOrCreateFolderFromSkeleton(searchId);
 }
 
 AbstractInventoryItem *OpenSimInventoryDataModel::GetRoot() const
@@ -96,7 +122,7 @@ InventoryFolder *OpenSimInventoryDataModel::GetMyInventoryFolder() const
 
 InventoryFolder *OpenSimInventoryDataModel::GetOpenSimLibraryFolder() const
 {
-    return rootFolder_->GetFirstChildFolderByName("OpenSim Library");
+    return static_cast<InventoryFolder *>(GetChildFolderById(libraryFolderId_));
 }
 
 AbstractInventoryItem *OpenSimInventoryDataModel::GetOrCreateNewFolder(
@@ -110,8 +136,8 @@ AbstractInventoryItem *OpenSimInventoryDataModel::GetOrCreateNewFolder(
         return 0;
 
     // Return an existing folder if one with the given id is present.
-    InventoryFolder *existing = dynamic_cast<InventoryFolder *>(parent->GetChildFolderById(id));
-    if (existing)
+    InventoryFolder *existing = dynamic_cast<InventoryFolder *>(GetChildFolderById(id));
+    if (existing && existing->IsDescendentOf(parent))
         return existing;
 
     // Create a new folder.
@@ -129,6 +155,7 @@ AbstractInventoryItem *OpenSimInventoryDataModel::GetOrCreateNewFolder(
             255, newFolder->GetName().toStdString().c_str());
 
     newFolder->SetDirty(true);
+    IndexItem(newFolder);
     return parent->AddChild(newFolder);
 }
 
@@ -143,8 +170,8 @@ AbstractInventoryItem *OpenSimInventoryDataModel::GetOrCreateNewAsset(
         return 0;
 
     // Return an existing asset if one with the given id is present.
-    InventoryAsset *existing = dynamic_cast<InventoryAsset *>(parent->GetChildAssetById(inventory_id));
-    if (existing)
+    InventoryAsset *existing = dynamic_cast<InventoryAsset *>(GetIndexedItem(inventory_id));
+    if (existing && existing->GetParent() == parent)
         return existing;
 
     // Create a new asset.
@@ -153,6 +180,7 @@ AbstractInventoryItem *OpenSimInventoryDataModel::GetOrCreateNewAsset(
     if (parent->IsDescendentOf(GetOpenSimLibraryFolder()))
         newAsset->SetIsLibraryItem(true);
 
+    IndexItem(newAsset);
     return parent->AddChild(newAsset);
 }
 
@@ -161,6 +189,10 @@ bool OpenSimInventoryDataModel::FetchInventoryDescendents(AbstractInventoryItem
     if (item->GetItemType() != AbstractInventoryItem::Type_Folder)
         return false;
 
+    // Create the child folders received at login before the server sends the rest of the descendents,
+    // so that they are counted as existing ones.
+    CreateChildFoldersFromSkeleton(static_cast<InventoryFolder *>(item));
+
     ///\note    Due to some server-side mystery behaviour we must send the same packet twice: once
     ///         with fetch_folders = true & fetch_items = false and once with fetch_folders = false & fetch_items = true
     ///         in order to reveice the inventory item information correctly (asset&inventory types at least).
@@ -643,6 +675,15 @@ UploadResult OpenSimInventoryDataModel::UploadFile(
         SetUploadCapability(upload_url.toStdString());
     }
 
+    QVector<uchar> buffer;
+    if (!ReadFile(filename, buffer))
+        return upload_result;
+
+    return UploadBuffer(asset_type, filename, name, description, folder_id, buffer);
+}
+
+bool OpenSimInventoryDataModel::ReadFile(std::string filename, QVector<uchar> &buffer)
+{
 #ifdef Q_WS_WIN
     // Remove leading '/' on Windows environment, if it exists.
     if (filename.find('/',0) == 0)
@@ -654,18 +695,17 @@ UploadResult OpenSimInventoryDataModel::UploadFile(
     if (!file.is_open())
     {
         InventoryModule::LogError("Could not open the file: " + filename + ".");
-        return upload_result;
+        return false;
     }
 
-    QVector<uchar> buffer;
     std::filebuf *pbuf = file.rdbuf();
     size_t size = pbuf->pubseekoff(0, std::ios::end, std::ios::in);
     buffer.resize(size);
     pbuf->pubseekpos(0, std::ios::in);
-    pbuf->sgetn((char *)&buffer[0], size);
+    if (size)
+        pbuf->sgetn((char *)&buffer[0], size);
     file.close();
-
-    return UploadBuffer(asset_type, filename, name, description, folder_id, buffer);
+    return true;
 }
 
 UploadResult OpenSimInventoryDataModel::UploadBuffer(
@@ -675,6 +715,30 @@ UploadResult OpenSimInventoryDataModel::UploadBuffer(
     const std::string& description,
     const RexUUID& folder_id,
     const QVector<uchar>& buffer)
+{
+    // Prepare the data on the thread pool, the encoding of a large image spreads over it
+    UploadEncodeQueue queue(owner_->GetFramework()->GetThreadPool());
+    queue.Add(0, asset_type, buffer);
+
+    UploadEncodeQueue::Item item;
+    if (!queue.Next(item) || !item.success)
+    {
+        UploadResult upload_result;
+        upload_result.first = false;
+        upload_result.second = QString("");
+        return upload_result;
+    }
+
+    return UploadData(asset_type, filename, name, description, folder_id, item.data);
+}
+
+UploadResult OpenSimInventoryDataModel::UploadData(
+    const asset_type_t asset_type,
+    const std::string& filename,
+    const std::string& name,
+    const std::string& description,
+    const RexUUID& folder_id,
+    const std::vector<u8>& data)
 {
     UploadResult upload_result;
     upload_result.first = false;
@@ -727,38 +791,8 @@ UploadResult OpenSimInventoryDataModel::UploadBuffer(
     request2.SetUrl(upload_url);
     request2.SetMethod(HttpUtilities::HttpRequest::Post);
 
-    // If the file is texture, use Ogre image and J2k encoding.
-    if (asset_type == RexTypes::RexAT_Texture)
-    {
-        Ogre::Image image;
-        try
-        {
-#include "DisableMemoryLeakCheck.h"
-            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)&buffer[0], buffer.size(), false));
-#include "EnableMemoryLeakCheck.h"
-            image.load(stream);
-        }
-        catch (Ogre::Exception &e)
-        {
-            InventoryModule::LogError("Error loading image: " + std::string(e.what()));
-            return upload_result;
-        }
-
-        std::vector<u8> encoded_buffer;
-        bool success = J2k::J2kEncode(image, encoded_buffer, false);
-        if (!success)
-        {
-            InventoryModule::LogError("Could not J2k encode the image file.");
-            return upload_result;
-        }
-        
-        request2.SetRequestData("application/octet-stream", encoded_buffer);
-    }
-    else
-    {
-        // Other assets can be uploaded as raw data.
-        request2.SetRequestData("application/octet-stream", buffer.toStdVector());
-    }
+    // Textures have already been J2k encoded, other assets are uploaded as raw data.
+    request2.SetRequestData("application/octet-stream", data);
 
     response.clear();
     response_str.clear();
@@ -841,7 +875,7 @@ QString OpenSimInventoryDataModel::CreateNameFromFilename(const QString &filenam
     return name;
 }
 
-void OpenSimInventoryDataModel::CreateNewFolderFromFolderSkeleton(
+InventoryFolder *OpenSimInventoryDataModel::CreateNewFolderFromFolderSkeleton(
     InventoryFolder *parent_folder,
     ProtocolUtilities::InventoryFolderSkeleton *folder_skeleton)
 {
@@ -851,39 +885,113 @@ void OpenSimInventoryDataModel::CreateNewFolderFromFolderSkeleton(
         folder_skeleton->name.c_str(), parent_folder, folder_skeleton->editable);
     //if (!folder_skeleton->HasChildren())
     newFolder->SetDirty(true);
-
-    if (!rootFolder_ && !parent_folder)
-        rootFolder_ = newFolder;
+    IndexItem(newFolder);
 
     if (parent_folder)
     {
         parent_folder->AddChild(newFolder);
         // A small hack: Add dummy item so that the expand/collapse arrows appear for every folder.
         // These dummy items are deleted after the folder has been expanded for the first time.
+        // InventoryItemModel::DeleteDummyFolder expects the dummy to be the first child, so add it before any other.
         InventoryAsset *dummy = new InventoryAsset("DummyItem", "", "Loading...", newFolder);
         newFolder->AddChild(dummy);
 
-        if (newFolder == GetOpenSimLibraryFolder())
+        // Flag Library folders. They have some special behavior.
+        if (parent_folder->IsLibraryItem() || newFolder->GetID() == libraryFolderId_)
             newFolder->SetIsLibraryItem(true);
+    }
 
-        // Flag Library folders. They have some special behavior.
-        if (GetOpenSimLibraryFolder())
-            if (newFolder->IsDescendentOf(GetOpenSimLibraryFolder()))
-                newFolder->SetIsLibraryItem(true);
+    // The child folders are created when this folder is expanded or one of them is looked up.
+    if (folder_skeleton->HasChildren())
+        unexpandedFolders_[newFolder->GetID()] = folder_skeleton;
+
+    return newFolder;
+}
+
+bool OpenSimInventoryDataModel::CreateChildFoldersFromSkeleton(InventoryFolder *folder)
+{
+    using namespace ProtocolUtilities;
+
+    QHash<QString, InventoryFolderSkeleton *>::iterator iter = unexpandedFolders_.find(folder->GetID());
+    if (iter == unexpandedFolders_.end())
+        return false;
+
+    InventoryFolderSkeleton *folder_skeleton = iter.value();
+    unexpandedFolders_.erase(iter);
+
+    for(InventoryFolderSkeleton::FolderIter child = folder_skeleton->children.begin();
+        child != folder_skeleton->children.end(); ++child)
+        CreateNewFolderFromFolderSkeleton(folder, &*child);
+
+    return true;
+}
+
+InventoryFolder *OpenSimInventoryDataModel::GetOrCreateFolderFromSkeleton(const QString &id)
+{
+    using namespace ProtocolUtilities;
+
+    if (!inventorySkeleton_ || !RexUUID::IsValid(id))
+        return 0;
+
+    InventoryFolderSkeleton *folder_skeleton = inventorySkeleton_->GetChildFolderById(QSTR_TO_UUID(id));
+    if (!folder_skeleton)
+        return 0;
+
+    // Find the nearest ancestor that has been created.
+    QList<InventoryFolderSkeleton *> path;
+    InventoryFolder *folder = 0;
+    for(InventoryFolderSkeleton *ancestor = folder_skeleton; ancestor; ancestor = ancestor->parent)
+    {
+        AbstractInventoryItem *item = GetIndexedItem(ancestor->id.ToQString());
+        if (item)
+        {
+            folder = dynamic_cast<InventoryFolder *>(item);
+            break;
+        }
+
+        path.push_front(ancestor);
     }
 
-    InventoryFolderSkeleton::FolderIter iter = folder_skeleton->children.begin();
-    while(iter != folder_skeleton->children.end())
+    // Create the folders on the path down from it. If the child folders of a folder on the path have already been
+    // created, the wanted folder has been deleted or moved since, and isn't created again.
+    foreach(InventoryFolderSkeleton *descendent, path)
     {
-        parent_folder = newFolder;
-        CreateNewFolderFromFolderSkeleton(parent_folder, &*iter);
-        ++iter;
+        if (!folder || !CreateChildFoldersFromSkeleton(folder))
+            return 0;
+
+        folder = dynamic_cast<InventoryFolder *>(GetIndexedItem(descendent->id.ToQString()));
     }
+
+    return folder;
+}
+
+void OpenSimInventoryDataModel::IndexItem(AbstractInventoryItem *item) const
+{
+    itemIndex_[item->GetID()] = item;
+}
+
+AbstractInventoryItem *OpenSimInventoryDataModel::GetIndexedItem(const QString &id) const
+{
+    QHash<QString, QPointer<AbstractInventoryItem> >::iterator iter = itemIndex_.find(id);
+    if (iter == itemIndex_.end())
+        return 0;
+
+    if (!iter.value().isNull())
+        return iter.value();
+
+    // The item has been deleted. When an item is moved, it's recreated in the new folder before the old one is
+    // deleted, so look for another one with the same id.
+    itemIndex_.erase(iter);
+    AbstractInventoryItem *item = rootFolder_ ? rootFolder_->GetChildById(id) : 0;
+    if (item)
+        IndexItem(item);
+
+    return item;
 }
 
 void OpenSimInventoryDataModel::SetupModelData(ProtocolUtilities::InventorySkeleton *inventory_skeleton)
 {
-    if (!inventory_skeleton && !inventory_skeleton->GetRoot())
+    if (!inventory_skeleton || !inventory_skeleton->GetRoot())
     {
         InventoryModule::LogError("Couldn't find inventory root folder skeleton. Can't create OpenSim inventory data model.");
         return;
@@ -891,11 +999,24 @@ void OpenSimInventoryDataModel::SetupModelData(ProtocolUtilities::InventorySkele
 
     worldLibraryOwnerId_ = inventory_skeleton->worldLibraryOwnerId.ToQString();
 
-    CreateNewFolderFromFolderSkeleton(0, inventory_skeleton->GetRoot());
+    ProtocolUtilities::InventoryFolderSkeleton *library = inventory_skeleton->GetFirstChildFolderByName("OpenSim Library");
+    if (library)
+        libraryFolderId_ = library->id.ToQString();
+
+    // Only the top-level folders are created now, the rest when they are first needed.
+    rootFolder_ = CreateNewFolderFromFolderSkeleton(0, inventory_skeleton->GetRoot());
+    CreateChildFoldersFromSkeleton(rootFolder_);
 }
 
 void OpenSimInventoryDataModel::ThreadedUploadFiles(QStringList &filenames, QStringList &item_names)
 {
+    // The images are J2k encoded on the thread pool while the previous ones upload. A few more are kept in
+    // preparation than there are threads, so that the pool stays busy but the raw files do not all sit in memory.
+    Foundation::ThreadPoolPtr pool = owner_->GetFramework()->GetThreadPool();
+    UploadEncodeQueue queue(pool);
+    int max_pending = pool ? pool->GetNumThreads() + 1 : 1;
+    QVector<PendingUpload> uploads;
+
     // Iterate trought every asset.
     int asset_count = 0;
     QStringList::iterator name_it = item_names.begin();
@@ -915,9 +1036,6 @@ void OpenSimInventoryDataModel::ThreadedUploadFiles(QStringList &filenames, QStr
             continue;
         }
 
-        // Create the asset uploading info XML message.
-        std::string it_str = RexTypes::GetInventoryTypeString(asset_type);
-        std::string at_str = RexTypes::GetAssetTypeString(asset_type);
         std::string cat_name = RexTypes::GetCategoryNameForAssetType(asset_type);
         
         ///\todo User-defined name and desc when we got the UI.
@@ -938,19 +1056,33 @@ void OpenSimInventoryDataModel::ThreadedUploadFiles(QStringList &filenames, QStr
             InventoryModule::LogError("Inventory folder for this type of file doesn't exists. File can't be uploaded.");
             continue;
         }
-        
-        UploadResult result = UploadFile(asset_type, filename.toStdString(), name.toStdString(), description, folder_id);
-        if (result.first)
-        {
-            emit UploadCompleted(real_filename, result.second);
-            ++asset_count;
-        }
-        else
+
+        QVector<uchar> buffer;
+        if (!ReadFile(filename.toStdString(), buffer))
         {
-            emit UploadFailed(real_filename, "Network error");
+            emit UploadFailed(real_filename, "Could not read the file");
+            continue;
         }
+
+        PendingUpload upload;
+        upload.path = filename;
+        upload.filename = real_filename;
+        upload.assetType = asset_type;
+        upload.name = name.toStdString();
+        upload.description = description;
+        upload.folderId = folder_id.ToString();
+        uploads.push_back(upload);
+        queue.Add(uploads.size() - 1, asset_type, buffer);
+
+        while(queue.GetNumPending() >= max_pending)
+            if (UploadNextPrepared(queue, uploads, true))
+                ++asset_count;
     }
 
+    while(queue.GetNumPending() > 0)
+        if (UploadNextPrepared(queue, uploads, true))
+            ++asset_count;
+
     emit MultiUploadCompleted();
     InventoryModule::LogInfo("Multiupload:" + ToString(asset_count) + " assets succesfully uploaded.");
 }
@@ -963,6 +1095,10 @@ void OpenSimInventoryDataModel::ThreadedUploadBuffers(QStringList filenames, QVe
         return;
     }
 
+    // The buffers are all in memory already, so all of them can be prepared at once
+    UploadEncodeQueue queue(owner_->GetFramework()->GetThreadPool());
+    QVector<PendingUpload> uploads;
+
     // Iterate trought every asset.
     int asset_count = 0;
     QVector<QVector<uchar> >::iterator it2 = buffers.begin();
@@ -971,6 +1107,9 @@ void OpenSimInventoryDataModel::ThreadedUploadBuffers(QStringList filenames, QVe
     while(it.hasNext())
     {
         QString filename = it.next();
+        const QVector<uchar> &buffer = *it2;
+        ++it2;
+
         asset_type_t asset_type = RexTypes::GetAssetTypeFromFilename(filename.toStdString());
         if (asset_type == RexAT_None)
         {
@@ -978,9 +1117,6 @@ void OpenSimInventoryDataModel::ThreadedUploadBuffers(QStringList filenames, QVe
             continue;
         }
 
-        // Create the asset uploading info XML message.
-        std::string it_str = RexTypes::GetInventoryTypeString(asset_type);
-        std::string at_str = RexTypes::GetAssetTypeString(asset_type);
         std::string cat_name = RexTypes::GetCategoryNameForAssetType(asset_type);
 
         ///\todo User-defined name and desc when we got the UI.
@@ -993,17 +1129,52 @@ void OpenSimInventoryDataModel::ThreadedUploadBuffers(QStringList filenames, QVe
             InventoryModule::LogError("Inventory folder for this type of file doesn't exists. File can't be uploaded.");
             continue;
         }
-        
-        UploadResult result = UploadBuffer(asset_type, filename.toStdString(), name.toStdString(), description, folder_id, *it2);
-        if (result.first)
-            ++asset_count;
 
-        ++it2;
+        PendingUpload upload;
+        upload.path = filename;
+        upload.filename = filename;
+        upload.assetType = asset_type;
+        upload.name = name.toStdString();
+        upload.description = description;
+        upload.folderId = folder_id.ToString();
+        uploads.push_back(upload);
+        queue.Add(uploads.size() - 1, asset_type, buffer);
     }
 
+    while(queue.GetNumPending() > 0)
+        if (UploadNextPrepared(queue, uploads, false))
+            ++asset_count;
+
     InventoryModule::LogInfo("Multiupload:" + ToString(asset_count) + " assets succesfully uploaded.");
 }
 
+bool OpenSimInventoryDataModel::UploadNextPrepared(UploadEncodeQueue &queue, const QVector<PendingUpload> &uploads, bool emit_signals)
+{
+    UploadEncodeQueue::Item item;
+    if (!queue.Next(item))
+        return false;
+
+    const PendingUpload &upload = uploads[item.index];
+    if (!item.success)
+    {
+        if (emit_signals)
+            emit UploadFailed(upload.filename, "Could not encode the file");
+        return false;
+    }
+
+    UploadResult result = UploadData(upload.assetType, upload.path.toStdString(), upload.name, upload.description,
+        RexUUID(upload.folderId), item.data);
+    if (emit_signals)
+    {
+        if (result.first)
+            emit UploadCompleted(upload.filename, result.second);
+        else
+            emit UploadFailed(upload.filename, "Network error");
+    }
+
+    return result.first;
+}
+
 void OpenSimInventoryDataModel::SendNameUuidRequest(InventoryAsset *asset)
 {
     std::vector<RexUUID> names, groups;
@@ -14,8 +14,10 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <QHash>
 #include <QMap>
 #include <QPair>
+#include <QPointer>
 #include <QVector>
 
 class RexUUID;
@@ -25,6 +27,7 @@ namespace ProtocolUtilities
 {
     class InventorySkeleton;
     class InventoryFolderSkeleton;
+    typedef boost::shared_ptr<InventorySkeleton> InventoryPtr;
     class WorldStream;
     typedef boost::shared_ptr<WorldStream> WorldStreamPtr;
 }
@@ -34,6 +37,7 @@ namespace Inventory
     class InventoryModule;
     class InventoryFolder;
     class InventoryAsset;
+    class UploadEncodeQueue;
 
     /// Data model providing the OpenSim inventory model backend functionality.
     class OpenSimInventoryDataModel : public AbstractInventoryDataModel
@@ -43,8 +47,8 @@ namespace Inventory
     public:
         /// Constructor.
         /// @param owner Owner module
-        /// @inventory_skeleton Inventory skeleton pointer.
-        OpenSimInventoryDataModel(InventoryModule *owner, ProtocolUtilities::InventorySkeleton *inventory_skeleton);
+        /// @inventory_skeleton Inventory skeleton pointer. Kept for creating the folders when they're first needed.
+        OpenSimInventoryDataModel(InventoryModule *owner, ProtocolUtilities::InventoryPtr inventory_skeleton);
 
         /// Destructor.
         virtual ~OpenSimInventoryDataModel();
@@ -198,23 +202,91 @@ namespace Inventory
     private:
         Q_DISABLE_COPY(OpenSimInventoryDataModel);
 
-        /// Utility function for creating new folders from the folder skeletons. Used recursively.
+        /// Utility function for creating new folders from the folder skeletons. The child folders are created
+        /// later by CreateChildFoldersFromSkeleton.
         /// @param parent_folder Parent folder.
         /// @param folder_skeleton Folder skeleton for the folder to be created.
-        void CreateNewFolderFromFolderSkeleton(
+        /// @return The new folder.
+        InventoryFolder *CreateNewFolderFromFolderSkeleton(
             InventoryFolder *parent_folder,
             ProtocolUtilities::InventoryFolderSkeleton *folder_skeleton);
 
+        /// Creates the child folders of a folder from its skeleton, if they haven't been created yet.
+        /// @param folder Folder.
+        /// @return True if the child folders were created now.
+        bool CreateChildFoldersFromSkeleton(InventoryFolder *folder);
+
+        /// Returns folder received at login, creating it and its ancestors from the skeleton if needed.
+        /// @param id Folder ID.
+        /// @return Pointer to the folder, or null if the skeleton doesn't have it, or if it has been deleted.
+        InventoryFolder *GetOrCreateFolderFromSkeleton(const QString &id);
+
+        /// Adds item to the ID index.
+        /// @param item Item.
+        void IndexItem(AbstractInventoryItem *item) const;
+
+        /// Returns item from the ID index.
+        /// @param id Item ID.
+        /// @return Pointer to the item, or null if not found.
+        AbstractInventoryItem *GetIndexedItem(const QString &id) const;
+
         /// Creates the tree model data for inventory.
         /// @param inventory_skeleton OpenSim inventory skeleton.
         void SetupModelData(ProtocolUtilities::InventorySkeleton *inventory_skeleton);
 
+        /// Upload waiting for its data to be prepared by the UploadEncodeQueue.
+        struct PendingUpload
+        {
+            /// Filename.
+            QString path;
+            /// Filename without the path, used in the upload signals.
+            QString filename;
+            /// Asset type.
+            asset_type_t assetType;
+            /// Item name.
+            std::string name;
+            /// Item description.
+            std::string description;
+            /// Id of the destination folder.
+            std::string folderId;
+        };
+
         /// Used by UploadFiles.
         void ThreadedUploadFiles(QStringList &filenames, QStringList &item_names);
 
         /// Used by UploadBuffers.
         void ThreadedUploadBuffers(QStringList filenames, QVector<QVector<uchar> > buffers);
 
+        /// Waits for the next upload to be prepared by the encode queue, and uploads it.
+        /// @param queue Encode queue.
+        /// @param uploads Uploads by the indices given to the queue.
+        /// @param emit_signals Whether to emit UploadCompleted and UploadFailed.
+        /// @return True if the upload succeeded.
+        bool UploadNextPrepared(UploadEncodeQueue &queue, const QVector<PendingUpload> &uploads, bool emit_signals);
+
+        /** Uploads already prepared (J2k encoded, for textures) data using HTTP.
+            @param asset_type_t Asset type.
+            @param filename Filename.
+            @param name User-defined name.
+            @param description User-defined description.
+            @param folder_id Id of the destination folder for this item.
+            @param data Data to upload.
+            @return UploadResult (bool and QString asset ref)
+         */
+        UploadResult UploadData(
+            const asset_type_t asset_type,
+            const std::string &filename,
+            const std::string &name,
+            const std::string &description,
+            const RexUUID &folder_id,
+            const std::vector<u8> &data);
+
+        /// Reads a whole file.
+        /// @param filename Filename.
+        /// @param buffer [out] File data.
+        /// @return True if the file could be read.
+        bool ReadFile(std::string filename, QVector<uchar> &buffer);
+
         /// Creates NewFileAgentInventory XML message.
         std::string CreateNewFileAgentInventoryXML(
             const std::string &asset_type,
@@ -232,6 +304,18 @@ namespace Inventory
         /// The root folder.
         InventoryFolder *rootFolder_;
 
+        /// Inventory skeleton received at login.
+        ProtocolUtilities::InventoryPtr inventorySkeleton_;
+
+        /// Folders whose child folders haven't been created from their skeletons yet, by ID.
+        QHash<QString, ProtocolUtilities::InventoryFolderSkeleton *> unexpandedFolders_;
+
+        /// Items by ID. Deleted items become null and are dropped when looked up.
+        mutable QHash<QString, QPointer<AbstractInventoryItem> > itemIndex_;
+
+        /// ID of the OpenSim Library folder.
+        QString libraryFolderId_;
+
         /// World Library owner id.
         QString worldLibraryOwnerId_;
 
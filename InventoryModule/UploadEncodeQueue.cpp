@@ -0,0 +1,109 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   UploadEncodeQueue.cpp
+ *  @brief  Prepares the data of inventory uploads on the framework thread pool.
+ */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "UploadEncodeQueue.h"
+#include "InventoryModule.h"
+#include "J2kEncoder.h"
+#include "ThreadPool.h"
+
+#include <OgreImage.h>
+#include <OgreException.h>
+
+#include <boost/bind.hpp>
+
+#include "MemoryLeakCheck.h"
+
+namespace Inventory
+{
+
+UploadEncodeQueue::UploadEncodeQueue(const Foundation::ThreadPoolPtr &pool) :
+    pool_(pool), pending_(0)
+{
+}
+
+UploadEncodeQueue::~UploadEncodeQueue()
+{
+    // The preparations refer to this object, so wait for them
+    Item item;
+    while(Next(item))
+        ;
+}
+
+void UploadEncodeQueue::Add(int index, asset_type_t asset_type, const QVector<uchar> &buffer)
+{
+    ++pending_;
+    if (!pool_ || !pool_->Submit(boost::bind(&UploadEncodeQueue::Prepare, this, index, asset_type, buffer),
+        Foundation::ThreadPool::PriorityLow))
+    {
+        // No pool, prepare on the calling thread
+        Prepare(index, asset_type, buffer);
+    }
+}
+
+bool UploadEncodeQueue::Next(Item &item)
+{
+    if (pending_ <= 0)
+        return false;
+
+    boost::unique_lock<Mutex> lock(mutex_);
+    while(finished_.empty())
+        condition_.wait(lock);
+
+    item.index = finished_.front().index;
+    item.success = finished_.front().success;
+    item.data.swap(finished_.front().data);
+    finished_.pop_front();
+    --pending_;
+    return true;
+}
+
+void UploadEncodeQueue::Prepare(int index, asset_type_t asset_type, QVector<uchar> buffer)
+{
+    Item item;
+    item.index = index;
+    item.success = false;
+
+    if (buffer.empty())
+        InventoryModule::LogError("Zero size upload data.");
+    else if (asset_type == RexTypes::RexAT_Texture)
+    {
+        Ogre::Image image;
+        try
+        {
+#include "DisableMemoryLeakCheck.h"
+            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)&buffer[0], buffer.size(), false));
+#include "EnableMemoryLeakCheck.h"
+            image.load(stream);
+
+            // Large images also spread their pixel conversion over the pool
+            item.success = J2k::J2kEncode(image, item.data, false, pool_.get());
+            if (!item.success)
+                InventoryModule::LogError("Could not J2k encode the image file.");
+        }
+        catch (Ogre::Exception &e)
+        {
+            InventoryModule::LogError("Error loading image: " + std::string(e.what()));
+        }
+    }
+    else
+    {
+        // Other assets can be uploaded as raw data.
+        item.data.assign(buffer.begin(), buffer.end());
+        item.success = true;
+    }
+
+    MutexLock lock(mutex_);
+    finished_.push_back(Item());
+    finished_.back().index = item.index;
+    finished_.back().success = item.success;
+    finished_.back().data.swap(item.data);
+    condition_.notify_one();
+}
+
+}
@@ -0,0 +1,86 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   UploadEncodeQueue.h
+ *  @brief  Prepares the data of inventory uploads on the framework thread pool.
+ */
+
+#ifndef incl_InventoryModule_UploadEncodeQueue_h
+#define incl_InventoryModule_UploadEncodeQueue_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+#include "ForwardDefines.h"
+#include "RexTypes.h"
+
+#include <QVector>
+
+#include <deque>
+#include <vector>
+
+namespace Inventory
+{
+    /// Prepares the data of inventory uploads on the framework thread pool, and hands it back in the order the
+    /// preparations finish. Images are loaded and J2k encoded, other assets are passed on as is.
+    /// The queue is fed and drained from one upload thread, which must not be a thread pool worker.
+    class UploadEncodeQueue
+    {
+    public:
+        /// Prepared upload.
+        struct Item
+        {
+            /// Index given to Add().
+            int index;
+
+            /// Whether the preparation succeeded.
+            bool success;
+
+            /// Data to upload.
+            std::vector<u8> data;
+        };
+
+        /// Constructor.
+        /// @param pool Thread pool to prepare the uploads on.
+        explicit UploadEncodeQueue(const Foundation::ThreadPoolPtr &pool);
+
+        /// Destructor. Waits for the preparations still running.
+        ~UploadEncodeQueue();
+
+        /// Queues an upload for preparation.
+        /// @param index Index to identify the upload with.
+        /// @param asset_type Asset type.
+        /// @param buffer Raw file data.
+        void Add(int index, asset_type_t asset_type, const QVector<uchar> &buffer);
+
+        /// Waits for the next upload to finish its preparation.
+        /// @param item [out] Prepared upload.
+        /// @return False if there are no uploads left.
+        bool Next(Item &item);
+
+        /// @return Number of uploads added and not yet returned by Next().
+        int GetNumPending() const { return pending_; }
+
+    private:
+        Q_DISABLE_COPY(UploadEncodeQueue);
+
+        /// Prepares an upload. Runs on the thread pool.
+        void Prepare(int index, asset_type_t asset_type, QVector<uchar> buffer);
+
+        /// Thread pool.
+        Foundation::ThreadPoolPtr pool_;
+
+        /// Mutex for the finished uploads.
+        Mutex mutex_;
+
+        /// Signaled when an upload has finished its preparation.
+        Condition condition_;
+
+        /// Finished uploads, guarded by mutex_.
+        std::deque<Item> finished_;
+
+        /// Number of uploads added and not yet returned by Next(). Only touched by the upload thread.
+        int pending_;
+    };
+}
+
+#endif
@@ -30,7 +30,7 @@ namespace Inventory
 {
 
 UploadProgressWindow::UploadProgressWindow(InventoryModule *owner, QWidget *parent) :
-    QWidget(parent), owner_(owner), mainWidget_(0), layout_(0), uploadCount_(0)
+    QWidget(parent), owner_(owner), mainWidget_(0), layout_(0), uploadCount_(0), finishedCount_(0)
 {
     QUiLoader loader;
     QFile file("./data/ui/uploadprogress.ui");
@@ -71,7 +71,7 @@ void UploadProgressWindow::OpenUploadProgress(size_t file_count)
         return;
 
     progressBar_->setRange(0, file_count);
-    progressBar_->setValue(uploadCount_);
+    progressBar_->setValue(finishedCount_);
     proxyWidget_->show();
     ui_module->GetInworldSceneController()->BringProxyToFront(proxyWidget_);
 #endif
@@ -82,9 +82,17 @@ void UploadProgressWindow::UploadStarted(const QString &filename)
     ++uploadCount_;
     int max_value = progressBar_->maximum();
     if (uploadCount_ <= max_value)
+        labelFileNumber_->setText(QString("%1 (%2/%3)").arg(filename).arg(finishedCount_).arg(max_value));
+}
+
+void UploadProgressWindow::UploadProgress(const QString &filename)
+{
+    ++finishedCount_;
+    int max_value = progressBar_->maximum();
+    if (finishedCount_ <= max_value)
     {
-        progressBar_->setValue(uploadCount_);
-        labelFileNumber_->setText(QString("%1 (%2/%3)").arg(filename).arg(uploadCount_).arg(max_value));
+        progressBar_->setValue(finishedCount_);
+        labelFileNumber_->setText(QString("%1 (%2/%3)").arg(filename).arg(finishedCount_).arg(max_value));
     }
 }
 
@@ -92,6 +100,7 @@ void UploadProgressWindow::CloseUploadProgress()
 {
     progressBar_->reset();
     uploadCount_ = 0;
+    finishedCount_ = 0;
     proxyWidget_->hide();
 }
 
@@ -43,6 +43,11 @@ namespace Inventory
         ///
         void UploadStarted(const QString &filename);
 
+        /// Advances the progress bar when an upload has finished, successfully or not.
+        /// Uploads finish in the order their data is ready, not in the order they were started.
+        /// @param filename Filename.
+        void UploadProgress(const QString &filename);
+
         ///
         void CloseUploadProgress();
 
@@ -67,6 +72,9 @@ namespace Inventory
 
         /// Upload count.
         size_t uploadCount_;
+
+        /// Finished upload count.
+        size_t finishedCount_;
     };
 }
 
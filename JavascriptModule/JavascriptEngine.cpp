@@ -4,34 +4,46 @@
 #include "DebugOperatorNew.h"
 #include "JavascriptEngine.h"
 #include "JavascriptModule.h"
-#include "ScriptMetaTypeDefines.h"
-#include "NaaliCoreTypeDefines.h"
 
 #include <QFile>
-#include <QUiLoader>
+#include <QScriptEngine>
 
 #include "MemoryLeakCheck.h"
 
-JavascriptEngine::JavascriptEngine(const QString &scriptRef):
+JavascriptEngine::JavascriptEngine(const QString &scriptRef, const JavascriptEnginePoolPtr &pool, bool shareable):
+    pool_(pool),
     engine_(0),
     scriptRef_(scriptRef)
 {
-    engine_ = new QScriptEngine;
+    // An instance without a script never runs anything, so it does not need an engine
+    if (scriptRef_.isEmpty())
+        return;
 
-    ExposeQtMetaTypes(engine_);
-    ExposeNaaliCoreTypes(engine_);
-    ExposeCoreApiMetaTypes(engine_);
+    engine_ = pool_->Acquire(shareable);
+    if (pool_->IsShared(engine_))
+    {
+        // Variables and functions of the script go to a global object of its own, which sees the shared globals
+        global_ = engine_->newObject();
+        global_.setPrototype(engine_->globalObject());
+    }
+    else
+        global_ = engine_->globalObject();
 }
 
 JavascriptEngine::~JavascriptEngine()
 {
+    if (!engine_)
+        return;
+
     // As a convention, we call a function 'OnScriptDestroyed' for each JS script
     // so that they can clean up their data before the script is removed from the object,
     // or when the system is unloading.
-    QScriptValue destructor = engine_->globalObject().property("OnScriptDestroyed");
-    if (!destructor.isUndefined())
-        destructor.call();
-    SAFE_DELETE(engine_);
+    QScriptValue destructor = global_.property("OnScriptDestroyed");
+    if (destructor.isFunction())
+        destructor.call(global_);
+    global_ = QScriptValue();
+    pool_->Release(engine_);
+    engine_ = 0;
 }
 
 void JavascriptEngine::Reload()
@@ -44,30 +56,74 @@ void JavascriptEngine::Unload()
 
 void JavascriptEngine::Run()
 {
-    QString program = LoadScript();
-    //Before we begin to run the script check for syntax errors.
-    QScriptSyntaxCheckResult syntaxResult = engine_->checkSyntax(program);
-    if(syntaxResult.state() != QScriptSyntaxCheckResult::Valid)
+    if (!engine_)
+        return;
+
+    QString source = LoadScript();
+    // Syntax is checked once per distinct script source
+    JavascriptProgramPtr program = pool_->GetProgram(source, scriptRef_);
+    if (!program->valid_)
     {
-        JavascriptModule::LogError("Syntax error in " + scriptRef_.toStdString() + syntaxResult.errorMessage().toStdString()
-            + " In line:" + QString::number(syntaxResult.errorLineNumber()).toStdString());
+        JavascriptModule::LogError("Syntax error in " + scriptRef_.toStdString() + program->error_.toStdString()
+            + " In line:" + QString::number(program->errorLine_).toStdString());
         return;
     }
 
-    QScriptValue result = engine_->evaluate(program, scriptRef_);
+    bool shared = pool_->IsShared(engine_);
+    if (shared)
+    {
+        QScriptContext *context = engine_->pushContext();
+        context->setActivationObject(global_);
+        context->setThisObject(global_);
+    }
+
+#if QT_VERSION >= 0x040700
+    QScriptValue result = engine_->evaluate(program->program_);
+#else
+    QScriptValue result = engine_->evaluate(program->source_, scriptRef_);
+#endif
     if (engine_->hasUncaughtException())
         JavascriptModule::LogError(result.toString().toStdString());
+
+    if (shared)
+        engine_->popContext();
 }
 
 void JavascriptEngine::Stop()
 {
-    engine_->abortEvaluation();
+    if (engine_)
+        engine_->abortEvaluation();
 }
 
 void JavascriptEngine::RegisterService(QObject *serviceObject, const QString &name)
 {
+    if (!engine_)
+        return;
+
     QScriptValue scriptValue = engine_->newQObject(serviceObject);
-    engine_->globalObject().setProperty(name, scriptValue);
+    global_.setProperty(name, scriptValue);
+}
+
+void JavascriptEngine::RegisterServiceLazily(QObject *serviceObject, const QString &name)
+{
+    if (!engine_)
+        return;
+
+    QScriptValue getter = engine_->newFunction(GetLazyService, serviceObject);
+    global_.setProperty(name, getter, QScriptValue::PropertyGetter);
+}
+
+QScriptValue JavascriptEngine::GetLazyService(QScriptContext *context, QScriptEngine *engine, void *serviceObject)
+{
+    // The script object is kept in the getter, so it is created only once
+    QScriptValue getter = context->callee();
+    QScriptValue service = getter.data();
+    if (!service.isValid())
+    {
+        service = engine->newQObject(static_cast<QObject*>(serviceObject));
+        getter.setData(service);
+    }
+    return service;
 }
 
 QString JavascriptEngine::LoadScript() const
@@ -9,13 +9,21 @@
 #define incl_JavascriptModule_JavascriptEngine_h
 
 #include "IScriptInstance.h"
+#include "JavascriptEnginePool.h"
+
+#include <QScriptValue>
 
 class QScriptEngine;
 
 class JavascriptEngine: public IScriptInstance
 {
 public:
-    explicit JavascriptEngine(const QString &scriptRef);
+    //! Constructor
+    /*! \param scriptRef Script file, empty for an instance that does nothing
+        \param pool Pool to take the script engine from
+        \param shareable Whether the script may share its engine with other scripts, see JavascriptEnginePool
+     */
+    JavascriptEngine(const QString &scriptRef, const JavascriptEnginePoolPtr &pool, bool shareable);
     ~JavascriptEngine();
 
     //! Overload from IScriptInstance
@@ -33,13 +41,22 @@ public:
     //! Register new service to java script engine.
     void RegisterService(QObject *serviceObject, const QString &name);
 
+    //! Register new service to java script engine. The script object is created when the script first uses the service.
+    void RegisterServiceLazily(QObject *serviceObject, const QString &name);
+
     //void SetPrototype(QScriptable *prototype, );
 
 private:
     QString LoadScript() const;
 
+    //! Returns the script object of a lazily registered service, creating it on first use
+    static QScriptValue GetLazyService(QScriptContext *context, QScriptEngine *engine, void *serviceObject);
+
+    JavascriptEnginePoolPtr pool_;
     QScriptEngine *engine_;
+    //! Global object of this script: the global object of the engine, or a scope of its own if the engine is shared
+    QScriptValue global_;
     QString scriptRef_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,123 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "JavascriptEnginePool.h"
+#include "ScriptMetaTypeDefines.h"
+#include "NaaliCoreTypeDefines.h"
+
+#include <QCryptographicHash>
+#include <QScriptEngine>
+
+#include "MemoryLeakCheck.h"
+
+JavascriptEnginePool::JavascriptEnginePool(bool shareEngines, int scriptsPerEngine, int preparedEngines) :
+    shareEngines_(shareEngines),
+    scriptsPerEngine_(scriptsPerEngine > 0 ? scriptsPerEngine : 1),
+    preparedEngines_(preparedEngines > 0 ? preparedEngines : 0),
+    openEngine_(0)
+{
+}
+
+JavascriptEnginePool::~JavascriptEnginePool()
+{
+    assert(shared_.empty());
+    while(!prepared_.isEmpty())
+        delete prepared_.takeFirst();
+}
+
+QScriptEngine *JavascriptEnginePool::Acquire(bool shareable)
+{
+    if (shareable && shareEngines_)
+    {
+        if (!openEngine_)
+        {
+            openEngine_ = prepared_.isEmpty() ? CreateEngine() : prepared_.takeFirst();
+            shared_[openEngine_] = 0;
+        }
+
+        QScriptEngine *engine = openEngine_;
+        if (++shared_[engine] >= scriptsPerEngine_)
+            openEngine_ = 0;
+        return engine;
+    }
+
+    if (!prepared_.isEmpty())
+        return prepared_.takeFirst();
+    return CreateEngine();
+}
+
+void JavascriptEnginePool::Release(QScriptEngine *engine)
+{
+    QMap<QScriptEngine*, int>::iterator iter = shared_.find(engine);
+    if (iter != shared_.end())
+    {
+        // Keep a shared engine as long as any of its instances is alive
+        if (--iter.value() > 0)
+            return;
+        shared_.erase(iter);
+        if (openEngine_ == engine)
+            openEngine_ = 0;
+    }
+
+    // Engines are not reused, deleting the engine is the only way to drop the signal connections of its scripts
+    delete engine;
+}
+
+bool JavascriptEnginePool::IsShared(QScriptEngine *engine) const
+{
+    return shared_.contains(engine);
+}
+
+void JavascriptEnginePool::Prepare()
+{
+    if (prepared_.size() < preparedEngines_)
+        prepared_.append(CreateEngine());
+}
+
+JavascriptProgramPtr JavascriptEnginePool::GetProgram(const QString &source, const QString &fileName)
+{
+    QByteArray key = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Md5);
+    QHash<QByteArray, JavascriptProgramPtr>::const_iterator iter = programs_.find(key);
+    if (iter != programs_.end())
+        return iter.value();
+
+    if (programs_.size() >= cMaxCachedPrograms)
+        ClearPrograms();
+
+    JavascriptProgramPtr program(new JavascriptProgram());
+    program->source_ = source;
+    program->fileName_ = fileName;
+    QScriptSyntaxCheckResult syntaxResult = QScriptEngine::checkSyntax(source);
+    program->valid_ = (syntaxResult.state() == QScriptSyntaxCheckResult::Valid);
+    program->error_ = syntaxResult.errorMessage();
+    program->errorLine_ = syntaxResult.errorLineNumber();
+#if QT_VERSION >= 0x040700
+    if (program->valid_)
+        program->program_ = QScriptProgram(source, fileName);
+#endif
+
+    programs_.insert(key, program);
+    return program;
+}
+
+void JavascriptEnginePool::ClearPrograms()
+{
+    QHash<QByteArray, JavascriptProgramPtr>::iterator iter = programs_.begin();
+    while(iter != programs_.end())
+    {
+        if (iter.value().unique())
+            iter = programs_.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+QScriptEngine *JavascriptEnginePool::CreateEngine() const
+{
+    QScriptEngine *engine = new QScriptEngine;
+    ExposeQtMetaTypes(engine);
+    ExposeNaaliCoreTypes(engine);
+    ExposeCoreApiMetaTypes(engine);
+    return engine;
+}
@@ -0,0 +1,129 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   JavascriptEnginePool.h
+ *  @brief  Hands out prepared script engines and caches parsed scripts.
+ */
+
+#ifndef incl_JavascriptModule_JavascriptEnginePool_h
+#define incl_JavascriptModule_JavascriptEnginePool_h
+
+#include <boost/shared_ptr.hpp>
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QtGlobal>
+
+#if QT_VERSION >= 0x040700
+#include <QScriptProgram>
+#endif
+
+class QScriptEngine;
+
+//! A script checked for syntax errors and, with Qt 4.7 or newer, compiled. Shared by all instances of the same source.
+struct JavascriptProgram
+{
+    //! Script source
+    QString source_;
+
+    //! File name used in error messages
+    QString fileName_;
+
+    //! Whether the script has no syntax errors
+    bool valid_;
+
+    //! Syntax error message, if not valid
+    QString error_;
+
+    //! Line of the syntax error, if not valid
+    int errorLine_;
+
+#if QT_VERSION >= 0x040700
+    //! Compiled program
+    QScriptProgram program_;
+#endif
+};
+
+typedef boost::shared_ptr<JavascriptProgram> JavascriptProgramPtr;
+
+//! Hands out script engines that have the Qt and Naali core types already exposed, and caches parsed scripts.
+/*! Exposing the types to an engine is the bulk of the cost of creating one, so the pool keeps a few engines prepared
+    ahead of time, see Prepare().
+
+    Engines are not shared by default: a script instance gets an engine of its own, which is destroyed with the
+    instance, so that the signal connections made by the script go away with it. With sharing enabled, up to
+    scriptsPerEngine shareable instances run in one engine, each with a global object of its own. The engine
+    is destroyed once the last of its instances is released; until then the signal handlers of released instances
+    stay connected, so shared scripts must disconnect their handlers in OnScriptDestroyed.
+ */
+class JavascriptEnginePool
+{
+public:
+    //! Constructor
+    /*! \param shareEngines Whether shareable instances share engines
+        \param scriptsPerEngine Maximum amount of instances sharing one engine
+        \param preparedEngines Amount of engines to keep prepared for unshared instances
+     */
+    JavascriptEnginePool(bool shareEngines, int scriptsPerEngine, int preparedEngines);
+
+    //! Destructor. All engines must have been released.
+    ~JavascriptEnginePool();
+
+    //! Returns an engine for a script instance, release it with Release()
+    /*! \param shareable Whether the instance may share the engine with other instances
+     */
+    QScriptEngine *Acquire(bool shareable);
+
+    //! Releases an engine returned by Acquire()
+    void Release(QScriptEngine *engine);
+
+    //! Returns whether an engine is shared by several instances, ie. whether instances need global objects of their own
+    bool IsShared(QScriptEngine *engine) const;
+
+    //! Prepares one engine, if fewer than the wanted amount are prepared. Call when there is time to spare, f.ex. once per frame.
+    void Prepare();
+
+    //! Returns the script with the given source, checked and compiled once per distinct source
+    /*! \param source Script source
+        \param fileName File name used in error messages
+     */
+    JavascriptProgramPtr GetProgram(const QString &source, const QString &fileName);
+
+    //! Drops cached scripts that are not in use
+    void ClearPrograms();
+
+private:
+    //! Creates an engine and exposes the Qt and Naali core types to it
+    QScriptEngine *CreateEngine() const;
+
+    //! Maximum amount of cached scripts before the ones not in use are dropped
+    static const int cMaxCachedPrograms = 256;
+
+    //! Whether shareable instances share engines
+    bool shareEngines_;
+
+    //! Maximum amount of instances sharing one engine
+    int scriptsPerEngine_;
+
+    //! Amount of engines to keep prepared
+    int preparedEngines_;
+
+    //! Prepared engines not handed out yet
+    QList<QScriptEngine*> prepared_;
+
+    //! Amount of instances using each shared engine
+    QMap<QScriptEngine*, int> shared_;
+
+    //! Shared engine new shareable instances go to, 0 if none has room
+    QScriptEngine *openEngine_;
+
+    //! Cached scripts by the MD5 hash of their source
+    QHash<QByteArray, JavascriptProgramPtr> programs_;
+};
+
+typedef boost::shared_ptr<JavascriptEnginePool> JavascriptEnginePoolPtr;
+
+#endif
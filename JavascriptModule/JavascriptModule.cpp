@@ -21,6 +21,7 @@
 #include "Console.h"
 #include "ConsoleCommandServiceInterface.h"
 #include "NaaliCoreTypeDefines.h"
+#include "ConfigurationManager.h"
 
 #include <QtScript>
 
@@ -60,6 +61,13 @@ void JavascriptModule::Initialize()
     assert(!javascriptModuleInstance_);
     javascriptModuleInstance_ = this;
 
+    // Sharing engines saves memory and startup time in scenes with many scripts, but the scripts must then disconnect
+    // their signal handlers in OnScriptDestroyed, see JavascriptEnginePool
+    bool shareEngines = framework_->GetDefaultConfig().DeclareSetting("Javascript", "share_engines", false);
+    int scriptsPerEngine = framework_->GetDefaultConfig().DeclareSetting("Javascript", "scripts_per_shared_engine", 64);
+    int preparedEngines = framework_->GetDefaultConfig().DeclareSetting("Javascript", "prepared_engines", 2);
+    enginePool_ = JavascriptEnginePoolPtr(new JavascriptEnginePool(shareEngines, scriptsPerEngine, preparedEngines));
+
     // Register ourselves as javascript scripting service.
     boost::shared_ptr<JavascriptModule> jsmodule = framework_->GetModuleManager()->GetModule<JavascriptModule>().lock();
     boost::weak_ptr<ScriptServiceInterface> service = boost::dynamic_pointer_cast<ScriptServiceInterface>(jsmodule);
@@ -105,10 +113,17 @@ void JavascriptModule::PostInitialize()
 void JavascriptModule::Uninitialize()
 {
     UnloadStartupScripts();
+    // Script instances still alive keep the pool until they are deleted
+    enginePool_.reset();
 }
 
 void JavascriptModule::Update(f64 frametime)
 {
+    {
+        PROFILE(JavascriptModule_PrepareEngines);
+        enginePool_->Prepare();
+    }
+
     RESETPROFILER;
 }
 
@@ -138,6 +153,7 @@ Console::CommandResult JavascriptModule::ConsoleRunFile(const StringVector &para
 
 Console::CommandResult JavascriptModule::ConsoleReloadScripts(const StringVector &params)
 {
+    enginePool_->ClearPrograms();
     LoadStartupScripts();
 
     return Console::ResultSuccess();
@@ -189,7 +205,7 @@ void JavascriptModule::ScriptChanged(const QString &scriptRef)
         // If script ref is empty or otherwise invalid we need to destroy the previous script if it's type is javascript.
         if(dynamic_cast<JavascriptEngine*>(sender->GetScriptInstance()))
         {
-            JavascriptEngine *javaScriptInstance = new JavascriptEngine("");
+            JavascriptEngine *javaScriptInstance = new JavascriptEngine("", enginePool_, true);
             sender->SetScriptInstance(javaScriptInstance);
         }
         return;
@@ -198,7 +214,7 @@ void JavascriptModule::ScriptChanged(const QString &scriptRef)
     if (sender->type.Get() != "js")
         return;
     
-    JavascriptEngine *javaScriptInstance = new JavascriptEngine(scriptRef);
+    JavascriptEngine *javaScriptInstance = new JavascriptEngine(scriptRef, enginePool_, true);
     sender->SetScriptInstance(javaScriptInstance);
 
     //Register all services to script engine
@@ -255,7 +271,7 @@ void JavascriptModule::LoadStartupScripts()
     // Create a scriptengine for each of the files, and try to run
     for (uint i = 0; i < scripts.size(); ++i)
     {
-        JavascriptEngine* javaScriptInstance = new JavascriptEngine(QString::fromStdString(scripts[i]));
+        JavascriptEngine* javaScriptInstance = new JavascriptEngine(QString::fromStdString(scripts[i]), enginePool_, false);
         
         //Register all services to script engine
         PrepareScriptEngine(javaScriptInstance);
@@ -277,9 +293,10 @@ void JavascriptModule::UnloadStartupScripts()
 
 void JavascriptModule::PrepareScriptEngine(JavascriptEngine* engine)
 {
+    // Most scripts use only a few of the services, so their script objects are created on first use
     ServiceMap::iterator iter = services_.begin();
     for(; iter != services_.end(); iter++)
-        engine->RegisterService(iter.value(), iter.key());
+        engine->RegisterServiceLazily(iter.value(), iter.key());
 }
 
 QScriptValue Print(QScriptContext *context, QScriptEngine *engine)
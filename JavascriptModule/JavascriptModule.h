@@ -12,6 +12,7 @@
 #include "ModuleLoggingFunctions.h"
 #include "AttributeChangeType.h"
 #include "ScriptServiceInterface.h"
+#include "JavascriptEnginePool.h"
 
 #include <QObject>
 
@@ -93,7 +94,7 @@ private:
     //! Stop & delete startup scripts
     void UnloadStartupScripts();
     
-    //! Prepare a script engine by registering all needed services to it
+    //! Prepare a script engine by registering all needed services to it, to be bound on first use
     void PrepareScriptEngine(JavascriptEngine* engine);
     
     /// Type name of the module.
@@ -106,6 +107,9 @@ private:
     
     /// Engines for executing startup (possibly persistent) scripts
     std::vector<JavascriptEngine*> startupScripts_;
+
+    /// Script engines and parsed scripts for the script instances
+    JavascriptEnginePoolPtr enginePool_;
 };
 
 //api stuff
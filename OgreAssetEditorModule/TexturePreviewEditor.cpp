@@ -130,7 +130,10 @@ void TexturePreviewEditor::HandleResouceReady(Resource::Events::ResourceReady *r
         Foundation::TextureInterface *tex = dynamic_cast<Foundation::TextureInterface *>(res->resource_.get());
         if(tex)
         {
-            QImage img = ConvertToQImage(tex->GetData(), tex->GetWidth(), tex->GetHeight(), tex->GetComponents());
+            QImage img;
+            std::vector<u8> pixels;
+            if (tex->GetPixels(pixels))
+                img = ConvertToQImage(&pixels[0], tex->GetWidth(), tex->GetHeight(), tex->GetComponents());
             // Only show chessboard patern if image has an alfa channel.
             if(tex->GetComponents() == 4 || tex->GetComponents() == 2) 
             {
@@ -12,6 +12,7 @@
 #include "OgreMeshResource.h"
 #include "OgreMaterialResource.h"
 #include "OgreSkeletonResource.h"
+#include "StaticBatcher.h"
 #include <Ogre.h>
 #include <OgreTagPoint.h>
 
@@ -561,6 +562,10 @@ bool EC_Mesh::SetMaterial(uint index, const std::string& material_name)
         return false;
     }
     
+    StaticBatcherPtr batcher = GetStaticBatcher();
+    if (batcher)
+        batcher->InvalidateEntity(entity_);
+    
     return true;
 }
 
@@ -720,6 +725,10 @@ void EC_Mesh::DetachEntity()
     if ((!attached_) || (!entity_) || (!placeable_))
         return;
         
+    StaticBatcherPtr batcher = GetStaticBatcher();
+    if (batcher)
+        batcher->RemoveEntity(entity_);
+    
     EC_Placeable* placeable = checked_static_cast<EC_Placeable*>(placeable_.get());
     Ogre::SceneNode* node = placeable->GetSceneNode();
     adjustment_node_->detachObject(entity_);
@@ -737,10 +746,22 @@ void EC_Mesh::AttachEntity()
     Ogre::SceneNode* node = placeable->GetSceneNode();
     node->addChild(adjustment_node_);
     adjustment_node_->attachObject(entity_);
+    
+    StaticBatcherPtr batcher = GetStaticBatcher();
+    if (batcher)
+        batcher->AddEntity(entity_);
             
     attached_ = true;
 }
 
+StaticBatcherPtr EC_Mesh::GetStaticBatcher() const
+{
+    RendererPtr renderer = renderer_.lock();
+    if (!renderer)
+        return StaticBatcherPtr();
+    return renderer->GetStaticBatcher();
+}
+
 Ogre::Mesh* EC_Mesh::PrepareMesh(const std::string& mesh_name, bool clone)
 {
     if (renderer_.expired())
@@ -809,7 +830,12 @@ void EC_Mesh::AttributeUpdated(IAttribute *attribute)
     if (attribute == &drawDistance)
     {
         if(entity_)
+        {
             entity_->setRenderingDistance(drawDistance.Get());
+            StaticBatcherPtr batcher = GetStaticBatcher();
+            if (batcher)
+                batcher->InvalidateEntity(entity_);
+        }
     }
     else if (attribute == &castShadows)
     {
@@ -817,6 +843,9 @@ void EC_Mesh::AttributeUpdated(IAttribute *attribute)
         {
             if (entity_)
                 entity_->setCastShadows(castShadows.Get());
+            StaticBatcherPtr batcher = GetStaticBatcher();
+            if (batcher)
+                batcher->InvalidateEntity(entity_);
             //! \todo might want to disable shadows for some attachments
             for (uint i = 0; i < attachment_entities_.size(); ++i)
             {
@@ -381,6 +381,9 @@ private:
     
     //! detaches entity from placeable
     void DetachEntity();
+
+    //! returns the static batcher of the renderer, null if static batching is disabled
+    OgreRenderer::StaticBatcherPtr GetStaticBatcher() const;
     
     bool HandleResourceEvent(event_id_t event_id, IEventData* data);
     bool HandleMeshResourceEvent(event_id_t event_id, IEventData* data);
@@ -6,6 +6,7 @@
 #include "Entity.h"
 #include "EC_Placeable.h"
 #include "EC_OgreCustomObject.h"
+#include "StaticBatcher.h"
 
 #include <Ogre.h>
 
@@ -16,6 +17,7 @@ EC_OgreCustomObject::EC_OgreCustomObject(IModule* module) :
     renderer_(checked_static_cast<OgreRenderingModule*>(module)->GetRenderer()),
     entity_(0),
     attached_(false),
+    shared_mesh_(false),
     cast_shadows_(false),
     draw_distance_(0.0f)
 {
@@ -68,34 +70,84 @@ bool EC_OgreCustomObject::CommitChanges(Ogre::ManualObject* object)
     if (!object->getNumSections())
         return true;
         
+    std::string mesh_name = renderer->GetUniqueObjectName();
     try
     {
-        std::string mesh_name = renderer->GetUniqueObjectName();
         object->convertToMesh(mesh_name);
         object->clear();
+    }   
+    catch (Ogre::Exception& e)
+    {
+        OgreRenderingModule::LogError("Could not convert manualobject to mesh: " + std::string(e.what()));
+        return false;
+    }
+    
+    shared_mesh_ = false;
+    return CreateEntity(mesh_name);
+}
+
+bool EC_OgreCustomObject::CommitChanges(const Ogre::MeshPtr& mesh, const std::vector<std::string>& materials)
+{
+    if (renderer_.expired())
+        return false;
+    
+    DestroyEntity();
+    
+    // If placeable is not set yet, set it manually by searching it from the parent entity
+    if (!placeable_)
+    {
+        Scene::Entity* entity = GetParentEntity();
+        if (entity)
+        {
+            ComponentPtr placeable = entity->GetComponent(EC_Placeable::TypeNameStatic());
+            if (placeable)
+                placeable_ = placeable;
+        }
+    }
+    
+    if (mesh.isNull())
+        return true;
+    
+    shared_mesh_ = true;
+    if (!CreateEntity(mesh->getName()))
+        return false;
+    
+    for (uint i = 0; i < materials.size() && i < entity_->getNumSubEntities(); ++i)
+        SetMaterial(i, materials[i]);
+    
+    return true;
+}
+
+bool EC_OgreCustomObject::CreateEntity(const std::string& mesh_name)
+{
+    RendererPtr renderer = renderer_.lock();
+    if (!renderer)
+        return false;
     
+    try
+    {
         Ogre::SceneManager* scene_mgr = renderer->GetSceneManager();
 
         entity_ = scene_mgr->createEntity(renderer->GetUniqueObjectName(), mesh_name);
         if (entity_)
         {
-            AttachEntity();
             entity_->setRenderingDistance(draw_distance_);
             entity_->setCastShadows(cast_shadows_);
             entity_->setUserAny(Ogre::Any(GetParentEntity()));
             // Set UserAny also on subentities
             for (uint i = 0; i < entity_->getNumSubEntities(); ++i)
                 entity_->getSubEntity(i)->setUserAny(entity_->getUserAny());
+            AttachEntity();
         }
         else
         {
-            OgreRenderingModule::LogError("Could not create entity from manualobject mesh");
+            OgreRenderingModule::LogError("Could not create entity from mesh " + mesh_name);
             return false;
         }
     }   
     catch (Ogre::Exception& e)
     {
-        OgreRenderingModule::LogError("Could not convert manualobject to mesh: " + std::string(e.what()));
+        OgreRenderingModule::LogError("Could not create entity from mesh " + mesh_name + ": " + std::string(e.what()));
         return false;
     }
     
@@ -106,14 +158,24 @@ void EC_OgreCustomObject::SetDrawDistance(float draw_distance)
 {
     draw_distance_ = draw_distance;
     if (entity_)
+    {
         entity_->setRenderingDistance(draw_distance);
+        StaticBatcherPtr batcher = GetStaticBatcher();
+        if (batcher)
+            batcher->InvalidateEntity(entity_);
+    }
 }
 
 void EC_OgreCustomObject::SetCastShadows(bool enabled)
 {
     cast_shadows_ = enabled;
     if (entity_)
+    {
         entity_->setCastShadows(enabled);
+        StaticBatcherPtr batcher = GetStaticBatcher();
+        if (batcher)
+            batcher->InvalidateEntity(entity_);
+    }
 }
 
 bool EC_OgreCustomObject::SetMaterial(uint index, const std::string& material_name)
@@ -137,6 +199,10 @@ bool EC_OgreCustomObject::SetMaterial(uint index, const std::string& material_na
         return false;
     }
     
+    StaticBatcherPtr batcher = GetStaticBatcher();
+    if (batcher)
+        batcher->InvalidateEntity(entity_);
+    
     return true;
 }
 
@@ -169,6 +235,10 @@ void EC_OgreCustomObject::AttachEntity()
         Ogre::SceneNode* node = placeable->GetSceneNode();
         node->attachObject(entity_);
         attached_ = true;
+        
+        StaticBatcherPtr batcher = GetStaticBatcher();
+        if (batcher)
+            batcher->AddEntity(entity_);
     }
 }
 
@@ -176,6 +246,10 @@ void EC_OgreCustomObject::DetachEntity()
 {
     if ((placeable_) && (attached_) && (entity_))
     {
+        StaticBatcherPtr batcher = GetStaticBatcher();
+        if (batcher)
+            batcher->RemoveEntity(entity_);
+        
         EC_Placeable* placeable = checked_static_cast<EC_Placeable*>(placeable_.get());
         Ogre::SceneNode* node = placeable->GetSceneNode();
         node->detachObject(entity_);
@@ -183,6 +257,14 @@ void EC_OgreCustomObject::DetachEntity()
     }
 }
 
+StaticBatcherPtr EC_OgreCustomObject::GetStaticBatcher() const
+{
+    RendererPtr renderer = renderer_.lock();
+    if (!renderer)
+        return StaticBatcherPtr();
+    return renderer->GetStaticBatcher();
+}
+
 void EC_OgreCustomObject::DestroyEntity()
 {
     if (renderer_.expired())
@@ -197,11 +279,15 @@ void EC_OgreCustomObject::DestroyEntity()
         std::string mesh_name = entity_->getMesh()->getName();
         scene_mgr->destroyEntity(entity_);
         entity_ = 0;
-        try
+        // A shared mesh is removed by its owner
+        if (!shared_mesh_)
         {
-            Ogre::MeshManager::getSingleton().remove(mesh_name);
+            try
+            {
+                Ogre::MeshManager::getSingleton().remove(mesh_name);
+            }
+            catch (...) {}
         }
-        catch (...) {}
     }
 }
 
@@ -10,6 +10,13 @@
 
 #include "Vector3D.h"
 
+#include <vector>
+
+namespace Ogre
+{
+    class MeshPtr;
+}
+
 //! Ogre custom object component
 /**
 <table class="header">
@@ -75,6 +82,15 @@ public:
      */
     bool CommitChanges(Ogre::ManualObject* object);
 
+    //! Commit a mesh shared with other objects
+    /*! makes an entity out of the mesh & sets the materials on its subentities. The mesh is not removed with the entity,
+        its owner removes it once no entity uses it.
+        \param mesh Mesh, or null for no geometry
+        \param materials Material of each submesh
+        \return true if successful
+     */
+    bool CommitChanges(const Ogre::MeshPtr& mesh, const std::vector<std::string>& materials);
+
     //! Sets material on already committed geometry, similar to EC_Mesh
     /*! \param index submesh index
         \param material_name material name
@@ -110,9 +126,17 @@ private:
     
     //! detaches entity from placeable
     void DetachEntity();
+
+    //! returns the static batcher of the renderer, null if static batching is disabled
+    OgreRenderer::StaticBatcherPtr GetStaticBatcher() const;
     
     //! removes old entity and mesh
     void DestroyEntity();
+
+    //! creates entity from a mesh & attaches it to placeable
+    /*! \return true if successful
+     */
+    bool CreateEntity(const std::string& mesh_name);
     
     //! placeable component 
     ComponentPtr placeable_;
@@ -125,6 +149,9 @@ private:
     
     //! object attached to placeable -flag
     bool attached_;
+
+    //! mesh of the entity is shared with other objects -flag
+    bool shared_mesh_;
     
     //! whether should cast shadows
     bool cast_shadows_;
@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QImage>
+#include <QRect>
 
 #include <utility>
 
@@ -192,6 +193,37 @@ void NaaliRenderWindow::UpdateOverlayImage(const QImage &src)
     texture->getBuffer()->blitFromMemory(bufbox);
 }
 
+void NaaliRenderWindow::UpdateOverlayImage(const QImage &src, const QRect &rect)
+{
+    PROFILE(NaaliRenderWindow_UpdateOverlayImageRect);
+
+    Ogre::TextureManager &mgr = Ogre::TextureManager::getSingleton();
+    Ogre::TexturePtr texture = mgr.getByName(rttTextureName);
+    assert(texture.get());
+    Ogre::HardwarePixelBufferSharedPtr buffer = texture->getBuffer();
+
+    // The overlay is scaled to the image on a full update, a part of it can only be copied if the sizes match.
+    if ((int)buffer->getWidth() != src.width() || (int)buffer->getHeight() != src.height())
+    {
+        UpdateOverlayImage(src);
+        return;
+    }
+
+    QRect area = rect & src.rect();
+    if (area.isEmpty())
+        return;
+
+    // Describe the rectangle as an image of its own that starts at its top-left pixel, but steps the rows of the
+    // whole source image, so that no render system needs to interpret the offset of the source box.
+    const int bytesPerPixel = 4;
+    Ogre::PixelBox bufbox(area.width(), area.height(), 1, Ogre::PF_A8R8G8B8,
+        (void *)(src.bits() + area.top() * src.bytesPerLine() + area.left() * bytesPerPixel));
+    bufbox.rowPitch = src.bytesPerLine() / bytesPerPixel;
+    bufbox.slicePitch = bufbox.rowPitch * area.height();
+
+    buffer->blitFromMemory(bufbox, Ogre::Box(area.left(), area.top(), area.right() + 1, area.bottom() + 1));
+}
+
 void NaaliRenderWindow::ShowOverlay(bool visible)
 {
     if (overlayContainer)
@@ -15,6 +15,7 @@ class OverlayElement;
 }
 
 class QImage;
+class QRect;
 
 /// NaaliRenderWindow stores the main Ogre::RenderWindow that is created by the Renderer.
 class OGRE_MODULE_API NaaliRenderWindow : public QObject
@@ -38,6 +39,10 @@ public:
     /// Fully repaints the Ogre 2D Overlay from the given source image.
     void UpdateOverlayImage(const QImage &src);
 
+    /// Repaints a rectangle of the Ogre 2D Overlay from the same rectangle of the given source image.
+    /// Repaints the whole overlay if the image and the overlay are not the same size.
+    void UpdateOverlayImage(const QImage &src, const QRect &rect);
+
     /// Shows or hides whether the 2D Ogre Overlay is visible or not.
     void ShowOverlay(bool visible);
 
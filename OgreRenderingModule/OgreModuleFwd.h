@@ -23,6 +23,9 @@ namespace Ogre
     class RaySceneQuery;
     class Viewport;
     class RenderTexture;
+    class Material;
+    class MovableObject;
+    class Vector3;
 }
 
 namespace OgreRenderer
@@ -41,11 +44,13 @@ namespace OgreRenderer
     class StereoController;
     class CompositionHandler;
     class GaussianListener;
+    class StaticBatcher;
 
     typedef boost::shared_ptr<Ogre::Root> OgreRootPtr;
     typedef boost::shared_ptr<LogListener> OgreLogListenerPtr;
     typedef boost::shared_ptr<ResourceHandler> ResourceHandlerPtr;
     typedef boost::shared_ptr<RenderableListener> RenderableListenerPtr;
+    typedef boost::shared_ptr<StaticBatcher> StaticBatcherPtr;
 }
 
 class EC_Placeable;
@@ -118,13 +118,39 @@ namespace OgreRenderer
             }
         }
 
+        // Block compressed textures come with their own mipmaps, as the hardware can not generate them
+        bool compressed = Ogre::PixelUtil::isCompressed(pixel_format);
+        uint width = source->GetWidth();
+        uint height = source->GetHeight();
+        uint mipmaps = source->GetNumMipmaps();
+        const u8* data = source->GetData();
+        if (compressed)
+        {
+            if (!Ogre::Root::getSingleton().getRenderSystem()->getCapabilities()->hasCapability(Ogre::RSC_TEXTURE_COMPRESSION_DXT))
+            {
+                OgreRenderingModule::LogError("Texture " + id_ + " is block compressed, but the render system does not support compressed textures");
+                return false;
+            }
+
+            // For the highest level texture, skip the full size mipmap in low quality mode
+            if ((!source->GetLevel()) && (texturequality_ == Texture_Low) && (mipmaps))
+            {
+                data += Ogre::PixelUtil::getMemorySize(width, height, 1, pixel_format);
+                width = std::max(width / 2, 1u);
+                height = std::max(height / 2, 1u);
+                --mipmaps;
+            }
+        }
+        int num_mipmaps = compressed ? (int)mipmaps : Ogre::MIP_DEFAULT;
+        int usage = compressed ? Ogre::TU_STATIC_WRITE_ONLY : Ogre::TU_DEFAULT;
+
         try
         {
             if (ogre_texture_.isNull())
             {   
                 ogre_texture_ = Ogre::TextureManager::getSingleton().createManual(
                     id_, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D,
-                    source->GetWidth(), source->GetHeight(), Ogre::MIP_DEFAULT, pixel_format, Ogre::TU_DEFAULT); 
+                    width, height, num_mipmaps, pixel_format, usage); 
 
                 if (ogre_texture_.isNull())
                 {
@@ -135,20 +161,36 @@ namespace OgreRenderer
             else
             {
                 // See if size/format changed, have to delete/recreate internal resources
-                if ((source->GetWidth() != ogre_texture_->getWidth()) ||
-                    (source->GetHeight() != ogre_texture_->getHeight()) ||
-                    (pixel_format != ogre_texture_->getFormat()))
+                if ((width != ogre_texture_->getWidth()) ||
+                    (height != ogre_texture_->getHeight()) ||
+                    (pixel_format != ogre_texture_->getFormat()) ||
+                    ((compressed) && (mipmaps != ogre_texture_->getNumMipmaps())))
                 {
                     ogre_texture_->freeInternalResources();
-                    ogre_texture_->setWidth(source->GetWidth());
-                    ogre_texture_->setHeight(source->GetHeight());
+                    ogre_texture_->setWidth(width);
+                    ogre_texture_->setHeight(height);
                     ogre_texture_->setFormat(pixel_format);
+                    ogre_texture_->setNumMipmaps(compressed ? mipmaps : Ogre::TextureManager::getSingleton().getDefaultNumMipmaps());
+                    ogre_texture_->setUsage(usage);
                     ogre_texture_->createInternalResources();
                 }
             }
 
+            if (compressed)
+            {
+                // Upload each mipmap level, they follow each other in the data
+                for (uint i = 0; i <= mipmaps; ++i)
+                {
+                    Ogre::PixelBox pixel_box(width, height, 1, pixel_format, (void*)data);
+                    if (!ogre_texture_->getBuffer(0, i).isNull())
+                        ogre_texture_->getBuffer(0, i)->blitFromMemory(pixel_box);
+                    data += Ogre::PixelUtil::getMemorySize(width, height, 1, pixel_format);
+                    width = std::max(width / 2, 1u);
+                    height = std::max(height / 2, 1u);
+                }
+            }
             // For the highest level texture, reduce size in low quality mode
-            if ((!source->GetLevel()) && (texturequality_ == Texture_Low))
+            else if ((!source->GetLevel()) && (texturequality_ == Texture_Low))
             {
                 Ogre::Image tempImage;
                 Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)source->GetData(), source->GetDataSize(), false));
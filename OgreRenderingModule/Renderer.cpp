@@ -6,6 +6,7 @@
 #include "Renderer.h"
 #include "RendererEvents.h"
 #include "ResourceHandler.h"
+#include "StaticBatcher.h"
 #include "OgreRenderingModule.h"
 #include "OgreConversionUtils.h"
 #include "EC_Placeable.h"
@@ -59,6 +60,12 @@ using namespace Foundation;
 
 namespace OgreRenderer
 {
+    //! Largest amount of changed UI rectangles repainted and uploaded separately, more are merged to their bounding rectangle
+    static const int MAX_UI_DIRTY_RECTS = 16;
+
+    //! Share of their bounding rectangle the changed UI rectangles may cover before they are merged to it
+    static const float UI_DIRTY_RECT_MERGE_COVERAGE = 0.75f;
+
     //! Ogre renderable listener to find out visible objects for each frame
     class RenderableListener : public Ogre::RenderQueue::RenderableListener
     {
@@ -159,6 +166,8 @@ namespace OgreRenderer
     {
         RemoveLogListener();
 
+        static_batcher_.reset();
+
         if ((scenemanager_) && (scenemanager_->getRenderQueue()))
             scenemanager_->getRenderQueue()->setRenderableListener(0);
 
@@ -298,6 +307,11 @@ namespace OgreRenderer
         OgreRenderingModule::LogDebug("Initializing resources, may take a while...");
         SetupResources();
         SetupScene();
+
+        // Draw repeated entities that stay put as static geometry, see StaticBatcher
+        if (framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batching", false))
+            static_batcher_ = StaticBatcherPtr(new StaticBatcher(this, framework_));
+
         initialized_ = true;
     }
 
@@ -309,6 +323,8 @@ namespace OgreRenderer
     void Renderer::PostInitialize()
     {
         resource_handler_->PostInitialize();
+        if (static_batcher_)
+            static_batcher_->PostInitialize();
     }
 
     void Renderer::SetFullScreen(bool value)
@@ -462,6 +478,9 @@ namespace OgreRenderer
     void Renderer::Update(f64 frametime)
     {
         Ogre::WindowEventUtilities::messagePump();
+
+        if (resource_handler_)
+            resource_handler_->UpdateTexturePriorities(frametime);
     }
     
     void Renderer::SetCurrentCamera(Ogre::Camera* camera)
@@ -503,6 +522,57 @@ namespace OgreRenderer
         renderWindow->UpdateOverlayImage(*backBuffer);
     }
 
+    void Renderer::DoDirtyUIRedraw(const QRegion &dirty)
+    {
+        PROFILE(Renderer_Render_QtDirtyBlit);
+
+        NaaliGraphicsView *view = framework_->Ui()->GraphicsView();
+
+        QImage *backBuffer = view->BackBuffer();
+        if (!backBuffer)
+            return;
+
+        QRegion region = dirty & QRegion(backBuffer->rect());
+        if (region.isEmpty())
+            return;
+
+        // Repaint the bounding rectangle instead of the separate rectangles when they are many, or cover most of
+        // it anyway, as each rectangle costs a Qt render pass and a texture upload of its own.
+        QRect bounds = region.boundingRect();
+        QVector<QRect> rects = region.rects();
+        int area = 0;
+        for(int i = 0; i < rects.size(); ++i)
+            area += rects[i].width() * rects[i].height();
+        if (rects.size() > MAX_UI_DIRTY_RECTS || area > bounds.width() * bounds.height() * UI_DIRTY_RECT_MERGE_COVERAGE)
+        {
+            rects.clear();
+            rects.push_back(bounds);
+        }
+
+        if (bounds == backBuffer->rect())
+        {
+            DoFullUIRedraw();
+            return;
+        }
+
+        {
+            PROFILE(QPainter_Render);
+
+            // Paint the changed parts of the ui view into buffer
+            QPainter painter(backBuffer);
+            for(int i = 0; i < rects.size(); ++i)
+            {
+                painter.setCompositionMode(QPainter::CompositionMode_Source);
+                painter.fillRect(rects[i], Qt::transparent);
+                painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+                view->viewport()->render(&painter, rects[i].topLeft(), QRegion(rects[i]), QWidget::DrawChildren);
+            }
+        }
+
+        for(int i = 0; i < rects.size(); ++i)
+            renderWindow->UpdateOverlayImage(*backBuffer, rects[i]);
+    }
+
     void Renderer::Render()
     {
         using namespace std;
@@ -660,11 +730,11 @@ namespace OgreRenderer
                 }
             }
         }
-#else // Not using the subrectangle blit - just do a full UI blit.
-        if (view->IsViewDirty())
-        {
+#else // Not using the D3D9 subrectangle blit - repaint and upload the changed rectangles.
+        if (resized_dirty_ > 0)
             DoFullUIRedraw();
-        }
+        else if (view->IsViewDirty())
+            DoDirtyUIRedraw(view->DirtyRegion());
 #endif
 
         if (resized_dirty_ > 0)
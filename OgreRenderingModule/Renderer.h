@@ -14,6 +14,7 @@
 #include <QVariant>
 #include <QTime>
 #include <QRect>
+#include <QRegion>
 #include <QPixmap>
 #include <QImage>
 
@@ -44,11 +45,13 @@ namespace OgreRenderer
     class StereoController;
     class CompositionHandler;
     class GaussianListener;
+    class StaticBatcher;
 
     typedef boost::shared_ptr<Ogre::Root> OgreRootPtr;
     typedef boost::shared_ptr<LogListener> OgreLogListenerPtr;
     typedef boost::shared_ptr<ResourceHandler> ResourceHandlerPtr;
     typedef boost::shared_ptr<RenderableListener> RenderableListenerPtr;
+    typedef boost::shared_ptr<StaticBatcher> StaticBatcherPtr;
 
     //! Ogre renderer
     /*! Created by OgreRenderingModule. Implements the RenderServiceInterface.
@@ -186,6 +189,9 @@ namespace OgreRenderer
         //! Returns resource handler
         ResourceHandlerPtr GetResourceHandler() const { return resource_handler_; }
 
+        //! Returns static batcher, null if static batching is disabled
+        StaticBatcherPtr GetStaticBatcher() const { return static_batcher_; }
+
         //! Removes log listener
         void RemoveLogListener();
 
@@ -249,6 +255,11 @@ namespace OgreRenderer
         //! Performs a full UI repaint with Qt and re-fills the GPU surface accordingly.
         void DoFullUIRedraw();
 
+        //! Repaints the changed parts of the UI with Qt and uploads only them to the GPU surface.
+        /*! \param dirty Changed area of the UI view. Nothing is repainted or uploaded if empty.
+         */
+        void DoDirtyUIRedraw(const QRegion &dirty);
+
     private:
         
         //! Initialises the events related info for this module
@@ -303,6 +314,9 @@ namespace OgreRenderer
         //! Resource handler
         ResourceHandlerPtr resource_handler_;
 
+        //! Static batcher, null if static batching is disabled
+        StaticBatcherPtr static_batcher_;
+
         //! Renderer event category
         event_category_id_t renderercategory_id_;
 
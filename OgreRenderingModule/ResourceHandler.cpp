@@ -18,11 +18,37 @@
 #include "Framework.h"
 #include "EventManager.h"
 #include "ServiceManager.h"
+#include "FrameScheduler.h"
+
+#include <Ogre.h>
+#include <boost/bind.hpp>
 
 
 namespace OgreRenderer
 {
+    //! Interval of texture priority updates in seconds
+    static const f64 TEXTURE_PRIORITY_INTERVAL = 0.25;
+
+    //! Priority multiplier of textures on objects outside the view
+    static const f32 OFFSCREEN_TEXTURE_PRIORITY_FACTOR = 0.1f;
+
+    //! Priority of textures not found on any object, for example sky and UI textures
+    static const f32 UNSEEN_TEXTURE_PRIORITY = 1.0f;
+
+    //! Time a texture decoded enough for the size it is drawn at keeps downloading further levels, in seconds
+    static const f64 REDUCED_TEXTURE_TIMEOUT = 30.0;
+
+    //! Largest on-screen size a texture priority is based on
+    static const f32 MAX_TEXTURE_SCREEN_SIZE = 4096.0f;
+
+    //! Name of the frame stage textures are uploaded in
+    static const std::string RESOURCE_FINALIZATION_STAGE = "ResourceFinalization";
+
+    //! Default share of the frame for uploading textures
+    static const f64 RESOURCE_FINALIZATION_SHARE = 0.1;
+
     ResourceHandler::ResourceHandler(Renderer* renderer, Foundation::Framework* framework) :
+        texture_priority_timer_(0.0),
         renderer_(renderer),
         framework_(framework)
     {
@@ -36,6 +62,10 @@ namespace OgreRenderer
 
     ResourceHandler::~ResourceHandler()
     {
+        Foundation::FrameSchedulerPtr scheduler = framework_->GetFrameScheduler();
+        if (scheduler)
+            scheduler->RemoveStage(RESOURCE_FINALIZATION_STAGE);
+
         // Check for still outstanding resource references
         std::map<std::string, Foundation::ResourceReferenceVector>::iterator i = outstanding_references_.begin();
         while (i != outstanding_references_.end())
@@ -56,6 +86,9 @@ namespace OgreRenderer
         EventManagerPtr event_manager = framework_->GetEventManager();
         
         resource_event_category_ = event_manager->QueryEventCategory("Resource");
+
+        framework_->GetFrameScheduler()->AddStage(RESOURCE_FINALIZATION_STAGE, RESOURCE_FINALIZATION_SHARE,
+            boost::bind(&ResourceHandler::FinalizeResources, this, _1, _2));
     }
     
     Foundation::ResourcePtr ResourceHandler::GetResource(const std::string& id, const std::string& type)
@@ -179,7 +212,11 @@ namespace OgreRenderer
                     Resource::Events::ResourceCanceled canceled_event_data(event_data->asset_id_, tags[i]);
                     framework_->GetEventManager()->SendEvent(resource_event_category_, Resource::Events::RESOURCE_CANCELED, &canceled_event_data);
                 }
-                request_tags_.erase(event_data->asset_id_);
+                RemovePendingTexture(event_data->asset_id_);
+
+                // A texture left at a reduced level is requested again if it is drawn larger
+                if (IsReducedTextureEnough(event_data->asset_id_, 0))
+                    reduced_textures_.insert(event_data->asset_id_);
                 
                 // Check if the asset matches outstanding resource references
                 std::map<std::string, Foundation::ResourceReferenceVector>::iterator i = outstanding_references_.begin();
@@ -216,9 +253,9 @@ namespace OgreRenderer
                 if (event_data->resource_->GetType() == "Texture")
                 {
                     // Check that the request tag matches our request, so we do not (possibly) update unnecessarily many times
-                    // because of others' requests
+                    // because of others' requests. The upload to Ogre happens in FinalizeResources()
                     if (expected_request_tags_.find(event_data->tag_) != expected_request_tags_.end())
-                        UpdateTexture(event_data->resource_, event_data->tag_);
+                        QueueTextureUpdate(event_data->resource_, event_data->tag_);
                 }
             }
         }
@@ -226,6 +263,54 @@ namespace OgreRenderer
         return false;
     }
 
+    void ResourceHandler::QueueTextureUpdate(Foundation::ResourcePtr source, request_tag_t tag)
+    {
+        Foundation::TexturePtr source_tex = boost::shared_dynamic_cast<Foundation::TextureInterface>(source);
+        if (!source_tex)
+            return;
+
+        std::map<std::string, std::pair<Foundation::ResourcePtr, request_tag_t> >::iterator i = pending_texture_updates_.find(source_tex->GetId());
+        if (i == pending_texture_updates_.end())
+        {
+            pending_texture_updates_[source_tex->GetId()] = std::make_pair(source, tag);
+            pending_texture_update_order_.push_back(source_tex->GetId());
+            return;
+        }
+
+        // Already waiting for upload: keep the finer of the two levels, on a tie the newer one
+        Foundation::TexturePtr queued_tex = boost::shared_static_cast<Foundation::TextureInterface>(i->second.first);
+        if (source_tex->GetLevel() > queued_tex->GetLevel())
+            return;
+
+        // The replaced update will not be uploaded, so erase its tag here if it was the last level of its request
+        if ((queued_tex->GetLevel() == 0) && (i->second.second != tag))
+            expected_request_tags_.erase(i->second.second);
+        i->second = std::make_pair(source, tag);
+    }
+
+    bool ResourceHandler::FinalizeResources(f64 frametime, const Foundation::FrameBudget& budget)
+    {
+        PROFILE(ResourceHandler_FinalizeResources);
+
+        bool updated_any = false;
+        while (!pending_texture_update_order_.empty())
+        {
+            if (updated_any && budget.Expired())
+                return false;
+
+            std::string id = pending_texture_update_order_.front();
+            pending_texture_update_order_.pop_front();
+            std::map<std::string, std::pair<Foundation::ResourcePtr, request_tag_t> >::iterator i = pending_texture_updates_.find(id);
+            if (i == pending_texture_updates_.end())
+                continue;
+            std::pair<Foundation::ResourcePtr, request_tag_t> update = i->second;
+            pending_texture_updates_.erase(i);
+            UpdateTexture(update.first, update.second);
+            updated_any = true;
+        }
+        return true;
+    }
+
     request_tag_t ResourceHandler::RequestTexture(const std::string& id)
     {
         request_tag_t tag = framework_->GetEventManager()->GetNextRequestTag();
@@ -291,6 +376,7 @@ namespace OgreRenderer
                 if (source_tag)
                 {
                     expected_request_tags_.insert(source_tag);
+                    pending_textures_.insert(id);
                     request_tags_[id].push_back(tag); 
                     return tag;
                 }
@@ -322,9 +408,13 @@ namespace OgreRenderer
         if (source_tex->GetLevel() == 0)
             expected_request_tags_.erase(tag);
 
+        // A reduced texture requested again starts over from a coarse level, keep the finer one until passed
+        OgreTextureResource* tex_res = checked_static_cast<OgreTextureResource*>(tex.get());
+        bool coarser = (tex_res->GetLevel() >= 0) && (source_tex->GetLevel() > tex_res->GetLevel());
+
         // If success, send Ogre resource ready event
         bool success = false;
-        if (checked_static_cast<OgreTextureResource*>(tex.get())->SetData(source_tex))
+        if ((!coarser) && (tex_res->SetData(source_tex)))
         {
             resources_[source_tex->GetId()] = tex;
             
@@ -343,10 +433,212 @@ namespace OgreRenderer
 
         // If highest level, erase also request tags 
         if (source_tex->GetLevel() == 0)
-            request_tags_.erase(source_tex->GetId());
+            RemovePendingTexture(source_tex->GetId());
 
         return success;
-    }    
+    }
+
+    void ResourceHandler::UpdateTexturePriorities(f64 frametime)
+    {
+        texture_priority_timer_ += frametime;
+        if (texture_priority_timer_ < TEXTURE_PRIORITY_INTERVAL)
+            return;
+        f64 elapsed = texture_priority_timer_;
+        texture_priority_timer_ = 0.0;
+
+        if ((pending_textures_.empty()) && (reduced_textures_.empty()))
+            return;
+
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        Ogre::Camera* camera = renderer_->GetCurrentCamera();
+        if ((!scene) || (!camera))
+            return;
+
+        boost::shared_ptr<Foundation::TextureServiceInterface> texture_service = framework_->GetServiceManager()->
+            GetService<Foundation::TextureServiceInterface>(Service::ST_Texture).lock();
+        if (!texture_service)
+            return;
+
+        PROFILE(ResourceHandler_UpdateTexturePriorities);
+
+        // Projected size of a unit sized object at unit distance, in pixels
+        Ogre::Real tan_half_fov = Ogre::Math::Tan(camera->getFOVy() * 0.5f);
+        if (tan_half_fov <= 0.0f)
+            return;
+        f32 pixels_per_unit = renderer_->GetWindowHeight() * 0.5f / tan_half_fov;
+        f32 near_clip = camera->getNearClipDistance();
+        Ogre::Vector3 camera_pos = camera->getDerivedPosition();
+
+        // The largest priority and screen size of each material, so that each material is walked only once
+        MaterialPriorityMap material_priorities;
+
+        Ogre::SceneManager::MovableObjectIterator entities = scene->getMovableObjectIterator(Ogre::EntityFactory::FACTORY_TYPE_NAME);
+        while (entities.hasMoreElements())
+        {
+            Ogre::Entity* entity = static_cast<Ogre::Entity*>(entities.getNext());
+            f32 priority;
+            uint screen_size;
+            if (!GetObjectScreenPriority(entity, camera, camera_pos, pixels_per_unit, near_clip, priority, screen_size))
+                continue;
+            for (uint i = 0; i < entity->getNumSubEntities(); ++i)
+                AddMaterialPriority(entity->getSubEntity(i)->getMaterial().get(), priority, screen_size, material_priorities);
+        }
+
+        Ogre::SceneManager::MovableObjectIterator manuals = scene->getMovableObjectIterator(Ogre::ManualObjectFactory::FACTORY_TYPE_NAME);
+        while (manuals.hasMoreElements())
+        {
+            Ogre::ManualObject* manual = static_cast<Ogre::ManualObject*>(manuals.getNext());
+            f32 priority;
+            uint screen_size;
+            if (!GetObjectScreenPriority(manual, camera, camera_pos, pixels_per_unit, near_clip, priority, screen_size))
+                continue;
+            for (uint i = 0; i < manual->getNumSections(); ++i)
+                AddMaterialPriority(manual->getSection(i)->getMaterial().get(), priority, screen_size, material_priorities);
+        }
+
+        TexturePriorityMap texture_priorities;
+        for (MaterialPriorityMap::iterator m = material_priorities.begin(); m != material_priorities.end(); ++m)
+            AddMaterialTexturePriorities(m->first, m->second.first, m->second.second, texture_priorities);
+
+        // Reduced textures now drawn larger than they were decoded are requested again
+        std::set<std::string>::iterator r = reduced_textures_.begin();
+        while (r != reduced_textures_.end())
+        {
+            TexturePriorityMap::iterator t = texture_priorities.find(*r);
+            if (!IsReducedTextureEnough(*r, 0))
+                reduced_textures_.erase(r++);
+            else if ((t != texture_priorities.end()) && (!IsReducedTextureEnough(*r, t->second.second)))
+            {
+                std::string id = *r;
+                reduced_textures_.erase(r++);
+                RequestTexture(id);
+            }
+            else
+                ++r;
+        }
+
+        for (std::set<std::string>::iterator i = pending_textures_.begin(); i != pending_textures_.end(); ++i)
+        {
+            TexturePriorityMap::iterator t = texture_priorities.find(*i);
+            if (t != texture_priorities.end())
+            {
+                drawn_textures_.insert(*i);
+
+                // A texture that has been decoded enough for its drawn size for long is paused, so that its download
+                // ends instead of staying open for the finer levels
+                if (IsReducedTextureEnough(*i, t->second.second))
+                {
+                    f64& reduced_time = reduced_texture_times_[*i];
+                    reduced_time += elapsed;
+                    if (reduced_time >= REDUCED_TEXTURE_TIMEOUT)
+                    {
+                        texture_service->SetTexturePriority(*i, 0.0f, t->second.second);
+                        continue;
+                    }
+                }
+                else
+                    reduced_texture_times_.erase(*i);
+
+                texture_service->SetTexturePriority(*i, t->second.first, t->second.second);
+            }
+            // A texture no longer found on any object it was drawn on has lost its references, for example to a
+            // removed entity. Pause it; the asset provider cancels the transfer if it stays paused
+            else if (drawn_textures_.find(*i) != drawn_textures_.end())
+                texture_service->SetTexturePriority(*i, 0.0f, 0);
+            // Textures never seen on any object, such as sky and UI textures, keep downloading at a low priority and
+            // full resolution
+            else
+                texture_service->SetTexturePriority(*i, UNSEEN_TEXTURE_PRIORITY, 0);
+        }
+    }
+
+    bool ResourceHandler::GetObjectScreenPriority(Ogre::MovableObject* object, Ogre::Camera* camera, const Ogre::Vector3& camera_pos,
+        f32 pixels_per_unit, f32 near_clip, f32& priority, uint& screen_size)
+    {
+        if (!object->isInScene())
+            return false;
+
+        const Ogre::AxisAlignedBox& bounds = object->getWorldBoundingBox(true);
+        if (bounds.isNull())
+            return false;
+
+        // The size the object is drawn at, from its bounding sphere
+        f32 size = MAX_TEXTURE_SCREEN_SIZE;
+        if (!bounds.isInfinite())
+        {
+            Ogre::Real radius = bounds.getHalfSize().length();
+            Ogre::Real distance = std::max(camera_pos.distance(bounds.getCenter()) - radius, near_clip);
+            if (distance > 0.0f)
+                size = std::min((f32)(2.0f * radius * pixels_per_unit / distance), MAX_TEXTURE_SCREEN_SIZE);
+        }
+
+        priority = size;
+        if ((!object->isVisible()) || (!camera->isVisible(bounds)))
+            priority *= OFFSCREEN_TEXTURE_PRIORITY_FACTOR;
+        screen_size = std::max((uint)size, (uint)1);
+        return true;
+    }
+
+    void ResourceHandler::AddMaterialPriority(Ogre::Material* material, f32 priority, uint screen_size, MaterialPriorityMap& material_priorities)
+    {
+        if (!material)
+            return;
+
+        MaterialPriorityMap::iterator m = material_priorities.find(material);
+        if (m == material_priorities.end())
+            material_priorities[material] = std::make_pair(priority, screen_size);
+        else
+        {
+            m->second.first = std::max(m->second.first, priority);
+            m->second.second = std::max(m->second.second, screen_size);
+        }
+    }
+
+    void ResourceHandler::AddMaterialTexturePriorities(Ogre::Material* material, f32 priority, uint screen_size, TexturePriorityMap& texture_priorities)
+    {
+        for (uint i = 0; i < material->getNumTechniques(); ++i)
+        {
+            Ogre::Technique* tech = material->getTechnique(i);
+            for (uint j = 0; j < tech->getNumPasses(); ++j)
+            {
+                Ogre::Pass* pass = tech->getPass(j);
+                for (uint k = 0; k < pass->getNumTextureUnitStates(); ++k)
+                {
+                    const std::string& name = pass->getTextureUnitState(k)->getTextureName();
+                    if ((pending_textures_.find(name) == pending_textures_.end()) &&
+                        (reduced_textures_.find(name) == reduced_textures_.end()))
+                        continue;
+
+                    TexturePriorityMap::iterator t = texture_priorities.find(name);
+                    if (t == texture_priorities.end())
+                        texture_priorities[name] = std::make_pair(priority, screen_size);
+                    else
+                    {
+                        t->second.first = std::max(t->second.first, priority);
+                        t->second.second = std::max(t->second.second, screen_size);
+                    }
+                }
+            }
+        }
+    }
+
+    bool ResourceHandler::IsReducedTextureEnough(const std::string& id, uint screen_size)
+    {
+        OgreTextureResource* tex = dynamic_cast<OgreTextureResource*>(GetResourceInternal(id, OgreTextureResource::GetTypeStatic()).get());
+        if ((!tex) || (tex->GetLevel() <= 0) || (tex->GetTexture().isNull()))
+            return false;
+
+        Ogre::TexturePtr ogre_tex = tex->GetTexture();
+        return std::max(ogre_tex->getWidth(), ogre_tex->getHeight()) >= screen_size;
+    }
+
+    void ResourceHandler::RemovePendingTexture(const std::string& id)
+    {
+        request_tags_.erase(id);
+        pending_textures_.erase(id);
+        drawn_textures_.erase(id);
+        reduced_texture_times_.erase(id);
+    }
 
     request_tag_t ResourceHandler::RequestOtherResource(const std::string& id, const std::string& type)
     {
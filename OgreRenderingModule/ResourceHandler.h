@@ -6,6 +6,9 @@
 #include "ResourceInterface.h"
 #include "AssetInterface.h"
 #include "OgreModuleApi.h"
+#include "OgreModuleFwd.h"
+
+#include <deque>
 
 namespace OgreRenderer
 {
@@ -39,6 +42,20 @@ namespace OgreRenderer
 
         //! Handles a resource event. Called by OgreRenderingModule
         bool HandleResourceEvent(event_id_t event_id, IEventData* data);
+
+        //! Passes priorities of the textures still being downloaded to the texture service, based on how large they
+        //! are drawn on screen. Called by Renderer
+        /*! Textures no longer drawn on any object, and textures decoded enough for their drawn size for long, get
+            priority 0 so that their downloads are paused and canceled. Textures that ended at a reduced level are
+            requested again when drawn larger.
+         */
+        void UpdateTexturePriorities(f64 frametime);
+
+        //! Creates or updates the Ogre textures of decoded texture levels until the budget expires, but at least one.
+        //! Run as the ResourceFinalization stage of the frame scheduler
+        /*! \return true if no textures are left for the next frame
+         */
+        bool FinalizeResources(f64 frametime, const Foundation::FrameBudget& budget);
         
         //! Internal method to parse braces from an Ogre script. Returns true if line contained open/close brace
         static bool ProcessBraces(const std::string& line, int& brace_level);
@@ -68,6 +85,12 @@ namespace OgreRenderer
          */
         bool UpdateTexture(Foundation::ResourcePtr source, request_tag_t tag);
 
+        //! Queues a decoded texture level for upload in FinalizeResources(), replacing a coarser level of the same texture
+        /*! \param source Raw texture
+            \param tag Request tag from raw texture resource event
+         */
+        void QueueTextureUpdate(Foundation::ResourcePtr source, request_tag_t tag);
+
         //! Creates or updates a mesh, based on source asset data
         /*! \param source Asset
             \param tag Request tag from asset event
@@ -116,6 +139,28 @@ namespace OgreRenderer
         //! Gets number of outstanding (not yet loaded) references for resource
         unsigned GetNumOutstandingReferences(const std::string& id);
 
+        typedef std::map<Ogre::Material*, std::pair<f32, uint> > MaterialPriorityMap;
+        typedef std::map<std::string, std::pair<f32, uint> > TexturePriorityMap;
+
+        //! Computes the texture priority and on-screen size of an object from its world bounding box
+        /*! Hidden objects get the priority of objects outside the view.
+            \return false if the object is not in the scene
+         */
+        bool GetObjectScreenPriority(Ogre::MovableObject* object, Ogre::Camera* camera, const Ogre::Vector3& camera_pos,
+            f32 pixels_per_unit, f32 near_clip, f32& priority, uint& screen_size);
+
+        //! Records the priority and on-screen size of a material, keeping the largest found so far
+        void AddMaterialPriority(Ogre::Material* material, f32 priority, uint screen_size, MaterialPriorityMap& material_priorities);
+
+        //! Records the priority and on-screen size of each pending or reduced texture used by a material, keeping the largest found so far
+        void AddMaterialTexturePriorities(Ogre::Material* material, f32 priority, uint screen_size, TexturePriorityMap& texture_priorities);
+
+        //! Returns whether a texture has been decoded to a reduced level that already covers the size it is drawn at
+        bool IsReducedTextureEnough(const std::string& id, uint screen_size);
+
+        //! Forgets the request of a pending texture
+        void RemovePendingTexture(const std::string& id);
+
         //! resource event category
         event_category_id_t resource_event_category_;
                 
@@ -136,6 +181,27 @@ namespace OgreRenderer
         
         //! Map of outstanding reference requests per resource
         std::map<std::string, Foundation::ResourceReferenceVector> outstanding_references_;
+
+        //! Textures requested from the texture service and not yet at full quality
+        std::set<std::string> pending_textures_;
+
+        //! Pending textures that have been found on an object
+        std::set<std::string> drawn_textures_;
+
+        //! Time each pending texture has been decoded enough for the size it is drawn at
+        std::map<std::string, f64> reduced_texture_times_;
+
+        //! Textures whose request ended at a reduced level. Requested again if drawn larger
+        std::set<std::string> reduced_textures_;
+
+        //! Decoded texture levels waiting to be uploaded to Ogre, with their request tags. Only the finest level of a texture is kept
+        std::map<std::string, std::pair<Foundation::ResourcePtr, request_tag_t> > pending_texture_updates_;
+
+        //! Ids of textures in pending_texture_updates_, in arrival order
+        std::deque<std::string> pending_texture_update_order_;
+
+        //! Time since texture priorities were last updated
+        f64 texture_priority_timer_;
         
         //! Framework we belong to
         Foundation::Framework* framework_;
@@ -0,0 +1,427 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "StaticBatcher.h"
+#include "Renderer.h"
+#include "OgreRenderingModule.h"
+#include "ConfigurationManager.h"
+#include "FrameScheduler.h"
+
+#include <Ogre.h>
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OgreRenderer
+{
+    //! Name of the frame stage static geometry is built in
+    static const std::string STATIC_BATCHING_STAGE = "StaticBatching";
+
+    //! Default share of the frame for building static geometry
+    static const f64 STATIC_BATCHING_SHARE = 0.05;
+
+    //! Default size of the cells, in world units
+    static const f64 DEFAULT_CELL_SIZE = 64.0;
+
+    //! Default time an entity has to stay put before it is batched, in seconds
+    static const f64 DEFAULT_SETTLE_TIME = 2.0;
+
+    //! Default amount of entities that must use a mesh for its entities to be batched
+    static const int DEFAULT_MIN_INSTANCES = 2;
+
+    //! Default time between the checks of a batched entity for having been hidden, in seconds
+    static const f64 DEFAULT_VISIBILITY_CHECK_INTERVAL = 0.5;
+
+    //! Largest change of position or scale that does not take an entity out of its batch
+    static const Ogre::Real POSITION_TOLERANCE = 0.001f;
+
+    //! Largest change of orientation that does not take an entity out of its batch, in radians
+    static const Ogre::Real ORIENTATION_TOLERANCE = 0.0001f;
+
+    bool StaticBatcher::CellKey::operator < (const CellKey& rhs) const
+    {
+        if (x_ != rhs.x_)
+            return x_ < rhs.x_;
+        if (y_ != rhs.y_)
+            return y_ < rhs.y_;
+        if (z_ != rhs.z_)
+            return z_ < rhs.z_;
+        return cast_shadows_ < rhs.cast_shadows_;
+    }
+
+    StaticBatcher::StaticBatcher(Renderer* renderer, Foundation::Framework* framework) :
+        renderer_(renderer),
+        framework_(framework),
+        time_(0.0)
+    {
+        cell_size_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_cell_size", DEFAULT_CELL_SIZE);
+        if (cell_size_ <= 0.0f)
+            cell_size_ = DEFAULT_CELL_SIZE;
+        settle_time_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_settle_time", DEFAULT_SETTLE_TIME);
+        min_instances_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_min_instances", DEFAULT_MIN_INSTANCES);
+        visibility_check_interval_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_visibility_check_interval", DEFAULT_VISIBILITY_CHECK_INTERVAL);
+        if (visibility_check_interval_ <= 0.0)
+            visibility_check_interval_ = DEFAULT_VISIBILITY_CHECK_INTERVAL;
+    }
+
+    StaticBatcher::~StaticBatcher()
+    {
+        Foundation::FrameSchedulerPtr scheduler = framework_->GetFrameScheduler();
+        if (scheduler)
+            scheduler->RemoveStage(STATIC_BATCHING_STAGE);
+
+        Ogre::SceneManager* scene_mgr = renderer_->GetSceneManager();
+        for(CellMap::iterator i = cells_.begin(); i != cells_.end(); ++i)
+        {
+            for(std::set<Ogre::Entity*>::iterator j = i->second.members_.begin(); j != i->second.members_.end(); ++j)
+                (*j)->setVisibilityFlags(members_[*j].visibility_flags_);
+            if (i->second.geometry_ && scene_mgr)
+                scene_mgr->destroyStaticGeometry(i->second.geometry_);
+        }
+
+        for(std::map<const Ogre::Node*, std::vector<Ogre::Entity*> >::iterator i = node_members_.begin(); i != node_members_.end(); ++i)
+        {
+            Ogre::Node* node = const_cast<Ogre::Node*>(i->first);
+            if (node->getListener() == this)
+                node->setListener(GetChainedListener(node));
+        }
+    }
+
+    void StaticBatcher::PostInitialize()
+    {
+        framework_->GetFrameScheduler()->AddStage(STATIC_BATCHING_STAGE, STATIC_BATCHING_SHARE,
+            boost::bind(&StaticBatcher::Update, this, _1, _2));
+    }
+
+    void StaticBatcher::AddEntity(Ogre::Entity* entity)
+    {
+        if (!entity || members_.find(entity) != members_.end())
+            return;
+
+        Ogre::SceneNode* node = entity->getParentSceneNode();
+        if (!node)
+            return;
+
+        // Moves of the node are followed with a listener. A node only has one, so chain a listener already set
+        Ogre::Node::Listener* listener = node->getListener();
+        if (listener != this)
+        {
+            if (listener)
+                chained_listeners_[node] = listener;
+            node->setListener(this);
+        }
+
+        Member& member = members_[entity];
+        member.node_ = node;
+        member.mesh_ = entity->getMesh().get();
+        member.check_entry_ = check_queue_.insert(std::make_pair(time_ + settle_time_, entity));
+        member.batched_ = false;
+        member.visibility_flags_ = entity->getVisibilityFlags();
+        member.position_ = node->_getDerivedPosition();
+        member.orientation_ = node->_getDerivedOrientation();
+        member.scale_ = node->_getDerivedScale();
+
+        node_members_[node].push_back(entity);
+        ++mesh_instances_[member.mesh_];
+    }
+
+    void StaticBatcher::RemoveEntity(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        if (i == members_.end())
+            return;
+        Member& member = i->second;
+
+        Unbatch(entity, member);
+        check_queue_.erase(member.check_entry_);
+
+        std::map<Ogre::Mesh*, int>::iterator m = mesh_instances_.find(member.mesh_);
+        if (m != mesh_instances_.end() && --m->second <= 0)
+            mesh_instances_.erase(m);
+
+        std::map<const Ogre::Node*, std::vector<Ogre::Entity*> >::iterator n = node_members_.find(member.node_);
+        if (n != node_members_.end())
+        {
+            n->second.erase(std::remove(n->second.begin(), n->second.end(), entity), n->second.end());
+            if (n->second.empty())
+            {
+                if (member.node_->getListener() == this)
+                    member.node_->setListener(GetChainedListener(member.node_));
+                chained_listeners_.erase(member.node_);
+                node_members_.erase(n);
+            }
+        }
+
+        members_.erase(i);
+    }
+
+    void StaticBatcher::InvalidateEntity(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        if (i != members_.end())
+            Unbatch(entity, i->second);
+    }
+
+    bool StaticBatcher::Update(f64 frametime, const Foundation::FrameBudget& budget)
+    {
+        PROFILE(StaticBatcher_Update);
+
+        time_ += frametime;
+
+        // Check the entities that are due. Each is due again later, so this drains within the budget
+        bool checked_any = false;
+        while(!check_queue_.empty() && check_queue_.begin()->first <= time_)
+        {
+            if (checked_any && budget.Expired())
+                break;
+            Ogre::Entity* entity = check_queue_.begin()->second;
+            Check(entity, members_[entity]);
+            checked_any = true;
+        }
+
+        while(!dirty_cells_.empty())
+        {
+            Rebuild(*dirty_cells_.begin());
+            if (budget.Expired())
+                break;
+        }
+
+        return dirty_cells_.empty() && (check_queue_.empty() || check_queue_.begin()->first > time_);
+    }
+
+    void StaticBatcher::nodeUpdated(const Ogre::Node* node)
+    {
+        Ogre::Node::Listener* listener = GetChainedListener(node);
+        if (listener)
+            listener->nodeUpdated(node);
+
+        std::map<const Ogre::Node*, std::vector<Ogre::Entity*> >::iterator n = node_members_.find(node);
+        if (n == node_members_.end())
+            return;
+
+        // Nodes are also updated when their transform is set or recalculated without a change
+        const Ogre::Vector3& position = node->_getDerivedPosition();
+        const Ogre::Quaternion& orientation = node->_getDerivedOrientation();
+        const Ogre::Vector3& scale = node->_getDerivedScale();
+
+        std::vector<Ogre::Entity*> entities = n->second;
+        for(uint i = 0; i < entities.size(); ++i)
+        {
+            Member& member = members_[entities[i]];
+            if (member.position_.positionEquals(position, POSITION_TOLERANCE) &&
+                member.orientation_.equals(orientation, Ogre::Radian(ORIENTATION_TOLERANCE)) &&
+                member.scale_.positionEquals(scale, POSITION_TOLERANCE))
+                continue;
+
+            Unbatch(entities[i], member);
+            member.position_ = position;
+            member.orientation_ = orientation;
+            member.scale_ = scale;
+        }
+    }
+
+    void StaticBatcher::nodeDestroyed(const Ogre::Node* node)
+    {
+        Ogre::Node::Listener* listener = GetChainedListener(node);
+        if (listener)
+            listener->nodeDestroyed(node);
+
+        std::map<const Ogre::Node*, std::vector<Ogre::Entity*> >::iterator n = node_members_.find(node);
+        if (n == node_members_.end())
+            return;
+
+        std::vector<Ogre::Entity*> entities = n->second;
+        for(uint i = 0; i < entities.size(); ++i)
+            RemoveEntity(entities[i]);
+    }
+
+    void StaticBatcher::nodeAttached(const Ogre::Node* node)
+    {
+        Ogre::Node::Listener* listener = GetChainedListener(node);
+        if (listener)
+            listener->nodeAttached(node);
+    }
+
+    void StaticBatcher::nodeDetached(const Ogre::Node* node)
+    {
+        Ogre::Node::Listener* listener = GetChainedListener(node);
+        if (listener)
+            listener->nodeDetached(node);
+    }
+
+    Ogre::Node::Listener* StaticBatcher::GetChainedListener(const Ogre::Node* node) const
+    {
+        std::map<const Ogre::Node*, Ogre::Node::Listener*>::const_iterator i = chained_listeners_.find(node);
+        return (i != chained_listeners_.end()) ? i->second : 0;
+    }
+
+    bool StaticBatcher::CanBatch(Ogre::Entity* entity, const Member& member) const
+    {
+        if (!entity->getVisible() || !entity->isInScene() || entity->hasSkeleton() || !entity->getNumSubEntities())
+            return false;
+        if (entity->getParentSceneNode() != member.node_ || !member.node_->isInSceneGraph())
+            return false;
+        // Moves can not be followed if another object has replaced the listener
+        if (member.node_->getListener() != this)
+            return false;
+
+        std::map<Ogre::Mesh*, int>::const_iterator m = mesh_instances_.find(member.mesh_);
+        return m != mesh_instances_.end() && m->second >= min_instances_;
+    }
+
+    void StaticBatcher::Check(Ogre::Entity* entity, Member& member)
+    {
+        if (member.batched_)
+        {
+            if (!entity->getVisible() || member.node_->getListener() != this)
+                Unbatch(entity, member);
+            else
+                Schedule(entity, member, visibility_check_interval_);
+            return;
+        }
+
+        if (!CanBatch(entity, member))
+        {
+            Schedule(entity, member, settle_time_);
+            return;
+        }
+
+        // Bringing the node up to date reschedules the entity if it has moved after all
+        member.node_->_getDerivedPosition();
+        if (member.check_entry_->first > time_)
+            return;
+
+        CellKey key;
+        key.x_ = (int)floor(member.position_.x / cell_size_);
+        key.y_ = (int)floor(member.position_.y / cell_size_);
+        key.z_ = (int)floor(member.position_.z / cell_size_);
+        key.cast_shadows_ = entity->getCastShadows();
+
+        CellMap::iterator c = cells_.find(key);
+        if (c == cells_.end())
+        {
+            c = cells_.insert(std::make_pair(key, Cell())).first;
+            c->second.geometry_ = 0;
+            c->second.dirty_ = false;
+        }
+        MarkDirty(key, c->second);
+
+        member.visibility_flags_ = entity->getVisibilityFlags();
+        member.batched_ = true;
+        member.cell_ = key;
+        c->second.members_.insert(entity);
+        Schedule(entity, member, visibility_check_interval_);
+    }
+
+    void StaticBatcher::Schedule(Ogre::Entity* entity, Member& member, f64 delay)
+    {
+        check_queue_.erase(member.check_entry_);
+        member.check_entry_ = check_queue_.insert(std::make_pair(time_ + delay, entity));
+    }
+
+    void StaticBatcher::Unbatch(Ogre::Entity* entity, Member& member)
+    {
+        Schedule(entity, member, settle_time_);
+        if (!member.batched_)
+            return;
+
+        CellMap::iterator c = cells_.find(member.cell_);
+        if (c != cells_.end())
+        {
+            MarkDirty(member.cell_, c->second);
+            c->second.members_.erase(entity);
+        }
+        member.batched_ = false;
+    }
+
+    void StaticBatcher::MarkDirty(const CellKey& key, Cell& cell)
+    {
+        dirty_cells_.insert(key);
+        if (cell.dirty_)
+            return;
+
+        // Draw the entities one by one until the rebuild, so that the change shows right away
+        if (cell.geometry_)
+            cell.geometry_->setVisible(false);
+        for(std::set<Ogre::Entity*>::iterator i = cell.members_.begin(); i != cell.members_.end(); ++i)
+            (*i)->setVisibilityFlags(members_[*i].visibility_flags_);
+        cell.dirty_ = true;
+    }
+
+    void StaticBatcher::Rebuild(const CellKey& key)
+    {
+        PROFILE(StaticBatcher_Rebuild);
+
+        CellMap::iterator c = cells_.find(key);
+        if (c == cells_.end())
+        {
+            dirty_cells_.erase(key);
+            return;
+        }
+
+        Ogre::SceneManager* scene_mgr = renderer_->GetSceneManager();
+
+        // Bring the nodes up to date first, which takes the entities that have moved out of the cell
+        std::vector<Ogre::Entity*> entities(c->second.members_.begin(), c->second.members_.end());
+        for(uint i = 0; i < entities.size(); ++i)
+            members_[entities[i]].node_->_getDerivedPosition();
+        dirty_cells_.erase(key);
+
+        Cell& cell = c->second;
+        if (cell.members_.empty())
+        {
+            if (cell.geometry_)
+                scene_mgr->destroyStaticGeometry(cell.geometry_);
+            cells_.erase(c);
+            return;
+        }
+
+        if (!cell.geometry_)
+        {
+            cell.geometry_ = scene_mgr->createStaticGeometry(renderer_->GetUniqueObjectName());
+            cell.geometry_->setRegionDimensions(Ogre::Vector3(cell_size_, cell_size_, cell_size_));
+            cell.geometry_->setOrigin(Ogre::Vector3(key.x_ * cell_size_, key.y_ * cell_size_, key.z_ * cell_size_));
+            cell.geometry_->setCastShadows(key.cast_shadows_);
+        }
+        else
+            cell.geometry_->reset();
+
+        // The cell is drawn as far as its farthest drawn entity
+        bool unlimited_distance = false;
+        Ogre::Real rendering_distance = 0.0f;
+        try
+        {
+            for(std::set<Ogre::Entity*>::iterator i = cell.members_.begin(); i != cell.members_.end(); ++i)
+            {
+                const Member& member = members_[*i];
+                cell.geometry_->addEntity(*i, member.position_, member.orientation_, member.scale_);
+                if ((*i)->getRenderingDistance() <= 0.0f)
+                    unlimited_distance = true;
+                else
+                    rendering_distance = std::max(rendering_distance, (*i)->getRenderingDistance());
+            }
+            cell.geometry_->setRenderingDistance(unlimited_distance ? 0.0f : rendering_distance);
+            cell.geometry_->build();
+        }
+        catch (Ogre::Exception& e)
+        {
+            // Leave the entities drawn one by one, they are tried again after the settle time
+            OgreRenderingModule::LogError("Could not build static geometry: " + std::string(e.what()));
+            for(std::set<Ogre::Entity*>::iterator i = cell.members_.begin(); i != cell.members_.end(); ++i)
+            {
+                Member& member = members_[*i];
+                member.batched_ = false;
+                Schedule(*i, member, settle_time_);
+            }
+            scene_mgr->destroyStaticGeometry(cell.geometry_);
+            cells_.erase(c);
+            return;
+        }
+
+        for(std::set<Ogre::Entity*>::iterator i = cell.members_.begin(); i != cell.members_.end(); ++i)
+            (*i)->setVisibilityFlags(0);
+        cell.geometry_->setVisible(true);
+        cell.dirty_ = false;
+    }
+}
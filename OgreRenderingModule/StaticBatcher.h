@@ -0,0 +1,205 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_StaticBatcher_h
+#define incl_OgreRenderer_StaticBatcher_h
+
+#include "OgreModuleApi.h"
+#include "OgreModuleFwd.h"
+
+#include <OgreNode.h>
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace Ogre
+{
+    class StaticGeometry;
+}
+
+namespace OgreRenderer
+{
+    //! Draws entities that stay put as static geometry, one Ogre::StaticGeometry per spatial cell. Used internally by Renderer.
+    /*! The components register the Ogre entities they attach to scene nodes. An entity is batched once it has not moved
+        for the settle time, if its mesh is used by enough registered entities to be worth it and it has no skeleton.
+        Batched entities stay in the scene for raycasts and bounds, only their visibility flags hide them from rendering,
+        and the static geometry of their cell draws them instead, merged by material.
+
+        When a batched entity moves, is hidden or removed, or the components invalidate it because of a material or
+        other change, its whole cell goes back to drawing the entities one by one right away, and the static geometry
+        of the cell is rebuilt without the entity within the budget of the StaticBatching frame stage. Entities drawn
+        by static geometry do not show up in the visible entities of the renderer.
+
+        Moves are followed with a listener on the scene nodes. A listener another object has set on a node is
+        called from the batcher's, and restored when the node has no registered entities left. Ogre does not tell
+        when an entity is hidden, so instead of scanning all entities each frame, each entity is due for a check in
+        a timed queue: an unbatched entity after the settle time, a batched one after the visibility check interval.
+
+        Batching is enabled with the "static_batching" setting of the OgreRenderer configuration group.
+     */
+    class OGRE_MODULE_API StaticBatcher : public Ogre::Node::Listener
+    {
+    public:
+        //! Constructor
+        explicit StaticBatcher(Renderer* renderer, Foundation::Framework* framework);
+
+        //! Destructor. Destroys the static geometry and shows the batched entities one by one.
+        virtual ~StaticBatcher();
+
+        //! Postinitialization. Adds the StaticBatching frame stage
+        void PostInitialize();
+
+        //! Registers an entity attached to a scene node as a candidate for batching
+        void AddEntity(Ogre::Entity* entity);
+
+        //! Unregisters an entity. Call before detaching or destroying a registered entity.
+        void RemoveEntity(Ogre::Entity* entity);
+
+        //! Takes an entity out of its batch after a change the static geometry does not follow, such as a new
+        //! material, draw distance or shadow casting. It is batched again after the settle time.
+        void InvalidateEntity(Ogre::Entity* entity);
+
+        //! Checks the entities due for a check and rebuilds the changed cells until the budget expires, but at least
+        //! one cell. Run as the StaticBatching stage of the frame scheduler
+        /*! \return true if no checks are due and no cells are left to rebuild
+         */
+        bool Update(f64 frametime, const Foundation::FrameBudget& budget);
+
+        //! Ogre::Node::Listener override. Takes the entities of a moved node out of their batches
+        virtual void nodeUpdated(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override. Forgets the entities of a destroyed node
+        virtual void nodeDestroyed(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override. Calls the chained listener of the node
+        virtual void nodeAttached(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override. Calls the chained listener of the node
+        virtual void nodeDetached(const Ogre::Node* node);
+
+    private:
+        //! Cell of the static geometry. Shadow casters and other entities are in separate cells.
+        struct CellKey
+        {
+            int x_;
+            int y_;
+            int z_;
+            bool cast_shadows_;
+
+            bool operator < (const CellKey& rhs) const;
+        };
+
+        //! Registered entities by the time they are due for a check, in seconds of batcher time
+        typedef std::multimap<f64, Ogre::Entity*> CheckQueue;
+
+        //! Registered entity
+        struct Member
+        {
+            //! Scene node the entity is attached to
+            Ogre::SceneNode* node_;
+
+            //! Mesh of the entity
+            Ogre::Mesh* mesh_;
+
+            //! Entry of the entity in the check queue
+            CheckQueue::iterator check_entry_;
+
+            //! Whether the entity is drawn by the static geometry of its cell
+            bool batched_;
+
+            //! Cell of a batched entity
+            CellKey cell_;
+
+            //! Visibility flags of the entity before it was batched
+            Ogre::uint32 visibility_flags_;
+
+            //! Transform of the node when it was last updated
+            Ogre::Vector3 position_;
+            Ogre::Quaternion orientation_;
+            Ogre::Vector3 scale_;
+        };
+
+        //! Static geometry of a cell
+        struct Cell
+        {
+            //! Static geometry, null until built
+            Ogre::StaticGeometry* geometry_;
+
+            //! Batched entities
+            std::set<Ogre::Entity*> members_;
+
+            //! Whether the entities are drawn one by one until the cell is rebuilt
+            bool dirty_;
+        };
+
+        typedef std::map<Ogre::Entity*, Member> MemberMap;
+        typedef std::map<CellKey, Cell> CellMap;
+
+        //! Returns whether an entity can be batched now
+        bool CanBatch(Ogre::Entity* entity, const Member& member) const;
+
+        //! Checks an entity due in the check queue. Batches an unbatched one, unbatches a batched one that has been hidden
+        void Check(Ogre::Entity* entity, Member& member);
+
+        //! Moves an entity in the check queue to be due after a delay, in seconds
+        void Schedule(Ogre::Entity* entity, Member& member, f64 delay);
+
+        //! Takes an entity out of its batch, so that it is drawn on its own and may be batched again after the settle time
+        void Unbatch(Ogre::Entity* entity, Member& member);
+
+        //! Returns the listener another object had set on a node before the batcher, or null
+        Ogre::Node::Listener* GetChainedListener(const Ogre::Node* node) const;
+
+        //! Shows the entities of a cell one by one until the cell is rebuilt
+        void MarkDirty(const CellKey& key, Cell& cell);
+
+        //! Rebuilds the static geometry of a cell, destroying it if no entities are left
+        void Rebuild(const CellKey& key);
+
+        //! Renderer
+        Renderer* renderer_;
+
+        //! Framework
+        Foundation::Framework* framework_;
+
+        //! Size of the cells, in world units
+        float cell_size_;
+
+        //! Time an entity has to stay put before it is batched, in seconds
+        f64 settle_time_;
+
+        //! Amount of registered entities that must use a mesh for its entities to be batched
+        int min_instances_;
+
+        //! Time between the checks of a batched entity for having been hidden, in seconds
+        f64 visibility_check_interval_;
+
+        //! Time the batcher has run, in seconds
+        f64 time_;
+
+        //! Registered entities
+        MemberMap members_;
+
+        //! Registered entities by the scene node they are attached to
+        std::map<const Ogre::Node*, std::vector<Ogre::Entity*> > node_members_;
+
+        //! Listeners other objects had set on the nodes of registered entities, called from the batcher's
+        std::map<const Ogre::Node*, Ogre::Node::Listener*> chained_listeners_;
+
+        //! Registered entities by the time they are due for a check
+        CheckQueue check_queue_;
+
+        //! Amount of registered entities using each mesh
+        std::map<Ogre::Mesh*, int> mesh_instances_;
+
+        //! Cells
+        CellMap cells_;
+
+        //! Cells waiting for a rebuild
+        std::set<CellKey> dirty_cells_;
+    };
+}
+
+#endif
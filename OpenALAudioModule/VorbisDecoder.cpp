@@ -87,27 +87,19 @@ namespace OpenALAudio
     }
 
     VorbisDecoder::VorbisDecoder() :
-        Foundation::ThreadTask("VorbisDecoder")
+        Foundation::ThreadTask("VorbisDecoder", true)
     {
     }
     
-    void VorbisDecoder::Work()
+    VorbisDecoder::~VorbisDecoder()
     {
-        while (ShouldRun())
-        {
-            WaitForRequests();
-            
-            VorbisDecodeRequestPtr request = GetNextRequest<VorbisDecodeRequest>();
-            if (request)
-            {
-                {
-                    PROFILE(VorbisDecoder_Decode);
-                    PerformDecode(request);
-                }
-            }
-
-            RESETPROFILER
-        }
+        Stop();
+    }
+    
+    void VorbisDecoder::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
+    {
+        PROFILE(VorbisDecoder_Decode);
+        PerformDecode(boost::dynamic_pointer_cast<VorbisDecodeRequest>(request));
     }
     
     void VorbisDecoder::PerformDecode(VorbisDecodeRequestPtr request)
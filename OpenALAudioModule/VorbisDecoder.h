@@ -31,15 +31,19 @@ namespace OpenALAudio
     typedef boost::shared_ptr<VorbisDecodeRequest> VorbisDecodeRequestPtr;
     typedef boost::shared_ptr<VorbisDecodeResult> VorbisDecodeResultPtr;
 
-    //! Ogg Vorbis decoder that runs in a thread and serves decode requests, used by SoundSystem
+    //! Ogg Vorbis decoder that serves decode requests on the framework thread pool, used by SoundSystem
     class VorbisDecoder : public Foundation::ThreadTask
     {
     public:
         //! Constructor
         VorbisDecoder();
         
-        //! Work function
-        virtual void Work();
+        //! Destructor. Waits for the running decodes to finish.
+        virtual ~VorbisDecoder();
+        
+    protected:
+        //! Decodes one sound
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
         
     private:
         //! perform a decode & queue result
@@ -69,6 +69,8 @@ namespace TaigaProtocol
         networkManager_ = boost::shared_ptr<ProtocolUtilities::NetMessageManager>(new ProtocolUtilities::NetMessageManager(filename));
         assert(networkManager_);
         networkManager_->RegisterNetworkListener(this);
+        // Receive, ack and decode UDP traffic on a dedicated thread so that it doesn't depend on the frame rate.
+        networkManager_->SetThreadedReceive(framework_->GetDefaultConfig().DeclareSetting("ProtocolModuleTaiga", "threaded_network_receive", true));
 
         // Send event that other modules can query above categories
         boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> thisModule = framework_->GetModuleManager()->GetModule<ProtocolModuleTaiga>().lock();
@@ -186,7 +186,7 @@ namespace TaigaProtocol
             {
                 ProtocolModuleTaiga::LogWarning(QString("Failed to read inventory: %1").arg(e.what()).toStdString());
                 threadState_->parameters.inventory = boost::shared_ptr<InventorySkeleton>(new InventorySkeleton);
-                InventoryParser::SetErrorFolder(threadState_->parameters.inventory->GetRoot());
+                InventoryParser::SetErrorFolder(threadState_->parameters.inventory.get());
             }
 
             // Buddy List
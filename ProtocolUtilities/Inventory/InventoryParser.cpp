@@ -58,8 +58,6 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
     if (!inventoryNode || XMLRPC_GetValueType(inventoryNode) != xmlrpc_vector)
         throw XmlRpcException("Failed to read inventory, inventory-skeleton in the reply was not properly formed!");
 
-    typedef std::pair<RexUUID, ProtocolUtilities::InventoryFolderSkeleton> DetachedInventoryFolder;
-    typedef std::list<DetachedInventoryFolder> DetachedInventoryFolderList;
     DetachedInventoryFolderList folders;
 
     XMLRPC_VALUE item = XMLRPC_VectorRewind(inventoryNode);
@@ -117,53 +115,23 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
         throw XmlRpcException("Failed to read inventory, inventory-root value folder_id was null or unparseable!");
 
     // Find the root folder from the list of detached folders, and set it as the root folder to start with.
+    ProtocolUtilities::InventoryFolderSkeleton *myInventory = 0;
     for(DetachedInventoryFolderList::iterator iter = folders.begin(); iter != folders.end(); ++iter)
     {
         if (iter->second.id == inventoryRootFolderID)
         {
-            ProtocolUtilities::InventoryFolderSkeleton *root = inventory->GetRoot();
             iter->second.editable = false;
-            root->AddChildFolder(iter->second);
+            myInventory = inventory->AddChildFolder(inventory->GetRoot(), iter->second);
             folders.erase(iter);
             break;
         }
     }
 
-    if ( inventory->GetFirstChildFolderByName("My Inventory") == 0) 
+    if (!myInventory || myInventory->name != "My Inventory")
         throw XmlRpcException("Failed to read inventory, inventory-root value folder_id pointed to a nonexisting folder!");
 
-    if (inventory->GetFirstChildFolderByName("My Inventory")->id != inventoryRootFolderID)
-        throw XmlRpcException("Failed to read inventory, inventory-root value folder_id pointed to a nonexisting folder!");
-    
-
-    // Insert the detached folders onto the tree view until all folders have been added or there are orphans left
-    // that cannot be added, and quit.
-    bool progress = true;
-    while(folders.size() > 0 && progress)
-    {
-        progress = false;
-        DetachedInventoryFolderList::iterator iter = folders.begin();
-        while(iter != folders.end())
-        {
-            DetachedInventoryFolderList::iterator next = iter;
-            ++next;
-
-            ProtocolUtilities::InventoryFolderSkeleton *parent = inventory->GetChildFolderById(iter->first);
-            if (parent)
-            {
-                // Mark harcoded OpenSim Library folders non-editable.
-                if (parent->id == inventoryRootFolderID &&
-                    IsHardcodedOpenSimFolder(iter->second.name.c_str()))
-                    iter->second.editable = false;
-
-                parent->AddChildFolder(iter->second);
-                progress = true;
-                folders.erase(iter);
-            }
-
-            iter = next;
-        }
-    }
+    // Insert the detached folders onto the tree view. Orphans that cannot be added are left out.
+    AttachDetachedFolders(inventory.get(), myInventory, folders, false);
 
     /********** World Library **********/
 
@@ -270,57 +238,73 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
         throw XmlRpcException("Failed to read inventory, inventory-lib-root value folder_id was null or unparseable!");
 
     // Find the root folder from the list of detached folders, and set it as the root folder to start with.
+    ProtocolUtilities::InventoryFolderSkeleton *worldLibrary = 0;
     for(DetachedInventoryFolderList::iterator iter = library_folders.begin(); iter != library_folders.end(); ++iter)
     {
         if (iter->second.id == inventoryLibraryRootFolderID)
         {
-            ProtocolUtilities::InventoryFolderSkeleton *root = inventory->GetRoot();
             iter->second.editable = false;
-            root->AddChildFolder(iter->second);
+            worldLibrary = inventory->AddChildFolder(inventory->GetRoot(), iter->second);
             library_folders.erase(iter);
             break;
         }
     }
 
-    ProtocolUtilities::InventoryFolderSkeleton *worldLibrary = inventory->GetChildFolderById(inventoryLibraryRootFolderID);
     if (!worldLibrary)
         throw XmlRpcException("Failed to read inventory, inventory-lib-root value folder_id pointed to a nonexisting folder!");
 
-    // Insert the detached folders onto the tree view until all folders have been added or there are orphans left
-    // that cannot be added, and quit.
-    progress = true;
-    while(library_folders.size() > 0 && progress)
+    // Insert the detached folders onto the tree view. Orphans that cannot be added are left out.
+    AttachDetachedFolders(inventory.get(), worldLibrary, library_folders, true);
+
+    return inventory;
+}
+
+// static
+void InventoryParser::AttachDetachedFolders(ProtocolUtilities::InventorySkeleton *inventory,
+    ProtocolUtilities::InventoryFolderSkeleton *top, DetachedInventoryFolderList &folders, bool library)
+{
+    // Group the folders by their parents, so that each folder is added right after its parent without searching.
+    typedef std::map<RexUUID, std::vector<DetachedInventoryFolder *> > ChildMap;
+    ChildMap children;
+    for(DetachedInventoryFolderList::iterator iter = folders.begin(); iter != folders.end(); ++iter)
+        children[iter->first].push_back(&*iter);
+
+    std::vector<ProtocolUtilities::InventoryFolderSkeleton *> added;
+    added.push_back(top);
+    for(size_t i = 0; i < added.size(); ++i)
     {
-        progress = false;
-        DetachedInventoryFolderList::iterator iter = library_folders.begin();
-        while(iter != library_folders.end())
-        {
-            DetachedInventoryFolderList::iterator next = iter;
-            ++next;
+        ProtocolUtilities::InventoryFolderSkeleton *parent = added[i];
+        ChildMap::iterator iter = children.find(parent->id);
+        if (iter == children.end())
+            continue;
 
-            ProtocolUtilities::InventoryFolderSkeleton *parent = inventory->GetChildFolderById(iter->first);
-            if (parent)
+        for(size_t j = 0; j < iter->second.size(); ++j)
+        {
+            ProtocolUtilities::InventoryFolderSkeleton &folder = iter->second[j]->second;
+            if (library)
             {
                 // Mark all World Libary folder descendents non-editable.
-                iter->second.editable = false;
-                parent->AddChildFolder(iter->second);
-                progress = true;
-                library_folders.erase(iter);
+                folder.editable = false;
+            }
+            else if (parent == top && IsHardcodedOpenSimFolder(folder.name.c_str()))
+            {
+                // Mark harcoded OpenSim Library folders non-editable.
+                folder.editable = false;
             }
 
-            iter = next;
+            added.push_back(inventory->AddChildFolder(parent, folder));
         }
-    }
 
-    return inventory;
+        // A folder can't be added twice, even if the reply had a cycle of parents.
+        children.erase(iter);
+    }
 }
 
 // STATIC
-void InventoryParser::SetErrorFolder(ProtocolUtilities::InventoryFolderSkeleton *root)
+void InventoryParser::SetErrorFolder(ProtocolUtilities::InventorySkeleton *inventory)
 {
-    ProtocolUtilities::InventoryFolderSkeleton errorFolder;
-    errorFolder.name = "Inventory parsing failed";
-    root->AddChildFolder(errorFolder);
+    ProtocolUtilities::InventoryFolderSkeleton errorFolder(RexUUID::CreateRandom(), "Inventory parsing failed");
+    inventory->AddChildFolder(inventory->GetRoot(), errorFolder);
 }
 
 }
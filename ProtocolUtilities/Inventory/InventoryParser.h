@@ -10,6 +10,7 @@
 
 namespace ProtocolUtilities
 {
+    class InventorySkeleton;
     class InventoryFolderSkeleton;
 
     class InventoryParser
@@ -20,9 +21,23 @@ namespace ProtocolUtilities
         /// @return The inventory object, or null pointer if an error occurred.
         static boost::shared_ptr<ProtocolUtilities::InventorySkeleton> ExtractInventoryFromXMLRPCReply(XmlRpcEpi &call);
 
-        static void SetErrorFolder(ProtocolUtilities::InventoryFolderSkeleton *root);
+        /// Adds a folder that tells that reading the inventory failed to the root of the inventory.
+        /// @param inventory The inventory, the folder is added through it so that it gets indexed by id.
+        static void SetErrorFolder(ProtocolUtilities::InventorySkeleton *inventory);
 
     private:
+        /// Folder read from the reply, with the id of its parent, not yet added to the inventory.
+        typedef std::pair<RexUUID, ProtocolUtilities::InventoryFolderSkeleton> DetachedInventoryFolder;
+        typedef std::list<DetachedInventoryFolder> DetachedInventoryFolderList;
+
+        /// Adds the detached folders that descend from the top folder to the inventory. Orphans are left out.
+        /// @param inventory Inventory.
+        /// @param top Top folder, already added to the inventory.
+        /// @param folders Detached folders.
+        /// @param library Are the folders World Library folders.
+        static void AttachDetachedFolders(ProtocolUtilities::InventorySkeleton *inventory,
+            ProtocolUtilities::InventoryFolderSkeleton *top, DetachedInventoryFolderList &folders, bool library);
+
         /// Checks if the name of the folder belongs to the harcoded OpenSim folders.
         /// @param name name of the folder.
         /// @return True if one of the harcoded folders, false if not.
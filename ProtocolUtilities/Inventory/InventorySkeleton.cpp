@@ -70,6 +70,14 @@ namespace ProtocolUtilities
     {
         root_ = InventoryFolderSkeleton(RexUUID::CreateRandom(), "OpenSim Inventory");
         worldLibraryOwnerId = RexUUID();
+        folderIndex_[root_.id] = &root_;
+    }
+
+    InventoryFolderSkeleton *InventorySkeleton::AddChildFolder(InventoryFolderSkeleton *parent, const InventoryFolderSkeleton &folder)
+    {
+        InventoryFolderSkeleton *child = parent->AddChildFolder(folder);
+        IndexFolder(child);
+        return child;
     }
 
     InventoryFolderSkeleton *InventorySkeleton::GetFirstChildFolderByName(const char *searchName)
@@ -79,7 +87,11 @@ namespace ProtocolUtilities
 
     InventoryFolderSkeleton *InventorySkeleton::GetChildFolderById(const RexUUID &searchId)
     {
-        return root_.GetChildFolderById(searchId);
+        boost::unordered_map<RexUUID, InventoryFolderSkeleton *>::const_iterator iter = folderIndex_.find(searchId);
+        if (iter == folderIndex_.end())
+            return 0;
+
+        return iter->second;
     }
 
     InventoryFolderSkeleton *InventorySkeleton::GetMyInventoryFolder()
@@ -92,4 +104,16 @@ namespace ProtocolUtilities
         root_.DebugDumpInventoryFolderStructure(0);
     }
 
+    void InventorySkeleton::IndexFolder(InventoryFolderSkeleton *folder)
+    {
+        // The first folder with the id wins, like in the depth-first search.
+        folderIndex_.insert(std::make_pair(folder->id, folder));
+
+        for(InventoryFolderSkeleton::FolderIter iter = folder->children.begin(); iter != folder->children.end(); ++iter)
+        {
+            iter->parent = folder;
+            IndexFolder(&*iter);
+        }
+    }
+
 } // namespace ProtocolUtilities
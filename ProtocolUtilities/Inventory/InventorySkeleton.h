@@ -8,6 +8,8 @@
 
 #include "RexUUID.h"
 
+#include <boost/unordered_map.hpp>
+
 namespace ProtocolUtilities
 {
     class InventoryAssetSkeleton
@@ -108,10 +110,17 @@ namespace ProtocolUtilities
         /// @return Inventory root folder.
         InventoryFolderSkeleton *GetRoot() { return &root_; }
 
+        /// Adds child folder and indexes it by id, along with its children.
+        /// @param parent Parent folder, which must belong to this inventory.
+        /// @param folder Folder to be added.
+        /// @return Pointer to the new child.
+        InventoryFolderSkeleton *AddChildFolder(InventoryFolderSkeleton *parent, const InventoryFolderSkeleton &folder);
+
         /// @return First folder by the requested name or null if the folder isn't found.
         InventoryFolderSkeleton *GetFirstChildFolderByName(const char *searchName);
 
         /// @return Folder by the requested id or null if the folder isn't found.
+        /// @note Uses the id index, so only finds the folders added with InventorySkeleton::AddChildFolder.
         InventoryFolderSkeleton *GetChildFolderById(const RexUUID &searchId);
 
         /// @return Pointer to "My Inventory" folder or null if not found.
@@ -123,9 +132,20 @@ namespace ProtocolUtilities
         /// World Library owner id.
         RexUUID worldLibraryOwnerId;
 
-        private:
+    private:
+        /// Inventory holds pointers to its own folders, so it can't be copied.
+        InventorySkeleton(const InventorySkeleton &);
+        InventorySkeleton &operator =(const InventorySkeleton &);
+
+        /// Adds folder and its children to the id index, and fixes their parent pointers.
+        /// @param folder Folder to be indexed.
+        void IndexFolder(InventoryFolderSkeleton *folder);
+
         /// Root folder.
         InventoryFolderSkeleton root_;
+
+        /// Folders by id.
+        boost::unordered_map<RexUUID, InventoryFolderSkeleton *> folderIndex_;
     };
 }
 
@@ -2,9 +2,18 @@
 #include "StableHeaders.h"
 
 #include <utility>
+#include <cstring>
 
 #include "NetworkConnection.h"
 
+#include <Poco/Net/NetException.h>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#endif
+
 using namespace std;
 
 namespace ProtocolUtilities
@@ -31,6 +40,14 @@ bool NetworkConnection::PacketsAvailable() const
     return socket.available() != 0;
 }
 
+bool NetworkConnection::WaitForPackets(int timeoutMsecs)
+{
+    if (!bOpen)
+        return false;
+
+    return socket.poll(Poco::Timespan(0, timeoutMsecs * 1000), Poco::Net::Socket::SELECT_READ);
+}
+
 int NetworkConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
 {
     int numBytes = min((int)maxCount, socket.available());
@@ -40,6 +57,61 @@ int NetworkConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
     return socket.receiveBytes(bytes, numBytes);
 }
 
+size_t NetworkConnection::ReceiveBatch(uint8_t **buffers, size_t bufferSize, size_t *sizes, size_t maxPackets)
+{
+    if (!bOpen || maxPackets == 0)
+        return 0;
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+    // The message headers live on the stack so that draining the socket does not allocate.
+    static const size_t cMaxBatchSize = 64;
+    maxPackets = min(maxPackets, cMaxBatchSize);
+    mmsghdr headers[cMaxBatchSize];
+    iovec iovecs[cMaxBatchSize];
+    for(size_t i = 0; i < maxPackets; ++i)
+    {
+        iovecs[i].iov_base = buffers[i];
+        iovecs[i].iov_len = bufferSize;
+        memset(&headers[i], 0, sizeof(mmsghdr));
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int received = recvmmsg(socket.impl()->sockfd(), headers, (unsigned int)maxPackets, MSG_DONTWAIT, 0);
+    if (received < 0)
+    {
+        // Only an empty socket means no data. Other errors, such as a refused connection, are reported like the
+        // Poco socket calls would report them, so that the connection gets closed.
+        int error = errno;
+        if (error == EAGAIN || error == EWOULDBLOCK || error == EINTR)
+            return 0;
+        throw Poco::Net::NetException(strerror(error), error);
+    }
+
+    // Datagrams larger than the buffer were cut short by the kernel. Drop them instead of parsing the truncated data.
+    size_t numPackets = 0;
+    for(int i = 0; i < received; ++i)
+    {
+        if (headers[i].msg_hdr.msg_flags & MSG_TRUNC)
+            continue;
+        if (numPackets != (size_t)i)
+            memcpy(buffers[numPackets], buffers[i], headers[i].msg_len);
+        sizes[numPackets++] = headers[i].msg_len;
+    }
+    return numPackets;
+#else
+    size_t received = 0;
+    while(received < maxPackets && PacketsAvailable())
+    {
+        int numBytes = ReceiveBytes(buffers[received], bufferSize);
+        if (numBytes <= 0)
+            break;
+        sizes[received++] = (size_t)numBytes;
+    }
+    return received;
+#endif
+}
+
 void NetworkConnection::SendBytes(const uint8_t *bytes, size_t count)
 {
     socket.sendBytes(bytes, (int)count);
@@ -18,11 +18,25 @@ namespace ProtocolUtilities
         /// @return True if there are available UDP packets in the stream and the socket is open. 
         bool PacketsAvailable() const;
 
+        /// Blocks until there are UDP packets available or the timeout elapses.
+        /// @param timeoutMsecs The maximum time to wait, in milliseconds.
+        /// @return True if there are packets available.
+        bool WaitForPackets(int timeoutMsecs);
+
         /// Reads bytes from the socket. Doesn't block, but returns 0 if no bytes available.
         /// @param maxCount The maximum number of bytes to fill into the buffer.
         /// @return The number of bytes that was actually filled into the buffer.
         int ReceiveBytes(uint8_t *bytes, size_t maxCount);
 
+        /// Reads up to maxPackets datagrams from the socket with as few system calls as possible. Doesn't block.
+        /** On Linux this maps to a single recvmmsg() call, elsewhere it falls back to repeated ReceiveBytes calls.
+            @param buffers Array of maxPackets destination buffers, each bufferSize bytes long.
+            @param bufferSize The size of each destination buffer in bytes.
+            @param sizes [out] Array of maxPackets entries that receives the size of each datagram read.
+            @param maxPackets The maximum number of datagrams to read.
+            @return The number of datagrams that were read. */
+        size_t ReceiveBatch(uint8_t **buffers, size_t bufferSize, size_t *sizes, size_t maxPackets);
+
         /// Pushes out a packet with the given contents.
         void SendBytes(const uint8_t *bytes, size_t count);
 
@@ -0,0 +1,67 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "InboundPacketRing.h"
+
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "MemoryLeakCheck.h"
+
+/// Full memory barrier, so that the slot contents are visible to the other thread before the index that publishes them.
+#ifdef _MSC_VER
+#define RING_MEMORY_BARRIER() _ReadWriteBarrier(); MemoryBarrier()
+#else
+#define RING_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+namespace ProtocolUtilities
+{
+
+InboundPacketRing::InboundPacketRing(size_t numSlots) :
+    slots(numSlots),
+    writeIndex(0),
+    readIndex(0)
+{
+    assert(numSlots > 0);
+}
+
+InboundPacketRing::Slot *InboundPacketRing::WritableSlot(size_t index)
+{
+    RING_MEMORY_BARRIER();
+    const size_t used = writeIndex - readIndex;
+    if (used + index >= slots.size())
+        return 0;
+
+    return &slots[(writeIndex + index) % slots.size()];
+}
+
+void InboundPacketRing::CommitWrite(size_t count)
+{
+    assert(writeIndex - readIndex + count <= slots.size());
+    RING_MEMORY_BARRIER();
+    writeIndex = writeIndex + count;
+}
+
+InboundPacketRing::Slot *InboundPacketRing::BeginRead()
+{
+    RING_MEMORY_BARRIER();
+    if (readIndex == writeIndex)
+        return 0;
+
+    return &slots[readIndex % slots.size()];
+}
+
+void InboundPacketRing::EndRead()
+{
+    assert(readIndex != writeIndex);
+    RING_MEMORY_BARRIER();
+    readIndex = readIndex + 1;
+}
+
+}
@@ -0,0 +1,110 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_ProtocolUtilities_InboundPacketRing_h
+#define incl_ProtocolUtilities_InboundPacketRing_h
+
+#include <vector>
+
+#include "RexTypes.h"
+#include "NetMessage.h"
+
+namespace ProtocolUtilities
+{
+    /// A preallocated ring of fixed-size receive slots for inbound UDP datagrams. Used by NetMessageManager
+    /// so that receiving and parsing packets does not allocate memory at runtime.
+    /** The ring is a lock-free single-producer, single-consumer queue: one thread receives datagrams into
+        writable slots and publishes them with CommitWrite, another thread reads the published slots in order
+        and hands them back with EndRead once the message listeners are done with them. Both sides may also
+        be the same thread. Each slot carries scratch memory for the zero-decoded message body and the results
+        of pre-parsing the datagram, so that the consumer can parse the message in place.
+        \ingroup OpenSimProtocolClient */
+    class InboundPacketRing
+    {
+    public:
+        /// The maximum size of a single datagram, in bytes.
+        static const size_t cMaxPayload = 2048;
+
+        /// The size of the zero-decoding scratch memory of a slot, in bytes. Messages that expand to more than this
+        /// are handed to the consumer still zero-encoded.
+        static const size_t cDecodeBufferSize = 8192;
+
+        /// A single receive slot.
+        struct Slot
+        {
+            /// The raw datagram.
+            uint8_t data[cMaxPayload];
+
+            /// The number of bytes in data.
+            size_t numBytes;
+
+            /// Scratch memory for zero-decoding the message body.
+            uint8_t decodeBuffer[cDecodeBufferSize];
+
+            // The following are filled in by NetMessageManager when the datagram is pre-parsed.
+
+            /// If false, the datagram was a duplicate or malformed and should be skipped.
+            bool valid;
+
+            /// The packet sequence number.
+            uint32_t sequenceNumber;
+
+            /// Points to the message body inside data or decodeBuffer.
+            const uint8_t *body;
+
+            /// The size of the message body, in bytes.
+            size_t bodySize;
+
+            /// True if body is still zero-encoded.
+            bool bodyZeroEncoded;
+
+            /// Points to the acks appended to the datagram, or 0 if there are none.
+            const uint8_t *appendedAcks;
+
+            /// The number of appended acks.
+            size_t numAppendedAcks;
+
+            /// The number of packets detected as lost right before this one. Used for statistics only.
+            size_t numLostBefore;
+        };
+
+        /// Constructor. Allocates all the slots up front.
+        /// @param numSlots The number of slots in the ring.
+        explicit InboundPacketRing(size_t numSlots);
+
+        /// Producer: returns the index'th free slot after the already published ones, or 0 if there are not that many free slots.
+        Slot *WritableSlot(size_t index);
+
+        /// Producer: publishes the first count writable slots to the consumer.
+        void CommitWrite(size_t count);
+
+        /// Consumer: returns the oldest published slot, or 0 if there is none.
+        Slot *BeginRead();
+
+        /// Consumer: returns the slot obtained with BeginRead back to the producer.
+        void EndRead();
+
+        /// @return The number of published slots that have not been read yet. Only approximate if called while the other side is running.
+        size_t NumReadableSlots() const { return writeIndex - readIndex; }
+
+        /// @return The total number of slots.
+        size_t NumSlots() const { return slots.size(); }
+
+        /// Returns all slots back to the producer. Not thread-safe, call only when neither side is running.
+        void Clear() { readIndex = writeIndex = 0; }
+
+    private:
+        InboundPacketRing(const InboundPacketRing &);
+        void operator=(const InboundPacketRing &);
+
+        /// The slot storage.
+        std::vector<Slot> slots;
+
+        /// Running count of slots published by the producer. Written by the producer thread only.
+        volatile size_t writeIndex;
+
+        /// Running count of slots returned by the consumer. Written by the consumer thread only.
+        volatile size_t readIndex;
+    };
+}
+
+#endif // incl_ProtocolUtilities_InboundPacketRing_h
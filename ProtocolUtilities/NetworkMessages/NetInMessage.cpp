@@ -100,38 +100,77 @@ static uint8_t *ComputeMessageContentStartAddrAndLength(uint8_t *data, size_t nu
 */
 
 NetInMessage::NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroCoded) :
-    messageInfo(0), sequenceNumber(seqNum)
+    messageInfo(0), sequenceNumber(seqNum), messageData(0), messageDataSize(0)
+{
+    InitMessageData(data, numBytes, zeroCoded, 0, 0, true);
+}
+
+NetInMessage::NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroCoded,
+    uint8_t *decodeBuffer, size_t decodeBufferSize) :
+    messageInfo(0), sequenceNumber(seqNum), messageData(0), messageDataSize(0)
+{
+    InitMessageData(data, numBytes, zeroCoded, decodeBuffer, decodeBufferSize, false);
+}
+
+void NetInMessage::InitMessageData(const uint8_t *data, size_t numBytes, bool zeroCoded,
+    uint8_t *decodeBuffer, size_t decodeBufferSize, bool copyData)
 {
     if (zeroCoded)
     {
         size_t decodedLength = CountZeroDecodedLength(data, numBytes);
         if (decodedLength == 0)
             throw Exception("Corrupted zero-encoded stream received!");
-        messageData.resize(decodedLength, 0); ///\todo Can optimize here for extra-extra bit of performance if profiling shows the need for so..
-        bool success = ZeroDecode(&messageData[0], decodedLength, data, numBytes);
+
+        // Expand into the caller's scratch memory if it is large enough, otherwise fall back to owned storage.
+        uint8_t *dst = decodeBuffer;
+        if (!dst || decodedLength > decodeBufferSize)
+        {
+            ownedData.resize(decodedLength, 0);
+            dst = &ownedData[0];
+        }
+        bool success = ZeroDecode(dst, decodedLength, data, numBytes);
         if (!success)
             throw Exception("Zero-decoding input data failed!");
+        messageData = dst;
+        messageDataSize = decodedLength;
+    }
+    else if (copyData)
+    {
+        ownedData.reserve(numBytes);
+        ownedData.insert(ownedData.end(), data, data + numBytes);
+        messageData = ownedData.empty() ? 0 : &ownedData[0];
+        messageDataSize = numBytes;
     }
     else
     {
-        messageData.reserve(numBytes);
-        messageData.insert(messageData.end(), data, data + numBytes);
+        // Parse in place, the receive buffer stays owned by the caller.
+        messageData = data;
+        messageDataSize = numBytes;
     }
 
     size_t messageIDLength = 0;
-    messageID = ExtractNetworkMessageID(&messageData[0], numBytes, &messageIDLength);
+    messageID = ExtractNetworkMessageID(messageData, messageDataSize, &messageIDLength);
     if (messageIDLength == 0)
         throw Exception("Malformed SLUDP packet read! MessageID not present!");
-    
-    // We remove the messageID from the beginning of the message data buffer, since we just want to store the message content.
-    messageData.erase(messageData.begin(), messageData.begin() + messageIDLength);
+
+    // We skip the messageID at the beginning of the message data buffer, since we just want to store the message content.
+    messageData += messageIDLength;
+    messageDataSize -= messageIDLength;
+}
+
+NetMsgID NetInMessage::ExtractMessageID(const uint8_t *data, size_t numBytes, size_t *messageIDLength)
+{
+    return ExtractNetworkMessageID(data, numBytes, messageIDLength);
 }
 
 NetInMessage::NetInMessage(const NetInMessage &rhs)
 {
     sequenceNumber = rhs.sequenceNumber;
     messageInfo = rhs.messageInfo;
-    messageData = rhs.messageData;
+    // Copies always own their data, so that they can outlive the receive buffer the original was parsed from.
+    ownedData.assign(rhs.messageData, rhs.messageData + rhs.messageDataSize);
+    messageData = ownedData.empty() ? 0 : &ownedData[0];
+    messageDataSize = rhs.messageDataSize;
     currentBlock = rhs.currentBlock;
     currentBlockInstanceNumber = rhs.currentBlockInstanceNumber;
     currentBlockInstanceCount = rhs.currentBlockInstanceCount;
@@ -619,7 +658,7 @@ void NetInMessage::StartReadingNextBlock()
         return;
     case NetBlockVariable:
         // Malformity check.
-        if (bytesRead >= messageData.size())
+        if (bytesRead >= messageDataSize)
         {
             SkipToPacketEnd();
             return;
@@ -633,7 +672,7 @@ void NetInMessage::StartReadingNextBlock()
             ++currentBlock;
 
             // Malformity check.
-            if (bytesRead >= messageData.size() || currentBlock >= messageInfo->blocks.size())
+            if (bytesRead >= messageDataSize || currentBlock >= messageInfo->blocks.size())
             {
                 SkipToPacketEnd();
                 return;
@@ -667,7 +706,7 @@ void NetInMessage::ReadNextVariableSize()
     {
     case NetVarBufferByte:
         // Variable-sized variable, size denoted with 1 byte.
-        if (bytesRead >= messageData.size())
+        if (bytesRead >= messageDataSize)
         {
             SkipToPacketEnd();
             return;
@@ -679,7 +718,7 @@ void NetInMessage::ReadNextVariableSize()
         return;
     case NetVarBuffer2Bytes:
         // Variable-sized variable, size denoted with 2 bytes.
-        if (bytesRead + 1 >= messageData.size())
+        if (bytesRead + 1 >= messageDataSize)
         {
             SkipToPacketEnd();
             return;
@@ -707,17 +746,18 @@ void NetInMessage::ReadNextVariableSize()
 
 void *NetInMessage::ReadBytesUnchecked(size_t count)
 {
-    if (bytesRead >= messageData.size() || count == 0)
+    if (bytesRead >= messageDataSize || count == 0)
         return 0;
 
-    if (bytesRead + count > messageData.size())
+    if (bytesRead + count > messageDataSize)
     {
-        bytesRead = messageData.size(); // Jump to the end of the whole message so that we don't after this read anything.
+        bytesRead = messageDataSize; // Jump to the end of the whole message so that we don't after this read anything.
         std::cout << "Error: Size of the message exceeded. Can't read bytes anymore." << std::endl;
         return 0;
     }
 
-    void *data = &messageData[bytesRead];
+    // Callers only read through the returned pointer; the data may live in a shared receive buffer.
+    void *data = const_cast<uint8_t *>(&messageData[bytesRead]);
     bytesRead += count;
 
     return data;
@@ -731,7 +771,7 @@ void NetInMessage::SkipToPacketEnd()
     currentBlockInstanceCount = 0;
     currentVariable = 0;
     currentVariableSize = 0;
-    bytesRead = messageData.size();
+    bytesRead = messageDataSize;
 }
 
 void NetInMessage::RequireNextVariableType(NetVariableType type)
@@ -27,9 +27,28 @@ namespace ProtocolUtilities
         */
         NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroEncoded);
 
+        /// Constructor that parses the message in place over a caller-owned receive buffer.
+        /** Unencoded data is not copied and zero-encoded data is expanded into decodeBuffer. If decodeBuffer
+            is too small, the message allocates storage of its own. The buffers must outlive the message.
+            @param seqNum Sequence number of this message.
+            @param data Data buffer.
+            @param numBytes Number of bytes.
+            @param zeroEncoded Is this data zero-encoded.
+            @param decodeBuffer Scratch memory for zero-decoding.
+            @param decodeBufferSize Size of decodeBuffer in bytes.
+        */
+        NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroEncoded, uint8_t *decodeBuffer, size_t decodeBufferSize);
+
         /// Destructor.
         ~NetInMessage();
 
+        /// Reads the message number from the given byte stream that represents an SLUDP message body.
+        /// @param data Pointer to the start of the (zero-decoded) message body.
+        /// @param numBytes The number of bytes in data.
+        /// @param [out] messageIDLength The number of bytes taken by the VLE-encoding of the message ID, or 0 if the message was malformed.
+        /// @return The message number.
+        static NetMsgID ExtractMessageID(const uint8_t *data, size_t numBytes, size_t *messageIDLength);
+
         /// Copy-constuctor.
         NetInMessage(const NetInMessage &rhs);
 
@@ -124,10 +143,10 @@ namespace ProtocolUtilities
         const NetMessageInfo *GetMessageInfo() const { return messageInfo; }
 
         /// @return The original message data.
-        const std::vector<uint8_t> &GetData() const { return messageData; }
+        const uint8_t *GetData() const { return messageData; }
 
         /// @return The size of the data (message body, the header is excluded). 
-        size_t GetDataSize() const { return messageData.size(); }
+        size_t GetDataSize() const { return messageDataSize; }
 
         /// @return The amount of read bytes.
         uint32_t BytesRead() const { return (uint32_t)bytesRead; }
@@ -141,6 +160,9 @@ namespace ProtocolUtilities
 #endif
     private:
         void operator=(const NetInMessage &);
+
+        /// Sets up messageData over the given bytes and extracts the message ID.
+        void InitMessageData(const uint8_t *data, size_t numBytes, bool zeroCoded, uint8_t *decodeBuffer, size_t decodeBufferSize, bool copyData);
         
         /// Called to start reading the next variable.
         void AdvanceToNextVariable();
@@ -166,8 +188,14 @@ namespace ProtocolUtilities
         /// Identifies what kind of packet we're handling.
         const NetMessageInfo *messageInfo;
         
-        /// A pointer to the inbound message body
-        std::vector<uint8_t> messageData;
+        /// Storage for the message body, used when the message owns its data.
+        std::vector<uint8_t> ownedData;
+
+        /// A pointer to the inbound message body, either into ownedData or into an external receive buffer.
+        const uint8_t *messageData;
+
+        /// The size of the message body in bytes.
+        size_t messageDataSize;
         
         /// Index of the current block.
         size_t currentBlock;
@@ -12,6 +12,7 @@
 #include "Interfaces/INetMessageListener.h"
 
 #include "Profiler.h"
+#include "CoreStringUtils.h"
 
 #include <iomanip>
 #include <iostream>
@@ -20,9 +21,14 @@
 #include <cstring>
 
 #include <boost/timer.hpp>
+#include <boost/bind.hpp>
 
 #include <Poco/Net/NetException.h>
 
+#include "LoggingFunctions.h"
+
+DEFINE_POCO_LOGGING_FUNCTIONS("NetMessageManager");
+
 #include "MemoryLeakCheck.h"
 
 using namespace std;
@@ -86,29 +92,24 @@ namespace ProtocolUtilities
         return data + 6 + extraHeaderSize;
     }
 
-    /// Returns a list of appended acks from packet
+    /// Locates the acks appended to the end of a packet.
     /// @param data A pointer to the message data.
     /// @param numBytes The size of data, in bytes.
-    static std::vector<uint32_t> GetAppendedAckList(uint8_t *data, size_t numBytes)
+    /// @param ackData [out] Receives a pointer to the first appended ack. The acks are stored as consecutive big-endian u32s.
+    /// @return The number of appended acks, or 0 if there are none or the packet was malformed.
+    static size_t GetAppendedAcks(const uint8_t *data, size_t numBytes, const uint8_t **ackData)
     {
-        std::vector<uint32_t> acks;
-        if ((data[0] & NetFlagAck) && (numBytes > 6))
-        {
-            if (numBytes > 6)
-            {
-                size_t num_acks = data[numBytes-1];
-                acks.resize(num_acks);
-                
-                int idx = numBytes - 1 - num_acks * 4;
-                if (idx < 6) return acks;
-                
-                for (size_t i = 0; i < num_acks; ++i)
-                {
-                    acks.push_back((uint32_t)ntohl(*(u_long*)&data[idx]));
-                }
-            }
-        }
-        return acks;
+        assert(ackData);
+        *ackData = 0;
+        if (!(data[0] & NetFlagAck) || numBytes <= 6)
+            return 0;
+
+        const size_t num_acks = data[numBytes-1];
+        if (numBytes - 1 < 6 + num_acks * 4)
+            return 0;
+
+        *ackData = &data[numBytes - 1 - num_acks * 4];
+        return num_acks;
     }
 
     /// const version of above.
@@ -143,9 +144,40 @@ namespace ProtocolUtilities
         return data[type];
     }
 
+    namespace
+    {
+        typedef SequenceIndexedWindow<NetOutMessage*>::Entry ResendEntry;
+
+        /// Frees the messages of the resend queue when the message pool is cleared.
+        struct DeleteResendMessage
+        {
+            void operator()(ResendEntry &entry) { delete entry.value; }
+        };
+
+        /// Picks the messages of the resend queue that have waited for an ack for longer than the timeout, and restarts their timers.
+        struct CollectTimedOutMessages
+        {
+            CollectTimedOutMessages(time_t timeNow, time_t timeout) : timeNow(timeNow), timeout(timeout) {}
+
+            void operator()(ResendEntry &entry)
+            {
+                if (timeNow - entry.time >= timeout)
+                {
+                    entry.time = timeNow;
+                    messages.push_back(entry.value);
+                }
+            }
+
+            time_t timeNow;
+            time_t timeout;
+            std::vector<NetOutMessage *> messages;
+        };
+    }
+
     NetMessageManager::NetMessageManager(const char *messageListFilename)
     :messageList(boost::shared_ptr<NetMessageList>(new NetMessageList(messageListFilename)))
     ,messageListener(0)
+    ,unackedReliableBytes(0)
     ,sequenceNumber(1) // Note here: We always start outbound communication with PacketID==1.
     ,lastReceivedSequenceNumber(0)
 #ifdef PROFILING
@@ -162,14 +194,20 @@ namespace ProtocolUtilities
     ,lastHeardSince(0.0)
     ,lastHeardSinceTick(0)
     ,pingId(0)
+    ,inboundPackets(cInboundPacketRingSize)
+    ,threadedReceive(false)
+    ,receiveThreadRunning(false)
+    ,stopReceiveThread(false)
+    ,receiveThreadFailed(false)
     {
-        receivedSequenceNumbers.clear();
+        receivedSequenceNumbers.Clear();
     }
 
     NetMessageManager::~NetMessageManager()
     {
+        StopReceiveThread();
         ClearMessagePoolMemory();
-        receivedSequenceNumbers.clear();
+        receivedSequenceNumbers.Clear();
     }
 
     void NetMessageManager::DumpNetworkMessage(NetMsgID id, NetInMessage *msg)
@@ -251,28 +289,26 @@ namespace ProtocolUtilities
 
 #endif
 
-    void NetMessageManager::HandleInboundBytes(std::vector<uint8_t> &data)
+    bool NetMessageManager::PreprocessInboundSlot(InboundPacketRing::Slot &slot)
     {
-        const size_t numBytes = data.size();
-#ifdef PROFILING
-        receivedDatagrams.InsertRecord(1.0);
-        receivedDatabytes.InsertRecord(numBytes);
-#endif
+        slot.valid = false;
+        slot.numLostBefore = 0;
+        slot.appendedAcks = 0;
+        slot.numAppendedAcks = 0;
 
-        if (!messageListener)
-        {
-            cout << "No UDP message listener set! Dropping incoming packet as unhandled:" << endl;
-//            DumpNetworkMessage(&data[0], numBytes);
-            return;
-        }
+        uint8_t *data = slot.data;
+        const size_t numBytes = slot.numBytes;
+        if (numBytes == 0)
+            return false;
 
-        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(&data[0], numBytes);
+        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(data, numBytes);
+        slot.sequenceNumber = seqNum;
 
 #ifdef PROFILING
-        if (receivedSequenceNumbers.size() > 0 && seqNum - lastReceivedSequenceNumber < 16)
-            for(int i = lastReceivedSequenceNumber+1; i < seqNum; ++i)
-                if (receivedSequenceNumbers.find(i) == receivedSequenceNumbers.end())
-                    lostPackets.InsertRecord(1.0);
+        if (!receivedSequenceNumbers.Empty() && seqNum - lastReceivedSequenceNumber < 16)
+            for(uint32_t i = lastReceivedSequenceNumber+1; i < seqNum; ++i)
+                if (!receivedSequenceNumbers.Contains(i))
+                    ++slot.numLostBefore;
 #endif
         lastReceivedSequenceNumber = seqNum;
 
@@ -280,32 +316,99 @@ namespace ProtocolUtilities
         if ((data[0] & NetFlagReliable) != 0)
             QueuePacketACK(seqNum);
 
-        // We need to do pruning of inbound duplicates, so add the sequence number to the set of received sequence numbers, 
+        // We need to do pruning of inbound duplicates, so add the sequence number to the window of received sequence numbers, 
         // and check if we've seen this packet before.
-        pair<set<uint32_t>::iterator, bool> ret = receivedSequenceNumbers.insert(seqNum);
-        if (ret.second == false) 
+        if (!receivedSequenceNumbers.Insert(seqNum))
         {
 #ifdef PROFILING
-            duplicatesReceived.InsertRecord(1.0);
+            slot.numLostBefore = (size_t)-1; // Flags the slot as a duplicate for the statistics.
 #endif
-            return; // A message with this sequence number has already been given to the application for processing. Drop it this time.
+            return false; // A message with this sequence number has already been given to the application for processing. Drop it this time.
         }
 
-//        NetMsgID id = ExtractNetworkMessageNumber(&data[0], numBytes);
-
         size_t messageLength = 0;
-        const uint8_t *message = ComputeMessageBodyStartAddrAndLength(&data[0], numBytes, &messageLength);
+        const uint8_t *message = ComputeMessageBodyStartAddrAndLength(data, numBytes, &messageLength);
         if (!message)
         {
-            cout << "Malformed packet received, could not determine message size" << endl;
+            LogWarning("Malformed packet received, could not determine message size");
+            return false;
+        }
+
+        slot.numAppendedAcks = GetAppendedAcks(data, numBytes, &slot.appendedAcks);
+
+        // Expand zero-encoded bodies into the slot's scratch memory, so that the message can later be parsed in place.
+        slot.body = message;
+        slot.bodySize = messageLength;
+        slot.bodyZeroEncoded = false;
+        if ((data[0] & NetFlagZeroCode) != 0)
+        {
+            const size_t decodedLength = CountZeroDecodedLength(message, messageLength);
+            if (decodedLength == 0)
+            {
+                LogWarning("Corrupted zero-encoded stream received!");
+                return false;
+            }
+            if (decodedLength <= InboundPacketRing::cDecodeBufferSize)
+            {
+                if (!ZeroDecode(slot.decodeBuffer, decodedLength, message, messageLength))
+                {
+                    LogWarning("Zero-decoding input data failed!");
+                    return false;
+                }
+                slot.body = slot.decodeBuffer;
+                slot.bodySize = decodedLength;
+            }
+            else
+                slot.bodyZeroEncoded = true; // Too large for the scratch memory, NetInMessage decodes it into memory of its own.
+        }
+
+        // Look up the message description already here. The message list is not modified after loading, so this is thread-safe.
+        if (!slot.bodyZeroEncoded)
+        {
+            size_t messageIDLength = 0;
+            const NetMsgID id = NetInMessage::ExtractMessageID(slot.body, slot.bodySize, &messageIDLength);
+            if (messageIDLength == 0)
+            {
+                LogWarning("Malformed SLUDP packet read! MessageID not present!");
+                return false;
+            }
+            if (!messageList->GetMessageInfoByID(id))
+            {
+                LogWarning("Unknown message received with Message ID " + ToString(id) + "!");
+                return false;
+            }
+        }
+
+        slot.valid = true;
+        return true;
+    }
+
+    void NetMessageManager::DispatchInboundSlot(InboundPacketRing::Slot &slot)
+    {
+#ifdef PROFILING
+        receivedDatagrams.InsertRecord(1.0);
+        receivedDatabytes.InsertRecord(slot.numBytes);
+        if (slot.numLostBefore == (size_t)-1)
+            duplicatesReceived.InsertRecord(1.0);
+        else
+            for(size_t i = 0; i < slot.numLostBefore; ++i)
+                lostPackets.InsertRecord(1.0);
+#endif
+
+        if (!messageListener)
+        {
+            cout << "No UDP message listener set! Dropping incoming packet as unhandled:" << endl;
+//            DumpNetworkMessage(slot.data, slot.numBytes);
             return;
         }
-        
-        std::vector<uint32_t> appended_acks = GetAppendedAckList(&data[0], numBytes);
-        
+
+        if (!slot.valid)
+            return;
+
         try
         {
-            NetInMessage msg(seqNum, &message[0], messageLength, (data[0] & NetFlagZeroCode) != 0);
+            // Parse the message in place over the receive slot.
+            NetInMessage msg(slot.sequenceNumber, slot.body, slot.bodySize, slot.bodyZeroEncoded, 0, 0);
 
             const NetMessageInfo *messageInfo = messageList->GetMessageInfoByID(msg.GetMessageID());
             if (!messageInfo)
@@ -316,9 +419,8 @@ namespace ProtocolUtilities
             msg.SetMessageInfo(messageInfo);
 
             // Process appended acks
-            if (appended_acks.size() > 0)
-                for(unsigned i = 0; i < appended_acks.size(); ++i)
-                    ProcessPacketACK(appended_acks[i]);
+            for(size_t i = 0; i < slot.numAppendedAcks; ++i)
+                ProcessPacketACK((uint32_t)ntohl(*(u_long*)&slot.appendedAcks[i * 4]));
 
             // NetMessageManager handles all Acks and Pings. Those are not passed to the application.
             switch(msg.GetMessageID())
@@ -345,16 +447,53 @@ namespace ProtocolUtilities
         }
     }
 
-    static void FlipBits(std::vector<uint8_t> &data, int numBitsToFlip)
+    void NetMessageManager::HandleInboundBytes(InboundPacketRing::Slot &slot)
+    {
+        PreprocessInboundSlot(slot);
+        DispatchInboundSlot(slot);
+    }
+
+    static void FlipBits(uint8_t *data, size_t numBytes, int numBitsToFlip)
     {
         while(numBitsToFlip-- > 0)
         {
-            int idx = rand() % data.size();
+            int idx = rand() % numBytes;
             uint8_t bit = 1 << (rand() % 8);
             data[idx] ^= bit;
         }
     }
 
+    size_t NetMessageManager::ReceiveIntoRing(bool preprocess)
+    {
+        // Receive a batch of datagrams straight into free slots of the packet ring.
+        InboundPacketRing::Slot *batch[cMaxReceiveBatch];
+        uint8_t *buffers[cMaxReceiveBatch];
+        size_t sizes[cMaxReceiveBatch];
+        size_t numSlots = 0;
+        while(numSlots < cMaxReceiveBatch)
+        {
+            InboundPacketRing::Slot *slot = inboundPackets.WritableSlot(numSlots);
+            if (!slot)
+                break;
+            batch[numSlots] = slot;
+            buffers[numSlots] = slot->data;
+            ++numSlots;
+        }
+        if (numSlots == 0)
+            return 0;
+
+        const size_t numReceived = connection->ReceiveBatch(buffers, InboundPacketRing::cMaxPayload, sizes, numSlots);
+        for(size_t i = 0; i < numReceived; ++i)
+        {
+            batch[i]->numBytes = sizes[i];
+            if (preprocess)
+                PreprocessInboundSlot(*batch[i]);
+        }
+
+        inboundPackets.CommitWrite(numReceived);
+        return numReceived;
+    }
+
     /// Polls the inbound socket until the message queue is empty. Also resends any timed out reliable messages.
     void NetMessageManager::ProcessMessages()
     {
@@ -370,44 +509,185 @@ namespace ProtocolUtilities
         boost::timer timer;
 
         PROFILE(NetMessageManager_WhilePacketsAvailable);
-        while(connection->PacketsAvailable() && timer.elapsed() < MAX_PROCESS_TIME)
+        const bool threaded = receiveThreadRunning;
+        while(timer.elapsed() < MAX_PROCESS_TIME)
         {
-            const int cMaxPayload = 2048;
-            std::vector<uint8_t> data(cMaxPayload, 0);
-            int numBytes = connection->ReceiveBytes(&data[0], cMaxPayload);
-            if (numBytes == 0)
-                break;
+            // When the receive thread is running, it keeps the ring filled with received and pre-parsed datagrams.
+            // Otherwise receive the next batch here.
+            if (!threaded && !inboundPackets.BeginRead())
+            {
+                if (!connection->PacketsAvailable() || ReceiveIntoRing(false) == 0)
+                    break;
+            }
 
-            data.resize(numBytes);
+            InboundPacketRing::Slot *slot = inboundPackets.BeginRead();
+            if (!slot)
+                break;
 
             tick_t now = GetCurrentClockTime();
             lastHeardSince = (double)(now - lastHeardSinceTick) / GetCurrentClockFreq() * 1000;
             lastHeardSinceTick = now;
 
-#ifdef PROTOCOL_STRESS_TEST
-            const int numDuplications = 10;
-            const double bitErrorRate = 0.05;
-            for(int i = 0; i < numDuplications; ++i)
+            if (threaded)
+                DispatchInboundSlot(*slot);
+            else
             {
+#ifdef PROTOCOL_STRESS_TEST
+                const int numDuplications = 10;
+                const double bitErrorRate = 0.05;
+                for(int i = 0; i < numDuplications && slot->numBytes > 0; ++i)
+                {
 #endif
-                HandleInboundBytes(data);
+                    HandleInboundBytes(*slot);
 #ifdef PROTOCOL_STRESS_TEST
-                FlipBits(data, (int)ceil(data.size() * bitErrorRate));
-            }
+                    FlipBits(slot->data, slot->numBytes, (int)ceil(slot->numBytes * bitErrorRate));
+                }
 #endif
+            }
+
+            // The listeners are done with the message, so the slot can be reused.
+            inboundPackets.EndRead();
+        }
+
+        // Report errors of the receive thread the same way as if they had occurred on this thread.
+        if (receiveThreadFailed)
+        {
+            StopReceiveThread();
+            throw Poco::Net::NetException(receiveThreadError);
         }
+
         if (!connection->Open())
+        {
+            StopReceiveThread();
             connection.reset();
+            pendingACKs.clear();
+            return;
+        }
+
+        // Acknowledge all the new accumulated packets that the server sent as reliable. With the receive thread
+        // running, it sends the acks itself as soon as the packets arrive.
+        if (!threaded)
+            SendPendingACKs();
 
-        // To keep memory footprint down and to defend against memory attacks, keep the list of seen sequence numbers to a fixed size.
-        const size_t cMaxSeqNumMemorySize = 300;
-        while(receivedSequenceNumbers.size() > cMaxSeqNumMemorySize)
-            receivedSequenceNumbers.erase(receivedSequenceNumbers.begin()); // We remove from the front to guarantee the smallest(oldest) are removed first.
+        ManagePingSends();
+    }
+
+    void NetMessageManager::SetThreadedReceive(bool enable)
+    {
+        threadedReceive = enable;
+        if (!connection)
+            return;
+
+        if (enable)
+            StartReceiveThread();
+        else
+            StopReceiveThread();
+    }
+
+    void NetMessageManager::StartReceiveThread()
+    {
+        if (receiveThreadRunning || !connection)
+            return;
 
-        // Acknowledge all the new accumulated packets that the server sent as reliable.
+        // Hand the packets that were already received on this thread to the application first,
+        // since the receive thread takes over duplicate tracking and acking.
+        while(InboundPacketRing::Slot *slot = inboundPackets.BeginRead())
+        {
+            HandleInboundBytes(*slot);
+            inboundPackets.EndRead();
+        }
         SendPendingACKs();
 
-        ManagePingSends();
+        receiveThreadFailed = false;
+        stopReceiveThread = false;
+        receiveThreadRunning = true;
+        receiveThread = boost::thread(boost::bind(&NetMessageManager::ReceiveThreadMain, this));
+    }
+
+    void NetMessageManager::StopReceiveThread()
+    {
+        if (!receiveThreadRunning)
+            return;
+
+        stopReceiveThread = true;
+        receiveThread.join();
+        receiveThreadRunning = false;
+    }
+
+    void NetMessageManager::ReceiveThreadMain()
+    {
+        // How long to wait for the socket to become readable before checking whether we should exit.
+        const int cPollTimeoutMsecs = 10;
+
+        try
+        {
+            while(!stopReceiveThread && connection->Open())
+            {
+                if (!connection->WaitForPackets(cPollTimeoutMsecs))
+                    continue;
+
+                // Keep draining until the socket is empty or the main thread falls behind and the ring fills up.
+                size_t numReceived = 0;
+                while(!stopReceiveThread && connection->PacketsAvailable())
+                {
+                    const size_t n = ReceiveIntoRing(true);
+                    if (n == 0)
+                        break;
+                    numReceived += n;
+                    SendPendingACKsFromReceiveThread();
+                }
+
+                if (numReceived == 0)
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            }
+        }
+        // Any error stops the thread. ProcessMessages reports it on the main thread, which then disconnects.
+        catch(Poco::Exception &e)
+        {
+            receiveThreadError = e.displayText();
+            receiveThreadFailed = true;
+        }
+        catch(std::exception &e)
+        {
+            receiveThreadError = e.what();
+            receiveThreadFailed = true;
+        }
+        catch(...)
+        {
+            receiveThreadError = "Unknown error in the network receive thread";
+            receiveThreadFailed = true;
+        }
+    }
+
+    void NetMessageManager::SendPendingACKsFromReceiveThread()
+    {
+        static const size_t max_acks_in_msg = 100;
+
+        // The receive thread owns its own message struct and doesn't go through the message pools or the listener,
+        // which belong to the main thread.
+        if (!receiveThreadAckMessage)
+            receiveThreadAckMessage = boost::shared_ptr<NetOutMessage>(new NetOutMessage());
+        const NetMessageInfo *info = messageList->GetMessageInfoByID(RexNetMsgPacketAck);
+        assert(info);
+
+        while(pendingACKs.size() > 0)
+        {
+            const size_t acks_to_send = std::min(pendingACKs.size(), max_acks_in_msg);
+
+            NetOutMessage *m = receiveThreadAckMessage.get();
+            m->ResetWriting();
+            m->SetMessageInfo(info);
+            m->AddMessageHeader();
+            m->SetVariableBlockCount(acks_to_send);
+            for(size_t added_acks = 0; added_acks < acks_to_send; ++added_acks)
+            {
+                // See SendPendingACKs for why there's no endianness conversion here.
+                m->AddU32(pendingACKs.front());
+                pendingACKs.pop_front();
+            }
+            m->SetSequenceNumber(GetNewSequenceNumber());
+            connection->SendBytes(&m->GetData()[0], m->BytesFilled());
+        }
     }
 
     bool NetMessageManager::ConnectTo(const char *serverAddress, int port)
@@ -416,6 +696,8 @@ namespace ProtocolUtilities
         {
             connection = boost::shared_ptr<NetworkConnection>(new NetworkConnection(serverAddress, port));
             pingSendTimer.restart();
+            if (threadedReceive)
+                StartReceiveThread();
             return true;
         }
         catch(Poco::Net::NetException &e)
@@ -427,9 +709,12 @@ namespace ProtocolUtilities
 
     void NetMessageManager::Disconnect()
     {
+        StopReceiveThread();
         connection->Close();
         ClearMessagePoolMemory();
-        receivedSequenceNumbers.clear();
+        receivedSequenceNumbers.Clear();
+        pendingACKs.clear();
+        inboundPackets.Clear();
     }
 
     NetOutMessage *NetMessageManager::StartNewMessage(NetMsgID id)
@@ -539,7 +824,7 @@ namespace ProtocolUtilities
 
     void NetMessageManager::QueuePacketACK(uint32_t packetID)
     {
-        pendingACKs.insert(packetID);
+        pendingACKs.push_back(packetID);
     }
 
     void NetMessageManager::ClearMessagePoolMemory()
@@ -552,12 +837,13 @@ namespace ProtocolUtilities
         for(std::list<NetOutMessage*>::iterator iter = usedMessagePool.begin(); iter != usedMessagePool.end(); ++iter)
             delete *iter;
 
-        for(MessageResendList::iterator iter = messageResendQueue.begin(); iter != messageResendQueue.end(); ++iter)
-            delete iter->second;
+        DeleteResendMessage deleteMessage;
+        messageResendQueue.ForEach(deleteMessage);
 
         unusedMessagePool.clear();
         usedMessagePool.clear();
-        messageResendQueue.clear();
+        messageResendQueue.Clear();
+        unackedReliableBytes = 0;
     }
 
     ///\todo Have better delay method for pending ACKs, currently sends everything accumulated just over one frame
@@ -583,23 +869,17 @@ namespace ProtocolUtilities
             assert(m);
             m->SetVariableBlockCount(acks_to_send);
             
-            std::set<uint32_t>::iterator i = pendingACKs.begin();
-            size_t added_acks = 0;
-            
-            while (added_acks < acks_to_send)
+            for(size_t added_acks = 0; added_acks < acks_to_send; ++added_acks)
             {
                 // Note! Horrible protocol design issue! The sequence numbers that both
                 // server and client use are sent in big endian, but in the ACK packets
                 // they need to be transferred in little endian. !! So, no conversion to
                 // big endian here.
-                m->AddU32(*i);
-                ++added_acks;
-                ++i;
+                m->AddU32(pendingACKs.front());
+                pendingACKs.pop_front();
             }
             
             FinishMessage(m);
-            
-            pendingACKs.erase(pendingACKs.begin(), i);
         }
     }
 
@@ -654,40 +934,24 @@ namespace ProtocolUtilities
         FinishMessage(m);
     }
 
-    /// A unary find predicate that looks for a NetOutMessage that has the given desired sequence number in a resendqueue container.
-    class MsgSeqNumMatchPred
-    {
-    public:
-        MsgSeqNumMatchPred(uint32_t seqNum_):seqNum(seqNum_) {}
-
-        bool operator()(const std::pair<time_t, NetOutMessage*> &elem) const { return elem.second && elem.second->GetSequenceNumber() == seqNum; }
-    private:
-        uint32_t seqNum;
-    };
-
     void NetMessageManager::AddMessageToResendQueue(NetOutMessage *msg)
     {
         // Don't add this message to the queue, if it already exists in the queue, i.e. it has already been resent once due to a timeout.
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(msg->GetSequenceNumber()));
-        if (it != messageResendQueue.end())
-        {
-            // If the sequence numbers matched but these are different message structs, add the message to unusedMessagePool, it's extraneous.
-            if (it->second != msg)
-                unusedMessagePool.push_back(msg);
-            return;
-        }
-
-        messageResendQueue.push_back(std::make_pair(time(0), msg));
+        NetOutMessage *existing = messageResendQueue.Insert(msg->GetSequenceNumber(), time(0), msg);
+        if (!existing)
+            unackedReliableBytes += msg->BytesFilled();
+        // If the sequence numbers matched but these are different message structs, add the message to unusedMessagePool, it's extraneous.
+        else if (existing != msg)
+            unusedMessagePool.push_back(msg);
     }
 
     void NetMessageManager::RemoveMessageFromResendQueue(uint32_t packetID)
     {
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(packetID));
-
-        if (it != messageResendQueue.end())
+        NetOutMessage *msg = messageResendQueue.Remove(packetID);
+        if (msg)
         {
-            unusedMessagePool.push_back(it->second);
-            messageResendQueue.erase(it);
+            unackedReliableBytes -= msg->BytesFilled();
+            unusedMessagePool.push_back(msg);
         }
     }
 
@@ -696,19 +960,16 @@ namespace ProtocolUtilities
         PROFILE(NetMessageManager_ProcessResendQueue);
         const int cTimeoutSeconds = 5;
 
-        const time_t timeNow = time(0);
-        for(MessageResendList::iterator it = messageResendQueue.begin(); it != messageResendQueue.end(); ++it)
+        CollectTimedOutMessages timedOut(time(0), cTimeoutSeconds);
+        messageResendQueue.ForEach(timedOut);
+        for(size_t i = 0; i < timedOut.messages.size(); ++i)
         {
-            if (timeNow - it->first >= cTimeoutSeconds)
-            {
-                it->first = timeNow;
-                it->second->MarkResend();
-                SendProcessedMessage(it->second);
-                //std::cout << "Resending packet " << it->second->GetSequenceNumber() << std::endl;
+            timedOut.messages[i]->MarkResend();
+            SendProcessedMessage(timedOut.messages[i]);
+            //std::cout << "Resending packet " << timedOut.messages[i]->GetSequenceNumber() << std::endl;
 #ifdef PROFILING
-                resentPackets.InsertRecord(1.0);
+            resentPackets.InsertRecord(1.0);
 #endif
-            }
         }
     }
     void NetMessageManager::ManagePingSends()
@@ -717,7 +978,8 @@ namespace ProtocolUtilities
         if (pingSendTimer.elapsed() >= interval)
         {
             ++pingId;
-            uint32_t oldestUnacked = pendingACKs.empty() ? 0 : *pendingACKs.begin();
+            // The pending acks belong to the receive thread if it is running, so report the oldest unacked reliable message we've sent instead.
+            uint32_t oldestUnacked = messageResendQueue.Empty() ? 0 : messageResendQueue.Oldest();
             pendingPings[pingId] = GetCurrentClockTime();
             SendStartPingCheck(pingId, oldestUnacked);
             pingSendTimer.restart();
@@ -726,19 +988,12 @@ namespace ProtocolUtilities
 
     int NetMessageManager::NumUnackedReliablePackets() const
     {
-        return messageResendQueue.size();
+        return messageResendQueue.Size();
     }
 
     int NetMessageManager::NumBytesInUnackedReliablePackets() const
     {
-        size_t bytes = 0;
-        MessageResendList::const_iterator it = messageResendQueue.begin();
-        while(it != messageResendQueue.end())
-        {
-            bytes += it->second->BytesFilled();
-            ++it;
-        }
-        return bytes;
+        return (int)unackedReliableBytes;
     }
 }
 
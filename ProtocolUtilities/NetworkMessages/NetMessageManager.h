@@ -4,11 +4,14 @@
 #define incl_ProtocolUtilities_NetMessageManager_h
 
 #include <list>
-#include <set>
+#include <map>
 
 #include <boost/shared_ptr.hpp>
+#include "CoreThread.h"
 
 #include "NetMessage.h"
+#include "InboundPacketRing.h"
+#include "SequenceTracking.h"
 #include "EventHistory.h"
 
 #include "RexTypes.h"
@@ -48,9 +51,20 @@ namespace ProtocolUtilities
         void FinishMessage(NetOutMessage *message);
 
         /// Reads in all inbound UDP messages and processes them forward to the application through the listener.
-        /// Checks and resends any timed out reliable outbound messages. This could be moved into a separate thread, but not that timing specific so not necessary atm.
+        /// Checks and resends any timed out reliable outbound messages.
+        /** If the receive thread is enabled, the messages have already been received, acked, zero-decoded and pre-parsed
+            by it, and this function only passes them on to the application. */
         void ProcessMessages();
 
+        /// Enables or disables receiving UDP traffic on a dedicated network thread. Disabled by default.
+        /** With the receive thread running, inbound packets are acked as soon as they arrive instead of once per frame,
+            and the main thread only has to dispatch the pre-parsed messages to the listener. Takes effect immediately
+            if connected, otherwise on the next ConnectTo. */
+        void SetThreadedReceive(bool enable);
+
+        /// @return True if the receive thread is enabled.
+        bool IsThreadedReceive() const { return threadedReceive; }
+
         /// Interprets the given byte stream as a message and dumps it contents out to the log. Useful only for diagnostics and such.
         void DumpNetworkMessage(NetMsgID id, NetInMessage *msg);
 
@@ -119,8 +133,8 @@ namespace ProtocolUtilities
         /// Deallocates all memory used for outbound message structs.
         void ClearMessagePoolMemory();
 
-        /// @return A new sequence number for outbound UDP messages.
-        size_t GetNewSequenceNumber() { return sequenceNumber++; }
+        /// @return A new sequence number for outbound UDP messages. Thread-safe.
+        size_t GetNewSequenceNumber() { MutexLock lock(sequenceNumberMutex); return sequenceNumber++; }
 
         /// Queues acking the packet with the given packetID.
         void QueuePacketACK(uint32_t packetID);
@@ -128,8 +142,33 @@ namespace ProtocolUtilities
         /// Sends pending acks to the server.
         void SendPendingACKs();
 
-        /// Processes a single raw datagram received from the network.
-        void HandleInboundBytes(std::vector<uint8_t> &data);
+        /// Processes a single raw datagram received from the network. The message is parsed in place over the slot.
+        void HandleInboundBytes(InboundPacketRing::Slot &slot);
+
+        /// Does the work on a received datagram that doesn't involve the application: duplicate pruning, queuing the ack,
+        /// zero-decoding and looking up the message type. Runs on the receive thread if it is enabled.
+        /// @return False if the datagram should be skipped.
+        bool PreprocessInboundSlot(InboundPacketRing::Slot &slot);
+
+        /// Processes the appended acks of a datagram pre-parsed with PreprocessInboundSlot and passes the message to the listener.
+        void DispatchInboundSlot(InboundPacketRing::Slot &slot);
+
+        /// Receives a batch of datagrams from the socket into the inbound packet ring and publishes them.
+        /// @param preprocess If true, PreprocessInboundSlot is called for each datagram before publishing.
+        /// @return The number of datagrams received.
+        size_t ReceiveIntoRing(bool preprocess);
+
+        /// Starts the receive thread if it is not running.
+        void StartReceiveThread();
+
+        /// Stops the receive thread and waits for it to exit.
+        void StopReceiveThread();
+
+        /// Entry point of the receive thread.
+        void ReceiveThreadMain();
+
+        /// Sends the pending acks straight from the receive thread.
+        void SendPendingACKsFromReceiveThread();
 
         /// Processes a received PacketAck message.
         void ProcessPacketACK(NetInMessage *msg);
@@ -163,7 +202,7 @@ namespace ProtocolUtilities
         void RemoveMessageFromResendQueue(uint32_t packetID);
 
         /// @return True, if the resend queue is empty, false otherwise.
-        bool ResendQueueIsEmpty() const { return messageResendQueue.empty(); }
+        bool ResendQueueIsEmpty() const { return messageResendQueue.Empty(); }
 
         /// Checks each reliable message in outbound queue and resends any of the if an Ack was not received within a time-out period.
         void ProcessResendQueue();
@@ -186,23 +225,29 @@ namespace ProtocolUtilities
         /// A pool of NetOutMessage structures, which have been handed out to the application and are currently being built.
         std::list<NetOutMessage*> usedMessagePool;
 
-        /// Packet acks pending to be sent
-        std::set<uint32_t> pendingACKs;
+        /// Packet acks pending to be sent, in the order they were queued. Owned by the receive thread when it is running.
+        RingBuffer<uint32_t> pendingACKs;
 
-        typedef std::list<std::pair<time_t, NetOutMessage*> > MessageResendList;
-        /// A pool of NetOutMessages that are in the outbound queue. Need to keep the unacked reliable messages in
-        /// memory for possible resending.
-        MessageResendList messageResendQueue;
+        typedef SequenceIndexedWindow<NetOutMessage*> MessageResendWindow;
+        /// A pool of NetOutMessages that are in the outbound queue, indexed by sequence number. Need to keep the unacked
+        /// reliable messages in memory for possible resending.
+        MessageResendWindow messageResendQueue;
+
+        /// Total size of the messages in messageResendQueue.
+        size_t unackedReliableBytes;
 
         /// A running sequence number for outbound messages.
         size_t sequenceNumber;
 
+        /// Guards sequenceNumber, which is also used by the receive thread for acks.
+        Mutex sequenceNumberMutex;
+
         /// The sequence number of the most recent packet we received.
         /// Note that this can go up and down if we receive data out of order (or if we receive spoofed data)
         size_t lastReceivedSequenceNumber;
 
-        /// A set of received messages' sequence numbers.
-        std::set<uint32_t> receivedSequenceNumbers;
+        /// A sliding window of received messages' sequence numbers. Owned by the receive thread when it is running.
+        SequenceNumberWindow receivedSequenceNumbers;
 
         /// Timer for sending pings.
         boost::timer pingSendTimer;
@@ -215,6 +260,37 @@ namespace ProtocolUtilities
 
         /// How much time has elapsed in CPU ticks since we've heard from the server last time.
         tick_t lastHeardSinceTick;
+
+        /// The number of slots in the inbound packet ring.
+        static const size_t cInboundPacketRingSize = 64;
+
+        /// The maximum number of datagrams read from the socket at a time.
+        static const size_t cMaxReceiveBatch = 32;
+
+        /// Preallocated receive slots for inbound datagrams. When the receive thread is running, it is the producer
+        /// and the main thread the consumer.
+        InboundPacketRing inboundPackets;
+
+        /// If true, the receive thread is started when connecting.
+        bool threadedReceive;
+
+        /// True while the receive thread is running.
+        bool receiveThreadRunning;
+
+        /// Set by the main thread to ask the receive thread to exit.
+        volatile bool stopReceiveThread;
+
+        /// Set by the receive thread if a socket error occurred.
+        volatile bool receiveThreadFailed;
+
+        /// The error message of the socket error that stopped the receive thread.
+        std::string receiveThreadError;
+
+        /// The receive thread.
+        boost::thread receiveThread;
+
+        /// The message struct the receive thread builds acks into.
+        boost::shared_ptr<NetOutMessage> receiveThreadAckMessage;
     };
 }
 
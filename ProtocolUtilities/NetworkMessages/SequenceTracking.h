@@ -0,0 +1,337 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_ProtocolUtilities_SequenceTracking_h
+#define incl_ProtocolUtilities_SequenceTracking_h
+
+#include <vector>
+#include <map>
+#include <cassert>
+#include <cstring>
+
+#include "RexTypes.h"
+
+namespace ProtocolUtilities
+{
+    /// Tracks which of the most recently received packet sequence numbers have been seen, using a sliding-window bitmap.
+    /** Used to prune inbound duplicates with a fixed, small cost per packet. Sequence numbers that are older than the
+        window can not be tracked, and are reported as new.
+        \ingroup OpenSimProtocolClient */
+    class SequenceNumberWindow
+    {
+    public:
+        /// The number of sequence numbers the window remembers. Must be a multiple of 32.
+        static const uint32_t cWindowSize = 1024;
+
+        SequenceNumberWindow() { Clear(); }
+
+        /// Forgets all received sequence numbers.
+        void Clear()
+        {
+            memset(bits, 0, sizeof(bits));
+            newest = 0;
+            empty = true;
+        }
+
+        /// @return True if no sequence numbers have been received since the last Clear.
+        bool Empty() const { return empty; }
+
+        /// Marks the given sequence number as received.
+        /// @return True if the sequence number was new, false if it has been received before.
+        bool Insert(uint32_t seqNum)
+        {
+            if (empty)
+            {
+                empty = false;
+                newest = seqNum;
+                SetBit(seqNum);
+                return true;
+            }
+
+            const int32_t ahead = (int32_t)(seqNum - newest);
+            if (ahead > 0)
+            {
+                // Slide the window forward, forgetting the sequence numbers that fall off its tail.
+                if ((uint32_t)ahead >= cWindowSize)
+                    memset(bits, 0, sizeof(bits));
+                else
+                    for(uint32_t s = newest + 1; s != seqNum; ++s)
+                        ClearBit(s);
+                newest = seqNum;
+                SetBit(seqNum);
+                return true;
+            }
+
+            if ((uint32_t)-ahead >= cWindowSize)
+                return true; // Too old to tell, let it through.
+
+            if (TestBit(seqNum))
+                return false;
+            SetBit(seqNum);
+            return true;
+        }
+
+        /// @return True if the given sequence number is inside the window and has been received.
+        bool Contains(uint32_t seqNum) const
+        {
+            if (empty)
+                return false;
+            const int32_t ahead = (int32_t)(seqNum - newest);
+            if (ahead > 0 || (uint32_t)-ahead >= cWindowSize)
+                return false;
+            return TestBit(seqNum);
+        }
+
+    private:
+        void SetBit(uint32_t seqNum) { bits[(seqNum % cWindowSize) >> 5] |= 1u << (seqNum & 31); }
+        void ClearBit(uint32_t seqNum) { bits[(seqNum % cWindowSize) >> 5] &= ~(1u << (seqNum & 31)); }
+        bool TestBit(uint32_t seqNum) const { return (bits[(seqNum % cWindowSize) >> 5] & (1u << (seqNum & 31))) != 0; }
+
+        /// One bit per sequence number in the window, indexed by the sequence number modulo the window size.
+        uint32_t bits[cWindowSize / 32];
+
+        /// The newest sequence number received.
+        uint32_t newest;
+
+        /// True if nothing has been received yet.
+        bool empty;
+    };
+
+    /// A FIFO queue stored in a flat, power-of-two sized circular array. Grows by doubling when full, but never shrinks,
+    /// so in steady state pushing and popping do not allocate.
+    template<typename T>
+    class RingBuffer
+    {
+    public:
+        explicit RingBuffer(size_t initialCapacity = 64) : head(0), count(0)
+        {
+            size_t capacity = 1;
+            while(capacity < initialCapacity)
+                capacity <<= 1;
+            data.resize(capacity);
+        }
+
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+
+        void clear() { head = 0; count = 0; }
+
+        void push_back(const T &value)
+        {
+            if (count == data.size())
+                Grow();
+            data[(head + count) & (data.size() - 1)] = value;
+            ++count;
+        }
+
+        const T &front() const { assert(count > 0); return data[head]; }
+
+        void pop_front()
+        {
+            assert(count > 0);
+            head = (head + 1) & (data.size() - 1);
+            --count;
+        }
+
+        /// Returns the i'th oldest element.
+        const T &operator[](size_t i) const { assert(i < count); return data[(head + i) & (data.size() - 1)]; }
+
+    private:
+        void Grow()
+        {
+            std::vector<T> newData(data.size() * 2);
+            for(size_t i = 0; i < count; ++i)
+                newData[i] = data[(head + i) & (data.size() - 1)];
+            data.swap(newData);
+            head = 0;
+        }
+
+        std::vector<T> data;
+        size_t head;
+        size_t count;
+    };
+
+    /// Holds entries keyed by an increasing sequence number in a flat array indexed by the sequence number, giving O(1)
+    /// insertion, lookup and removal. Used for the queue of unacked reliable outbound messages.
+    /** Value must be a pointer type; a null value marks an empty slot. The array spans the range from the oldest
+        live entry to the newest one and grows by doubling up to a maximum capacity. An entry that would stretch the
+        span beyond that, because it has stayed in the window for long, is moved to a side map. So one entry that is
+        never removed does not make the memory use and the cost of ForEach grow with every later sequence number.
+        \ingroup OpenSimProtocolClient */
+    template<typename Value>
+    class SequenceIndexedWindow
+    {
+    public:
+        struct Entry
+        {
+            Entry() : seqNum(0), time(0), value(0) {}
+
+            uint32_t seqNum;
+            time_t time;
+            Value value;
+        };
+
+        explicit SequenceIndexedWindow(size_t initialCapacity = 256, size_t maxCapacity = 4096) : first(0), end(0), count(0)
+        {
+            size_t capacity = 1;
+            while(capacity < initialCapacity)
+                capacity <<= 1;
+            entries.resize(capacity);
+            this->maxCapacity = capacity;
+            while(this->maxCapacity < maxCapacity)
+                this->maxCapacity <<= 1;
+        }
+
+        bool Empty() const { return count == 0; }
+        size_t Size() const { return count; }
+
+        /// @return The oldest sequence number in the window. The window must not be empty.
+        uint32_t Oldest() const { assert(count > 0); return overflow.empty() ? first : overflow.begin()->first; }
+
+        /// Inserts a new entry. Sequence numbers must be inserted in increasing order.
+        /// @return The value already stored with this sequence number, or 0 if the entry was added.
+        Value Insert(uint32_t seqNum, time_t time, Value value)
+        {
+            assert(value);
+            if (Entry *existing = Find(seqNum))
+                return existing->value;
+
+            if (first == end)
+            {
+                first = seqNum;
+                end = seqNum;
+            }
+            else if ((int32_t)(seqNum - first) < 0)
+            {
+                assert(false && "SequenceIndexedWindow: sequence numbers must be inserted in increasing order!");
+                return value;
+            }
+
+            if ((int32_t)(seqNum - end) >= 0)
+            {
+                const uint32_t newEnd = seqNum + 1;
+                while(newEnd - first > entries.size() && entries.size() < maxCapacity)
+                    Grow();
+                if (newEnd - first > entries.size())
+                    MoveToOverflow(newEnd - (uint32_t)entries.size());
+                end = newEnd;
+            }
+
+            Entry &e = entries[seqNum & (entries.size() - 1)];
+            e.seqNum = seqNum;
+            e.time = time;
+            e.value = value;
+            ++count;
+            return 0;
+        }
+
+        /// @return The entry with the given sequence number, or 0 if there is none.
+        Entry *Find(uint32_t seqNum)
+        {
+            if (seqNum - first < end - first)
+            {
+                Entry &e = entries[seqNum & (entries.size() - 1)];
+                return (e.value && e.seqNum == seqNum) ? &e : 0;
+            }
+            if (overflow.empty())
+                return 0;
+            typename OverflowMap::iterator i = overflow.find(seqNum);
+            return (i != overflow.end()) ? &i->second : 0;
+        }
+
+        const Entry *Find(uint32_t seqNum) const { return const_cast<SequenceIndexedWindow *>(this)->Find(seqNum); }
+
+        /// Removes the entry with the given sequence number.
+        /// @return The removed value, or 0 if there was no such entry.
+        Value Remove(uint32_t seqNum)
+        {
+            Entry *e = Find(seqNum);
+            if (!e)
+                return 0;
+            Value value = e->value;
+            --count;
+
+            if (seqNum - first < end - first)
+            {
+                e->value = 0;
+                // Shrink the covered span from the front past any already removed entries.
+                while(first != end && !IsLive(first))
+                    ++first;
+            }
+            else
+                overflow.erase(seqNum);
+            return value;
+        }
+
+        /// Calls func(Entry &) for each entry, oldest first. The function must not insert or remove entries.
+        template<typename Func>
+        void ForEach(Func &func)
+        {
+            for(typename OverflowMap::iterator i = overflow.begin(); i != overflow.end(); ++i)
+                func(i->second);
+            for(uint32_t seqNum = first; seqNum != end; ++seqNum)
+                if (IsLive(seqNum))
+                    func(entries[seqNum & (entries.size() - 1)]);
+        }
+
+        void Clear()
+        {
+            for(size_t i = 0; i < entries.size(); ++i)
+                entries[i] = Entry();
+            overflow.clear();
+            first = end = 0;
+            count = 0;
+        }
+
+    private:
+        typedef std::map<uint32_t, Entry> OverflowMap;
+
+        bool IsLive(uint32_t seqNum) const
+        {
+            const Entry &e = entries[seqNum & (entries.size() - 1)];
+            return e.value && e.seqNum == seqNum;
+        }
+
+        void Grow()
+        {
+            std::vector<Entry> newEntries(entries.size() * 2);
+            for(size_t i = 0; i < entries.size(); ++i)
+                if (entries[i].value)
+                    newEntries[entries[i].seqNum & (newEntries.size() - 1)] = entries[i];
+            entries.swap(newEntries);
+        }
+
+        /// Moves the entries older than newFirst from the array to the side map, and starts the span at newFirst.
+        void MoveToOverflow(uint32_t newFirst)
+        {
+            for(; first != newFirst && first != end; ++first)
+            {
+                Entry &e = entries[first & (entries.size() - 1)];
+                if (e.value && e.seqNum == first)
+                {
+                    overflow[first] = e;
+                    e = Entry();
+                }
+            }
+            first = newFirst;
+        }
+
+        std::vector<Entry> entries;
+
+        /// The largest the array grows to.
+        size_t maxCapacity;
+
+        /// Entries that fell out of the span of the array, by sequence number.
+        OverflowMap overflow;
+
+        /// The oldest sequence number that may hold a live entry in the array.
+        uint32_t first;
+
+        /// One past the newest sequence number inserted.
+        uint32_t end;
+
+        /// The number of live entries, in the array and in the side map.
+        size_t count;
+    };
+}
+
+#endif // incl_ProtocolUtilities_SequenceTracking_h
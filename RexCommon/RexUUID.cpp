@@ -211,3 +211,11 @@ bool RexUUID::operator >(const RexUUID &rhs) const
     return rhs < *this;
 }
 
+std::size_t hash_value(const RexUUID &id)
+{
+    std::size_t hash = 0;
+    for(int i = 0; i < RexUUID::cSizeBytes; ++i)
+        hash = hash * 31 + id.data[i];
+
+    return hash;
+}
@@ -95,4 +95,7 @@ public:
     uint8_t data[cSizeBytes];
 };
 
+/// Hash function for RexUUID, so that it can be used as the key of boost::unordered_map.
+std::size_t hash_value(const RexUUID &id);
+
 #endif
@@ -0,0 +1,154 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PrimGeometryQueue.cpp
+ *  @brief  Generates prim geometry on the framework thread pool.
+ */
+
+#include "StableHeaders.h"
+#include "Environment/PrimGeometryQueue.h"
+#include "Framework.h"
+#include "FrameScheduler.h"
+#include "ThreadPool.h"
+
+#include <OgreMesh.h>
+
+#include <boost/bind.hpp>
+
+namespace RexLogic
+{
+
+PrimGeometryQueue::PrimGeometryQueue(Foundation::Framework* framework) :
+    framework_(framework),
+    state_(new JobState())
+{
+}
+
+PrimGeometryQueue::~PrimGeometryQueue()
+{
+    // The jobs hold the shared state, not this object, so they need not be waited for
+    MutexLock lock(state_->mutex);
+    state_->abandoned = true;
+    state_->finished.clear();
+}
+
+bool PrimGeometryQueue::Request(entity_id_t entity, EC_OpenSimPrim& primitive, Ogre::MeshPtr& mesh, std::vector<std::string>& materials)
+{
+    PrimGeometryParams params;
+    GetPrimGeometryParams(framework_, primitive, true, params);
+    if (FindSharedPrimMesh(params, mesh, materials))
+    {
+        requested_.erase(entity);
+        return true;
+    }
+
+    requested_[entity] = params.key;
+
+    // Only one job per key, the other prims with the same key wait for it
+    std::vector<entity_id_t>& waiters = waiters_[params.key];
+    waiters.push_back(entity);
+    if (waiters.size() > 1)
+        return false;
+
+    Foundation::ThreadPoolPtr pool = framework_->GetThreadPool();
+    if (!pool || !pool->Submit(boost::bind(&PrimGeometryQueue::Generate, state_, params), Foundation::ThreadPool::PriorityNormal))
+    {
+        // No pool, generate on the calling thread
+        Generate(state_, params);
+    }
+    return false;
+}
+
+bool PrimGeometryQueue::Finalize(const Foundation::FrameBudget& budget)
+{
+    for(;;)
+    {
+        Result result;
+        {
+            MutexLock lock(state_->mutex);
+            if (state_->finished.empty())
+                return true;
+            result.params = state_->finished.front().params;
+            result.geometry.sections.swap(state_->finished.front().geometry.sections);
+            result.success = state_->finished.front().success;
+            state_->finished.pop_front();
+        }
+
+        std::map<std::string, std::vector<entity_id_t> >::iterator i = waiters_.find(result.params.key);
+        if (i == waiters_.end())
+            continue;
+
+        // Entities that have since requested other geometry, or have been cancelled, are not interested any more
+        std::vector<entity_id_t> interested;
+        for(uint j = 0; j < i->second.size(); ++j)
+        {
+            entity_id_t entity = i->second[j];
+            std::map<entity_id_t, std::string>::iterator r = requested_.find(entity);
+            if (r == requested_.end() || r->second != result.params.key)
+                continue;
+            requested_.erase(r);
+            interested.push_back(entity);
+        }
+        waiters_.erase(i);
+        if (interested.empty())
+            continue;
+
+        // If the mesh could not be created the entities keep their old geometry
+        if (result.success && AddSharedPrimMesh(framework_, result.params, result.geometry))
+        {
+            for(uint j = 0; j < interested.size(); ++j)
+                if (ready_set_.insert(interested[j]).second)
+                    ready_.push_back(interested[j]);
+        }
+
+        if (budget.Expired())
+        {
+            MutexLock lock(state_->mutex);
+            return state_->finished.empty();
+        }
+    }
+}
+
+bool PrimGeometryQueue::PopReady(entity_id_t& entity)
+{
+    if (ready_.empty())
+        return false;
+    entity = ready_.front();
+    ready_.pop_front();
+    ready_set_.erase(entity);
+    return true;
+}
+
+void PrimGeometryQueue::Cancel(entity_id_t entity)
+{
+    requested_.erase(entity);
+}
+
+void PrimGeometryQueue::CancelAll()
+{
+    requested_.clear();
+    ready_.clear();
+    ready_set_.clear();
+}
+
+void PrimGeometryQueue::Generate(boost::shared_ptr<JobState> state, const PrimGeometryParams& params)
+{
+    {
+        MutexLock lock(state->mutex);
+        if (state->abandoned)
+            return;
+    }
+
+    Result result;
+    result.success = GeneratePrimGeometry(params, result.geometry);
+
+    MutexLock lock(state->mutex);
+    if (state->abandoned)
+        return;
+    state->finished.push_back(Result());
+    state->finished.back().params = params;
+    state->finished.back().geometry.sections.swap(result.geometry.sections);
+    state->finished.back().success = result.success;
+}
+
+}
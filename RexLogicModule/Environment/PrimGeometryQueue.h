@@ -0,0 +1,120 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PrimGeometryQueue.h
+ *  @brief  Generates prim geometry on the framework thread pool.
+ */
+
+#ifndef incl_RexLogicModule_PrimGeometryQueue_h
+#define incl_RexLogicModule_PrimGeometryQueue_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+#include "ForwardDefines.h"
+#include "Environment/PrimGeometryUtils.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class EC_OpenSimPrim;
+
+namespace RexLogic
+{
+    //! Generates the shared meshes of prims on the framework thread pool
+    /*! The prim parameters are copied on the main thread and the geometry is generated from the copy on a worker.
+        Prims with the same key wait for the same job. The finished geometry is turned into Ogre meshes on the main
+        thread by Finalize(), as many as fit in the frame budget. The prims waiting for a finished mesh are queued,
+        and handed out by PopReady() so that the caller can apply them within its budget over several frames. A prim
+        that changes again before its geometry is ready only gets the geometry of its latest request.
+     */
+    class PrimGeometryQueue : public boost::noncopyable
+    {
+    public:
+        //! Constructor
+        explicit PrimGeometryQueue(Foundation::Framework* framework);
+
+        //! Destructor. Jobs still queued or running are abandoned, and discard their geometry when they finish.
+        ~PrimGeometryQueue();
+
+        //! Requests the shared mesh of a prim
+        /*! \param entity Entity of the prim
+            \param mesh Set to the mesh if it is ready, null if the prim has no visible geometry
+            \param materials Filled with the material of each submesh if the mesh is ready
+            \return true if the mesh is ready, false if it is being generated and the entity is returned by Finalize() later
+         */
+        bool Request(entity_id_t entity, EC_OpenSimPrim& primitive, Ogre::MeshPtr& mesh, std::vector<std::string>& materials);
+
+        //! Creates the meshes of finished geometry until the budget expires. Always creates at least one.
+        /*! The entities waiting for the meshes are queued for PopReady().
+            \return true if no finished geometry is left
+         */
+        bool Finalize(const Foundation::FrameBudget& budget);
+
+        //! Takes the next entity the mesh of which is now ready, to request again
+        /*! \return false if no entities are ready
+         */
+        bool PopReady(entity_id_t& entity);
+
+        //! Returns whether entities are waiting to be taken with PopReady()
+        bool HasReady() const { return !ready_.empty(); }
+
+        //! Forgets the pending request of an entity
+        void Cancel(entity_id_t entity);
+
+        //! Forgets the pending requests of all entities, and the entities that are ready
+        void CancelAll();
+
+    private:
+        //! Generated geometry of a key
+        struct Result
+        {
+            PrimGeometryParams params;
+            PrimGeometry geometry;
+            bool success;
+        };
+
+        //! State shared with the jobs, which may outlive the queue
+        struct JobState
+        {
+            JobState() : abandoned(false) {}
+
+            //! Mutex for the finished geometry and the abandoned flag
+            Mutex mutex;
+
+            //! Finished geometry, guarded by mutex
+            std::deque<Result> finished;
+
+            //! Set when the queue is destroyed, the jobs skip or discard their work. Guarded by mutex
+            bool abandoned;
+        };
+
+        //! Generates geometry. Runs on the thread pool.
+        static void Generate(boost::shared_ptr<JobState> state, const PrimGeometryParams& params);
+
+        //! Framework
+        Foundation::Framework* framework_;
+
+        //! Key of the latest request of each entity waiting for geometry
+        std::map<entity_id_t, std::string> requested_;
+
+        //! Entities waiting for each key being generated
+        std::map<std::string, std::vector<entity_id_t> > waiters_;
+
+        //! Entities the meshes of which are ready, in the order they became ready
+        std::deque<entity_id_t> ready_;
+
+        //! Entities in ready_, so that an entity is queued only once
+        std::set<entity_id_t> ready_set_;
+
+        //! State shared with the jobs
+        boost::shared_ptr<JobState> state_;
+    };
+}
+
+#endif
@@ -51,10 +51,35 @@
 
 #include <Ogre.h>
 
+#include <boost/unordered_map.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
+
 namespace RexLogic
 {
     static Ogre::ManualObject* prim_manual_object = 0;
     
+    //! Largest face number the parameters of are always part of the shared mesh key, higher ones only if the prim has them
+    static const uint MAX_PRIM_FACES = 9;
+    
+    //! Shared prim mesh
+    struct PrimMeshEntry
+    {
+        //! The mesh
+        Ogre::MeshPtr mesh;
+        
+        //! Face number of the first face of each submesh, the material of which the submesh uses
+        std::vector<uint8_t> submesh_faces;
+        
+        //! Use count of the mesh when no entity uses it
+        unsigned int unused_count;
+    };
+    
+    //! Shared prim meshes by the parameters that affect their geometry
+    static boost::unordered_map<std::string, PrimMeshEntry> prim_meshes;
+    
     void TransformUV(Ogre::Vector2& uv, float repeat_u, float repeat_v, float offset_u, float offset_v, float rot_sin, float rot_cos)
     {
         const static Ogre::Vector2 half(0.5f, 0.5f);
@@ -82,14 +107,9 @@ namespace RexLogic
         
         return true;
     }
-
-    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled)
+    
+    Ogre::ManualObject* GetPrimManualObject(Foundation::Framework* framework)
     {
-        PROFILE(Primitive_CreateGeometry)
-        
-        if (!primitive.HasPrimShapeData)
-            return 0;
-        
         // Create only a single manual object for prim geometry and reuse it over and over, to avoid Ogre generating
         // a huge load of unnecessary D3D resources, that are never used for anything visible (the manual object will
         // be converted to a mesh anyway)
@@ -100,10 +120,13 @@ namespace RexLogic
                 return 0;
             Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
             prim_manual_object = sceneMgr->createManualObject(renderer->GetUniqueObjectName());
-            if (!prim_manual_object)
-                return 0;
         }
         
+        return prim_manual_object;
+    }
+    
+    std::string GetMaterialOverride(Foundation::Framework* framework, EC_OpenSimPrim& primitive)
+    {
         std::string mat_override;
         if ((primitive.Materials[0].Type == RexTypes::RexAT_MaterialScript) && (!RexTypes::IsNull(primitive.Materials[0].asset_id)))
         {
@@ -118,21 +141,216 @@ namespace RexLogic
                 mat_override = "LitTextured";
             }
         }
+        
+        return mat_override;
+    }
+    
+    template <typename T> void GetFaceParam(const std::map<uint8_t, T>& params, uint8_t facenum, T& value)
+    {
+        typename std::map<uint8_t, T>::const_iterator i = params.find(facenum);
+        if (i != params.end())
+            value = i->second;
+    }
+    
+    PrimFace GetPrimFace(EC_OpenSimPrim& primitive, uint8_t facenum, bool use_default, const std::string& mat_override)
+    {
+        PrimFace face;
+        face.variation = 0;
+        face.color = primitive.PrimDefaultColor;
+        face.repeat_u = primitive.PrimDefaultRepeatU;
+        face.repeat_v = primitive.PrimDefaultRepeatV;
+        face.offset_u = primitive.PrimDefaultOffsetU;
+        face.offset_v = primitive.PrimDefaultOffsetV;
+        face.rot = primitive.PrimDefaultUVRotation;
+        bool fullbright = (primitive.PrimDefaultMaterialType & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
+        std::string texture_name = primitive.PrimDefaultTextureID;
+        
+        if (!use_default)
+        {
+            GetFaceParam(primitive.PrimColors, facenum, face.color);
+            GetFaceParam(primitive.PrimRepeatU, facenum, face.repeat_u);
+            GetFaceParam(primitive.PrimRepeatV, facenum, face.repeat_v);
+            GetFaceParam(primitive.PrimOffsetU, facenum, face.offset_u);
+            GetFaceParam(primitive.PrimOffsetV, facenum, face.offset_v);
+            GetFaceParam(primitive.PrimUVRotation, facenum, face.rot);
+            MaterialTypeMap::const_iterator mt = primitive.PrimMaterialTypes.find(facenum);
+            if (mt != primitive.PrimMaterialTypes.end())
+                fullbright = (mt->second & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
+            GetFaceParam(primitive.PrimTextures, facenum, texture_name);
+        }
+        
+        // Very transparent faces are skipped, no need for a material
+        if (face.color.a <= 0.11f)
+            return face;
+        
+        if (!mat_override.empty())
+            face.material = mat_override;
+        else
+        {
+            face.variation = OgreRenderer::LEGACYMAT_VERTEXCOL;
+            
+            // Check for transparency
+            if (face.color.a < 1.0f)
+                face.variation = OgreRenderer::LEGACYMAT_VERTEXCOLALPHA;
+            
+            // Check for fullbright
+            if (fullbright)
+                face.variation |= OgreRenderer::LEGACYMAT_FULLBRIGHT;
             
+            face.texture_name = texture_name;
+            face.material = texture_name + OgreRenderer::GetMaterialSuffix(face.variation);
+        }
+        
+        return face;
+    }
+    
+    //! Returns the parameters of a face
+    const PrimFace& GetPrimFace(const PrimGeometryParams& params, uint8_t facenum)
+    {
+        PrimFaceMap::const_iterator f = params.faces.find(facenum);
+        return (f != params.faces.end()) ? f->second : params.default_face;
+    }
+    
+    //! Returns the material of a face, creating it if it is a legacy material not yet created
+    const std::string& UsePrimFaceMaterial(const PrimFace& face)
+    {
+        // Create the material here if texture yet missing, the material will be updated later
+        if (!face.texture_name.empty())
+            OgreRenderer::GetOrCreateLegacyMaterial(face.texture_name, face.variation);
+        
+        return face.material;
+    }
+    
+    template <typename T> void AppendKey(std::string& key, const T& value)
+    {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    
+    //! Returns the parameters that affect the geometry of a prim as a string. The materials only affect which faces
+    //! end up in the same submesh, so faces are keyed by the first face that uses the same material.
+    std::string GetPrimMeshKey(const PrimGeometryParams& params)
+    {
+        std::string key;
+        AppendKey(key, params.profile_curve);
+        AppendKey(key, params.profile_begin);
+        AppendKey(key, params.profile_end);
+        AppendKey(key, params.profile_hollow);
+        AppendKey(key, params.path_curve);
+        AppendKey(key, params.path_begin);
+        AppendKey(key, params.path_end);
+        AppendKey(key, params.path_shear_x);
+        AppendKey(key, params.path_shear_y);
+        AppendKey(key, params.path_twist_begin);
+        AppendKey(key, params.path_twist);
+        AppendKey(key, params.path_scale_x);
+        AppendKey(key, params.path_scale_y);
+        AppendKey(key, params.path_radius_offset);
+        AppendKey(key, params.path_revolutions);
+        AppendKey(key, params.path_skew);
+        AppendKey(key, params.path_taper_x);
+        AppendKey(key, params.path_taper_y);
+        AppendKey(key, params.optimisations_enabled);
+        
+        std::vector<const PrimFace*> keyed_faces;
+        keyed_faces.push_back(&params.default_face);
+        for (PrimFaceMap::const_iterator i = params.faces.begin(); i != params.faces.end(); ++i)
+        {
+            AppendKey(key, i->first);
+            keyed_faces.push_back(&i->second);
+        }
+        
+        for (uint i = 0; i < keyed_faces.size(); ++i)
+        {
+            const PrimFace& face = *keyed_faces[i];
+            AppendKey(key, face.color.r);
+            AppendKey(key, face.color.g);
+            AppendKey(key, face.color.b);
+            AppendKey(key, face.color.a);
+            AppendKey(key, face.repeat_u);
+            AppendKey(key, face.repeat_v);
+            AppendKey(key, face.offset_u);
+            AppendKey(key, face.offset_v);
+            AppendKey(key, face.rot);
+            
+            uint material_index = i;
+            for (uint j = 0; j < i; ++j)
+                if (keyed_faces[j]->material == face.material)
+                {
+                    material_index = j;
+                    break;
+                }
+            AppendKey(key, material_index);
+        }
+        
+        return key;
+    }
+    
+    void GetPrimGeometryParams(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled, PrimGeometryParams& params)
+    {
+        params.profile_curve = primitive.ProfileCurve.Get();
+        params.profile_begin = primitive.ProfileBegin.Get();
+        params.profile_end = primitive.ProfileEnd.Get();
+        params.profile_hollow = primitive.ProfileHollow.Get();
+        params.path_curve = primitive.PathCurve.Get();
+        params.path_begin = primitive.PathBegin.Get();
+        params.path_end = primitive.PathEnd.Get();
+        params.path_shear_x = primitive.PathShearX.Get();
+        params.path_shear_y = primitive.PathShearY.Get();
+        params.path_twist_begin = primitive.PathTwistBegin.Get();
+        params.path_twist = primitive.PathTwist.Get();
+        params.path_scale_x = primitive.PathScaleX.Get();
+        params.path_scale_y = primitive.PathScaleY.Get();
+        params.path_radius_offset = primitive.PathRadiusOffset.Get();
+        params.path_revolutions = primitive.PathRevolutions.Get();
+        params.path_skew = primitive.PathSkew.Get();
+        params.path_taper_x = primitive.PathTaperX.Get();
+        params.path_taper_y = primitive.PathTaperY.Get();
+        params.optimisations_enabled = optimisations_enabled || primitive.DrawType == RexTypes::DRAWTYPE_MESH;
+        
+        std::string mat_override = GetMaterialOverride(framework, primitive);
+        params.default_face = GetPrimFace(primitive, 0, true, mat_override);
+        
+        std::set<uint8_t> facenums;
+        for (uint i = 0; i < MAX_PRIM_FACES; ++i)
+            facenums.insert((uint8_t)i);
+        for (TextureMap::const_iterator i = primitive.PrimTextures.begin(); i != primitive.PrimTextures.end(); ++i)
+            facenums.insert(i->first);
+        for (ColorMap::const_iterator i = primitive.PrimColors.begin(); i != primitive.PrimColors.end(); ++i)
+            facenums.insert(i->first);
+        for (MaterialTypeMap::const_iterator i = primitive.PrimMaterialTypes.begin(); i != primitive.PrimMaterialTypes.end(); ++i)
+            facenums.insert(i->first);
+        const UVParamMap* uv_params[] = { &primitive.PrimRepeatU, &primitive.PrimRepeatV, &primitive.PrimOffsetU, &primitive.PrimOffsetV, &primitive.PrimUVRotation };
+        for (uint j = 0; j < sizeof(uv_params) / sizeof(uv_params[0]); ++j)
+            for (UVParamMap::const_iterator i = uv_params[j]->begin(); i != uv_params[j]->end(); ++i)
+                facenums.insert(i->first);
+        
+        params.faces.clear();
+        for (std::set<uint8_t>::const_iterator i = facenums.begin(); i != facenums.end(); ++i)
+            params.faces[*i] = GetPrimFace(primitive, *i, false, mat_override);
+        
+        params.key = GetPrimMeshKey(params);
+    }
+    
+    bool GeneratePrimGeometry(const PrimGeometryParams& params, PrimGeometry& geometry)
+    {
+        PROFILE(Primitive_GenerateGeometry)
+        
+        geometry.sections.clear();
+        
         try
         {
-            float profileBegin = primitive.ProfileBegin.Get();
-            float profileEnd = 1.0f - primitive.ProfileEnd.Get();
-            float profileHollow = primitive.ProfileHollow.Get();
+            float profileBegin = params.profile_begin;
+            float profileEnd = 1.0f - params.profile_end;
+            float profileHollow = params.profile_hollow;
 
             int sides = 4;
-            if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_EQUILATERAL_TRIANGLE)
+            if ((params.profile_curve & 0x07) == RexTypes::SHAPE_EQUILATERAL_TRIANGLE)
                 sides = 3;
-            else if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_CIRCLE)
+            else if ((params.profile_curve & 0x07) == RexTypes::SHAPE_CIRCLE)
                 // Reduced prim lod!!!
                 sides = 12;
                 //sides = 24;
-            else if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_HALF_CIRCLE)
+            else if ((params.profile_curve & 0x07) == RexTypes::SHAPE_HALF_CIRCLE)
             {
                 // half circle, prim is a sphere
                 // Reduced prim lod!!!
@@ -144,196 +362,270 @@ namespace RexLogic
             }
 
             int hollowSides = sides;
-            if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_CIRCLE)
+            if ((params.profile_curve & 0xf0) == RexTypes::HOLLOW_CIRCLE)
                 // Reduced prim lod!!!
                 hollowSides = 12;
                 //hollowSides = 24;
-            else if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_SQUARE)
+            else if ((params.profile_curve & 0xf0) == RexTypes::HOLLOW_SQUARE)
                 hollowSides = 4;
-            else if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_TRIANGLE)
+            else if ((params.profile_curve & 0xf0) == RexTypes::HOLLOW_TRIANGLE)
                 hollowSides = 3;
             
             PrimMesher::PrimMesh primMesh(sides, profileBegin, profileEnd, profileHollow, hollowSides);
-            primMesh.topShearX = primitive.PathShearX.Get();
-            primMesh.topShearY = primitive.PathShearY.Get();
-            primMesh.pathCutBegin = primitive.PathBegin.Get();
-            primMesh.pathCutEnd = 1.0f - primitive.PathEnd.Get();
+            primMesh.topShearX = params.path_shear_x;
+            primMesh.topShearY = params.path_shear_y;
+            primMesh.pathCutBegin = params.path_begin;
+            primMesh.pathCutEnd = 1.0f - params.path_end;
 
-            if (primitive.PathCurve.Get() == RexTypes::EXTRUSION_STRAIGHT)
+            if (params.path_curve == RexTypes::EXTRUSION_STRAIGHT)
             {
-                primMesh.twistBegin = primitive.PathTwistBegin.Get() * 180;
-                primMesh.twistEnd = primitive.PathTwist.Get() * 180;
-                primMesh.taperX = primitive.PathScaleX.Get() - 1.0f;
-                primMesh.taperY = primitive.PathScaleY.Get() - 1.0f;
+                primMesh.twistBegin = params.path_twist_begin * 180;
+                primMesh.twistEnd = params.path_twist * 180;
+                primMesh.taperX = params.path_scale_x - 1.0f;
+                primMesh.taperY = params.path_scale_y - 1.0f;
                 primMesh.ExtrudeLinear();
             }
             else
             {
-                primMesh.holeSizeX = (2.0f - primitive.PathScaleX.Get());
-                primMesh.holeSizeY = (2.0f - primitive.PathScaleY.Get());
-                primMesh.radius = primitive.PathRadiusOffset.Get();
-                primMesh.revolutions = primitive.PathRevolutions.Get();
-                primMesh.skew = primitive.PathSkew.Get();
-                primMesh.twistBegin = primitive.PathTwistBegin.Get() * 360;
-                primMesh.twistEnd = primitive.PathTwist.Get() * 360;
-                primMesh.taperX = primitive.PathTaperX.Get();
-                primMesh.taperY = primitive.PathTaperY.Get();
+                primMesh.holeSizeX = (2.0f - params.path_scale_x);
+                primMesh.holeSizeY = (2.0f - params.path_scale_y);
+                primMesh.radius = params.path_radius_offset;
+                primMesh.revolutions = params.path_revolutions;
+                primMesh.skew = params.path_skew;
+                primMesh.twistBegin = params.path_twist_begin * 360;
+                primMesh.twistEnd = params.path_twist * 360;
+                primMesh.taperX = params.path_taper_x;
+                primMesh.taperY = params.path_taper_y;
                 primMesh.ExtrudeCircular();
             }
             
-            PROFILE(Primitive_CreateManualObject)
-            prim_manual_object->clear();
-            prim_manual_object->setBoundingBox(Ogre::AxisAlignedBox());
-            
             // Check for highly illegal coordinates in any of the faces
             for (int i = 0; i < primMesh.viewerFaces.size(); ++i)
             {
                 if (!(CheckCoord(primMesh.viewerFaces[i].v1) && CheckCoord(primMesh.viewerFaces[i].v2) && CheckCoord(primMesh.viewerFaces[i].v3)))
                 {
                     RexLogicModule::LogError("NaN or infinite number encountered in prim face coordinates. Skipping geometry creation.");
-                    return 0;
+                    return false;
                 }
             }
             
-            std::string mat_name;
-            std::string prev_mat_name;
-            
-            uint indices = 0;
-            bool first_face = true;
+            const std::string* prev_mat_name = 0;
+            PrimGeometrySection* section = 0;
             
             for (int i = 0; i < primMesh.viewerFaces.size(); ++i)
             {
-                int facenum = primMesh.viewerFaces[i].primFaceNumber;
+                const PrimMesher::ViewerFace& viewerFace = primMesh.viewerFaces[i];
+                int facenum = viewerFace.primFaceNumber;
                 
-                Color color = primitive.PrimDefaultColor;
-                ColorMap::const_iterator c = primitive.PrimColors.find(facenum);
-                if (c != primitive.PrimColors.end())
-                    color = c->second;
+                const PrimFace& face = GetPrimFace(params, (uint8_t)facenum);
+                const Color& color = face.color;
                 
                 // Skip face if very transparent
                 if (color.a <= 0.11f)
                     continue;
                 
-                if (!mat_override.empty())
-                    mat_name = mat_override;
+                bool new_section = !section;
+                if (params.optimisations_enabled)
+                    new_section = new_section || (face.material != *prev_mat_name);
                 else
+                    new_section = new_section || (i % 2 == 0);
+                if (new_section)
                 {
-                    unsigned variation = OgreRenderer::LEGACYMAT_VERTEXCOL;
-                    
-                    // Check for transparency
-                    if (color.a < 1.0f)
-                        variation = OgreRenderer::LEGACYMAT_VERTEXCOLALPHA;
-                    
-                    // Check for fullbright
-                    bool fullbright = (primitive.PrimDefaultMaterialType & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
-                    MaterialTypeMap::const_iterator mt = primitive.PrimMaterialTypes.find(facenum);
-                    if (mt != primitive.PrimMaterialTypes.end())
-                        fullbright = (mt->second & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
-                    if (fullbright)
-                        variation |= OgreRenderer::LEGACYMAT_FULLBRIGHT;
-                    
-                    std::string suffix = OgreRenderer::GetMaterialSuffix(variation);
-                    
-                    // Try to find face's texture in texturemap, use default if not found
-                    std::string texture_name = primitive.PrimDefaultTextureID;
-                    TextureMap::const_iterator t = primitive.PrimTextures.find(facenum);
-                    if (t != primitive.PrimTextures.end())
-                        texture_name = t->second;
-                    
-                    mat_name = texture_name + suffix;
-                    
-                    // Create the material here if texture yet missing, the material will be updated later
-                    OgreRenderer::GetOrCreateLegacyMaterial(texture_name, variation);
+                    geometry.sections.push_back(PrimGeometrySection());
+                    section = &geometry.sections.back();
+                    section->face = (uint8_t)facenum;
+                    prev_mat_name = &face.material;
                 }
                 
-                // Get texture mapping parameters
-                float repeat_u = primitive.PrimDefaultRepeatU;
-                float repeat_v = primitive.PrimDefaultRepeatV;
-                float offset_u = primitive.PrimDefaultOffsetU;
-                float offset_v = primitive.PrimDefaultOffsetV;
-                float rot = primitive.PrimDefaultUVRotation;
-                if (primitive.PrimRepeatU.find(facenum) != primitive.PrimRepeatU.end())
-                    repeat_u = primitive.PrimRepeatU[facenum];
-                if (primitive.PrimRepeatV.find(facenum) != primitive.PrimRepeatV.end())
-                    repeat_v = primitive.PrimRepeatV[facenum];
-                if (primitive.PrimOffsetU.find(facenum) != primitive.PrimOffsetU.end())
-                    offset_u = primitive.PrimOffsetU[facenum];
-                if (primitive.PrimOffsetV.find(facenum) != primitive.PrimOffsetV.end())
-                    offset_v = primitive.PrimOffsetV[facenum];
-                if (primitive.PrimUVRotation.find(facenum) != primitive.PrimUVRotation.end())
-                    rot = primitive.PrimUVRotation[facenum];
-                float rot_sin = sin(-rot);
-                float rot_cos = cos(-rot);
+                float rot_sin = sin(-face.rot);
+                float rot_cos = cos(-face.rot);
 
-                if (optimisations_enabled || primitive.DrawType == RexTypes::DRAWTYPE_MESH)
+                const PrimMesher::Coord* positions[] = { &viewerFace.v1, &viewerFace.v2, &viewerFace.v3 };
+                const PrimMesher::Coord* normals[] = { &viewerFace.n1, &viewerFace.n2, &viewerFace.n3 };
+                const PrimMesher::UVCoord* uvs[] = { &viewerFace.uv1, &viewerFace.uv2, &viewerFace.uv3 };
+                for (uint j = 0; j < 3; ++j)
                 {
-                    if ((first_face) || (mat_name != prev_mat_name))
-                    {
-                        if (indices)
-                            prim_manual_object->end();
-                        indices = 0;
-                        prim_manual_object->begin(mat_name, Ogre::RenderOperation::OT_TRIANGLE_LIST);
-                        prev_mat_name = mat_name;
-                        first_face = false;
-                    }
-                }
-                else
-                {
-                    if (i % 2 == 0)
-                    {
-                        if (indices)
-                            prim_manual_object->end();
-                        indices = 0;
-                        prim_manual_object->begin(mat_name, Ogre::RenderOperation::OT_TRIANGLE_LIST);
-                    }
+                    Ogre::Vector2 uv(uvs[j]->U, uvs[j]->V);
+                    TransformUV(uv, face.repeat_u, face.repeat_v, face.offset_u, face.offset_v, rot_sin, rot_cos);
+                    
+                    PrimVertex vertex;
+                    vertex.position[0] = positions[j]->X;
+                    vertex.position[1] = positions[j]->Y;
+                    vertex.position[2] = positions[j]->Z;
+                    vertex.normal[0] = normals[j]->X;
+                    vertex.normal[1] = normals[j]->Y;
+                    vertex.normal[2] = normals[j]->Z;
+                    vertex.uv[0] = uv.x;
+                    vertex.uv[1] = uv.y;
+                    vertex.color = color;
+                    section->vertices.push_back(vertex);
                 }
-                
-                Ogre::Vector3 pos1(primMesh.viewerFaces[i].v1.X, primMesh.viewerFaces[i].v1.Y, primMesh.viewerFaces[i].v1.Z);
-                Ogre::Vector3 pos2(primMesh.viewerFaces[i].v2.X, primMesh.viewerFaces[i].v2.Y, primMesh.viewerFaces[i].v2.Z);
-                Ogre::Vector3 pos3(primMesh.viewerFaces[i].v3.X, primMesh.viewerFaces[i].v3.Y, primMesh.viewerFaces[i].v3.Z);
-
-                Ogre::Vector3 n1(primMesh.viewerFaces[i].n1.X, primMesh.viewerFaces[i].n1.Y, primMesh.viewerFaces[i].n1.Z);
-                Ogre::Vector3 n2(primMesh.viewerFaces[i].n2.X, primMesh.viewerFaces[i].n2.Y, primMesh.viewerFaces[i].n2.Z);
-                Ogre::Vector3 n3(primMesh.viewerFaces[i].n3.X, primMesh.viewerFaces[i].n3.Y, primMesh.viewerFaces[i].n3.Z);
-                
-                Ogre::Vector2 uv1(primMesh.viewerFaces[i].uv1.U, primMesh.viewerFaces[i].uv1.V);
-                Ogre::Vector2 uv2(primMesh.viewerFaces[i].uv2.U, primMesh.viewerFaces[i].uv2.V);
-                Ogre::Vector2 uv3(primMesh.viewerFaces[i].uv3.U, primMesh.viewerFaces[i].uv3.V);
-
-                TransformUV(uv1, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
-                TransformUV(uv2, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
-                TransformUV(uv3, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
-
-                prim_manual_object->position(pos1);
-                prim_manual_object->normal(n1);
-                prim_manual_object->textureCoord(uv1);
-                prim_manual_object->colour(color.r, color.g, color.b, color.a);
-                
-                prim_manual_object->position(pos2);
-                prim_manual_object->normal(n2);
-                prim_manual_object->textureCoord(uv2);
-                prim_manual_object->colour(color.r, color.g, color.b, color.a);
-                
-                prim_manual_object->position(pos3);
-                prim_manual_object->normal(n3);
-                prim_manual_object->textureCoord(uv3);
-                prim_manual_object->colour(color.r, color.g, color.b, color.a);
-                
-                prim_manual_object->index(indices++);
-                prim_manual_object->index(indices++);
-                prim_manual_object->index(indices++);
             }
-            
-            // End last subsection
-            if (indices)
-                prim_manual_object->end();
         }
         catch (Exception& e)
         {
             RexLogicModule::LogError(std::string("Exception while creating primitive geometry: ") + e.what());
+            return false;
+        }
+        
+        return true;
+    }
+    
+    //! Fills generated prim geometry into a manual object
+    void FillManualObject(Ogre::ManualObject* manual, const PrimGeometryParams& params, const PrimGeometry& geometry)
+    {
+        PROFILE(Primitive_CreateManualObject)
+        manual->clear();
+        manual->setBoundingBox(Ogre::AxisAlignedBox());
+        
+        for (uint i = 0; i < geometry.sections.size(); ++i)
+        {
+            const PrimGeometrySection& section = geometry.sections[i];
+            manual->begin(UsePrimFaceMaterial(GetPrimFace(params, section.face)), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+            for (uint j = 0; j < section.vertices.size(); ++j)
+            {
+                const PrimVertex& vertex = section.vertices[j];
+                manual->position(vertex.position[0], vertex.position[1], vertex.position[2]);
+                manual->normal(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+                manual->textureCoord(vertex.uv[0], vertex.uv[1]);
+                manual->colour(vertex.color.r, vertex.color.g, vertex.color.b, vertex.color.a);
+                manual->index(j);
+            }
+            manual->end();
+        }
+    }
+
+    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled)
+    {
+        PROFILE(Primitive_CreateGeometry)
+        
+        if (!primitive.HasPrimShapeData)
             return 0;
+        
+        Ogre::ManualObject* manual = GetPrimManualObject(framework);
+        if (!manual)
+            return 0;
+        
+        PrimGeometryParams params;
+        GetPrimGeometryParams(framework, primitive, optimisations_enabled, params);
+        PrimGeometry geometry;
+        if (!GeneratePrimGeometry(params, geometry))
+            return 0;
+        
+        FillManualObject(manual, params, geometry);
+        return manual;
+    }
+    
+    Ogre::MeshPtr GetSharedPrimMesh(Foundation::Framework* framework, EC_OpenSimPrim& primitive, std::vector<std::string>& materials)
+    {
+        PROFILE(Primitive_GetSharedMesh)
+        
+        materials.clear();
+        if (!primitive.HasPrimShapeData)
+            return Ogre::MeshPtr();
+        
+        PrimGeometryParams params;
+        GetPrimGeometryParams(framework, primitive, true, params);
+        
+        Ogre::MeshPtr mesh;
+        if (FindSharedPrimMesh(params, mesh, materials))
+            return mesh;
+        
+        PrimGeometry geometry;
+        if (!GeneratePrimGeometry(params, geometry) || !AddSharedPrimMesh(framework, params, geometry))
+            return Ogre::MeshPtr();
+        
+        FindSharedPrimMesh(params, mesh, materials);
+        return mesh;
+    }
+    
+    bool FindSharedPrimMesh(const PrimGeometryParams& params, Ogre::MeshPtr& mesh, std::vector<std::string>& materials)
+    {
+        materials.clear();
+        boost::unordered_map<std::string, PrimMeshEntry>::const_iterator i = prim_meshes.find(params.key);
+        if (i == prim_meshes.end())
+        {
+            mesh.setNull();
+            return false;
         }
         
-        return prim_manual_object;
+        const PrimMeshEntry& entry = i->second;
+        for (uint j = 0; j < entry.submesh_faces.size(); ++j)
+            materials.push_back(UsePrimFaceMaterial(GetPrimFace(params, entry.submesh_faces[j])));
+        
+        mesh = entry.mesh;
+        return true;
+    }
+    
+    bool AddSharedPrimMesh(Foundation::Framework* framework, const PrimGeometryParams& params, const PrimGeometry& geometry)
+    {
+        PROFILE(Primitive_AddSharedMesh)
+        
+        if (prim_meshes.find(params.key) != prim_meshes.end())
+            return true;
+        
+        // Prims with no visible faces are cached too, with a null mesh
+        Ogre::MeshPtr mesh;
+        if (!geometry.sections.empty())
+        {
+            Ogre::ManualObject* manual = GetPrimManualObject(framework);
+            OgreRenderer::RendererPtr renderer = framework->GetServiceManager()->GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
+            if (!manual || !renderer)
+                return false;
+            
+            FillManualObject(manual, params, geometry);
+            try
+            {
+                mesh = manual->convertToMesh(renderer->GetUniqueObjectName());
+                manual->clear();
+            }
+            catch (Ogre::Exception& e)
+            {
+                manual->clear();
+                RexLogicModule::LogError("Could not convert prim geometry to mesh: " + std::string(e.what()));
+                return false;
+            }
+        }
+        
+        PrimMeshEntry& entry = prim_meshes[params.key];
+        for (uint i = 0; i < geometry.sections.size(); ++i)
+            entry.submesh_faces.push_back(geometry.sections[i].face);
+        entry.mesh = mesh;
+        mesh.setNull();
+        // The references of the cache and the mesh manager
+        entry.unused_count = entry.mesh.isNull() ? 0 : entry.mesh.useCount();
+        return true;
+    }
+    
+    void ReleaseUnusedPrimMeshes()
+    {
+        boost::unordered_map<std::string, PrimMeshEntry>::iterator i = prim_meshes.begin();
+        while (i != prim_meshes.end())
+        {
+            Ogre::MeshPtr& mesh = i->second.mesh;
+            if (mesh.isNull() || mesh.useCount() <= i->second.unused_count)
+            {
+                if (!mesh.isNull())
+                {
+                    std::string mesh_name = mesh->getName();
+                    mesh.setNull();
+                    try
+                    {
+                        Ogre::MeshManager::getSingleton().remove(mesh_name);
+                    }
+                    catch (...) {}
+                }
+                i = prim_meshes.erase(i);
+            }
+            else
+                ++i;
+        }
+    }
+    
+    void ClearPrimMeshCache()
+    {
+        // Meshes still in use are removed by Ogre at shutdown
+        ReleaseUnusedPrimMeshes();
+        prim_meshes.clear();
     }
 }
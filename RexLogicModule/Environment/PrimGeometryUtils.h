@@ -4,21 +4,143 @@
 #define incl_RexLogicModule_PrimGeometryUtils_h
 
 #include "RexLogicModuleApi.h"
+#include "Color.h"
+
+#include <map>
+#include <string>
+#include <vector>
 
 class EC_OpenSimPrim;
 
 namespace Ogre
 {
     class ManualObject;
+    class MeshPtr;
 }
 
 namespace RexLogic
 {
+    //! Parameters of a prim face that affect its geometry
+    struct PrimFace
+    {
+        Color color;
+        float repeat_u;
+        float repeat_v;
+        float offset_u;
+        float offset_v;
+        float rot;
+
+        //! Material name
+        std::string material;
+
+        //! Texture and variation of the legacy material, if the face does not use the override material
+        std::string texture_name;
+        unsigned variation;
+    };
+
+    typedef std::map<uint8_t, PrimFace> PrimFaceMap;
+
+    //! Prim geometry parameters, copied from the prim so that the geometry can be generated on another thread
+    struct PrimGeometryParams
+    {
+        int profile_curve;
+        float profile_begin;
+        float profile_end;
+        float profile_hollow;
+        int path_curve;
+        float path_begin;
+        float path_end;
+        float path_shear_x;
+        float path_shear_y;
+        float path_twist_begin;
+        float path_twist;
+        float path_scale_x;
+        float path_scale_y;
+        float path_radius_offset;
+        float path_revolutions;
+        float path_skew;
+        float path_taper_x;
+        float path_taper_y;
+
+        //! Parameters of the faces not in faces
+        PrimFace default_face;
+
+        //! Parameters of the faces by face number
+        PrimFaceMap faces;
+
+        //! Whether faces with the same material are put into the same submesh
+        bool optimisations_enabled;
+
+        //! Key of the shared mesh, the parameters that end up in the vertex data. Materials are keyed only by which
+        //! faces use the same one.
+        std::string key;
+    };
+
+    //! Vertex of prim geometry
+    struct PrimVertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+        Color color;
+    };
+
+    //! Submesh of prim geometry. Every three vertices form a triangle.
+    struct PrimGeometrySection
+    {
+        //! Face number of the first face, the material of which the submesh uses
+        uint8_t face;
+
+        //! Vertices
+        std::vector<PrimVertex> vertices;
+    };
+
+    //! Prim geometry in plain buffers, not yet in Ogre
+    struct PrimGeometry
+    {
+        std::vector<PrimGeometrySection> sections;
+    };
+
+    //! Copies the geometry parameters of a prim. Main thread only, creates no materials.
+    REXLOGIC_MODULE_API void GetPrimGeometryParams(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled, PrimGeometryParams& params);
+
+    //! Generates prim geometry from parameters. Thread-safe.
+    /*! \return true if successful
+     */
+    REXLOGIC_MODULE_API bool GeneratePrimGeometry(const PrimGeometryParams& params, PrimGeometry& geometry);
+
     //! Generates prim geometry into an Ogre manual object from prim parameters and returns it or 0 if something went wrong
     /*! Note that the same manual object is returned for each call, so you should immediately CommitChanges() into an
         EC_OgreCustomObject before calling CreatePrimGeometry again.
      */
     REXLOGIC_MODULE_API Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled = true);
+
+    //! Returns a mesh with the prim geometry, shared by all prims with the same shape, face colors and texture mapping
+    /*! The mesh is generated only for the first such prim. The prims differ by the materials of their submeshes, to be set
+        on the subentities, see EC_OgreCustomObject::CommitChanges(). The mesh is removed by ReleaseUnusedPrimMeshes() once
+        no entity uses it.
+        \param materials Filled with the material of each submesh for this prim
+        \return the mesh, or null if the prim has no visible geometry or something went wrong
+     */
+    REXLOGIC_MODULE_API Ogre::MeshPtr GetSharedPrimMesh(Foundation::Framework* framework, EC_OpenSimPrim& primitive, std::vector<std::string>& materials);
+
+    //! Looks up the shared mesh for prim geometry parameters
+    /*! \param mesh Set to the mesh, null if the prim has no visible geometry
+        \param materials Filled with the material of each submesh for the prim
+        \return true if the mesh has been created, false if it has to be generated first
+     */
+    REXLOGIC_MODULE_API bool FindSharedPrimMesh(const PrimGeometryParams& params, Ogre::MeshPtr& mesh, std::vector<std::string>& materials);
+
+    //! Creates the shared mesh of generated prim geometry, see FindSharedPrimMesh()
+    /*! \return true if successful
+     */
+    REXLOGIC_MODULE_API bool AddSharedPrimMesh(Foundation::Framework* framework, const PrimGeometryParams& params, const PrimGeometry& geometry);
+
+    //! Removes the shared prim meshes no entity uses any more
+    REXLOGIC_MODULE_API void ReleaseUnusedPrimMeshes();
+
+    //! Forgets all shared prim meshes, removing the unused ones. Call before the renderer is destroyed
+    REXLOGIC_MODULE_API void ClearPrimMeshCache();
 }
 
-#endif
\ No newline at end of file
+#endif
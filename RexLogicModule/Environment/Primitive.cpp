@@ -32,12 +32,14 @@
 #include "SceneEvents.h"
 #include "ResourceInterface.h"
 #include "Environment/PrimGeometryUtils.h"
+#include "Environment/PrimGeometryQueue.h"
 #include "SceneManager.h"
 #include "AssetServiceInterface.h"
 #include "ISoundService.h"
 #include "GenericMessageUtils.h"
 #include "EventManager.h"
 #include "ServiceManager.h"
+#include "FrameScheduler.h"
 #include "WorldStream.h"
 
 #include "EC_NetworkPosition.h"
@@ -47,9 +49,12 @@
 #include "EC_OpenSimPrim.h"
 
 #include "IAttribute.h"
+#include "DataSerializer.h"
 
 #include <OgreSceneNode.h>
 
+#include <boost/bind.hpp>
+
 #include <QUrl>
 #include <QColor>
 #include <QDomDocument>
@@ -60,18 +65,55 @@
 namespace RexLogic
 {
 
-Primitive::Primitive(RexLogicModule *rexlogicmodule) : rexlogicmodule_(rexlogicmodule)
+//! Prefix of freedata that holds binary serialized EC's. The rest of the freedata is the binary data in Base64, as
+//! freedata travels in null-terminated strings.
+static const char cBinaryECDataPrefix[] = "#ECB1:";
+
+//! Interval of removing the shared prim meshes no entity uses any more, in seconds
+static const f64 PRIM_MESH_RELEASE_INTERVAL = 5.0;
+
+//! Name of the frame stage the meshes of generated prim geometry are created in
+static const std::string PRIM_GEOMETRY_STAGE = "PrimGeometry";
+
+//! Default share of the frame for creating prim meshes
+static const f64 PRIM_GEOMETRY_SHARE = 0.1;
+
+Primitive::Primitive(RexLogicModule *rexlogicmodule) :
+    rexlogicmodule_(rexlogicmodule),
+    prim_mesh_release_timer_(0.0),
+    geometry_queue_(new PrimGeometryQueue(rexlogicmodule->GetFramework()))
 {
+    // Binary EC data is understood by all clients that have this code, but older clients only parse XML
+    binary_ec_sync_ = rexlogicmodule_->GetFramework()->GetDefaultConfig().DeclareSetting("RexLogicModule", "binary_ec_sync", false);
+
+    rexlogicmodule_->GetFramework()->GetFrameScheduler()->AddStage(PRIM_GEOMETRY_STAGE, PRIM_GEOMETRY_SHARE,
+        boost::bind(&Primitive::FinalizePrimGeometry, this, _1, _2));
 }
 
 Primitive::~Primitive()
 {
+    Foundation::FrameSchedulerPtr scheduler = rexlogicmodule_->GetFramework()->GetFrameScheduler();
+    if (scheduler)
+        scheduler->RemoveStage(PRIM_GEOMETRY_STAGE);
+
+    // Abandon the geometry jobs before the meshes go
+    geometry_queue_.reset();
+    ClearPrimMeshCache();
 }
 
 void Primitive::Update(f64 frametime)
 {
     // Comment line to disable old freedata messaging system
     // SerializeECsToNetwork();
+
+    // Remove the shared prim meshes of prims that have been removed or changed shape
+    prim_mesh_release_timer_ += frametime;
+    if (prim_mesh_release_timer_ >= PRIM_MESH_RELEASE_INTERVAL)
+    {
+        PROFILE(Primitive_ReleaseUnusedPrimMeshes);
+        prim_mesh_release_timer_ = 0.0;
+        ReleaseUnusedPrimMeshes();
+    }
 }
 
 Scene::EntityPtr Primitive::GetOrCreatePrimEntity(entity_id_t entityid, const RexUUID &fullid, bool *created)
@@ -583,10 +625,8 @@ void Primitive::HandleECData(entity_id_t entityid, const uint8_t* primdata, cons
     if (!entity)
         return;
 
-    QDomDocument temp_doc;
-    if (temp_doc.setContent(QByteArray::fromRawData(data.c_str(), data.size())))
+    if (DeserializeECsFromFreeData(entity, data))
     {
-        DeserializeECsFromFreeData(entity, temp_doc);
         Scene::Events::SceneEventData event_data(entity->GetId());
         EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
         event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_ECS_RECEIVED, &event_data);
@@ -800,18 +840,10 @@ void Primitive::SendECData(entity_id_t entity_id, IComponent * component)
     if (!entity)
         return;
     
-    QDomDocument temp_doc;
-    QDomElement entity_elem = temp_doc.createElement("entity");
-    
-    QString id_str;
-    id_str.setNum(entity->GetId());
-    entity_elem.setAttribute("id", id_str);
-    
+    std::vector<IComponent *> components;
     if ((component->IsSerializable()) && (component->GetNetworkSyncEnabled()))
-        component->SerializeTo(temp_doc, entity_elem);
- 
-    temp_doc.appendChild(entity_elem);
-    QByteArray bytes = temp_doc.toByteArray();
+        components.push_back(component);
+    QByteArray bytes = SerializeECs(entity, components);
     
     if (bytes.size() > 1000)
     {
@@ -1010,12 +1042,10 @@ void Primitive::HandleRexFreeData(entity_id_t entityid, const std::string& freed
     EC_FreeData& free = *(dynamic_cast<EC_FreeData*>(freeptr.get()));
     free.FreeData = freedata;
     
-    // Parse into XML form (may or may not succeed), and create/update EC's as result
+    // Parse (may or may not succeed), and create/update EC's as result
     // (primitive form of EC serialization/replication)
-    QDomDocument temp_doc;
-    if (temp_doc.setContent(QByteArray::fromRawData(freedata.c_str(), freedata.size())))
+    if (DeserializeECsFromFreeData(entity, freedata))
     {
-        DeserializeECsFromFreeData(entity, temp_doc);
         Scene::Events::SceneEventData event_data(entity->GetId());
         EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
         event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_ECS_RECEIVED, &event_data);
@@ -1037,22 +1067,24 @@ bool Primitive::HandleOSNE_KillObject(uint32_t objectid)
     if (prim)
         fullid = prim->FullId;
 
-    //need to remove children aswell... ///\todo is there a better way of doing this?
-    for(Scene::SceneManager::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+    // Need to remove children aswell. Collect them first, as removing entities invalidates scene iterators.
+    Scene::EntityList prims = scene->GetEntitiesWithComponent(EC_OpenSimPrim::TypeNameStatic());
+    for(Scene::EntityList::iterator iter = prims.begin(); iter != prims.end(); ++iter)
     {
-        Scene::Entity &entity = *iter->second;
-        EC_OpenSimPrim *prim = entity.GetComponent<EC_OpenSimPrim>().get();
+        EC_OpenSimPrim *prim = (*iter)->GetComponent<EC_OpenSimPrim>().get();
         if (!prim)
             continue;
 
         if (prim->ParentId == objectid)
         {
             childfullid = prim->FullId;
+            geometry_queue_->Cancel(prim->LocalId);
             scene->RemoveEntity(prim->LocalId);
             rexlogicmodule_->UnregisterFullId(childfullid);
         }
     }
 
+    geometry_queue_->Cancel(objectid);
     scene->RemoveEntity(objectid);
     rexlogicmodule_->UnregisterFullId(fullid);
     return false;
@@ -1202,16 +1234,7 @@ void Primitive::HandleDrawType(entity_id_t entityid)
         HandlePrimTexturesAndMaterial(entityid);
 
         // Create/update geometry
-        if (prim.HasPrimShapeData)
-        {
-            Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), prim);
-            custom.CommitChanges(manual);
-            
-            Scene::Events::EntityEventData event_data;
-            event_data.entity = entity;
-            EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
-            event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
-        }
+        UpdatePrimGeometry(entityid);
     }
 
     if (!RexTypes::IsNull(prim.ParticleScriptID))
@@ -1752,16 +1775,7 @@ void Primitive::HandleMaterialResourceReady(entity_id_t entityid, Foundation::Re
         if (custom && prim->Materials.size() && res->GetId() == prim->Materials[0].asset_id && prim->Materials[0].Type == RexTypes::RexAT_MaterialScript)
         {
             // Update geometry now that the material exists
-            if (prim->HasPrimShapeData)
-            {
-                Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), *prim);
-                custom->CommitChanges(manual);
-
-                Scene::Events::EntityEventData event_data;
-                event_data.entity = entity;
-                EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
-                event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
-            }
+            UpdatePrimGeometry(entityid);
         }
     }
     
@@ -1810,6 +1824,55 @@ void Primitive::HandleMaterialResourceReady(entity_id_t entityid, Foundation::Re
     }
 }
 
+void Primitive::UpdatePrimGeometry(entity_id_t entityid)
+{
+    Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(entityid);
+    if (!entity)
+    {
+        geometry_queue_->Cancel(entityid);
+        return;
+    }
+    EC_OpenSimPrim* prim = entity->GetComponent<EC_OpenSimPrim>().get();
+    EC_OgreCustomObject* custom = entity->GetComponent<EC_OgreCustomObject>().get();
+    if (!prim || !custom || prim->DrawType != RexTypes::DRAWTYPE_PRIM || !prim->HasPrimShapeData)
+    {
+        geometry_queue_->Cancel(entityid);
+        return;
+    }
+
+    // If the geometry is not ready yet, the prim keeps its old geometry until FinalizePrimGeometry gets back here
+    Ogre::MeshPtr mesh;
+    std::vector<std::string> materials;
+    if (!geometry_queue_->Request(entityid, *prim, mesh, materials))
+        return;
+
+    custom->CommitChanges(mesh, materials);
+
+    Scene::Events::EntityEventData event_data;
+    event_data.entity = entity;
+    EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
+    event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
+}
+
+bool Primitive::FinalizePrimGeometry(f64 frametime, const Foundation::FrameBudget& budget)
+{
+    PROFILE(Primitive_FinalizePrimGeometry);
+
+    // Apply the meshes already made first, a bounded number per frame, as each creates an entity and sends an event
+    entity_id_t entityid;
+    while(geometry_queue_->PopReady(entityid))
+    {
+        UpdatePrimGeometry(entityid);
+        if (budget.Expired())
+            return false;
+    }
+
+    bool done = geometry_queue_->Finalize(budget);
+    while(!budget.Expired() && geometry_queue_->PopReady(entityid))
+        UpdatePrimGeometry(entityid);
+    return done && !geometry_queue_->HasReady();
+}
+
 void Primitive::DiscardRequestTags(entity_id_t entityid, Primitive::EntityResourceRequestMap& map)
 {
     std::vector<Primitive::EntityResourceRequestMap::iterator> tags_to_remove;
@@ -2178,6 +2241,7 @@ void Primitive::HandleLogout()
     pending_rexprimdata_.clear();
     pending_rexfreedata_.clear();
     local_dirty_entities_.clear();
+    geometry_queue_->CancelAll();
 }
 
 
@@ -2343,21 +2407,14 @@ void Primitive::SerializeECsToNetwork()
             continue;
         EC_FreeData& free = *(dynamic_cast<EC_FreeData*>(freeptr.get()));
         
-        QDomDocument temp_doc;
-        QDomElement entity_elem = temp_doc.createElement("entity");
-        
-        QString id_str;
-        id_str.setNum(entity->GetId());
-        entity_elem.setAttribute("id", id_str);
-        
+        std::vector<IComponent *> serializable;
         for (uint j = 0; j < components.size(); ++j)
         {
             if ((components[j]->IsSerializable()) && (components[j]->GetNetworkSyncEnabled()))
-                components[j]->SerializeTo(temp_doc, entity_elem);
+                serializable.push_back(components[j].get());
         }
         
-        temp_doc.appendChild(entity_elem);
-        QByteArray bytes = temp_doc.toByteArray();
+        QByteArray bytes = SerializeECs(entity, serializable);
         
         if (bytes.size() > 1000)
         {
@@ -2372,7 +2429,92 @@ void Primitive::SerializeECsToNetwork()
     local_dirty_entities_.clear();
 }
 
-void Primitive::DeserializeECsFromFreeData(Scene::EntityPtr entity, QDomDocument& doc)
+QByteArray Primitive::SerializeECs(Scene::EntityPtr entity, const std::vector<IComponent *> &components)
+{
+    if (binary_ec_sync_)
+    {
+        QByteArray data;
+        DataSerializer dest(data);
+        dest.AddVLE(components.size());
+        for (uint i = 0; i < components.size(); ++i)
+            components[i]->SerializeToBinary(dest);
+        return QByteArray(cBinaryECDataPrefix) + data.toBase64();
+    }
+    
+    QDomDocument temp_doc;
+    QDomElement entity_elem = temp_doc.createElement("entity");
+    
+    QString id_str;
+    id_str.setNum(entity->GetId());
+    entity_elem.setAttribute("id", id_str);
+    
+    for (uint i = 0; i < components.size(); ++i)
+        components[i]->SerializeTo(temp_doc, entity_elem);
+    
+    temp_doc.appendChild(entity_elem);
+    return temp_doc.toByteArray();
+}
+
+bool Primitive::DeserializeECsFromFreeData(Scene::EntityPtr entity, const std::string& freedata)
+{
+    const size_t prefix_len = sizeof(cBinaryECDataPrefix) - 1;
+    if (freedata.compare(0, prefix_len, cBinaryECDataPrefix) == 0)
+    {
+        QByteArray data = QByteArray::fromBase64(QByteArray::fromRawData(freedata.c_str() + prefix_len, freedata.size() - prefix_len));
+        return DeserializeECsFromBinary(entity, data);
+    }
+    
+    // Parse into XML form (may or may not succeed)
+    QDomDocument temp_doc;
+    if (!temp_doc.setContent(QByteArray::fromRawData(freedata.c_str(), freedata.size())))
+        return false;
+    DeserializeECsFromXml(entity, temp_doc);
+    return true;
+}
+
+bool Primitive::DeserializeECsFromBinary(Scene::EntityPtr entity, const QByteArray& data)
+{
+    StringVector type_names;
+    StringVector names;
+    std::vector<ComponentPtr> deserialized;
+    
+    DataDeserializer source(data.constData(), data.size());
+    u32 num_components = source.ReadVLE();
+    for (u32 i = 0; i < num_components && source.IsValid(); ++i)
+    {
+        QString type_name, name;
+        IComponent::ReadBinaryHeader(source, type_name, name);
+        if (!source.IsValid())
+            break;
+        type_names.push_back(type_name.toStdString());
+        names.push_back(name.toStdString());
+        
+        // Signal the add of component right away
+        ComponentPtr new_comp = entity->GetOrCreateComponent(type_name, name, AttributeChange::LocalOnly);
+        if (!new_comp)
+            RexLogicModule::LogWarning("Could not create entity component from binary data: " + type_name.toStdString());
+        // If it's an existing component, and has network sync disabled, skip quietly
+        if ((new_comp) && (new_comp->GetNetworkSyncEnabled()))
+        {
+            // Deserialize in disconnected manner, signal the attribute changes later
+            new_comp->DeserializeFromBinary(source, AttributeChange::Disconnected);
+            deserialized.push_back(new_comp);
+        }
+        else
+            IComponent::SkipBinary(source);
+    }
+    
+    if (!source.IsValid())
+    {
+        RexLogicModule::LogError("Truncated binary entity component data for entity " + ToString(entity->GetId()));
+        return false;
+    }
+    
+    ApplyDeserializedECs(entity, type_names, names, deserialized);
+    return true;
+}
+
+void Primitive::DeserializeECsFromXml(Scene::EntityPtr entity, QDomDocument& doc)
 {
     StringVector type_names;
     StringVector names;
@@ -2403,6 +2545,12 @@ void Primitive::DeserializeECsFromFreeData(Scene::EntityPtr entity, QDomDocument
         }
     }
     
+    ApplyDeserializedECs(entity, type_names, names, deserialized);
+}
+
+void Primitive::ApplyDeserializedECs(Scene::EntityPtr entity, const StringVector& type_names, const StringVector& names,
+    const std::vector<ComponentPtr>& deserialized)
+{
     // If the entity has extra serializable EC's, we must remove them if they are no longer in the freedata.
     // However, at present time majority of EC's are not serializable, are handled internally, and must not be removed
     Scene::Entity::ComponentVector all_components = entity->GetComponentVector();
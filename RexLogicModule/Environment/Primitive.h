@@ -31,6 +31,7 @@ namespace RexLogic
 {
     class RexLogicModule;
     class EC_AttachedSound;
+    class PrimGeometryQueue;
 
     class Primitive : public QObject
     {
@@ -84,8 +85,9 @@ namespace RexLogic
         // Start listening to Scene's EC notification signals
         void RegisterToComponentChangeSignals(Scene::ScenePtr scene);
         
-        // Deserialize EC's sent by server
-        void DeserializeECsFromFreeData(Scene::EntityPtr entity, QDomDocument& doc);
+        //! Deserialize EC's sent by server. Accepts both XML and binary freedata.
+        //! \return true if the data could be parsed
+        bool DeserializeECsFromFreeData(Scene::EntityPtr entity, const std::string& freedata);
         
     public slots:
         //! Trigger EC sync because of component attributes changing
@@ -202,12 +204,33 @@ namespace RexLogic
         //! handles prim size and visibility
         void HandlePrimScaleAndVisibility(entity_id_t entityid);
 
+        //! Requests the geometry of a prim and sets it to the custom object of the prim once it is ready
+        //! @param entityid Entity id.
+        void UpdatePrimGeometry(entity_id_t entityid);
+
+        //! Frame stage that sets the prim geometry finished on the thread pool
+        bool FinalizePrimGeometry(f64 frametime, const Foundation::FrameBudget& budget);
+
         //! discards request tags for certain entity
         void DiscardRequestTags(entity_id_t, EntityResourceRequestMap& map);
 
         // Go through dirty lists & send changed components to server
         void SerializeECsToNetwork();
 
+        //! Serializes components of an entity into freedata, in binary or XML form depending on binary_ec_sync_.
+        QByteArray SerializeECs(Scene::EntityPtr entity, const std::vector<IComponent *> &components);
+
+        //! Deserializes EC's from binary data written by SerializeECs.
+        bool DeserializeECsFromBinary(Scene::EntityPtr entity, const QByteArray& data);
+
+        //! Deserializes EC's from an XML document written by SerializeECs.
+        void DeserializeECsFromXml(Scene::EntityPtr entity, QDomDocument& doc);
+
+        //! Removes the serializable EC's of the entity that were not in the deserialized data, and signals the changes
+        //! of the deserialized ones.
+        void ApplyDeserializedECs(Scene::EntityPtr entity, const StringVector& type_names, const StringVector& names,
+            const std::vector<ComponentPtr>& deserialized);
+
         //! Return valid uuid if given id is valid uuid or if given id
         //! is valid asset url with format: 'http://domain/path/xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx'
         //! Return zero uuid if either above works
@@ -234,6 +257,15 @@ namespace RexLogic
         typedef std::set<entity_id_t> EntityIdSet;
         //! entities with local EC changes
         EntityIdSet local_dirty_entities_;
+
+        //! Whether EC's are sent to the server in binary instead of XML form
+        bool binary_ec_sync_;
+
+        //! Time since unused shared prim meshes were last removed
+        f64 prim_mesh_release_timer_;
+
+        //! Generates prim geometry on the thread pool
+        boost::shared_ptr<PrimGeometryQueue> geometry_queue_;
     };
 }
 #endif
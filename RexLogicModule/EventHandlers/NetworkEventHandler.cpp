@@ -7,6 +7,7 @@
 
 #include "StableHeaders.h"
 #include "EventHandlers/NetworkEventHandler.h"
+#include "EventHandlers/TerseUpdateBatch.h"
 #include "RexLogicModule.h"
 #include "Avatar/AvatarControllable.h"
 #include "Avatar/AvatarHandler.h"
@@ -48,7 +49,9 @@ using namespace ProtocolUtilities;
 
 NetworkEventHandler::NetworkEventHandler(RexLogicModule *owner) :
     owner_(owner),
-    ongoing_script_teleport_(false)
+    ongoing_script_teleport_(false),
+    terse_update_index_(new LocalIdEntityIndex(owner)),
+    terse_update_batch_(new TerseUpdateBatch)
 {
     // Get the pointe to the current protocol module
     ProtocolModuleInterface *protocol = owner_->GetServerConnection()->GetCurrentProtocolModuleWeakPointer().lock().get();
@@ -308,6 +311,10 @@ bool NetworkEventHandler::HandleOSNE_ImprovedTerseObjectUpdate(NetworkEventInbou
         return false;
     }
 
+    // Decode all the blocks of the packet first, then apply them in one pass.
+    TerseUpdateBatch &batch = *terse_update_batch_;
+    batch.Clear();
+
     // Variable block
     size_t instance_count = msg.ReadCurrentBlockInstanceCount();
     for(size_t i = 0; i < instance_count; i++)
@@ -315,34 +322,17 @@ bool NetworkEventHandler::HandleOSNE_ImprovedTerseObjectUpdate(NetworkEventInbou
         size_t bytes_read = 0;
         const uint8_t *bytes = msg.ReadBuffer(&bytes_read);
 
-        uint32_t localid = 0;
-        switch(bytes_read)
+        if (!DecodeTerseUpdateBlock(*terse_update_index_, batch, bytes, bytes_read))
         {
-        case 30:
-            owner_->GetAvatarHandler()->HandleTerseObjectUpdate_30bytes(bytes); 
-            break;
-        case 44:
-            //this size is only for prims
-            localid = *reinterpret_cast<uint32_t*>((uint32_t*)&bytes[0]);
-            if (owner_->GetPrimEntity(localid))
-                owner_->GetPrimitiveHandler()->HandleTerseObjectUpdateForPrim_44bytes(bytes);
-            break;
-        case 60:
-            localid = *reinterpret_cast<uint32_t*>((uint32_t*)&bytes[0]); 
-            if (owner_->GetPrimEntity(localid)) 
-                owner_->GetPrimitiveHandler()->HandleTerseObjectUpdateForPrim_60bytes(bytes);
-            else if (owner_->GetAvatarEntity(localid))
-                owner_->GetAvatarHandler()->HandleTerseObjectUpdateForAvatar_60bytes(bytes);
-            break;
-        default:
             std::stringstream ss; 
             ss << "Unhandled ImprovedTerseObjectUpdate block of size " << bytes_read << "!";
             RexLogicModule::LogInfo(ss.str());
-            break;
         }
 
         msg.SkipToNextVariable(); ///\todo Unhandled inbound variable 'TextureEntry'.
     }
+
+    ApplyTerseUpdateBatch(batch);
     return false;
 }
 
@@ -356,6 +346,7 @@ bool NetworkEventHandler::HandleOSNE_KillObject(NetworkEventInboundData* data)
     for(size_t i = 0; i < instance_count; ++i)
     {
         uint32_t killedobjectid = msg.ReadU32();
+        terse_update_index_->Remove(killedobjectid);
         if (owner_->GetPrimEntity(killedobjectid))
             return owner_->GetPrimitiveHandler()->HandleOSNE_KillObject(killedobjectid);
         if (owner_->GetAvatarEntity(killedobjectid))
@@ -26,6 +26,9 @@ namespace RexLogic
     }
     typedef boost::shared_ptr<InWorldChat::Provider> InWorldChatProviderPtr;
 
+    class LocalIdEntityIndex;
+    struct TerseUpdateBatch;
+
     /// Handles incoming SLUDP network events (messages) in a reX-specific way.
     class NetworkEventHandler
     {
@@ -134,6 +137,12 @@ namespace RexLogic
 
         ScriptDialogHandlerPtr script_dialog_handler_; /// @todo: Move to RexLogic module
         bool ongoing_script_teleport_;
+
+        //! Localid to entity lookup used for ImprovedTerseObjectUpdate.
+        boost::shared_ptr<LocalIdEntityIndex> terse_update_index_;
+
+        //! Reused between ImprovedTerseObjectUpdate packets so that decoding doesn't allocate.
+        boost::shared_ptr<TerseUpdateBatch> terse_update_batch_;
     };
 }
 
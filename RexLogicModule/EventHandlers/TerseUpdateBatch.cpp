@@ -0,0 +1,281 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   TerseUpdateBatch.cpp
+ *  @brief  Batched application of ImprovedTerseObjectUpdate blocks, with a flat localid to entity index.
+ */
+
+#include "StableHeaders.h"
+#include "EventHandlers/TerseUpdateBatch.h"
+#include "RexLogicModule.h"
+#include "RexNetworkUtils.h"
+#include "Entity.h"
+#include "EC_NetworkPosition.h"
+
+namespace RexLogic
+{
+
+/// Spreads the bits of a localid so that consecutive ids don't cluster in the table.
+static inline size_t HashLocalId(uint32_t localid)
+{
+    localid ^= localid >> 16;
+    localid *= 0x85ebca6b;
+    localid ^= localid >> 13;
+    localid *= 0xc2b2ae35;
+    localid ^= localid >> 16;
+    return localid;
+}
+
+LocalIdEntityIndex::LocalIdEntityIndex(RexLogicModule *owner) :
+    used_(0),
+    deleted_(0),
+    owner_(owner)
+{
+    Rehash(256);
+}
+
+size_t LocalIdEntityIndex::Probe(uint32_t localid) const
+{
+    const size_t mask = slots_.size() - 1;
+    size_t idx = HashLocalId(localid) & mask;
+    size_t firstDeleted = (size_t)-1;
+    for(;;)
+    {
+        if (states_[idx] == SlotFree)
+            return firstDeleted != (size_t)-1 ? firstDeleted : idx;
+        if (states_[idx] == SlotDeleted)
+        {
+            if (firstDeleted == (size_t)-1)
+                firstDeleted = idx;
+        }
+        else if (slots_[idx].localid == localid)
+            return idx;
+        idx = (idx + 1) & mask;
+    }
+}
+
+const LocalIdEntityIndex::Entry *LocalIdEntityIndex::Find(uint32_t localid)
+{
+    size_t idx = Probe(localid);
+    if (states_[idx] == SlotUsed)
+    {
+        Entry &entry = slots_[idx];
+        if (!entry.entity.expired() && !entry.netpos.expired())
+            return &entry;
+
+        // The entity or its component is gone, the id may have been reused for a new object.
+        if (Resolve(localid, entry))
+            return &entry;
+        states_[idx] = SlotDeleted;
+        slots_[idx] = Entry();
+        --used_;
+        ++deleted_;
+        return 0;
+    }
+
+    Entry entry;
+    if (!Resolve(localid, entry))
+        return 0; // Negative results are not cached, the object may still be created later.
+
+    // Keep the load factor, counting tombstones, below 3/4.
+    if ((used_ + deleted_ + 1) * 4 > slots_.size() * 3)
+    {
+        Rehash(used_ + 1);
+        idx = Probe(localid);
+    }
+
+    if (states_[idx] == SlotDeleted)
+        --deleted_;
+    states_[idx] = SlotUsed;
+    slots_[idx] = entry;
+    ++used_;
+    return &slots_[idx];
+}
+
+void LocalIdEntityIndex::Remove(uint32_t localid)
+{
+    size_t idx = Probe(localid);
+    if (states_[idx] != SlotUsed)
+        return;
+    states_[idx] = SlotDeleted;
+    slots_[idx] = Entry();
+    --used_;
+    ++deleted_;
+}
+
+void LocalIdEntityIndex::Clear()
+{
+    slots_.assign(slots_.size(), Entry());
+    states_.assign(states_.size(), (unsigned char)SlotFree);
+    used_ = 0;
+    deleted_ = 0;
+}
+
+bool LocalIdEntityIndex::Resolve(uint32_t localid, Entry &entry) const
+{
+    ObjectKind kind = KindPrim;
+    Scene::EntityPtr entity = owner_->GetPrimEntity(localid);
+    if (!entity)
+    {
+        kind = KindAvatar;
+        entity = owner_->GetAvatarEntity(localid);
+    }
+    if (!entity)
+        return false;
+
+    boost::shared_ptr<EC_NetworkPosition> netpos = entity->GetComponent<EC_NetworkPosition>();
+    if (!netpos)
+        return false;
+
+    entry.localid = localid;
+    entry.kind = kind;
+    entry.entity = entity;
+    entry.netpos = netpos;
+    return true;
+}
+
+void LocalIdEntityIndex::Rehash(size_t minCapacity)
+{
+    // Count only the live entries; expired ones are dropped here.
+    std::vector<Entry> live;
+    live.reserve(used_);
+    for(size_t i = 0; i < slots_.size(); ++i)
+        if (states_[i] == SlotUsed && !slots_[i].entity.expired())
+            live.push_back(slots_[i]);
+
+    size_t capacity = 256;
+    while(capacity * 3 < (std::max(minCapacity, live.size()) + 1) * 4 * 2)
+        capacity <<= 1;
+
+    slots_.assign(capacity, Entry());
+    states_.assign(capacity, (unsigned char)SlotFree);
+    used_ = 0;
+    deleted_ = 0;
+    for(size_t i = 0; i < live.size(); ++i)
+    {
+        size_t idx = Probe(live[i].localid);
+        states_[idx] = SlotUsed;
+        slots_[idx] = live[i];
+        ++used_;
+    }
+}
+
+void TerseUpdateBatch::Clear()
+{
+    // Keep the capacity so that steady-state batches don't allocate.
+    entities.clear();
+    netpositions.clear();
+    flags.clear();
+    positions.clear();
+    velocities.clear();
+    accels.clear();
+    orientations.clear();
+    rotvels.clear();
+}
+
+void TerseUpdateBatch::Add(Scene::Entity *entity, EC_NetworkPosition *netpos, unsigned char flag, const Vector3df &position,
+    const Vector3df &velocity, const Vector3df &accel, const Quaternion &orientation, const Vector3df &rotvel)
+{
+    entities.push_back(entity);
+    netpositions.push_back(netpos);
+    flags.push_back(flag);
+    positions.push_back(position);
+    velocities.push_back(velocity);
+    accels.push_back(accel);
+    orientations.push_back(orientation);
+    rotvels.push_back(rotvel);
+}
+
+bool DecodeTerseUpdateBlock(LocalIdEntityIndex &index, TerseUpdateBatch &batch, const uint8_t *bytes, size_t size)
+{
+    // See Primitive::HandleTerseObjectUpdateForPrim_44bytes and AvatarHandler::HandleTerseObjectUpdate_30bytes for the block layouts.
+    //! \todo handle endians
+    if (size != 30 && size != 44 && size != 60)
+        return false;
+
+    uint32_t localid = *reinterpret_cast<const uint32_t*>(&bytes[0]);
+    const LocalIdEntityIndex::Entry *entry = index.Find(localid);
+    if (!entry)
+        return true;
+
+    // 30-byte blocks are for avatars, 44-byte blocks only for prims. 60-byte blocks come in different layouts for each.
+    if ((size == 30 && entry->kind != LocalIdEntityIndex::KindAvatar) || (size == 44 && entry->kind != LocalIdEntityIndex::KindPrim))
+        return true;
+
+    Scene::EntityPtr entity = entry->entity.lock();
+    boost::shared_ptr<EC_NetworkPosition> netpos = entry->netpos.lock();
+    if (!entity || !netpos)
+        return true;
+
+    unsigned char flags = 0;
+    int i = 0;
+    if (entry->kind == LocalIdEntityIndex::KindPrim)
+        i = 6;
+    else
+    {
+        flags |= TerseUpdateBatch::IsAvatar;
+        i = (size == 30) ? 4 : 22;
+    }
+
+    Vector3df position = GetProcessedVector(&bytes[i]);
+    i += sizeof(Vector3df);
+    if (IsValidPositionVector(position))
+        flags |= TerseUpdateBatch::HasPosition;
+    else if (entry->kind == LocalIdEntityIndex::KindAvatar)
+        return true; // Avatar updates with a bad position are discarded as a whole.
+
+    Vector3df velocity = GetProcessedScaledVectorFromUint16(&bytes[i], 128);
+    i += 6;
+
+    Vector3df accel;
+    Vector3df rotvel;
+    if (size != 30)
+    {
+        flags |= TerseUpdateBatch::HasAccelAndRotVel;
+        accel = GetProcessedVectorFromUint16(&bytes[i]);
+        i += 6;
+    }
+
+    Quaternion orientation = GetProcessedQuaternion(&bytes[i]);
+    i += 8;
+
+    if (size != 30)
+        rotvel = GetProcessedScaledVectorFromUint16(&bytes[i], 128);
+
+    batch.Add(entity.get(), netpos.get(), flags, position, velocity, accel, orientation, rotvel);
+    return true;
+}
+
+void ApplyTerseUpdateBatch(const TerseUpdateBatch &batch)
+{
+    const size_t count = batch.Size();
+    for(size_t i = 0; i < count; ++i)
+    {
+        EC_NetworkPosition *netpos = batch.netpositions[i];
+        const unsigned char flags = batch.flags[i];
+
+        if (flags & TerseUpdateBatch::HasPosition)
+            netpos->position_ = batch.positions[i];
+        netpos->velocity_ = batch.velocities[i];
+        if (flags & TerseUpdateBatch::HasAccelAndRotVel)
+        {
+            netpos->accel_ = batch.accels[i];
+            netpos->rotvel_ = batch.rotvels[i];
+        }
+        else
+        {
+            //! \todo what to do with acceleration & rotation velocity? zero them currently
+            netpos->accel_ = Vector3df::ZERO;
+            netpos->rotvel_ = Vector3df::ZERO;
+        }
+
+        // Do not update rotation for avatars controlled by this client, client handles the rotation for itself
+        // (jitters during turning may result otherwise).
+        if (!(flags & TerseUpdateBatch::IsAvatar) || !batch.entities[i]->GetComponent("EC_Controllable"))
+            netpos->orientation_ = batch.orientations[i];
+
+        netpos->Updated();
+    }
+}
+
+}
@@ -0,0 +1,124 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   TerseUpdateBatch.h
+ *  @brief  Batched application of ImprovedTerseObjectUpdate blocks, with a flat localid to entity index.
+ */
+
+#ifndef incl_RexLogicModule_TerseUpdateBatch_h
+#define incl_RexLogicModule_TerseUpdateBatch_h
+
+#include "ForwardDefines.h"
+#include "Vector3D.h"
+#include "Quaternion.h"
+
+#include <vector>
+
+class EC_NetworkPosition;
+
+namespace RexLogic
+{
+    class RexLogicModule;
+
+    /// Maps object localids to their entities and EC_NetworkPosition components with an open-addressing hash table.
+    /** Entries are resolved lazily through RexLogicModule the first time an id is seen, and re-resolved once the
+        cached entity has been destroyed. Only prims and avatars are cached. Expired entries are dropped when the
+        table grows, so the table does not need to be told about removed entities. */
+    class LocalIdEntityIndex
+    {
+    public:
+        /// What kind of object an entry refers to.
+        enum ObjectKind
+        {
+            KindNone = 0,
+            KindPrim,
+            KindAvatar
+        };
+
+        /// A cached lookup result.
+        struct Entry
+        {
+            Entry() : localid(0), kind(KindNone) {}
+
+            uint32_t localid;
+            ObjectKind kind;
+            Scene::EntityWeakPtr entity;
+            boost::weak_ptr<EC_NetworkPosition> netpos;
+        };
+
+        explicit LocalIdEntityIndex(RexLogicModule *owner);
+
+        /// Returns the cached entry for the given localid, resolving it if needed.
+        /// @return The entry, or 0 if there is no prim or avatar with this id. Valid until the next call to Find.
+        const Entry *Find(uint32_t localid);
+
+        /// Forgets the given localid.
+        void Remove(uint32_t localid);
+
+        /// Forgets all entries, e.g. when the world scene changes.
+        void Clear();
+
+    private:
+        /// Resolves the entity for the given localid through the owner module.
+        bool Resolve(uint32_t localid, Entry &entry) const;
+
+        /// @return Index of the slot holding the given localid, or of the first free slot in its probe sequence.
+        size_t Probe(uint32_t localid) const;
+
+        /// Doubles the table size if needed and reinserts the live entries.
+        void Rehash(size_t minCapacity);
+
+        /// Slot states.
+        enum SlotState { SlotFree = 0, SlotUsed, SlotDeleted };
+
+        std::vector<Entry> slots_;
+        std::vector<unsigned char> states_;
+        size_t used_;
+        size_t deleted_;
+
+        RexLogicModule *owner_;
+    };
+
+    /// The ImprovedTerseObjectUpdate blocks of one packet, decoded into parallel arrays.
+    struct TerseUpdateBatch
+    {
+        /// Bits of flags.
+        enum
+        {
+            /// The position is valid and should be applied.
+            HasPosition = 1,
+            /// Acceleration and rotational velocity are present. If not set, they are zeroed.
+            HasAccelAndRotVel = 2,
+            /// The orientation should not be applied if the entity is controlled by this client.
+            IsAvatar = 4
+        };
+
+        void Clear();
+        size_t Size() const { return entities.size(); }
+
+        /// Appends an update. The entity and component must stay alive until the batch has been applied.
+        void Add(Scene::Entity *entity, EC_NetworkPosition *netpos, unsigned char flags, const Vector3df &position,
+            const Vector3df &velocity, const Vector3df &accel, const Quaternion &orientation, const Vector3df &rotvel);
+
+        std::vector<Scene::Entity *> entities;
+        std::vector<EC_NetworkPosition *> netpositions;
+        std::vector<unsigned char> flags;
+        std::vector<Vector3df> positions;
+        std::vector<Vector3df> velocities;
+        std::vector<Vector3df> accels;
+        std::vector<Quaternion> orientations;
+        std::vector<Vector3df> rotvels;
+    };
+
+    /// Decodes the given terse update block into the batch.
+    /** @param index Index used to resolve the localid of the block.
+        @param bytes The block data.
+        @param size The block size in bytes: 30, 44 or 60.
+        @return False if the block size is not supported. */
+    bool DecodeTerseUpdateBlock(LocalIdEntityIndex &index, TerseUpdateBatch &batch, const uint8_t *bytes, size_t size);
+
+    /// Applies all the updates of the batch to the EC_NetworkPosition components in one pass.
+    void ApplyTerseUpdateBatch(const TerseUpdateBatch &batch);
+}
+
+#endif
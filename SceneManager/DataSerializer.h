@@ -0,0 +1,205 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   DataSerializer.h
+ *  @brief  Compact little-endian binary writer and reader used for attribute, component and scene serialization.
+ */
+
+#ifndef incl_SceneManager_DataSerializer_h
+#define incl_SceneManager_DataSerializer_h
+
+#include "CoreTypes.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstring>
+
+//! Appends binary data to a byte array.
+/*! Integers and floats are written in little-endian byte order regardless of the host. Strings are written as UTF-8
+    prefixed with their byte length.
+    \ingroup Scene_group
+*/
+class DataSerializer
+{
+public:
+    //! Constructor.
+    /*! \param dest Byte array to append the data to.
+     */
+    explicit DataSerializer(QByteArray &dest) : dest_(dest) {}
+
+    void AddU8(u8 value) { dest_.append((char)value); }
+
+    void AddU16(u16 value)
+    {
+        AddU8((u8)value);
+        AddU8((u8)(value >> 8));
+    }
+
+    void AddU32(u32 value)
+    {
+        AddU16((u16)value);
+        AddU16((u16)(value >> 16));
+    }
+
+    void AddS32(s32 value) { AddU32((u32)value); }
+
+    void AddBool(bool value) { AddU8(value ? 1 : 0); }
+
+    void AddFloat(float value)
+    {
+        u32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        AddU32(bits);
+    }
+
+    //! Writes an unsigned integer with 7 bits per byte, so that small values take one byte.
+    void AddVLE(u32 value)
+    {
+        while(value >= 0x80)
+        {
+            AddU8((u8)(value | 0x80));
+            value >>= 7;
+        }
+        AddU8((u8)value);
+    }
+
+    //! Writes a byte length and the bytes.
+    void AddBytes(const char *data, u32 size)
+    {
+        AddVLE(size);
+        dest_.append(data, (int)size);
+    }
+
+    void AddBytes(const QByteArray &data) { AddBytes(data.constData(), (u32)data.size()); }
+
+    void AddString(const QString &value) { AddBytes(value.toUtf8()); }
+
+    //! Returns the number of bytes in the destination array.
+    int BytesFilled() const { return dest_.size(); }
+
+private:
+    QByteArray &dest_;
+};
+
+//! Reads binary data written by DataSerializer from a memory block.
+/*! Reading past the end of the data does not throw: it returns zero values and marks the deserializer invalid. Check
+    IsValid() after reading a logical block and discard the results if it returns false.
+    \ingroup Scene_group
+*/
+class DataDeserializer
+{
+public:
+    //! Constructor.
+    /*! \param data Data to read. Must stay alive as long as the deserializer is used.
+        \param size Size of the data in bytes.
+     */
+    DataDeserializer(const char *data, size_t size) : data_(data), size_(size), pos_(0), valid_(true) {}
+
+    u8 ReadU8()
+    {
+        if (!Require(1))
+            return 0;
+        return (u8)data_[pos_++];
+    }
+
+    u16 ReadU16()
+    {
+        u16 low = ReadU8();
+        return low | (u16)(ReadU8() << 8);
+    }
+
+    u32 ReadU32()
+    {
+        u32 low = ReadU16();
+        return low | ((u32)ReadU16() << 16);
+    }
+
+    s32 ReadS32() { return (s32)ReadU32(); }
+
+    bool ReadBool() { return ReadU8() != 0; }
+
+    float ReadFloat()
+    {
+        u32 bits = ReadU32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    u32 ReadVLE()
+    {
+        u32 value = 0;
+        for(int shift = 0; shift < 35; shift += 7)
+        {
+            u8 byte = ReadU8();
+            value |= (u32)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        valid_ = false;
+        return 0;
+    }
+
+    //! Reads a byte length written by DataSerializer::AddBytes, and returns a pointer to the bytes.
+    /*! \param size [out] Number of bytes.
+        \return Pointer into the data, or null if the data is truncated.
+     */
+    const char *ReadBytes(u32 &size)
+    {
+        size = ReadVLE();
+        if (!Require(size))
+        {
+            size = 0;
+            return 0;
+        }
+        const char *bytes = data_ + pos_;
+        pos_ += size;
+        return bytes;
+    }
+
+    QString ReadString()
+    {
+        u32 size;
+        const char *bytes = ReadBytes(size);
+        return bytes ? QString::fromUtf8(bytes, (int)size) : QString();
+    }
+
+    //! Skips the given number of bytes.
+    void Skip(size_t size)
+    {
+        if (Require(size))
+            pos_ += size;
+    }
+
+    //! Returns false if a read has run past the end of the data.
+    bool IsValid() const { return valid_; }
+
+    //! Returns true if all data has been read.
+    bool AtEnd() const { return pos_ >= size_; }
+
+    //! Returns the number of bytes left.
+    size_t BytesLeft() const { return size_ - pos_; }
+
+    //! Returns pointer to the current read position.
+    const char *CurrentData() const { return data_ + pos_; }
+
+private:
+    bool Require(size_t size)
+    {
+        if (!valid_ || size > size_ - pos_)
+        {
+            valid_ = false;
+            pos_ = size_;
+            return false;
+        }
+        return true;
+    }
+
+    const char *data_;
+    size_t size_;
+    size_t pos_;
+    bool valid_;
+};
+
+#endif
@@ -41,6 +41,8 @@ namespace Scene
             components_[i]->SetParentEntity(0);
         
         components_.clear();
+        component_type_ids_.clear();
+        component_table_.clear();
         qDeleteAll(actions_);
     }
 
@@ -60,6 +62,8 @@ namespace Scene
 
             component->SetParentEntity(this);
             components_.push_back(component);
+            component_type_ids_.push_back(ComponentManager::GetComponentTypeId(component->TypeName()));
+            RebuildComponentTable();
             
             if (change != AttributeChange::Disconnected)
                 emit ComponentAdded(component.get(), change);
@@ -96,7 +100,9 @@ namespace Scene
                     scene_->EmitComponentRemoved(this, (*iter).get(), change);
 
                 (*iter)->SetParentEntity(0);
+                component_type_ids_.erase(component_type_ids_.begin() + (iter - components_.begin()));
                 components_.erase(iter);
+                RebuildComponentTable();
             }
             else
             {
@@ -113,9 +119,9 @@ namespace Scene
 
     ComponentPtr Entity::GetOrCreateComponent(const QString &type_name, AttributeChange::Type change, bool syncEnabled)
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name)
-                return components_[i];
+        ComponentPtr existing = GetComponent(type_name);
+        if (existing)
+            return existing;
 
         // If component was not found, try to create
         ComponentPtr new_comp = framework_->GetComponentManager()->CreateComponent(type_name);
@@ -133,9 +139,9 @@ namespace Scene
 
     ComponentPtr Entity::GetOrCreateComponent(const QString &type_name, const QString &name, AttributeChange::Type change, bool syncEnabled)
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name && components_[i]->Name() == name)
-                return components_[i];
+        ComponentPtr existing = GetComponent(type_name, name);
+        if (existing)
+            return existing;
 
         // If component was not found, try to create
         ComponentPtr new_comp = framework_->GetComponentManager()->CreateComponent(type_name, name);
@@ -153,37 +159,83 @@ namespace Scene
     
     ComponentPtr Entity::GetComponent(const QString &type_name) const
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name)
-                return components_[i];
-
-        return ComponentPtr();
+        return GetComponentByTypeId(FindComponentTypeId(type_name));
     }
 
     ComponentPtr Entity::GetComponent(const IComponent *component) const
     {
-        for (size_t i = 0; i < components_.size(); i++)
-            if(component->TypeName() == components_[i]->TypeName() &&
-               component->Name() == components_[i]->Name())
-               return components_[i];
-        return ComponentPtr();
+        return GetComponent(component->TypeName(), component->Name());
     }
 
     ComponentPtr Entity::GetComponent(const QString &type_name, const QString& name) const
     {
+        const component_type_id_t type_id = FindComponentTypeId(type_name);
         for (size_t i=0 ; i<components_.size() ; ++i)
-            if ((components_[i]->TypeName() == type_name) && (components_[i]->Name() == name))
+            if ((component_type_ids_[i] == type_id) && (components_[i]->Name() == name))
                 return components_[i];
 
         return ComponentPtr();
     }
 
+    ComponentPtr Entity::GetComponentByTypeId(component_type_id_t type_id) const
+    {
+        if (type_id == 0 || component_table_.empty())
+            return ComponentPtr();
+
+        const size_t mask = component_table_.size() - 1;
+        for(size_t i = type_id & mask; ; i = (i + 1) & mask)
+        {
+            const ComponentTableEntry &entry = component_table_[i];
+            if (entry.type_id == type_id)
+                return components_[entry.index];
+            if (entry.type_id == 0)
+                return ComponentPtr();
+        }
+    }
+
+    component_type_id_t Entity::ResolveComponentTypeId(const QString &type_name, QBasicAtomicInt &cache)
+    {
+        component_type_id_t type_id = (component_type_id_t)(int)cache;
+        if (type_id == 0)
+        {
+            type_id = ComponentManager::FindComponentTypeId(type_name);
+            if (type_id != 0)
+                cache.fetchAndStoreRelease((int)type_id);
+        }
+        return type_id;
+    }
+
+    component_type_id_t Entity::FindComponentTypeId(const QString &type_name)
+    {
+        return ComponentManager::FindComponentTypeId(type_name);
+    }
+
+    void Entity::RebuildComponentTable()
+    {
+        size_t size = 8;
+        while(size < components_.size() * 2)
+            size <<= 1;
+        component_table_.assign(size, ComponentTableEntry());
+
+        const size_t mask = size - 1;
+        for(uint c = 0; c < components_.size(); ++c)
+        {
+            const component_type_id_t type_id = component_type_ids_[c];
+            size_t i = type_id & mask;
+            while(component_table_[i].type_id != 0 && component_table_[i].type_id != type_id)
+                i = (i + 1) & mask;
+            // Keep the first component of each type
+            if (component_table_[i].type_id == 0)
+            {
+                component_table_[i].type_id = type_id;
+                component_table_[i].index = c;
+            }
+        }
+    }
+
     bool Entity::HasComponent(const QString &type_name) const
     {
-        for(size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name)
-                return true;
-        return false;
+        return GetComponentByTypeId(FindComponentTypeId(type_name)).get() != 0;
     }
 
     EntityPtr Entity::GetSharedPtr() const
@@ -196,10 +248,7 @@ namespace Scene
 
     bool Entity::HasComponent(const QString &type_name, const QString& name) const
     {
-        for(size_t i=0 ; i<components_.size() ; ++i)
-            if ((components_[i]->TypeName() == type_name) && (components_[i]->Name() == name))
-                return true;
-        return false;
+        return GetComponent(type_name, name).get() != 0;
     }
 
     IAttribute *Entity::GetAttributeInterface(const std::string &name) const
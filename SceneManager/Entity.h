@@ -11,6 +11,7 @@
 
 #include <QObject>
 #include <QMap>
+#include <QAtomicInt>
 
 namespace Scene
 {
@@ -84,6 +85,14 @@ namespace Scene
         */
         ComponentPtr GetComponent(const QString &type_name, const QString &name) const;
 
+        //! Returns a component with the given type id or empty pointer if component was not found
+        /*! This is the fastest way to look up a component: it does not compare strings. Type ids are assigned
+            by ComponentManager::GetComponentTypeId.
+            If there are several components with the specified type, returns the first one that was added.
+            \param type_id type id of the component
+        */
+        ComponentPtr GetComponentByTypeId(component_type_id_t type_id) const;
+
         //! Returns a component with type 'type_name' or creates & adds it if not found. If could not create, returns empty pointer
         /*! 
             \param type_name type of the component
@@ -151,8 +160,9 @@ namespace Scene
         ComponentVector GetComponents(const QString &type_name) const
         {
             ComponentVector ret;
+            const component_type_id_t type_id = FindComponentTypeId(type_name);
             for(size_t i = 0; i < components_.size() ; ++i)
-                if (components_[i]->TypeName() == type_name)
+                if (component_type_ids_[i] == type_id)
                     ret.push_back(components_[i]);
             return ret;
         }
@@ -163,10 +173,13 @@ namespace Scene
         template <class T>
         boost::shared_ptr<T> GetComponent() const
         {
-            return boost::dynamic_pointer_cast<T>(GetComponent(T::TypeNameStatic()));
+            static QBasicAtomicInt type_id_cache = Q_BASIC_ATOMIC_INITIALIZER(0);
+            // The type id identifies the class, so no RTTI cast is needed
+            return boost::static_pointer_cast<T>(GetComponentByTypeId(ResolveComponentTypeId(T::TypeNameStatic(), type_id_cache)));
         }
 
         /*! Returns list of components with certain class type, already cast to correct type.
+            Unlike the lookups by type name, this also returns the components of classes derived from T.
             \param T Component class type.
             \return List of components with certain class type, or empty list if no components was found.
         */
@@ -190,7 +203,12 @@ namespace Scene
         template <class T>
         boost::shared_ptr<T> GetComponent(const QString& name) const
         {
-            return boost::dynamic_pointer_cast<T>(GetComponent(T::TypeNameStatic(), name));
+            static QBasicAtomicInt type_id_cache = Q_BASIC_ATOMIC_INITIALIZER(0);
+            const component_type_id_t type_id = ResolveComponentTypeId(T::TypeNameStatic(), type_id_cache);
+            for(size_t i = 0; i < components_.size() ; ++i)
+                if (component_type_ids_[i] == type_id && components_[i]->Name() == name)
+                    return boost::static_pointer_cast<T>(components_[i]);
+            return boost::shared_ptr<T>();
         }
 
         //! Return entity's shared pointer.
@@ -291,8 +309,9 @@ namespace Scene
             }
             else
             {
+                const component_type_id_t type_id = FindComponentTypeId(type_name);
                 for(size_t i = 0; i < components_.size() ; ++i)
-                    if (components_[i]->TypeName() == type_name)
+                    if (component_type_ids_[i] == type_id)
                         ret.push_back(components_[i].get());
             }
             return ret;
@@ -395,6 +414,29 @@ namespace Scene
         bool IsTemporary() const { return temporary_; }
         
     private:
+        //! Entry of the type id -> component lookup table.
+        struct ComponentTableEntry
+        {
+            ComponentTableEntry() : type_id(0), index(0) {}
+            //! Type id, 0 for an empty entry
+            component_type_id_t type_id;
+            //! Index of the first component of the type in components_
+            uint index;
+        };
+
+        //! Returns the type id of the type name from the per class cache, looking it up if it has not been cached yet.
+        /*! Only looks up the id and never assigns one, so this can be called from any thread. Type ids don't change
+            once assigned, so whichever thread stores the id into the cache first, they all store the same value.
+            \return type id, or 0 if the type name has not been assigned one yet
+        */
+        static component_type_id_t ResolveComponentTypeId(const QString &type_name, QBasicAtomicInt &cache);
+
+        //! Returns the type id of the type name, or 0 if the type name is not known to the component manager.
+        static component_type_id_t FindComponentTypeId(const QString &type_name);
+
+        //! Rebuilds the type id -> component lookup table after components have been added or removed.
+        void RebuildComponentTable();
+
         /// Validates that the action has receivers. If not, deletes the action and removes it from the registered actions.
         /** @param action Action to be validated.
         */
@@ -403,6 +445,13 @@ namespace Scene
         //! a list of all components
         ComponentVector components_;
 
+        //! Type ids of the components, parallel to components_
+        std::vector<component_type_id_t> component_type_ids_;
+
+        //! Open-addressed table from type id to the first component of the type. Size is a power of two, and at
+        //! least twice the number of components, so lookups normally hit the first entry.
+        std::vector<ComponentTableEntry> component_table_;
+
         //! Unique id for this entity
         entity_id_t id_;
 
@@ -0,0 +1,205 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_SceneManager_EntitySlotMap_h
+#define incl_SceneManager_EntitySlotMap_h
+
+#include "ForwardDefines.h"
+#include "CoreTypes.h"
+
+#include <vector>
+#include <utility>
+#include <boost/unordered_map.hpp>
+
+namespace Scene
+{
+    //! Generational handle to an entity stored in an EntitySlotMap.
+    /*! Resolving a handle is a plain array access. Once the entity is removed the handle goes stale and resolves to null,
+        even if its slot has since been reused by another entity.
+
+        \ingroup Scene_group
+    */
+    struct EntityHandle
+    {
+        EntityHandle() : slot(0), generation(0) {}
+        EntityHandle(uint slot_, uint generation_) : slot(slot_), generation(generation_) {}
+
+        //! Returns true if the handle was never assigned to an entity.
+        bool IsNull() const { return generation == 0; }
+
+        bool operator == (const EntityHandle &rhs) const { return slot == rhs.slot && generation == rhs.generation; }
+        bool operator != (const EntityHandle &rhs) const { return !(*this == rhs); }
+
+        //! Index of the slot in the slot map.
+        uint slot;
+
+        //! Generation of the slot at the time the handle was created. Zero for a null handle.
+        uint generation;
+    };
+
+    //! Entity storage of SceneManager.
+    /*! Entities are kept in a dense array for cache-friendly iteration, and addressed through a table of generational
+        slots that stay fixed while the entity lives. Insertion and removal are O(1): removal moves the last element of
+        the dense array into the hole. Because of that, removing entities invalidates iterators; collect the entities
+        to remove first if you need to remove while iterating.
+
+        The element type is a (id, entity) pair, so iterating works the same way as iterating a std::map of entities did.
+
+        \ingroup Scene_group
+    */
+    class EntitySlotMap
+    {
+    public:
+        typedef std::pair<entity_id_t, EntityPtr> value_type;
+        typedef std::vector<value_type>::iterator iterator;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+
+        EntitySlotMap() {}
+
+        iterator begin() { return dense_.begin(); }
+        iterator end() { return dense_.end(); }
+        const_iterator begin() const { return dense_.begin(); }
+        const_iterator end() const { return dense_.end(); }
+
+        size_t size() const { return dense_.size(); }
+        bool empty() const { return dense_.empty(); }
+
+        //! Returns iterator to the entity with the given id, or end() if there is none.
+        iterator find(entity_id_t id)
+        {
+            IdMap::const_iterator it = slots_by_id_.find(id);
+            return it != slots_by_id_.end() ? dense_.begin() + slots_[it->second].dense_index : dense_.end();
+        }
+
+        const_iterator find(entity_id_t id) const
+        {
+            IdMap::const_iterator it = slots_by_id_.find(id);
+            return it != slots_by_id_.end() ? dense_.begin() + slots_[it->second].dense_index : dense_.end();
+        }
+
+        //! Adds an entity. The id of the entity must not be in use.
+        /*! \return Handle to the new entity
+        */
+        EntityHandle Insert(entity_id_t id, const EntityPtr &entity)
+        {
+            uint slot;
+            if (!free_slots_.empty())
+            {
+                slot = free_slots_.back();
+                free_slots_.pop_back();
+            }
+            else
+            {
+                slot = (uint)slots_.size();
+                slots_.push_back(Slot());
+            }
+
+            slots_[slot].dense_index = (uint)dense_.size();
+            dense_.push_back(value_type(id, entity));
+            dense_slots_.push_back(slot);
+            slots_by_id_[id] = slot;
+            return EntityHandle(slot, slots_[slot].generation);
+        }
+
+        //! Removes the entity with the given id.
+        /*! \return True if the entity existed
+        */
+        bool Erase(entity_id_t id)
+        {
+            IdMap::iterator it = slots_by_id_.find(id);
+            if (it == slots_by_id_.end())
+                return false;
+
+            const uint slot = it->second;
+            const uint index = slots_[slot].dense_index;
+            const uint last = (uint)dense_.size() - 1;
+            if (index != last)
+            {
+                dense_[index] = dense_[last];
+                dense_slots_[index] = dense_slots_[last];
+                slots_[dense_slots_[index]].dense_index = index;
+            }
+            dense_.pop_back();
+            dense_slots_.pop_back();
+
+            // Bump the generation so that outstanding handles to this slot go stale. Zero is reserved for null handles.
+            if (++slots_[slot].generation == 0)
+                slots_[slot].generation = 1;
+            free_slots_.push_back(slot);
+            slots_by_id_.erase(it);
+            return true;
+        }
+
+        //! Removes all entities. Outstanding handles go stale.
+        void clear()
+        {
+            for(size_t i = 0; i < dense_slots_.size(); ++i)
+            {
+                Slot &s = slots_[dense_slots_[i]];
+                if (++s.generation == 0)
+                    s.generation = 1;
+                free_slots_.push_back(dense_slots_[i]);
+            }
+            dense_.clear();
+            dense_slots_.clear();
+            slots_by_id_.clear();
+        }
+
+        //! Returns handle to the entity with the given id, or a null handle if there is none.
+        EntityHandle GetHandle(entity_id_t id) const
+        {
+            IdMap::const_iterator it = slots_by_id_.find(id);
+            return it != slots_by_id_.end() ? EntityHandle(it->second, slots_[it->second].generation) : EntityHandle();
+        }
+
+        //! Returns the entity the handle refers to, or null if the handle is stale.
+        EntityPtr Resolve(const EntityHandle &handle) const
+        {
+            if (!IsLiveSlot(handle.slot) || slots_[handle.slot].generation != handle.generation)
+                return EntityPtr();
+            return dense_[slots_[handle.slot].dense_index].second;
+        }
+
+        //! Returns the entity stored in the slot, which must be in use.
+        const EntityPtr &GetInSlot(uint slot) const { return dense_[slots_[slot].dense_index].second; }
+
+        //! Returns true if the slot holds a live entity.
+        bool IsLiveSlot(uint slot) const
+        {
+            if (slot >= slots_.size())
+                return false;
+            const uint index = slots_[slot].dense_index;
+            return index < dense_slots_.size() && dense_slots_[index] == slot;
+        }
+
+    private:
+        struct Slot
+        {
+            Slot() : dense_index(0), generation(1) {}
+
+            //! Index of the entity in the dense array, if the slot is in use.
+            uint dense_index;
+
+            //! Incremented every time the slot is freed.
+            uint generation;
+        };
+
+        typedef boost::unordered_map<entity_id_t, uint> IdMap;
+
+        //! (id, entity) pairs, packed.
+        std::vector<value_type> dense_;
+
+        //! Slot index of each element of dense_.
+        std::vector<uint> dense_slots_;
+
+        //! Slots, indexed by EntityHandle::slot.
+        std::vector<Slot> slots_;
+
+        //! Slots currently not in use.
+        std::vector<uint> free_slots_;
+
+        //! Maps entity ids to slots.
+        IdMap slots_by_id_;
+    };
+}
+
+#endif
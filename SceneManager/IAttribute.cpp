@@ -14,6 +14,7 @@
 #include "CoreStdIncludes.h"
 #include "Transform.h"
 #include "AssetReference.h"
+#include "DataSerializer.h"
 
 #include <QVector3D>
 #include <QVariant>
@@ -602,4 +603,216 @@ template<> void Attribute<Transform>::FromScriptValue(const QScriptValue &value,
 template<> void Attribute<QVector3D>::FromScriptValue(const QScriptValue &value, AttributeChange::Type change)
 {
     Set(qScriptValueToValue<QVector3D>(value), change);
-}
\ No newline at end of file
+}
+
+    // TOBINARY TEMPLATE IMPLEMENTATIONS.
+
+template<> void Attribute<QString>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddString(Get());
+}
+
+template<> void Attribute<bool>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddBool(Get());
+}
+
+template<> void Attribute<int>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddS32(Get());
+}
+
+template<> void Attribute<uint>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddU32(Get());
+}
+
+template<> void Attribute<float>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddFloat(Get());
+}
+
+template<> void Attribute<Vector3df>::ToBinary(DataSerializer& dest) const
+{
+    const Vector3df &value = Get();
+    dest.AddFloat(value.x);
+    dest.AddFloat(value.y);
+    dest.AddFloat(value.z);
+}
+
+template<> void Attribute<Quaternion>::ToBinary(DataSerializer& dest) const
+{
+    const Quaternion &value = Get();
+    dest.AddFloat(value.w);
+    dest.AddFloat(value.x);
+    dest.AddFloat(value.y);
+    dest.AddFloat(value.z);
+}
+
+template<> void Attribute<Color>::ToBinary(DataSerializer& dest) const
+{
+    const Color &value = Get();
+    dest.AddFloat(value.r);
+    dest.AddFloat(value.g);
+    dest.AddFloat(value.b);
+    dest.AddFloat(value.a);
+}
+
+template<> void Attribute<AssetReference>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddString(Get().type);
+    dest.AddString(Get().id);
+}
+
+template<> void Attribute<QVariant>::ToBinary(DataSerializer& dest) const
+{
+    // Same semantics as the XML form: the value travels as a string
+    dest.AddString(Get().toString());
+}
+
+template<> void Attribute<QVariantList >::ToBinary(DataSerializer& dest) const
+{
+    const QVariantList &values = Get();
+    dest.AddVLE(values.size());
+    for(int i = 0; i < values.size(); ++i)
+        dest.AddString(values[i].toString());
+}
+
+template<> void Attribute<Transform>::ToBinary(DataSerializer& dest) const
+{
+    const Transform &transform = Get();
+    const Vector3df *values[3] = { &transform.position, &transform.rotation, &transform.scale };
+    for(uint i = 0; i < 3; ++i)
+    {
+        dest.AddFloat(values[i]->x);
+        dest.AddFloat(values[i]->y);
+        dest.AddFloat(values[i]->z);
+    }
+}
+
+template<> void Attribute<QVector3D>::ToBinary(DataSerializer& dest) const
+{
+    const QVector3D &value = Get();
+    dest.AddFloat((float)value.x());
+    dest.AddFloat((float)value.y());
+    dest.AddFloat((float)value.z());
+}
+
+    // FROMBINARY TEMPLATE IMPLEMENTATIONS.
+
+template<> void Attribute<QString>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    QString value = source.ReadString();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<bool>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    bool value = source.ReadBool();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<int>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    int value = source.ReadS32();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<uint>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    uint value = source.ReadU32();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<float>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    float value = source.ReadFloat();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<Vector3df>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    Vector3df value;
+    value.x = source.ReadFloat();
+    value.y = source.ReadFloat();
+    value.z = source.ReadFloat();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<Quaternion>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    Quaternion value;
+    value.w = source.ReadFloat();
+    value.x = source.ReadFloat();
+    value.y = source.ReadFloat();
+    value.z = source.ReadFloat();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<Color>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    Color value;
+    value.r = source.ReadFloat();
+    value.g = source.ReadFloat();
+    value.b = source.ReadFloat();
+    value.a = source.ReadFloat();
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<AssetReference>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    QString type = source.ReadString();
+    QString id = source.ReadString();
+    if (source.IsValid())
+        Set(AssetReference(id, type), change);
+}
+
+template<> void Attribute<QVariant>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    QString value = source.ReadString();
+    if (source.IsValid())
+        Set(QVariant(value), change);
+}
+
+template<> void Attribute<QVariantList >::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    QVariantList value;
+    u32 count = source.ReadVLE();
+    for(u32 i = 0; i < count && source.IsValid(); ++i)
+        value.push_back(QVariant(source.ReadString()));
+    if (source.IsValid())
+        Set(value, change);
+}
+
+template<> void Attribute<Transform>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    float values[9];
+    for(uint i = 0; i < 9; ++i)
+        values[i] = source.ReadFloat();
+    if (!source.IsValid())
+        return;
+
+    Transform result;
+    result.SetPos(values[0], values[1], values[2]);
+    result.SetRot(values[3], values[4], values[5]);
+    result.SetScale(values[6], values[7], values[8]);
+    Set(result, change);
+}
+
+template<> void Attribute<QVector3D>::FromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    QVector3D value;
+    value.setX(source.ReadFloat());
+    value.setY(source.ReadFloat());
+    value.setZ(source.ReadFloat());
+    if (source.IsValid())
+        Set(value, change);
+}
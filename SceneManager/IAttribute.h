@@ -18,6 +18,8 @@
 
 class IComponent;
 class QScriptValue;
+class DataSerializer;
+class DataDeserializer;
 
 //! Attribute metadata contains information about the attribute.
 /*! The metadata includes information such as description (e.g. "color" or "direction",
@@ -110,6 +112,14 @@ public:
     //! Convert attribute from string for XML deserialization
     virtual void FromString(const std::string& str, AttributeChange::Type change) = 0;
 
+    //! Writes the attribute value in binary form for binary serialization
+    virtual void ToBinary(DataSerializer& dest) const = 0;
+
+    //! Reads the attribute value written by ToBinary
+    /*! If the source runs out of data, the value is left unchanged and the source is marked invalid.
+     */
+    virtual void FromBinary(DataDeserializer& source, AttributeChange::Type change) = 0;
+
     //! Returns the type name of the data stored in this attribute.
     virtual std::string TypeName() const = 0;
 
@@ -200,6 +210,12 @@ public:
     //! IAttribute override.
     virtual void FromString(const std::string& str, AttributeChange::Type change);
 
+    //! IAttribute override.
+    virtual void ToBinary(DataSerializer& dest) const;
+
+    //! IAttribute override.
+    virtual void FromBinary(DataDeserializer& source, AttributeChange::Type change);
+
     //! Returns the type of the data stored in this attribute.
     virtual std::string TypeName() const;
 
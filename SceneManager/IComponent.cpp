@@ -13,6 +13,7 @@
 #include "Entity.h"
 #include "SceneManager.h"
 #include "EventManager.h"
+#include "DataSerializer.h"
 
 #include <QDomDocument>
 
@@ -233,6 +234,64 @@ void IComponent::DeserializeFrom(QDomElement& element, AttributeChange::Type cha
     }
 }
 
+void IComponent::SerializeToBinary(DataSerializer& dest) const
+{
+    dest.AddString(TypeName());
+    dest.AddString(name_);
+    dest.AddBool(network_sync_);
+
+    QByteArray attribute_data;
+    if (IsSerializable())
+    {
+        DataSerializer attribute_dest(attribute_data);
+        SerializeAttributesToBinary(attribute_dest);
+    }
+    dest.AddBytes(attribute_data);
+}
+
+void IComponent::ReadBinaryHeader(DataDeserializer& source, QString& type_name, QString& name)
+{
+    type_name = source.ReadString();
+    name = source.ReadString();
+}
+
+void IComponent::DeserializeFromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    bool sync = source.ReadBool();
+    u32 size;
+    const char *attribute_data = source.ReadBytes(size);
+    if (!source.IsValid())
+        return;
+
+    SetNetworkSyncEnabled(sync);
+    if (!IsSerializable() || !size)
+        return;
+
+    DataDeserializer attribute_source(attribute_data, size);
+    DeserializeAttributesFromBinary(attribute_source, change);
+}
+
+void IComponent::SkipBinary(DataDeserializer& source)
+{
+    source.ReadBool();
+    u32 size;
+    source.ReadBytes(size);
+}
+
+void IComponent::SerializeAttributesToBinary(DataSerializer& dest) const
+{
+    dest.AddVLE(attributes_.size());
+    for (uint i = 0; i < attributes_.size(); ++i)
+        attributes_[i]->ToBinary(dest);
+}
+
+void IComponent::DeserializeAttributesFromBinary(DataDeserializer& source, AttributeChange::Type change)
+{
+    u32 count = source.ReadVLE();
+    for (uint i = 0; i < attributes_.size() && i < count && source.IsValid(); ++i)
+        attributes_[i]->FromBinary(source, change);
+}
+
 void IComponent::ComponentChanged(AttributeChange::Type change)
 {
     for (uint i = 0; i < attributes_.size(); ++i)
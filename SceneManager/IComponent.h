@@ -20,6 +20,8 @@
 
 class QDomDocument;
 class QDomElement;
+class DataSerializer;
+class DataDeserializer;
 
 /// IComponent is the base class for all user-created components. Inherit your own components from this class.
 /** Each Component has a compile-time specified Typename that identifies the class-name of the Component.
@@ -189,6 +191,24 @@ public:
     ///              the network and only local application of the data suffices.
     virtual void DeserializeFrom(QDomElement& element, AttributeChange::Type change);
 
+    /// Serializes this component and all its Attributes in binary form.
+    /// Writes the typename, name and network sync flag, followed by the size of the attribute data, so that readers
+    /// can skip components they can not create. If the component is not serializable, no attribute data is written.
+    /// @param dest The serializer to write to.
+    void SerializeToBinary(DataSerializer& dest) const;
+
+    /// Reads the typename and name of a component written by SerializeToBinary. After this, call either
+    /// DeserializeFromBinary on a component of that type and name, or SkipBinary.
+    static void ReadBinaryHeader(DataDeserializer& source, QString& type_name, QString& name);
+
+    /// Deserializes this component from data written by SerializeToBinary, after ReadBinaryHeader.
+    /// Always consumes the whole component from the source.
+    /// @param change Specifies the source of this change, as in DeserializeFrom.
+    void DeserializeFromBinary(DataDeserializer& source, AttributeChange::Type change);
+
+    /// Skips a component written by SerializeToBinary, after ReadBinaryHeader.
+    static void SkipBinary(DataDeserializer& source);
+
     /** Handles an event. Override in your own module if you want to receive events. Do not call.
         @param category_id Category id of the event
         @param event_id Id of the event
@@ -251,6 +271,14 @@ protected:
     /// Helper function for getting a attribute type from serialized component.
     QString ReadAttributeType(QDomElement& comp_element, const QString &name) const;
 
+    /// Writes the attribute values for binary serialization: the attribute count followed by the values
+    /// in the order the attributes were declared. Override if the set of attributes is not fixed.
+    virtual void SerializeAttributesToBinary(DataSerializer& dest) const;
+
+    /// Reads the attribute values written by SerializeAttributesToBinary. If the data has a different number of
+    /// attributes than this component (e.g. it was written by another version), the common leading ones are read.
+    virtual void DeserializeAttributesFromBinary(DataDeserializer& source, AttributeChange::Type change);
+
     /// Points to the Entity this Component is part of, or null if this Component is not attached to any Entity.
     Scene::Entity* parent_entity_;
 
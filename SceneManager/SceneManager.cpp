@@ -12,6 +12,7 @@
 #include "IComponent.h"
 #include "ForwardDefines.h"
 #include "EC_Name.h"
+#include "DataSerializer.h"
 
 #include <QString>
 #include <QDomDocument>
@@ -23,6 +24,10 @@ namespace Scene
 {
     uint SceneManager::gid_ = 0;
 
+    //! Identifies binary scene files
+    static const char cBinarySceneMagic[] = { 'N', 'S', 'C', 'B' };
+    static const u8 cBinarySceneVersion = 1;
+
     SceneManager::SceneManager() : framework_(0)
     {
     }
@@ -66,7 +71,11 @@ namespace Scene
                 entity->AddComponent(newComp, change); //change the param to a qstringlist or so \todo XXX
             }
         }
-        entities_[entity->GetId()] = entity;
+        EntityHandle handle = entities_.Insert(entity->GetId(), entity);
+        // The components were added before the entity was stored, so index them now
+        const Scene::Entity::ComponentVector &new_components = entity->GetComponentVector();
+        for(size_t i = 0; i < new_components.size(); ++i)
+            IndexComponent(handle, new_components[i].get());
 
         // Send event.
         Events::SceneEventData event_data(entity->GetId());
@@ -92,16 +101,36 @@ namespace Scene
 
     Scene::EntityPtr SceneManager::GetEntityByName(const QString& name) const
     {
-        EntityMap::const_iterator it = entities_.begin();
-        while(it != entities_.end())
+        QHash<QString, EntityHandle>::const_iterator hint = entity_names_.find(name);
+        if (hint != entity_names_.end())
         {
-            EntityPtr entity = it->second;
-            if (entity->HasComponent(EC_Name::TypeNameStatic()))
-                if (entity->GetComponent<EC_Name>()->name.Get() == name)
+            EntityPtr entity = entities_.Resolve(hint.value());
+            if (entity)
+            {
+                boost::shared_ptr<EC_Name> name_comp = entity->GetComponent<EC_Name>();
+                if (name_comp && name_comp->name.Get() == name)
                     return entity;
-            ++it;
+            }
         }
 
+        // The hint was missing or stale. Search the entities with EC_Name and remember the result.
+        const ComponentTypeMembers *members = GetComponentTypeMembers(EC_Name::TypeNameStatic());
+        if (members)
+        {
+            for(size_t i = 0; i < members->slots.size(); ++i)
+            {
+                const EntityPtr &entity = entities_.GetInSlot(members->slots[i]);
+                boost::shared_ptr<EC_Name> name_comp = entity->GetComponent<EC_Name>();
+                if (name_comp && name_comp->name.Get() == name)
+                {
+                    entity_names_[name] = entities_.GetHandle(entity->GetId());
+                    return entity;
+                }
+            }
+        }
+
+        if (hint != entity_names_.end())
+            entity_names_.remove(name);
         return Scene::EntityPtr();
     }
 
@@ -127,7 +156,11 @@ namespace Scene
             event_category_id_t cat_id = framework_->GetEventManager()->QueryEventCategory("Scene");
             framework_->GetEventManager()->SendEvent(cat_id, Events::EVENT_ENTITY_DELETED, &event_data);
             
-            entities_.erase(it);
+            EntityHandle handle = entities_.GetHandle(id);
+            const Scene::Entity::ComponentVector &components = del_entity->GetComponentVector();
+            for(size_t i = 0; i < components.size(); ++i)
+                UnindexComponent(handle, components[i].get());
+            entities_.Erase(id);
             // If entity somehow manages to live, at least it doesn't belong to the scene anymore
             del_entity->SetScene(0);
             del_entity.reset();
@@ -137,42 +170,108 @@ namespace Scene
     void SceneManager::RemoveAllEntities(bool send_events, AttributeChange::Type change)
     {
         event_category_id_t cat_id = framework_->GetEventManager()->QueryEventCategory("Scene");
-        EntityMap::iterator it = entities_.begin();
-        while (it != entities_.end())
+        // Iterate a copy, as removal handlers could modify the storage
+        std::vector<EntityPtr> entities;
+        entities.reserve(entities_.size());
+        for(EntityMap::iterator it = entities_.begin(); it != entities_.end(); ++it)
+            entities.push_back(it->second);
+
+        for(size_t i = 0; i < entities.size(); ++i)
         {
             // If entity somehow manages to live, at least it doesn't belong to the scene anymore
             if (send_events)
             {
-                EmitEntityRemoved(it->second.get(), change);
+                EmitEntityRemoved(entities[i].get(), change);
                 
                 // Send event.
-                Events::SceneEventData event_data(it->second->GetId());
+                Events::SceneEventData event_data(entities[i]->GetId());
                 framework_->GetEventManager()->SendEvent(cat_id, Events::EVENT_ENTITY_DELETED, &event_data);
             }
-            it->second->SetScene(0);
-            ++it;
+            entities[i]->SetScene(0);
         }
         entities_.clear();
+        component_index_.clear();
+        entity_names_.clear();
         emit SceneCleared();
     }
     
     EntityList SceneManager::GetEntitiesWithComponent(const QString &type_name) const
     {
         std::list<EntityPtr> entities;
-        EntityMap::const_iterator it = entities_.begin();
-        while(it != entities_.end())
+        const ComponentTypeMembers *members = GetComponentTypeMembers(type_name);
+        if (members)
+            for(size_t i = 0; i < members->slots.size(); ++i)
+                entities.push_back(entities_.GetInSlot(members->slots[i]));
+
+        return entities;
+    }
+
+    const SceneManager::ComponentTypeMembers *SceneManager::GetComponentTypeMembers(const QString &type_name) const
+    {
+        ComponentTypeIndex::const_iterator it = component_index_.find(type_name);
+        if (it == component_index_.end() || it.value().slots.empty())
+            return 0;
+        return &it.value();
+    }
+
+    EntityHandle SceneManager::HandleOf(Scene::Entity *entity) const
+    {
+        if (!entity)
+            return EntityHandle();
+        EntityHandle handle = entities_.GetHandle(entity->GetId());
+        if (handle.IsNull() || entities_.Resolve(handle).get() != entity)
+            return EntityHandle();
+        return handle;
+    }
+
+    void SceneManager::IndexComponent(const EntityHandle &handle, IComponent *comp)
+    {
+        if (handle.IsNull() || !comp)
+            return;
+
+        ComponentTypeMembers &members = component_index_[comp->TypeName()];
+        boost::unordered_map<uint, std::pair<uint, uint> >::iterator it = members.positions.find(handle.slot);
+        if (it != members.positions.end())
+            ++it->second.second;
+        else
         {
-            EntityPtr entity = it->second;
-            if (entity->HasComponent(type_name))
-                entities.push_back(entity);
-            ++it;
+            members.positions[handle.slot] = std::make_pair((uint)members.slots.size(), 1u);
+            members.slots.push_back(handle.slot);
         }
 
-        return entities;
+        EC_Name *name_comp = dynamic_cast<EC_Name *>(comp);
+        if (name_comp && !entity_names_.contains(name_comp->name.Get()))
+            entity_names_[name_comp->name.Get()] = handle;
+    }
+
+    void SceneManager::UnindexComponent(const EntityHandle &handle, IComponent *comp)
+    {
+        if (handle.IsNull() || !comp)
+            return;
+
+        ComponentTypeIndex::iterator type_it = component_index_.find(comp->TypeName());
+        if (type_it == component_index_.end())
+            return;
+
+        ComponentTypeMembers &members = type_it.value();
+        boost::unordered_map<uint, std::pair<uint, uint> >::iterator it = members.positions.find(handle.slot);
+        if (it == members.positions.end() || --it->second.second > 0)
+            return;
+
+        // Last component of the type removed from the entity: move the last member into its place
+        const uint pos = it->second.first;
+        const uint last = members.slots.back();
+        members.slots[pos] = last;
+        members.positions[last].first = pos;
+        members.slots.pop_back();
+        members.positions.erase(handle.slot);
     }
     
     void SceneManager::EmitComponentAdded(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change)
     {
+        // Keep the index up to date also for changes that are not signaled
+        IndexComponent(HandleOf(entity), comp);
+
         if (change == AttributeChange::Disconnected)
             return;
         if (change == AttributeChange::Default)
@@ -182,6 +281,8 @@ namespace Scene
     
     void SceneManager::EmitComponentRemoved(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change)
     {
+        UnindexComponent(HandleOf(entity), comp);
+
         if (change == AttributeChange::Disconnected)
             return;
         if (change == AttributeChange::Default)
@@ -193,6 +294,13 @@ namespace Scene
     {
         if (change == AttributeChange::Disconnected)
             return;
+        EC_Name *name_comp = dynamic_cast<EC_Name *>(comp);
+        if (name_comp && attribute == &name_comp->name)
+        {
+            EntityHandle handle = HandleOf(comp->GetParentEntity());
+            if (!handle.IsNull())
+                entity_names_[name_comp->name.Get()] = handle;
+        }
         if (change == AttributeChange::Default)
             change = comp->GetUpdateMode();
         emit AttributeChanged(comp, attribute, change);
@@ -233,9 +341,10 @@ namespace Scene
     {
         QVariantList ret;
 
-        EntityList entities = GetEntitiesWithComponent(type_name);
-        foreach(EntityPtr e, entities)
-            ret.append(QVariant(e->GetId()));
+        const ComponentTypeMembers *members = GetComponentTypeMembers(type_name);
+        if (members)
+            for(size_t i = 0; i < members->slots.size(); ++i)
+                ret.append(QVariant(entities_.GetInSlot(members->slots[i])->GetId()));
 
         return ret;
     }
@@ -244,9 +353,10 @@ namespace Scene
     {
         QList<Scene::Entity*> ret;
 
-        EntityList entities = GetEntitiesWithComponent(type_name);
-        foreach(EntityPtr e, entities)
-            ret.append(e.get());
+        const ComponentTypeMembers *members = GetComponentTypeMembers(type_name);
+        if (members)
+            for(size_t i = 0; i < members->slots.size(); ++i)
+                ret.append(entities_.GetInSlot(members->slots[i]).get());
 
         return ret;
     }
@@ -259,6 +369,14 @@ namespace Scene
         if (!file.open(QIODevice::ReadOnly))
             return false;
         
+        // Binary scenes skip the DOM altogether
+        if (file.peek(sizeof(cBinarySceneMagic)) == QByteArray::fromRawData(cBinarySceneMagic, sizeof(cBinarySceneMagic)))
+        {
+            QByteArray data = file.readAll();
+            file.close();
+            return LoadSceneBinary(data, change);
+        }
+        
         if (!scene_doc.setContent(&file))
         {
             file.close();
@@ -347,6 +465,86 @@ namespace Scene
     }
 
 
+    bool SceneManager::LoadSceneBinary(const QByteArray &data, AttributeChange::Type change)
+    {
+        DataDeserializer source(data.constData(), data.size());
+        source.Skip(sizeof(cBinarySceneMagic));
+        if (source.ReadU8() != cBinarySceneVersion || !source.IsValid())
+            return false;
+        
+        // Purge all old entities. Send events for the removal
+        RemoveAllEntities(true, change);
+        
+        u32 num_entities = source.ReadVLE();
+        for(u32 i = 0; i < num_entities && source.IsValid(); ++i)
+        {
+            entity_id_t id = source.ReadU32();
+            EntityPtr entity = CreateEntity(id, QStringList());
+            if (!entity)
+                return false;
+            
+            u32 num_components = source.ReadVLE();
+            for(u32 j = 0; j < num_components && source.IsValid(); ++j)
+            {
+                QString type_name, name;
+                IComponent::ReadBinaryHeader(source, type_name, name);
+                ComponentPtr new_comp = entity->GetOrCreateComponent(type_name, name);
+                if (new_comp)
+                    // Trigger no signal yet when entity is in incoherent state
+                    new_comp->DeserializeFromBinary(source, AttributeChange::Disconnected);
+                else
+                    IComponent::SkipBinary(source);
+            }
+            EmitEntityCreated(entity, change);
+            
+            // All components have been loaded. Trigger change for them now.
+            const Scene::Entity::ComponentVector &components = entity->GetComponentVector();
+            for(uint k = 0; k < components.size(); ++k)
+                components[k]->ComponentChanged(change);
+        }
+        
+        return source.IsValid();
+    }
+    
+    bool SceneManager::SaveSceneBinary(const std::string& filename)
+    {
+        QByteArray bytes;
+        DataSerializer dest(bytes);
+        bytes.append(cBinarySceneMagic, sizeof(cBinarySceneMagic));
+        dest.AddU8(cBinarySceneVersion);
+        
+        std::vector<Scene::Entity *> entities;
+        for(EntityMap::iterator it = entities_.begin(); it != entities_.end(); ++it)
+            if ((it->second) && (!it->second->IsTemporary()))
+                entities.push_back(it->second.get());
+        
+        dest.AddVLE(entities.size());
+        std::vector<IComponent *> serializable;
+        for(uint i = 0; i < entities.size(); ++i)
+        {
+            dest.AddU32(entities[i]->GetId());
+            
+            serializable.clear();
+            const Scene::Entity::ComponentVector &components = entities[i]->GetComponentVector();
+            for(uint j = 0; j < components.size(); ++j)
+                if ((components[j]->IsSerializable()) && (!components[j]->IsTemporary()))
+                    serializable.push_back(components[j].get());
+            
+            dest.AddVLE(serializable.size());
+            for(uint j = 0; j < serializable.size(); ++j)
+                serializable[j]->SerializeToBinary(dest);
+        }
+        
+        QFile scenefile(filename.c_str());
+        if (scenefile.open(QFile::WriteOnly))
+        {
+            scenefile.write(bytes);
+            scenefile.close();
+            return true;
+        }
+        else return false;
+    }
+
     QByteArray SceneManager::GetEntityXml(Scene::Entity *entity)
     {
         QDomDocument scene_doc("Scene");
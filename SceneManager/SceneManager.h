@@ -7,10 +7,12 @@
 #include "CoreStdIncludes.h"
 #include "Entity.h"
 #include "IComponent.h"
+#include "EntitySlotMap.h"
 
 #include <QObject>
 #include <QVariant>
 #include <QStringList>
+#include <QHash>
 
 namespace Scene
 {
@@ -62,8 +64,8 @@ namespace Scene
         //! destructor
         ~SceneManager();
 
-        //! entity map
-        typedef std::map<entity_id_t, EntityPtr> EntityMap;
+        //! entity storage. Iterates (id, entity) pairs in no particular order.
+        typedef EntitySlotMap EntityMap;
 
         //! entity iterator, see begin() and end()
         typedef EntityMap::iterator iterator;
@@ -102,8 +104,18 @@ namespace Scene
         */
         EntityPtr GetEntity(entity_id_t id) const;
 
+        //! Returns a generational handle to the entity with the specified id, or a null handle if it does not exist.
+        /*! Resolving the handle with GetEntity(const EntityHandle &) skips the id lookup, and is safe after the entity has
+            been removed.
+        */
+        EntityHandle GetEntityHandle(entity_id_t id) const { return entities_.GetHandle(id); }
+
+        //! Returns the entity the handle refers to, or null if the entity has been removed.
+        EntityPtr GetEntity(const EntityHandle &handle) const { return entities_.Resolve(handle); }
+
         //! Returns entity with the specified name, searches through only those entities which has EC_Name-component.
-        /*!
+        /*! Lookups go through a name index, so they are cheap regardless of the scene size.
+            \note If several entities share the name, any one of them may be returned.
             \note Returns a shared pointer, but it is preferable to use a weak pointer, Scene::EntityWeakPtr,
                   to avoid dangling references that prevent entities from being properly destroyed.
         */
@@ -144,7 +156,9 @@ namespace Scene
         const EntityMap &GetEntityMap() const { return entities_; }
 
         //! Return list of entities with a spesific component present.
-        //! \param type_name Type name of the component
+        /*! Served from a per-component-type index, so the cost depends on the number of matching entities only.
+            \param type_name Type name of the component
+        */
         EntityList GetEntitiesWithComponent(const QString &type_name) const;
         
         //! Emit notification of an attribute changing. Called by IComponent.
@@ -187,8 +201,9 @@ namespace Scene
          */
         void EmitEntityRemoved(Scene::Entity* entity, AttributeChange::Type change);
 
-        //! Load the scene (from an XML file for now, and only serializable components)
+        //! Load the scene (from an XML file or a binary file written by SaveSceneBinary, and only serializable components)
         /*! Note: will remove all existing entities
+            The format is detected from the file contents.
             \param filename File name
             \param change Changetype that will be used, when removing the old scene, and deserializing the new
            
@@ -202,6 +217,12 @@ namespace Scene
          */
         bool SaveScene(const std::string& filename);
 
+        //! Save the scene into a binary file (only serializable components). Much faster to load than XML.
+        /*! \param filename File name
+            \return true if successful
+         */
+        bool SaveSceneBinary(const std::string& filename);
+
         //! Emits a notification of an entity action being triggered.
         /*! \param entity Entity pointer
             \param action Name of the action
@@ -255,9 +276,44 @@ namespace Scene
     private:
         Q_DISABLE_COPY(SceneManager);
 
-        //! Entities in a map
+        //! Entities that have at least one component of a certain type.
+        struct ComponentTypeMembers
+        {
+            //! Entity slots of the members, packed.
+            std::vector<uint> slots;
+
+            //! For each member slot, its position in slots and the number of components of the type the entity has.
+            boost::unordered_map<uint, std::pair<uint, uint> > positions;
+        };
+
+        //! Component type name -> entities that have a component of the type.
+        typedef QHash<QString, ComponentTypeMembers> ComponentTypeIndex;
+
+        //! Adds the component to the component type index (and the name index, if it is EC_Name).
+        void IndexComponent(const EntityHandle &handle, IComponent *comp);
+
+        //! Removes one component of the entity from the component type index.
+        void UnindexComponent(const EntityHandle &handle, IComponent *comp);
+
+        //! Loads the scene from the contents of a binary scene file. See LoadScene.
+        bool LoadSceneBinary(const QByteArray &data, AttributeChange::Type change);
+
+        //! Returns the slot map handle of an entity of this scene, or a null handle if the entity is not (yet) stored.
+        EntityHandle HandleOf(Scene::Entity *entity) const;
+
+        //! Returns the index of entities with the given component type, or null if there are none.
+        const ComponentTypeMembers *GetComponentTypeMembers(const QString &type_name) const;
+
+        //! Entities
         EntityMap entities_;
 
+        //! Per-component-type membership lists, kept up to date by EmitComponentAdded and EmitComponentRemoved.
+        ComponentTypeIndex component_index_;
+
+        //! Name -> entity with an EC_Name of that name. Only a hint: names changed with AttributeChange::Disconnected
+        //! do not reach the scene, so GetEntityByName verifies the hit and falls back to the EC_Name members on a miss.
+        mutable QHash<QString, EntityHandle> entity_names_;
+
         //! parent framework
         Foundation::Framework *framework_;
 
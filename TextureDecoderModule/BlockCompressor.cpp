@@ -0,0 +1,357 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+// Block compression after J.M.P. van Waveren, "Real-Time DXT Compression": the endpoints are the inset bounding box
+// of the block colors, and each pixel gets the palette entry nearest to its projection on the endpoint line.
+
+#include "StableHeaders.h"
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cstring>
+
+// The block bounding boxes are taken 16 pixels at a time with SSE2, when the target has it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace TextureDecoder
+{
+    namespace
+    {
+        //! Copies a 4x4 block of RGBA pixels, repeating the edge pixels of levels smaller than a block
+        void ExtractBlock(const u8* rgba, uint width, uint height, uint block_x, uint block_y, u8* block)
+        {
+            for (uint y = 0; y < 4; ++y)
+            {
+                const uint source_y = std::min(block_y + y, height - 1);
+                for (uint x = 0; x < 4; ++x)
+                {
+                    const uint source_x = std::min(block_x + x, width - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + (source_y * width + source_x) * 4, 4);
+                }
+            }
+        }
+
+        //! Finds the per-channel minimum and maximum of a block
+        void GetMinMax(const u8* block, u8* min_color, u8* max_color)
+        {
+#ifdef BLOCK_COMPRESSOR_SSE2
+            const __m128i* rows = (const __m128i*)block;
+            __m128i row0 = _mm_loadu_si128(rows);
+            __m128i row1 = _mm_loadu_si128(rows + 1);
+            __m128i row2 = _mm_loadu_si128(rows + 2);
+            __m128i row3 = _mm_loadu_si128(rows + 3);
+            __m128i min = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+            __m128i max = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+            // Fold the four pixels of the row into one
+            min = _mm_min_epu8(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(2, 3, 0, 1)));
+            max = _mm_max_epu8(max, _mm_shuffle_epi32(max, _MM_SHUFFLE(2, 3, 0, 1)));
+            min = _mm_min_epu8(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(1, 0, 3, 2)));
+            max = _mm_max_epu8(max, _mm_shuffle_epi32(max, _MM_SHUFFLE(1, 0, 3, 2)));
+            const int min_pixel = _mm_cvtsi128_si32(min);
+            const int max_pixel = _mm_cvtsi128_si32(max);
+            memcpy(min_color, &min_pixel, 4);
+            memcpy(max_color, &max_pixel, 4);
+#else
+            for (uint c = 0; c < 4; ++c)
+            {
+                min_color[c] = 255;
+                max_color[c] = 0;
+            }
+            for (uint i = 0; i < 16; ++i)
+            {
+                for (uint c = 0; c < 4; ++c)
+                {
+                    min_color[c] = std::min(min_color[c], block[i * 4 + c]);
+                    max_color[c] = std::max(max_color[c], block[i * 4 + c]);
+                }
+            }
+#endif
+        }
+
+        u16 ToRGB565(const u8* color)
+        {
+            return (u16)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+        }
+
+        void FromRGB565(u16 value, int* color)
+        {
+            const int r = (value >> 11) & 31;
+            const int g = (value >> 5) & 63;
+            const int b = value & 31;
+            color[0] = (r << 3) | (r >> 2);
+            color[1] = (g << 2) | (g >> 4);
+            color[2] = (b << 3) | (b >> 2);
+        }
+
+        void WriteU16(u8* dest, u16 value)
+        {
+            dest[0] = (u8)value;
+            dest[1] = (u8)(value >> 8);
+        }
+
+        //! Writes the 8-byte color part of a BC1 or BC3 block
+        void CompressColorBlock(const u8* block, const u8* min_color, const u8* max_color, u8* dest)
+        {
+            // Move the endpoints inwards by 1/16 of the range, so that the palette covers the colors evenly
+            u8 inset_min[3];
+            u8 inset_max[3];
+            for (uint c = 0; c < 3; ++c)
+            {
+                const int inset = (max_color[c] - min_color[c]) >> 4;
+                inset_min[c] = (u8)(min_color[c] + inset);
+                inset_max[c] = (u8)(max_color[c] - inset);
+            }
+
+            // The maximum is at least the minimum in every channel, so c0 >= c1 and the block is in four color mode
+            // unless they are equal, in which case every pixel uses c0
+            const u16 c0 = ToRGB565(inset_max);
+            const u16 c1 = ToRGB565(inset_min);
+            WriteU16(dest, c0);
+            WriteU16(dest + 2, c1);
+
+            u32 indices = 0;
+            if (c0 != c1)
+            {
+                int end0[3];
+                int end1[3];
+                FromRGB565(c0, end0);
+                FromRGB565(c1, end1);
+
+                const int axis[3] = { end0[0] - end1[0], end0[1] - end1[1], end0[2] - end1[2] };
+                const int length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+                // Position on the line in thirds, from c1 (0) to c0 (3), mapped to the palette order c0, c1, 2/3, 1/3
+                static const u32 index_of_position[4] = { 1, 3, 2, 0 };
+
+                for (uint i = 0; i < 16; ++i)
+                {
+                    const u8* pixel = block + i * 4;
+                    const int dot = (pixel[0] - end1[0]) * axis[0] + (pixel[1] - end1[1]) * axis[1] + (pixel[2] - end1[2]) * axis[2];
+                    int position = (dot * 6 + length) / (length * 2);
+                    position = std::max(0, std::min(3, position));
+                    indices |= index_of_position[position] << (i * 2);
+                }
+            }
+
+            dest[4] = (u8)indices;
+            dest[5] = (u8)(indices >> 8);
+            dest[6] = (u8)(indices >> 16);
+            dest[7] = (u8)(indices >> 24);
+        }
+
+        //! Writes the 8-byte alpha part of a BC3 block
+        void CompressAlphaBlock(const u8* block, u8 min_alpha, u8 max_alpha, u8* dest)
+        {
+            // max_alpha > min_alpha selects the eight alpha mode
+            dest[0] = max_alpha;
+            dest[1] = min_alpha;
+
+            u64 indices = 0;
+            if (max_alpha != min_alpha)
+            {
+                const int range = max_alpha - min_alpha;
+                // Position in sevenths, from min_alpha (0) to max_alpha (7), mapped to the palette order
+                static const u64 index_of_position[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+                for (uint i = 0; i < 16; ++i)
+                {
+                    const int position = ((block[i * 4 + 3] - min_alpha) * 14 + range) / (range * 2);
+                    indices |= index_of_position[position] << (i * 3);
+                }
+            }
+
+            for (uint i = 0; i < 6; ++i)
+                dest[2 + i] = (u8)(indices >> (i * 8));
+        }
+
+        //! Compresses one level
+        void CompressLevel(const u8* rgba, uint width, uint height, bool alpha, u8* dest)
+        {
+            u8 block[64];
+            u8 min_color[4];
+            u8 max_color[4];
+
+            for (uint y = 0; y < height; y += 4)
+            {
+                for (uint x = 0; x < width; x += 4)
+                {
+                    ExtractBlock(rgba, width, height, x, y, block);
+                    GetMinMax(block, min_color, max_color);
+                    if (alpha)
+                    {
+                        CompressAlphaBlock(block, min_color[3], max_color[3], dest);
+                        dest += 8;
+                    }
+                    CompressColorBlock(block, min_color, max_color, dest);
+                    dest += 8;
+                }
+            }
+        }
+
+        //! Halves a level with a box filter
+        void Downsample(const u8* rgba, uint width, uint height, std::vector<u8>& dest)
+        {
+            const uint dest_width = std::max(width >> 1, 1u);
+            const uint dest_height = std::max(height >> 1, 1u);
+            dest.resize(dest_width * dest_height * 4);
+
+            for (uint y = 0; y < dest_height; ++y)
+            {
+                const u8* row0 = rgba + std::min(y * 2, height - 1) * width * 4;
+                const u8* row1 = rgba + std::min(y * 2 + 1, height - 1) * width * 4;
+                u8* out = &dest[y * dest_width * 4];
+                for (uint x = 0; x < dest_width; ++x)
+                {
+                    const uint x0 = std::min(x * 2, width - 1) * 4;
+                    const uint x1 = std::min(x * 2 + 1, width - 1) * 4;
+                    for (uint c = 0; c < 4; ++c)
+                        *out++ = (u8)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                }
+            }
+        }
+
+        uint GetLevelSize(uint width, uint height, bool alpha)
+        {
+            return ((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+        }
+    }
+
+    bool CanCompressTexture(uint width, uint height, uint components)
+    {
+        return ((components == 3) || (components == 4)) && (width >= 4) && (height >= 4) && !(width & 3) && !(height & 3);
+    }
+
+    bool CompressTexture(const u8* source, uint width, uint height, uint components, std::vector<u8>& dest, int& format, uint& mipmaps)
+    {
+        if (!CanCompressTexture(width, height, components))
+            return false;
+
+        // Work on RGBA
+        const uint pixels = width * height;
+        std::vector<u8> level(pixels * 4);
+        bool alpha = false;
+        if (components == 4)
+        {
+            memcpy(&level[0], source, pixels * 4);
+            for (uint i = 0; (i < pixels) && (!alpha); ++i)
+                alpha = source[i * 4 + 3] != 255;
+        }
+        else
+        {
+            for (uint i = 0; i < pixels; ++i)
+            {
+                level[i * 4] = source[i * 3];
+                level[i * 4 + 1] = source[i * 3 + 1];
+                level[i * 4 + 2] = source[i * 3 + 2];
+                level[i * 4 + 3] = 255;
+            }
+        }
+
+        uint total_size = 0;
+        mipmaps = 0;
+        for (uint w = width, h = height; ; w = std::max(w >> 1, 1u), h = std::max(h >> 1, 1u))
+        {
+            total_size += GetLevelSize(w, h, alpha);
+            if ((w == 1) && (h == 1))
+                break;
+            ++mipmaps;
+        }
+        dest.resize(total_size);
+
+        std::vector<u8> next_level;
+        u8* out = &dest[0];
+        for (uint w = width, h = height; ; )
+        {
+            CompressLevel(&level[0], w, h, alpha, out);
+            out += GetLevelSize(w, h, alpha);
+            if ((w == 1) && (h == 1))
+                break;
+
+            Downsample(&level[0], w, h, next_level);
+            level.swap(next_level);
+            w = std::max(w >> 1, 1u);
+            h = std::max(h >> 1, 1u);
+        }
+
+        format = alpha ? PIXEL_FORMAT_DXT5 : PIXEL_FORMAT_DXT1;
+        return true;
+    }
+
+    bool DecompressTexture(const u8* source, uint width, uint height, int format, uint components, std::vector<u8>& dest)
+    {
+        if (((format != PIXEL_FORMAT_DXT1) && (format != PIXEL_FORMAT_DXT5)) || ((components != 3) && (components != 4)))
+            return false;
+
+        const bool alpha = format == PIXEL_FORMAT_DXT5;
+        dest.resize(width * height * components);
+
+        for (uint block_y = 0; block_y < height; block_y += 4)
+        {
+            for (uint block_x = 0; block_x < width; block_x += 4)
+            {
+                u8 alphas[8];
+                u64 alpha_indices = 0;
+                if (alpha)
+                {
+                    alphas[0] = source[0];
+                    alphas[1] = source[1];
+                    for (uint i = 2; i < 8; ++i)
+                    {
+                        if (alphas[0] > alphas[1])
+                            alphas[i] = (u8)(((8 - i) * alphas[0] + (i - 1) * alphas[1]) / 7);
+                        else if (i < 6)
+                            alphas[i] = (u8)(((6 - i) * alphas[0] + (i - 1) * alphas[1]) / 5);
+                        else
+                            alphas[i] = (i == 6) ? 0 : 255;
+                    }
+                    for (uint i = 0; i < 6; ++i)
+                        alpha_indices |= (u64)source[2 + i] << (i * 8);
+                    source += 8;
+                }
+
+                const u16 c0 = (u16)(source[0] | (source[1] << 8));
+                const u16 c1 = (u16)(source[2] | (source[3] << 8));
+                int colors[4][4];
+                FromRGB565(c0, colors[0]);
+                FromRGB565(c1, colors[1]);
+                colors[0][3] = colors[1][3] = colors[2][3] = 255;
+                colors[3][3] = 255;
+                for (uint c = 0; c < 3; ++c)
+                {
+                    // BC3 color blocks are always in four color mode
+                    if ((c0 > c1) || (alpha))
+                    {
+                        colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+                        colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+                    }
+                    else
+                    {
+                        colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+                        colors[3][c] = 0;
+                    }
+                }
+                if ((c0 <= c1) && (!alpha))
+                    colors[3][3] = 0;
+                const u32 indices = source[4] | (source[5] << 8) | (source[6] << 16) | ((u32)source[7] << 24);
+                source += 8;
+
+                for (uint y = 0; (y < 4) && (block_y + y < height); ++y)
+                {
+                    for (uint x = 0; (x < 4) && (block_x + x < width); ++x)
+                    {
+                        const uint i = y * 4 + x;
+                        const int* color = colors[(indices >> (i * 2)) & 3];
+                        u8* out = &dest[((block_y + y) * width + block_x + x) * components];
+                        out[0] = (u8)color[0];
+                        out[1] = (u8)color[1];
+                        out[2] = (u8)color[2];
+                        if (components == 4)
+                            out[3] = alpha ? alphas[(alpha_indices >> (i * 3)) & 7] : (u8)color[3];
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+}
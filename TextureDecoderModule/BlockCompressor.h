@@ -0,0 +1,50 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_TextureDecoder_BlockCompressor_h
+#define incl_TextureDecoder_BlockCompressor_h
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+namespace TextureDecoder
+{
+    //! Ogre pixel format of BC1 (DXT1) compressed textures
+    const int PIXEL_FORMAT_DXT1 = 17;
+
+    //! Ogre pixel format of BC3 (DXT5) compressed textures
+    const int PIXEL_FORMAT_DXT5 = 21;
+
+    //! Returns true if the texture can be block compressed
+    /*! \param width Width of the texture
+        \param height Height of the texture
+        \param components Amount of components, 8 bits each
+     */
+    bool CanCompressTexture(uint width, uint height, uint components);
+
+    //! Compresses a texture to BC1, or to BC3 if it has any transparent pixels, and generates a full mip chain.
+    /*! Thread-safe, meant to be called from the decoder tasks.
+        \param source Pixels, 3 (RGB) or 4 (RGBA) components of 8 bits each
+        \param width Width of the texture, a multiple of 4
+        \param height Height of the texture, a multiple of 4
+        \param components Amount of components
+        \param dest [out] Compressed levels, largest first
+        \param format [out] Ogre pixel format, PIXEL_FORMAT_DXT1 or PIXEL_FORMAT_DXT5
+        \param mipmaps [out] Amount of levels after the first one
+        \return true if successful, false if CanCompressTexture() would have returned false
+     */
+    bool CompressTexture(const u8* source, uint width, uint height, uint components, std::vector<u8>& dest, int& format, uint& mipmaps);
+
+    //! Decompresses the full size level of a texture compressed by CompressTexture()
+    /*! \param source Compressed data
+        \param width Width of the texture
+        \param height Height of the texture
+        \param format Ogre pixel format, PIXEL_FORMAT_DXT1 or PIXEL_FORMAT_DXT5
+        \param components Amount of components to decompress to, 3 (RGB) or 4 (RGBA)
+        \param dest [out] Pixels
+        \return true if successful
+     */
+    bool DecompressTexture(const u8* source, uint width, uint height, int format, uint components, std::vector<u8>& dest);
+}
+
+#endif
@@ -40,6 +40,7 @@
 #include "TextureDecoderModule.h"
 #include "ThreadTaskManager.h"
 #include "OpenJpegDecoder.h"
+#include "BlockCompressor.h"
 #include "Profiler.h"
 
 #include <openjpeg.h>
@@ -49,50 +50,34 @@
 namespace TextureDecoder
 {
     OpenJpegDecoder::OpenJpegDecoder() :
-        Foundation::ThreadTask("TextureDecoder"),
-        decodes_per_frame_(1)
+        Foundation::ThreadTask("TextureDecoder", true),
+        decodes_per_frame_(1),
+        compress_textures_(false)
     {
+        SetMaxPendingResults(decodes_per_frame_);
+    }
+    
+    OpenJpegDecoder::~OpenJpegDecoder()
+    {
+        Stop();
     }
     
     void OpenJpegDecoder::SetDecodesPerFrame(uint decodes) 
     { 
         if (decodes)
+        {
             decodes_per_frame_ = decodes;
+            // Do not let "too many" results pile up, to prevent slowing down the main thread with too many texture
+            // creations per frame. Decodes in progress count as pending results, so allow one per worker on top.
+            uint workers = GetThreadPool() ? GetThreadPool()->GetNumThreads() : 1;
+            SetMaxPendingResults(decodes_per_frame_ + workers);
+        }
     }
     
-    void OpenJpegDecoder::Work()
+    void OpenJpegDecoder::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
     {
-        while (ShouldRun())
-        {
-            WaitForRequests();
-            
-            DecodeRequestPtr request = GetNextRequest<DecodeRequest>();
-            if (request)
-            {
-                // Wait if "too many" results already produced, to prevent slowing down the main thread with 
-                // too many texture creations per frame
-                Foundation::ThreadTaskManager* manager = GetThreadTaskManager();
-                if (manager)
-                {
-                    for (;;)
-                    {
-                        uint results = manager->GetNumResults(GetTaskDescription());
-                        if (results < decodes_per_frame_)
-                            break;
-                        if (!ShouldRun())
-                            return;
-                        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
-                    }
-                }
-                
-                {
-                    PROFILE(OpenJpegDecoder_Decode);
-                    PerformDecode(request);
-                }
-            }
-
-            RESETPROFILER
-        }
+        PROFILE(OpenJpegDecoder_Decode);
+        PerformDecode(boost::dynamic_pointer_cast<DecodeRequest>(request));
     }
 
     void HandleError(const char *msg, void *client_data)
@@ -137,6 +122,21 @@ namespace TextureDecoder
                 return;
             }
 
+            // On the first decode of a texture, find out the dimensions and the amount of resolutions. Later decodes
+            // of the same texture use the session, and decode directly at the requested resolution.
+            DecodeSessionPtr session = request->session_;
+            if (!session)
+                session = DecodeSessionPtr(new DecodeSession());
+            if (!session->header_parsed_)
+                ParseHeader(data, request->source_->GetSize(), *session);
+
+            // Asking for more reduction than there are resolutions fails the whole decode, so clamp to the coarsest one
+            int level = request->level_;
+            if ((session->resolutions_ > 0) && (level > session->resolutions_ - 1))
+                level = session->resolutions_ - 1;
+            if (level < 0)
+                level = 0;
+
             opj_dinfo_t* dinfo = 0; // decoder
             opj_image_t *image = 0; // decoded image
             opj_dparameters_t parameters; // decoder parameters
@@ -151,7 +151,7 @@ namespace TextureDecoder
             //event_mgr.info_handler = HandleInfo;
             
             opj_set_default_decoder_parameters(&parameters);
-            parameters.cp_reduce = request->level_;
+            parameters.cp_reduce = level;
             
             dinfo = opj_create_decompress(CODEC_J2K);
             opj_setup_decoder(dinfo, &parameters);
@@ -163,6 +163,7 @@ namespace TextureDecoder
             result->max_levels_ = cstr_info.numlayers;
 
             opj_cio_close(cio);
+            opj_destroy_cstr_info(&cstr_info);
             opj_destroy_decompress(dinfo);
             
             if ((image) && (image->numcomps))
@@ -170,7 +171,7 @@ namespace TextureDecoder
                 result->original_width_ = image->x1 - image->x0;
                 result->original_height_ = image->y1 - image->y0;
                 result->components_ = image->numcomps;
-                result->level_ = request->level_;
+                result->level_ = level;
 
                 // Assume all components are same size
                 int actual_width = image->comps[0].w;
@@ -179,8 +180,8 @@ namespace TextureDecoder
                 // Create a (possibly temporary, if no-one stores the pointer) raw texture resource
                 Foundation::ResourcePtr resource(new TextureResource(request->source_->GetId(), actual_width, actual_height, image->numcomps));
                 TextureResource* texture = checked_static_cast<TextureResource*>(resource.get());
-                u8* data = texture->GetData();
-                texture->SetLevel(request->level_);
+                u8* data = texture->GetWritableData();
+                texture->SetLevel(level);
                 texture->SetDataSize(actual_width * actual_height * image->numcomps);
 
                 for (int y = 0; y < actual_height; ++y)
@@ -194,7 +195,19 @@ namespace TextureDecoder
                         }
                     }
                 }
-         
+
+                // Compress the full resolution texture while still on the decode thread, so that the texture cache
+                // stores and the renderer uploads the compressed levels
+                if ((compress_textures_) && (!level) && (CanCompressTexture(actual_width, actual_height, image->numcomps)))
+                {
+                    PROFILE(OpenJpegDecoder_Compress);
+                    std::vector<u8> compressed;
+                    int format;
+                    uint mipmaps;
+                    if (CompressTexture(texture->GetData(), actual_width, actual_height, image->numcomps, compressed, format, mipmaps))
+                        texture->SetCompressedData(compressed, format, mipmaps);
+                }
+
                 result->texture_ = resource;
                 result->is_jpeg2000_ = true;
             }
@@ -253,7 +266,7 @@ namespace TextureDecoder
                     texture->SetFormat(ogre_format);
                     texture->SetLevel(0);
                     texture->SetDataSize(raw_image.byteCount());
-                    u8* data = texture->GetData();
+                    u8* data = texture->GetWritableData();
                     
                     memcpy(data, raw_image.bits(), raw_image.byteCount());
                     result->texture_ = resource;
@@ -273,4 +286,44 @@ namespace TextureDecoder
 
         QueueResult<DecodeResult>(result);
     }
+
+    void OpenJpegDecoder::ParseHeader(unsigned char* data, uint size, DecodeSession& session)
+    {
+        PROFILE(OpenJpegDecoder_ParseHeader);
+
+        opj_dparameters_t parameters;
+        opj_codestream_info_t cstr_info;
+        memset(&cstr_info, 0, sizeof(opj_codestream_info_t));
+
+        opj_event_mgr_t event_mgr;
+        memset(&event_mgr, 0, sizeof(opj_event_mgr_t));
+        event_mgr.error_handler = HandleError;
+
+        // Stop after the main header; no tiles are decoded
+        opj_set_default_decoder_parameters(&parameters);
+        parameters.cp_limit_decoding = LIMIT_TO_MAIN_HEADER;
+
+        opj_dinfo_t* dinfo = opj_create_decompress(CODEC_J2K);
+        opj_setup_decoder(dinfo, &parameters);
+        opj_set_event_mgr((opj_common_ptr)dinfo, &event_mgr, this);
+
+        opj_cio_t* cio = opj_cio_open((opj_common_ptr)dinfo, data, size);
+        opj_image_t* image = opj_decode_with_info(dinfo, cio, &cstr_info);
+
+        if ((image) && (image->numcomps) && (cstr_info.numdecompos))
+        {
+            session.width_ = image->x1 - image->x0;
+            session.height_ = image->y1 - image->y0;
+            session.components_ = image->numcomps;
+            session.resolutions_ = cstr_info.numdecompos[0] + 1;
+            session.layers_ = cstr_info.numlayers;
+            session.header_parsed_ = true;
+        }
+
+        opj_cio_close(cio);
+        opj_destroy_cstr_info(&cstr_info);
+        opj_destroy_decompress(dinfo);
+        if (image)
+            opj_image_destroy(image);
+    }
 }
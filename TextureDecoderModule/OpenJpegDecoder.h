@@ -11,28 +11,48 @@
 
 namespace TextureDecoder
 {
-    //! OpenJpeg decoder that runs in a thread and serves decode requests, used internally by TextureService
+    //! OpenJpeg decoder that serves decode requests on the framework thread pool, used internally by TextureService
     class OpenJpegDecoder : public Foundation::ThreadTask
     {
     public:
         //! Constructor
         OpenJpegDecoder();
         
-        //! Work function
-        virtual void Work();
+        //! Destructor. Waits for the running decodes to finish.
+        virtual ~OpenJpegDecoder();
         
         //! Set maximum amount of decodes to perform per frame
         /*! \param decodes Amount of decodes per frame
          */
         void SetDecodesPerFrame(uint decodes);
+
+        //! Set whether full resolution JPEG2000 textures are block compressed (DXT1/DXT5) after decoding
+        /*! Set before the first decode request; the decodes read it from the thread pool without locking.
+            \param enable Whether to compress
+         */
+        void SetCompressTextures(bool enable) { compress_textures_ = enable; }
+        
+    protected:
+        //! Decodes one texture
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
         
     private:
         //! perform a decode & queue result
         /*! \param request decode request to serve
          */
         void PerformDecode(DecodeRequestPtr request);
+
+        //! Parses the main header of a JPEG2000 codestream into a decode session
+        /*! \param data Codestream
+            \param size Codestream size in bytes
+            \param session Session to fill in
+         */
+        void ParseHeader(unsigned char* data, uint size, DecodeSession& session);
         
         uint decodes_per_frame_;
+
+        //! Whether to block compress full resolution textures
+        bool compress_textures_;
     };
 }
 #endif
\ No newline at end of file
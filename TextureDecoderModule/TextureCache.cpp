@@ -6,6 +6,7 @@
 #include "AssetServiceInterface.h"
 
 #include "UiSettingsServiceInterface.h"
+#include "FrameScheduler.h"
 
 #include <QFile>
 #include <QDataStream>
@@ -14,16 +15,33 @@
 
 #include <QMessageBox>
 
+#include <boost/bind.hpp>
+
 namespace TextureDecoder
 {
+    //! Size of the metadata written in front of the texture data: components, width, height, level, format, data size
+    const uint TEXTURE_METADATA_SIZE = 6 * 4;
+
+    //! Record tag of textures with mipmaps. Their metadata has the amount of mipmaps appended, and they may be block
+    //! compressed. Records tagged with the plain texture type, imported from earlier versions, have no mipmaps.
+    const std::string TEXTURE_MIPMAPPED_TAG("Texture.Mipmapped");
+
+    //! Size of the metadata of mipmapped texture records
+    const uint TEXTURE_MIPMAPPED_METADATA_SIZE = TEXTURE_METADATA_SIZE + 4;
+
+    //! Name of the frame stage the pack store is compacted in
+    const std::string TEXTURE_CACHE_COMPACTION_STAGE("TextureCacheCompaction");
+
+    //! Default share of the frame for compacting the pack store
+    const f64 TEXTURE_CACHE_COMPACTION_SHARE = 0.02;
+
     TextureCache::TextureCache(Foundation::Framework* framework) :
         QObject(),
         framework_(framework),
         DEFAULT_TEXTURE_CACHE_DIR("texturecache"),
         cache_max_size_(0),
         cache_dir_(framework->GetPlatform()->GetApplicationDataDirectory().c_str()),
-        cache_everything_(false),
-        current_cache_size_(0)
+        cache_everything_(false)
     {
         // Set/init working directory
         if (!cache_dir_.exists(DEFAULT_TEXTURE_CACHE_DIR))
@@ -45,39 +63,49 @@ namespace TextureDecoder
             }
         }
 
-        // Check the current cache size
-        QFileInfoList file_info_list = cache_dir_.entryInfoList(QDir::Files);
-        foreach(QFileInfo info, file_info_list)
-            current_cache_size_ += info.size();
+        // Open the pack store
+        store_.reset(new Foundation::PackStore(cache_dir_.absolutePath(), "textures"));
+        if (store_->IsNew())
+            ImportLooseFiles();
+        CheckCacheSize(false);
+
+        framework_->GetFrameScheduler()->AddStage(TEXTURE_CACHE_COMPACTION_STAGE, TEXTURE_CACHE_COMPACTION_SHARE,
+            boost::bind(&TextureCache::CompactCache, this, _1, _2));
     }
 
     TextureCache::~TextureCache()
     {
+        Foundation::FrameSchedulerPtr scheduler = framework_->GetFrameScheduler();
+        if (scheduler)
+            scheduler->RemoveStage(TEXTURE_CACHE_COMPACTION_STAGE);
     }
 
     void TextureCache::StoreTexture(Foundation::TextureInterface *texture)
     {
         QString id = GetHash(texture->GetId());
-        QFile decoded_texture(GetFullPath(id));
-        if (!decoded_texture.exists())
+        if (!store_->Contains(id.toStdString()))
         {
-            if (!decoded_texture.open(QIODevice::ReadWrite))
-                return;
+            QByteArray record;
+            record.reserve(TEXTURE_MIPMAPPED_METADATA_SIZE + texture->GetDataSize());
 
             // Write metadata
-            QDataStream data_stream(&decoded_texture);
+            QDataStream data_stream(&record, QIODevice::WriteOnly);
             data_stream << texture->GetComponents()
                         << texture->GetWidth()
                         << texture->GetHeight()
                         << texture->GetLevel()
                         << texture->GetFormat()
-                        << (int)texture->GetDataSize();
+                        << (int)texture->GetDataSize()
+                        << texture->GetNumMipmaps();
 
             // Write data
             data_stream.writeRawData((const char *)texture->GetData(), texture->GetDataSize());
-      
-            decoded_texture.close();
-            current_cache_size_ += decoded_texture.size();
+
+            if (!store_->Store(id.toStdString(), TEXTURE_MIPMAPPED_TAG, (const u8 *)record.constData(), record.size()))
+            {
+                TextureDecoderModule::LogError("Could not store decoded texture " + id.left(7).toStdString() + "... to texture cache");
+                return;
+            }
 
             // Remove unneeded encoded asset cache entry for this texture
             boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
@@ -92,51 +120,52 @@ namespace TextureDecoder
     TextureResource *TextureCache::GetTexture(const std::string &texture_id)
     {
         QString id = GetHash(texture_id);
-        QFile decoded_texture(GetFullPath(id));
-        if (decoded_texture.exists())
-        {
-            if (!decoded_texture.open(QIODevice::ReadOnly))
-                return 0;
+        Foundation::PackBlob record = store_->Load(id.toStdString());
+        if (record.IsNull())
+            return 0;
 
-            int data_length, format, level;
-            uint components, width, height;
+        int data_length = -1, format, level;
+        uint components, width, height, mipmaps = 0;
+        bool mipmapped = record.GetTag() == TEXTURE_MIPMAPPED_TAG;
+        uint metadata_size = mipmapped ? TEXTURE_MIPMAPPED_METADATA_SIZE : TEXTURE_METADATA_SIZE;
 
-            // Read metadata
-            QDataStream data_stream(&decoded_texture);
+        // Read metadata
+        if (record.GetSize() >= metadata_size)
+        {
+            QByteArray metadata = QByteArray::fromRawData((const char *)record.GetData(), metadata_size);
+            QDataStream data_stream(metadata);
             data_stream >> components;
             data_stream >> width;
             data_stream >> height;
             data_stream >> level;
             data_stream >> format;
             data_stream >> data_length;
+            if (mipmapped)
+                data_stream >> mipmaps;
+        }
 
-            // Init TextureResource with metadata
-            TextureResource *texture = new TextureResource(texture_id, width, height, components);
-            texture->SetLevel(level);
-            texture->SetFormat(format);
+        if ((data_length < 0) || ((uint)data_length > record.GetSize() - metadata_size))
+        {
+            TextureDecoderModule::LogError("Corrupt decoded texture " + id.left(7).toStdString() + "... in cache, removing");
+            store_->Remove(id.toStdString());
+            return 0;
+        }
 
-            // Read data
-            char *data_str_ptr = (char*)texture->GetData();
-            data_stream.readRawData(data_str_ptr, data_length);
+        // Init TextureResource with metadata. The data is used straight from the cache record.
+        TextureResource *texture = new TextureResource(texture_id, width, height, components, record, metadata_size, data_length);
+        texture->SetLevel(level);
+        texture->SetFormat(format);
+        texture->SetNumMipmaps(mipmaps);
 
-            decoded_texture.close();
-            TextureDecoderModule::LogDebug("Found decoded texture " + id.left(7).toStdString() + "... from cache");
-            return texture;
-        }
-        return 0;
+        TextureDecoderModule::LogDebug("Found decoded texture " + id.left(7).toStdString() + "... from cache");
+        return texture;
     }
 
     void TextureCache::DeleteFromCache(const std::string &texture_id)
     {
         QString id = GetHash(texture_id);
-        QFile decoded_texture(GetFullPath(id));
-        if (decoded_texture.exists())
-        {
-            if (decoded_texture.remove())
-                TextureDecoderModule::LogDebug("Removed decoded texture " + id.left(7).toStdString() + "... from cache");
-            else
-                TextureDecoderModule::LogDebug("Could not remove decoded texture " + id.left(7).toStdString() + "... from cache. I/O error.");
-        }
+        if (store_->Remove(id.toStdString()))
+            TextureDecoderModule::LogDebug("Removed decoded texture " + id.left(7).toStdString() + "... from cache");
         else
             TextureDecoderModule::LogDebug("Decoded texture " + id.left(7).toStdString() + "... was not in cache. Could not remove.");
     }
@@ -146,8 +175,8 @@ namespace TextureDecoder
         if (cache_max_size_ == 0)
             return;
 
-        // Remove files as long as we are under limit again
-        if (current_cache_size_ > cache_max_size_)
+        // Remove least recently used textures as long as we are under limit again
+        if (store_->GetLiveBytes() > (u64)cache_max_size_)
         {
             int aimed_size = cache_max_size_;
             if (make_extra_space)
@@ -155,27 +184,22 @@ namespace TextureDecoder
             if (aimed_size < 1)
                 return;
 
-            qint64 removed_bytes = 0;
-            int removed_files = 0;
-
-            QFileInfoList file_info_list = cache_dir_.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
-            foreach(QFileInfo info, file_info_list)
-            {
-                qint64 current_file_size = info.size();
-                if (!cache_dir_.remove(info.fileName()))
-                    continue;
-                removed_files++;
-                removed_bytes += current_file_size;
-                current_cache_size_ -= current_file_size;
-                if (current_cache_size_ < aimed_size)
-                    break;
-            }
+            u64 removed_bytes = 0;
+            uint removed_files = store_->Trim(aimed_size, &removed_bytes);
 
             TextureDecoderModule::LogInfo("Texture cache was over limit. Removed " + QString::number(removed_files).toStdString() + 
-                " files, total of " + QString::number(removed_bytes).toStdString() + " bytes");
+                " textures, total of " + QString::number(removed_bytes).toStdString() + " bytes");
         }
     }
 
+    bool TextureCache::CompactCache(f64 frametime, const Foundation::FrameBudget& budget)
+    {
+        // Copying all live textures takes seconds for a large cache, so it is spread over frames
+        if ((!store_->IsCompacting()) && (!store_->NeedsCompaction()))
+            return true;
+        return store_->Compact(budget);
+    }
+
     void TextureCache::ReadConfig()
     {
         QSettings cache_config(QSettings::IniFormat, QSettings::UserScope, APPLICATION_NAME, "configuration/CacheSettings");
@@ -196,32 +220,20 @@ namespace TextureDecoder
 
     void TextureCache::ClearCache()
     {
-        QFileInfoList file_info_list = cache_dir_.entryInfoList(QDir::Files);
-        if (file_info_list.count() > 0)
+        if (store_->GetNumRecords() > 0)
         {
-            qint64 removed_bytes = 0;
-            int removed_files = 0;
-            foreach(QFileInfo info, file_info_list)
-            {
-                qint64 temp_size = info.size();
-                if (cache_dir_.remove(info.fileName()))
-                {
-                    removed_files++;
-                    removed_bytes += temp_size;
-                }
-            }
+            u64 removed_bytes = store_->GetLiveBytes();
+            uint removed_files = store_->GetNumRecords();
+            store_->Clear();
 
             // Notify user
             qreal removed_bytes_f = removed_bytes;
             QString mb_string = QString::number(((removed_bytes_f/1024)/1024));
             mb_string = mb_string.left(mb_string.indexOf(".")+3);
-            QMessageBox::information(0, "Texture Cache", QString("Texture cache cleared, removed %1 files total of " + mb_string + " mb").arg(removed_files));
-
-            // Reset tracking size
-            current_cache_size_ = 0;
+            QMessageBox::information(0, "Texture Cache", QString("Texture cache cleared, removed %1 textures total of " + mb_string + " mb").arg(removed_files));
         }
         else
-            QMessageBox::information(0, "Texture Cache", "There are currently no files in texture cache");
+            QMessageBox::information(0, "Texture Cache", "There are currently no textures in texture cache");
     }
 
     QString TextureCache::GetHash(const std::string &id)
@@ -237,4 +249,30 @@ namespace TextureDecoder
     {
         return QString(cache_dir_.absolutePath() + "/" + hash_id + ".decoded.Texture");
     }
+
+    void TextureCache::ImportLooseFiles()
+    {
+        QFileInfoList file_info_list = cache_dir_.entryInfoList(QStringList("*.decoded.Texture"), QDir::Files);
+        if (file_info_list.isEmpty())
+            return;
+
+        int imported = 0;
+        foreach(QFileInfo info, file_info_list)
+        {
+            QFile decoded_texture(info.absoluteFilePath());
+            if (!decoded_texture.open(QIODevice::ReadOnly))
+                continue;
+            QByteArray record = decoded_texture.readAll();
+            decoded_texture.close();
+
+            QString id = info.fileName().left(info.fileName().indexOf('.'));
+            if (store_->Store(id.toStdString(), TextureResource::GetTypeStatic(), (const u8 *)record.constData(), record.size()))
+            {
+                cache_dir_.remove(info.fileName());
+                ++imported;
+            }
+        }
+
+        TextureDecoderModule::LogInfo("Imported " + QString::number(imported).toStdString() + " textures to the texture cache pack");
+    }
 }
\ No newline at end of file
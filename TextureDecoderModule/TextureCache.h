@@ -7,8 +7,11 @@
 #include <QDir>
 
 #include "Foundation.h"
+#include "PackStore.h"
 #include "TextureResource.h"
 
+#include <boost/scoped_ptr.hpp>
+
 namespace TextureDecoder
 {
     //! Cache reply when texture is found,
@@ -65,15 +68,25 @@ namespace TextureDecoder
             //! Get full path of file to open it
             QString GetFullPath(QString hash_id);
 
+            //! Moves textures cached as individual files by earlier versions into the pack store
+            void ImportLooseFiles();
+
         private:
+            //! Compacts the pack store a few textures at a time. Run as the TextureCacheCompaction frame stage
+            /*! \return true if no compaction is left in progress
+             */
+            bool CompactCache(f64 frametime, const Foundation::FrameBudget& budget);
+
             Foundation::Framework* framework_;
 
             QString DEFAULT_TEXTURE_CACHE_DIR;
             QString cache_path_;
             QDir cache_dir_;
 
+            //! Decoded textures, keyed by texture id hash
+            boost::scoped_ptr<Foundation::PackStore> store_;
+
             bool cache_everything_;
-            int current_cache_size_;
             int cache_max_size_;
     };
 }
@@ -11,9 +11,17 @@ namespace TextureDecoder
         received_(0),
         width_(0),
         height_(0),
+        components_(0),
         levels_(-1),
         decoded_level_(-1),
-        next_level_(5)
+        next_level_(5),
+        decode_requested_bytes_(0),
+        decode_failed_(false),
+        session_(new DecodeSession()),
+        priority_(DEFAULT_TEXTURE_PRIORITY),
+        screen_size_(0),
+        sent_priority_(-1.0f),
+        sent_target_level_(-1)
     {
     }
     
@@ -25,9 +33,17 @@ namespace TextureDecoder
         received_(0),
         width_(0),
         height_(0),
+        components_(0),
         levels_(-1),
         decoded_level_(-1),
-        next_level_(5)
+        next_level_(5),
+        decode_requested_bytes_(0),
+        decode_failed_(false),
+        session_(new DecodeSession()),
+        priority_(DEFAULT_TEXTURE_PRIORITY),
+        screen_size_(0),
+        sent_priority_(-1.0f),
+        sent_target_level_(-1)
     {
     }
     
@@ -43,13 +59,55 @@ namespace TextureDecoder
         // If has all data, can decode the max. quality level
         if ((size_) && (received >= size_))
             next_level_ = 0;
+        else
+            SkipToBestLevel();
     }
      
     bool TextureRequest::HasEnoughData() const
     {
+        // Decoding the same bytes again is only worth it for a finer level than they were decoded to, which happens
+        // when the texture is drawn larger than before. Not if they failed to decode
+        if ((decoded_level_ >= 0) && (received_ <= decode_requested_bytes_) && ((decode_failed_) || (next_level_ >= decoded_level_)))
+            return false;
+
+        // Nor would a finer level than the texture is drawn at, unless all data is there anyway
+        if ((decoded_level_ >= 0) && (decoded_level_ <= GetTargetLevel()) && (next_level_ > 0))
+            return false;
+
         return received_ >= EstimateDataSize(next_level_);
     }
 
+    void TextureRequest::SkipToBestLevel()
+    {
+        // The coarsest level that exists in the codestream
+        if ((session_->resolutions_ > 0) && (next_level_ > session_->resolutions_ - 1))
+            next_level_ = session_->resolutions_ - 1;
+
+        // Until the dimensions are known, all levels have the same estimate, so there is nothing to base a skip on
+        if ((!width_) || (!height_) || (!components_))
+            return;
+
+        // Go directly to the finest level the data is enough for, rather than decoding each level in between, but no
+        // further than the texture is drawn at
+        int target_level = GetTargetLevel();
+        while ((next_level_ > target_level) && (received_ >= EstimateDataSize(next_level_ - 1)))
+            --next_level_;
+    }
+
+    int TextureRequest::GetTargetLevel() const
+    {
+        if ((!screen_size_) || (!width_) || (!height_))
+            return 0;
+
+        int max_level = session_->resolutions_ > 0 ? session_->resolutions_ - 1 : next_level_;
+        uint size = width_ > height_ ? width_ : height_;
+        int level = 0;
+        while ((level < max_level) && ((size >> (level + 1)) >= screen_size_))
+            ++level;
+
+        return level;
+    }
+
     uint TextureRequest::EstimateDataSize(int level) const
     {
         if (level < 0) level = 0;
@@ -81,10 +139,22 @@ namespace TextureDecoder
         {
             // Decode no longer pending
             decode_requested_ = false;
+            decode_failed_ = !result->texture_;
 
             // Update amount of quality levels, should now be known
             levels_ = result->max_levels_;
             
+            // Texture original dimensions are known once the main header has been parsed, even if the decode failed
+            if (session_->header_parsed_)
+            {
+                width_ = session_->width_;
+                height_ = session_->height_;
+                components_ = session_->components_;
+            }
+
+            // The decoder may have clamped the level to the amount of resolutions in the codestream
+            int level = next_level_;
+
             // See if successfully decoded data
             if (result->texture_)
             {
@@ -92,16 +162,18 @@ namespace TextureDecoder
                 width_ = result->original_width_;
                 height_ =  result->original_height_;
                 components_ = result->components_;
-                       
-                decoded_level_ = next_level_;  
+
+                level = result->level_;
+                decoded_level_ = level;
             }
             
             // Set next quality level to decode
             // We do this regardless of success or failure, so that illegal texture data will
             // not cause endless re-decoding attempts
-            if (next_level_ > 0)
+            if (level > 0)
             {
-                next_level_--;
+                next_level_ = level - 1;
+                SkipToBestLevel();
                 return false;
             }
         }
@@ -9,6 +9,47 @@
 
 namespace TextureDecoder
 {
+    //! Codestream state of one texture, kept across its progressive decodes. Used internally by TextureService
+    /*! The decoder parses the JPEG2000 main header once, on the first decode of the texture, and stores what it found
+        here. TextureRequest uses the stored state to pick the finest resolution the received data allows, instead of
+        stepping through every resolution level with a full decode each.
+
+        Only one decode of a texture is in progress at a time, and the main thread reads the session only after the
+        result has been queued, so the session needs no locking.
+     */
+    struct DecodeSession
+    {
+        DecodeSession() :
+            header_parsed_(false),
+            width_(0),
+            height_(0),
+            components_(0),
+            resolutions_(0),
+            layers_(0)
+        {
+        }
+
+        //! Whether the main header has been parsed
+        bool header_parsed_;
+
+        //! Image width at full resolution
+        uint width_;
+
+        //! Image height at full resolution
+        uint height_;
+
+        //! Amount of components
+        uint components_;
+
+        //! Amount of resolution levels in the codestream; the coarsest decodable level is resolutions_ - 1
+        int resolutions_;
+
+        //! Amount of quality layers in the codestream
+        int layers_;
+    };
+
+    typedef boost::shared_ptr<DecodeSession> DecodeSessionPtr;
+
     //! OpenJpeg decode request, used internally by TextureService
     class DecodeRequest : public Foundation::ThreadTaskRequest
     {
@@ -21,6 +62,9 @@ namespace TextureDecoder
 
         //! Quality level to decode, 0 = highest
         int level_;
+
+        //! Decode session of the texture
+        DecodeSessionPtr session_;
     };
 
     typedef boost::shared_ptr<DecodeRequest> DecodeRequestPtr;
@@ -55,6 +99,9 @@ namespace TextureDecoder
     
     typedef boost::shared_ptr<DecodeResult> DecodeResultPtr;
 
+    //! Priority of texture requests that have not been given one
+    const f32 DEFAULT_TEXTURE_PRIORITY = 100.0f;
+
     //! An ongoing texture request, used internally by TextureService
     class TextureRequest
     {
@@ -74,7 +121,12 @@ namespace TextureDecoder
         void SetRequested(bool requested) { requested_ = requested; }
 
         //! Sets decode request status
-        void SetDecodeRequested(bool requested) { decode_requested_ = requested; }
+        void SetDecodeRequested(bool requested)
+        {
+            decode_requested_ = requested;
+            if (requested)
+                decode_requested_bytes_ = received_;
+        }
 
         //! Updates size & received count
         /*! \param size Total size of asset (from asset service)
@@ -135,6 +187,27 @@ namespace TextureDecoder
 
         //! Returns next level to decode
         int GetNextLevel() const { return next_level_; }
+
+        //! Returns the decode session of the texture
+        const DecodeSessionPtr& GetSession() const { return session_; }
+
+        //! Sets priority, and the size the texture is drawn at
+        /*! \param priority Priority, higher is served first
+            \param screen_size Largest size the texture is drawn at in pixels, 0 if not known
+         */
+        void SetPriority(f32 priority, uint screen_size) { priority_ = priority; screen_size_ = screen_size; }
+
+        //! Returns priority
+        f32 GetPriority() const { return priority_; }
+
+        //! Returns the coarsest quality level that still covers the drawn size; decoding stops there
+        int GetTargetLevel() const;
+
+        //! Returns whether priority or target level has changed since they were passed to the asset service
+        bool IsPriorityChanged() const { return (priority_ != sent_priority_) || (GetTargetLevel() != sent_target_level_); }
+
+        //! Marks the current priority and target level passed to the asset service
+        void SetPrioritySent() { sent_priority_ = priority_; sent_target_level_ = GetTargetLevel(); }
         
         //! List of request tags associated with this transfer
         RequestTagVector tags_;
@@ -144,6 +217,9 @@ namespace TextureDecoder
         /*! \param level quality level
          */
         uint EstimateDataSize(int level) const;
+
+        //! Moves the next level to the finest level that the received data is estimated to be enough for
+        void SkipToBestLevel();
         
         //! Asset on which this request is based
         std::string id_;
@@ -176,7 +252,28 @@ namespace TextureDecoder
         int decoded_level_;
 
         //! Next quality level to decode
-        int next_level_;     
+        int next_level_;
+
+        //! Received bytes at the time of the last decode request
+        uint decode_requested_bytes_;
+
+        //! Whether the last decode failed
+        bool decode_failed_;
+
+        //! Codestream state shared with the decoder
+        DecodeSessionPtr session_;
+
+        //! Priority
+        f32 priority_;
+
+        //! Largest size the texture is drawn at in pixels, 0 if not known
+        uint screen_size_;
+
+        //! Priority last passed to the asset service, negative if none
+        f32 sent_priority_;
+
+        //! Target level last passed to the asset service, negative if none
+        int sent_target_level_;
     };
 }
 #endif
\ No newline at end of file
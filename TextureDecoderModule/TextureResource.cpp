@@ -11,8 +11,11 @@ namespace TextureDecoder
         width_(0),
         height_(0),
         components_(0),
+        data_size_(0),
         level_(-1),
-        format_(-1)
+        format_(-1),
+        mipmaps_(0),
+        storage_offset_(0)
     {
     }
 
@@ -22,12 +25,28 @@ namespace TextureDecoder
         height_(height),
         components_(components),
         level_(-1),
-        format_(-1)
+        format_(-1),
+        mipmaps_(0),
+        storage_offset_(0)
     {
         data_.resize(width * height * components);
         data_size_ = width * height * components;
     }
 
+    TextureResource::TextureResource(const std::string& id, uint width, uint height, uint components, const Foundation::PackBlob& storage, uint offset, uint data_size) :
+        TextureInterface(id),
+        width_(width),
+        height_(height),
+        components_(components),
+        data_size_(data_size),
+        level_(-1),
+        format_(-1),
+        mipmaps_(0),
+        storage_(storage),
+        storage_offset_(offset)
+    {
+    }
+
     TextureResource::~TextureResource()
     {
     }
@@ -38,8 +57,41 @@ namespace TextureDecoder
         height_ = height;
         components_ = components;
 
+        storage_ = Foundation::PackBlob();
+        storage_offset_ = 0;
         data_.resize(width * height * components);
         data_size_ = width * height * components;
+        mipmaps_ = 0;
+    }
+
+    void TextureResource::SetCompressedData(std::vector<u8>& data, int format, uint mipmaps)
+    {
+        storage_ = Foundation::PackBlob();
+        storage_offset_ = 0;
+        data_.swap(data);
+        data.clear();
+        data_size_ = data_.size();
+        format_ = format;
+        mipmaps_ = mipmaps;
+    }
+
+    u8* TextureResource::GetWritableData()
+    {
+        if (!storage_.IsNull())
+        {
+            const u8* data = storage_.GetData() + storage_offset_;
+            data_.assign(data, data + data_size_);
+            storage_ = Foundation::PackBlob();
+            storage_offset_ = 0;
+        }
+        return &data_[0];
+    }
+
+    bool TextureResource::GetPixels(std::vector<u8>& pixels)
+    {
+        if (IsCompressed())
+            return DecompressTexture(GetData(), width_, height_, format_, components_, pixels);
+        return TextureInterface::GetPixels(pixels);
     }
 
     static const std::string texture_resource_name("Texture");
@@ -56,6 +108,6 @@ namespace TextureDecoder
     
     bool TextureResource::IsValid() const
     {
-        return data_.size() > 0;
+        return (data_.size() > 0) || (!storage_.IsNull());
     }
 }
\ No newline at end of file
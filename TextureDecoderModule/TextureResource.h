@@ -4,6 +4,8 @@
 #define incl_TextureDecoder_TextureResource_h
 
 #include "TextureInterface.h"
+#include "PackStore.h"
+#include "BlockCompressor.h"
 
 namespace TextureDecoder
 {
@@ -12,6 +14,8 @@ namespace TextureDecoder
     public:
         TextureResource(const std::string& id);
         TextureResource(const std::string& id, uint width, uint height, uint components);
+        //! Constructs a texture whose data is read directly from a texture cache record, without copying
+        TextureResource(const std::string& id, uint width, uint height, uint components, const Foundation::PackBlob& storage, uint offset, uint data_size);
         virtual ~TextureResource();
 
         virtual bool IsValid() const;
@@ -19,9 +23,11 @@ namespace TextureDecoder
         virtual uint GetHeight() const { return height_; }
         virtual uint GetComponents() const { return components_; }
         virtual int GetLevel() const { return level_; }
-        virtual u8* GetData() { return &data_[0]; }
+        virtual const u8* GetData() { return storage_.IsNull() ? &data_[0] : storage_.GetData() + storage_offset_; }
         virtual uint GetDataSize() { return data_size_; }
         virtual int GetFormat() { return format_; }
+        virtual uint GetNumMipmaps() const { return mipmaps_; }
+        virtual bool GetPixels(std::vector<u8>& pixels);
         virtual const std::string& GetType() const;
         static const std::string& GetTypeStatic();
 
@@ -31,6 +37,20 @@ namespace TextureDecoder
         void SetHeight(uint height) { height_ = height; }
         void SetLevel(int level) { level_ = level; }
         void SetFormat(int format) { format_ = format; }
+        void SetNumMipmaps(uint mipmaps) { mipmaps_ = mipmaps; }
+
+        //! Returns the data for writing. Data read from a cache record is copied first, as the record is read-only.
+        u8* GetWritableData();
+
+        //! Returns true if the data is block compressed
+        bool IsCompressed() const { return (format_ == PIXEL_FORMAT_DXT1) || (format_ == PIXEL_FORMAT_DXT5); }
+
+        //! Replaces the data with block compressed data. Takes the contents of data, leaving it empty.
+        /*! \param data Compressed levels, largest first
+            \param format Ogre pixel format of the data
+            \param mipmaps Amount of levels after the first one
+         */
+        void SetCompressedData(std::vector<u8>& data, int format, uint mipmaps);
 
     private:
         uint width_;
@@ -39,7 +59,11 @@ namespace TextureDecoder
         uint data_size_;
         int format_;
         int level_;
+        uint mipmaps_;
         std::vector<u8> data_;
+        //! Cache record holding the data instead of data_, if any. Read-only.
+        Foundation::PackBlob storage_;
+        uint storage_offset_;
     };
 }
 
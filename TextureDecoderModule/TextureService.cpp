@@ -19,6 +19,8 @@
 
 #include <QStringList>
 
+#include <algorithm>
+
 namespace TextureDecoder
 {
     static const int DEFAULT_MAX_DECODES = 4;
@@ -35,17 +37,25 @@ namespace TextureDecoder
         if (max_decodes_per_frame_ <= 0) 
             max_decodes_per_frame_ = 1;
 
-        // Create decoder thread task and let the framework thread task manager handle it
-        OpenJpegDecoder* decoder = new OpenJpegDecoder();
-        decoder->SetDecodesPerFrame(max_decodes_per_frame_);
+        // Block compressed textures take 1/4 (DXT5) or 1/8 (DXT1) of the memory, in the cache and on the GPU
+        bool compress_textures = framework_->GetDefaultConfig().DeclareSetting("TextureDecoder", "compress_textures", false);
 
+        // Create decoder task and let the framework thread task manager handle it. The decodes run on the thread pool.
+        OpenJpegDecoder* decoder = new OpenJpegDecoder();
+        decoder->SetCompressTextures(compress_textures);
         framework_->GetThreadTaskManager()->AddThreadTask(Foundation::ThreadTaskPtr(decoder));
+        decoder->SetDecodesPerFrame(max_decodes_per_frame_);
     }
     
     TextureService::~TextureService()
     {
     }
 
+    bool TextureService::CompareRequestPriority(const TextureRequest* lhs, const TextureRequest* rhs)
+    {
+        return lhs->GetPriority() > rhs->GetPriority();
+    }
+
     request_tag_t TextureService::RequestTexture(const std::string& asset_id)
     {
         request_tag_t tag = framework_->GetEventManager()->GetNextRequestTag();
@@ -140,21 +150,27 @@ namespace TextureDecoder
         foreach(QString sent, sent_replys)
             cache_replys_.erase(sent.toStdString());
 
-        // Check if assets have enough data to queue decode requests
-        TextureRequestMap::iterator i = requests_.begin();
-        while (i != requests_.end())
-        {
-            UpdateRequest(i->second, asset_service.get());
-            ++i;
-        }
+        // Check if assets have enough data to queue decode requests, highest priority first so that the most visible
+        // textures get to the decoder first
+        std::vector<TextureRequest*> sorted_requests;
+        sorted_requests.reserve(requests_.size());
+        for (TextureRequestMap::iterator i = requests_.begin(); i != requests_.end(); ++i)
+            sorted_requests.push_back(&i->second);
+        std::stable_sort(sorted_requests.begin(), sorted_requests.end(), CompareRequestPriority);
+
+        for (uint j = 0; j < sorted_requests.size(); ++j)
+            UpdateRequest(*sorted_requests[j], asset_service.get());
+    }
+
+    void TextureService::SetTexturePriority(const std::string& asset_id, float priority, uint screen_size)
+    {
+        TextureRequestMap::iterator i = requests_.find(asset_id);
+        if (i != requests_.end())
+            i->second.SetPriority(priority, screen_size);
     }
     
     void TextureService::UpdateRequest(TextureRequest& request, Foundation::AssetServiceInterface* asset_service)
     {
-        // If pending decode request, do nothing; wait for the result
-        if (request.IsDecodeRequested())
-            return;
-
         // If asset not yet requested, request now
         if (!request.IsRequested())
         {
@@ -162,6 +178,17 @@ namespace TextureDecoder
             request.SetRequested(true);
         }
 
+        // Let the asset provider know how urgent the texture is, and how much of it is needed
+        if (request.IsPriorityChanged())
+        {
+            asset_service->SetAssetPriority(request.GetId(), request.GetPriority(), request.GetTargetLevel());
+            request.SetPrioritySent();
+        }
+
+        // If pending decode request, do nothing more; wait for the result
+        if (request.IsDecodeRequested())
+            return;
+
         uint size = 0;
         uint received = 0;
         uint received_continuous = 0;
@@ -181,6 +208,7 @@ namespace TextureDecoder
                 new_decode_request->id_ = request.GetId();
                 new_decode_request->level_ = request.GetNextLevel();
                 new_decode_request->source_ = asset;
+                new_decode_request->session_ = request.GetSession();
                 framework_->GetThreadTaskManager()->AddRequest<DecodeRequest>("TextureDecoder", new_decode_request);
                 
                 request.SetDecodeRequested(true);
@@ -33,6 +33,13 @@ namespace TextureDecoder
          */
         virtual request_tag_t RequestTexture(const std::string& asset_id);
 
+        //! Sets priority of an ongoing texture request
+        /*! \param asset_id asset ID of texture
+            \param priority priority, higher is served first
+            \param screen_size largest size the texture is drawn at in pixels, 0 if not known
+         */
+        virtual void SetTexturePriority(const std::string& asset_id, float priority, uint screen_size);
+
         //! Gets a texture rousource from cache
         //! @param texture_id as std::string
         //! @return valid ptr if found, 0 ptr if not
@@ -57,6 +64,9 @@ namespace TextureDecoder
          */
         void UpdateRequest(TextureRequest& request, Foundation::AssetServiceInterface* asset_service);
 
+        //! Orders texture requests by descending priority
+        static bool CompareRequestPriority(const TextureRequest* lhs, const TextureRequest* rhs);
+
         typedef std::map<std::string, TextureRequest> TextureRequestMap;
 
         typedef std::map<std::string, CacheReply> CacheReplys;
@@ -42,6 +42,7 @@ QImage *NaaliGraphicsView::BackBuffer()
 void NaaliGraphicsView::MarkViewUndirty()
 {
     dirtyRectangle = QRectF(-1, -1, -1, -1);
+    dirtyRegion = QRegion();
 }
 
 bool NaaliGraphicsView::IsViewDirty() const
@@ -54,6 +55,11 @@ QRectF NaaliGraphicsView::DirtyRectangle() const
     return dirtyRectangle;
 }
 
+QRegion NaaliGraphicsView::DirtyRegion() const
+{
+    return dirtyRegion;
+}
+
 void NaaliGraphicsView::drawBackground(QPainter *painter, const QRectF &rect)
 {
     // Default backgroudBrush for QGraphicsScene and QGraphicsView is NoBrush,
@@ -86,6 +92,7 @@ void NaaliGraphicsView::Resize(int newWidth, int newHeight)
     viewport()->setGeometry(0, 0, newWidth, newHeight);
     scene()->setSceneRect(viewport()->rect());          
     dirtyRectangle = QRectF(0, 0, newWidth, newHeight);
+    dirtyRegion = QRegion(0, 0, newWidth, newHeight);
 
     delete backBuffer;
     backBuffer = new QImage(newWidth, newHeight, QImage::Format_ARGB32);
@@ -146,7 +153,10 @@ void NaaliGraphicsView::HandleSceneChanged(const QList<QRectF> &rectangles)
     // We received an unknown-sized scene change message. Mark everything dirty! (I've no idea what Qt
     // means when it sends a message saying 'nothing changed').
     if (rectangles.size() == 0)
+    {
         dirtyRectangle = QRectF(0, 0, width(), height());
+        dirtyRegion = QRegion(0, 0, width(), height());
+    }
 #endif
 
     if (!IsViewDirty() && rectangles.size() > 0)
@@ -161,7 +171,9 @@ void NaaliGraphicsView::HandleSceneChanged(const QList<QRectF> &rectangles)
         dirtyRectangle.setTop(min(dirtyRectangle.top(), rectangles[i].top()-guardbandWidth));
         dirtyRectangle.setRight(max(dirtyRectangle.right(), rectangles[i].right()+guardbandWidth));
         dirtyRectangle.setBottom(max(dirtyRectangle.bottom(), rectangles[i].bottom()+guardbandWidth));
+        dirtyRegion += rectangles[i].toAlignedRect().adjusted(-guardbandWidth, -guardbandWidth, guardbandWidth, guardbandWidth);
     }
+    dirtyRegion &= QRegion(0, 0, width(), height());
     dirtyRectangle.setLeft(max<int>(dirtyRectangle.left(), 0));
     dirtyRectangle.setTop(max<int>(dirtyRectangle.top(), 0));
     dirtyRectangle.setRight(min<int>(dirtyRectangle.right(), width()));
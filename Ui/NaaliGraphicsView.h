@@ -7,6 +7,7 @@
 #include <QDropEvent>
 #include <QDragEnterEvent>
 #include <QDragMoveEvent>
+#include <QRegion>
 
 #include "NaaliUiFwd.h"
 #include "UiApi.h"
@@ -33,6 +34,10 @@ public:
     /// Returns the rectangle that represents the dirty area of the screen, pending a Qt repaint.
     QRectF DirtyRectangle() const;
 
+    /// Returns the dirty area of the screen as the union of the changed rectangles, pending a Qt repaint.
+    /// Smaller than DirtyRectangle() when several small items far apart have changed.
+    QRegion DirtyRegion() const;
+
 signals:
     /// Emitted when this widget has been resized to a new size.
     void WindowResized(int newWidth, int newHeight);    
@@ -50,6 +55,7 @@ public slots:
 private:
     QImage *backBuffer;
     QRectF dirtyRectangle;
+    QRegion dirtyRegion;
 
     /// This virtual function is overridden from the QGraphicsView original to disable any background drawing functionality.
     /// The NaaliGraphicsView background displays the 3D scene rendered using Ogre.
@@ -10,6 +10,7 @@
 #include "UiProxyWidget.h"
 
 #include "TextureServiceInterface.h"
+#include "AssetServiceInterface.h"
 #include "TextureResource.h"
 
 #include "OgreImage.h"
@@ -725,9 +726,16 @@ namespace WorldBuilding
             int comps = texture->GetComponents();
 
             // -1 means jpeg2000, lets use ogre to get the correct pixelformat
-            // as qt does not provide ABGR directly
-            if (ogre_format == -1)
+            // as qt does not provide ABGR directly. Block compressed jpeg2000 textures are decompressed first.
+            if ((ogre_format == -1) || (texture->IsCompressed()))
             {
+                std::vector<u8> pixels;
+                if (!texture->GetPixels(pixels))
+                {
+                    WorldBuildingModule::LogDebug(">> Failed to read texture pixels, skipping texture");
+                    return new_ref;
+                }
+
                 Ogre::Image image;
                 Ogre::PixelFormat ogre_image_format;
                 if (comps == 1)
@@ -743,7 +751,7 @@ namespace WorldBuilding
                     WorldBuildingModule::LogDebug(">> Failed to store material texture with ogre, unhandled comps: " + QString::number(comps).toStdString());
                     return new_ref;
                 }                
-                image.loadDynamicImage(texture->GetData(), texture->GetWidth(), texture->GetHeight(), ogre_image_format);
+                image.loadDynamicImage(&pixels[0], texture->GetWidth(), texture->GetHeight(), ogre_image_format);
                 image.save(tex_filename.toStdString());                           
                 new_ref = replace_url;
             }
@@ -805,17 +813,10 @@ namespace WorldBuilding
 
     QString SceneExporter::GetCacheFilename(const QString &asset_id, const QString &type)
     {
-        std::string temp = asset_id.toStdString();
-        QCryptographicHash md5_engine(QCryptographicHash::Md5);
-        md5_engine.addData(temp.c_str(), temp.size());
-        QString md5_hash(md5_engine.result().toHex());
-        md5_engine.reset();
-
-        QString cache_path = framework_->GetPlatform()->GetApplicationDataDirectory().c_str();
-        cache_path.append("/assetcache/");
-        cache_path.append(md5_hash);
-        cache_path.append(".");
-        cache_path.append(type);
-        return cache_path;
+        // The asset cache keeps its contents in a pack file, ask it for a file copy of the asset
+        Foundation::AssetServiceInterface *asset_service = framework_->GetService<Foundation::AssetServiceInterface>();
+        if (!asset_service)
+            return QString();
+        return asset_service->GetAbsoluteAssetPath(asset_id.toStdString(), type.toStdString());
     }
 }